@@ -259,6 +259,9 @@ bail:
     //action
     NSNumber* action = nil;
     
+    //rule info
+    NSMutableDictionary* info = nil;
+    
     //error
     NSError* error = nil;
 
@@ -387,16 +390,13 @@ bail:
     endpointAddrRegex = @(endpointType);
 
     //endpoint port
-    // ...set var, but also validate (digits only, and within 1-65535)
+    // ...set var, but also validate (a port, range, or list, all within 1-65535)
     endpointPort = (0 != self.endpointPort.stringValue.length) ? self.endpointPort.stringValue : VALUE_ANY;
-    if( (0 != self.endpointPort.stringValue.length) &&
-        (YES != [self.endpointPort.stringValue isEqualToString:VALUE_ANY]) &&
-        ( (NSNotFound != [endpointPort rangeOfCharacterFromSet:[[NSCharacterSet decimalDigitCharacterSet] invertedSet]].location) ||
-          (endpointPort.integerValue < 1) ||
-          (endpointPort.integerValue > 65535) ) )
+    if( (YES != [endpointPort isEqualToString:VALUE_ANY]) &&
+        (YES != isPortSpec(endpointPort)) )
     {
         //show alert
-        showAlert(NSAlertStyleWarning, NSLocalizedString(@"ERROR: invalid port", @"ERROR: invalid port"), [NSString stringWithFormat:NSLocalizedString(@"%@ is not a valid port number (1-65535)", @"%@ is not a valid port number (1-65535)"), endpointPort], @[NSLocalizedString(@"OK", @"OK")]);
+        showAlert(NSAlertStyleWarning, NSLocalizedString(@"ERROR: invalid port", @"ERROR: invalid port"), [NSString stringWithFormat:NSLocalizedString(@"%@ is not a valid port, port range, or list of ports (1-65535)", @"%@ is not a valid port, port range, or list of ports (1-65535)"), endpointPort], @[NSLocalizedString(@"OK", @"OK")]);
 
         //highlight offending field
         [self.endpointPort selectText:nil];
@@ -408,13 +408,23 @@ bail:
     //set action
     action = (self.blockButton.state == NSControlStateValueOn) ? @RULE_STATE_BLOCK : @RULE_STATE_ALLOW;
     
+    //init info
+    info = [@{KEY_PATH:path,
+              KEY_ENDPOINT_ADDR:endpointAddr,
+              KEY_ENDPOINT_ADDR_IS_REGEX:endpointAddrRegex,
+              KEY_ENDPOINT_PORT:endpointPort,
+              KEY_TYPE:@RULE_TYPE_USER,
+              KEY_ACTION:action} mutableCopy];
+    
+    //editing a rule?
+    // keep its protocol (as it's not shown/editable)
+    if(nil != self.rule.protocol)
+    {
+        info[KEY_PROTOCOL] = self.rule.protocol;
+    }
+    
     //save all info
-    self.info = @{KEY_PATH:path,
-                  KEY_ENDPOINT_ADDR:endpointAddr,
-                  KEY_ENDPOINT_ADDR_IS_REGEX:endpointAddrRegex,
-                  KEY_ENDPOINT_PORT:endpointPort,
-                  KEY_TYPE:@RULE_TYPE_USER,
-                  KEY_ACTION:action};
+    self.info = info;
     
     //ok happy
     response = NSModalResponseOK;
@@ -0,0 +1,59 @@
+//
+//  file: RuleSearchIndex.h
+//  project: lulu (main app)
+//  description: (trigram) search index, for filtering rules (header)
+//
+//  created by Patrick Wardle
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#ifndef RuleSearchIndex_h
+#define RuleSearchIndex_h
+
+@import OSLog;
+@import Foundation;
+
+@class Rule;
+
+//min number of removed rules, before index is compacted
+#define RULE_SEARCH_COMPACT_MIN 1024
+
+//search index for rules
+// matches as '-[Rule matchesString:]' (name, path, pid, signing id, address, port, action), but w/o checking each rule
+// each rule's (searchable) fields are (lowercased &) appended to one buffer, w/ a trigram -> rules index over it
+// queries of 3+ chars intersect their trigrams' rules, shorter ones scan the buffer
+// an extended query (e.g. typing another char) only checks the previous query's matches
+// non-ascii queries (and rules), where localized case folding might differ from lowercasing, are checked via 'matchesString'
+// note: not thread safe, caller should sync
+@interface RuleSearchIndex : NSObject
+
+/* PROPERTIES */
+
+//number of (indexed) rules
+@property(nonatomic, readonly)NSUInteger count;
+
+/* METHODS */
+
+//add a rule
+// key is its item's key, so matches can be grouped by item
+-(void)add:(Rule*)rule key:(NSString*)key;
+
+//add all of an item's rules
+-(void)addItem:(NSDictionary*)item key:(NSString*)key;
+
+//remove a rule
+-(void)remove:(Rule*)rule;
+
+//remove all of an item's rules
+-(void)removeItem:(NSDictionary*)item;
+
+//remove all rules
+-(void)removeAllRules;
+
+//search
+// returns matching rules, by item key
+-(NSDictionary<NSString*, NSArray<Rule*>*>*)search:(NSString*)query;
+
+@end
+
+#endif /* RuleSearchIndex_h */
@@ -0,0 +1,632 @@
+//
+//  file: RuleSearchIndex.m
+//  project: lulu (main app)
+//  description: (trigram) search index, for filtering rules
+//
+//  created by Patrick Wardle
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#import "Rule.h"
+#import "consts.h"
+#import "RuleSearchIndex.h"
+
+#import <string.h>
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+//trigram
+// 3 (lowercased, utf-8) bytes
+#define TRIGRAM(bytes) (((uint32_t)(bytes)[0] << 16) | ((uint32_t)(bytes)[1] << 8) | (uint32_t)(bytes)[2])
+
+//compare (rule ids / trigrams)
+static int compareValues(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+
+    return (x > y) - (x < y);
+}
+
+@implementation RuleSearchIndex
+{
+    //(lowercased) text of all rules
+    // each rule's fields are '\n' terminated, so a match never spans fields (or rules)
+    NSMutableData* text;
+
+    //start of each rule's text
+    // index: rule id
+    NSMutableData* starts;
+
+    //end of each rule's text
+    // index: rule id
+    NSMutableData* ends;
+
+    //rules
+    // index: rule id, NSNull once removed
+    NSMutableArray* rules;
+
+    //item keys
+    // index: rule id
+    NSMutableArray<NSString*>* keys;
+
+    //rule ids
+    // key: rule's uuid
+    NSMutableDictionary<NSString*, NSNumber*>* ids;
+
+    //trigrams
+    // key: trigram, value: (sorted) ids of rules w/ it
+    NSMutableDictionary<NSNumber*, NSMutableData*>* trigrams;
+
+    //rules w/ non-ascii text
+    // (localized) case folding might differ from lowercasing, so these are always checked via 'matchesString'
+    NSMutableIndexSet* foldedRules;
+
+    //number of removed rules
+    // still in text & trigrams, until compacted
+    NSUInteger removed;
+
+    //previous query
+    // (lowercased, utf-8) for narrowing when it's extended
+    NSData* lastQuery;
+
+    //previous query's matches
+    // rule ids
+    NSData* lastMatches;
+}
+
+//init
+-(id)init
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //init
+        [self removeAllRules];
+    }
+
+    return self;
+}
+
+//number of rules
+-(NSUInteger)count
+{
+    return ids.count;
+}
+
+//rule's (searchable) text
+// fields (lowercased) that '-[Rule matchesString:]' checks
+-(NSData*)textForRule:(Rule*)rule
+{
+    //text
+    NSMutableString* ruleText = nil;
+
+    //action
+    NSString* action = nil;
+
+    //fields
+    NSMutableArray* fields = nil;
+
+    //init
+    ruleText = [NSMutableString string];
+    fields = [NSMutableArray array];
+
+    //action (as string)
+    // as (localized) in 'matchesString'
+    if(RULE_STATE_ALLOW == rule.action.integerValue)
+    {
+        action = NSLocalizedString(@"Allow", "@Allow");
+    }
+    else if(RULE_STATE_BLOCK == rule.action.integerValue)
+    {
+        action = NSLocalizedString(@"Block", @"Block");
+    }
+
+    //add each
+    if(nil != rule.name) [fields addObject:rule.name];
+    if(nil != rule.path) [fields addObject:rule.path];
+    if(nil != rule.pid) [fields addObject:rule.pid.stringValue];
+    if(YES == [rule.csInfo[KEY_CS_ID] isKindOfClass:[NSString class]]) [fields addObject:rule.csInfo[KEY_CS_ID]];
+    if(nil != rule.endpointAddr) [fields addObject:rule.endpointAddr];
+    if(nil != rule.endpointPort) [fields addObject:rule.endpointPort];
+    if(nil != action) [fields addObject:action];
+
+    //append
+    // lowercased (as queries are), and '\n' terminated
+    for(NSString* field in fields)
+    {
+        [ruleText appendString:[field lowercaseString]];
+        [ruleText appendString:@"\n"];
+    }
+
+    return [ruleText dataUsingEncoding:NSUTF8StringEncoding];
+}
+
+//add a rule
+-(void)add:(Rule*)rule key:(NSString*)key
+{
+    //rule's text
+    NSData* ruleText = nil;
+
+    //rule id
+    uint32_t ruleID = 0;
+
+    //offset
+    uint32_t offset = 0;
+
+    //trigrams
+    uint32_t* ruleTrigrams = NULL;
+
+    //number of trigrams
+    NSUInteger count = 0;
+
+    //number of unique trigrams
+    NSUInteger unique = 0;
+
+    //no uuid?
+    if(nil == rule.uuid) goto bail;
+
+    //already indexed?
+    // remove (old) first
+    if(nil != ids[rule.uuid]) [self remove:rule];
+
+    //init
+    ruleText = [self textForRule:rule];
+    ruleID = (uint32_t)rules.count;
+
+    //add text
+    offset = (uint32_t)text.length;
+    [starts appendBytes:&offset length:sizeof(offset)];
+    [text appendData:ruleText];
+    offset = (uint32_t)text.length;
+    [ends appendBytes:&offset length:sizeof(offset)];
+
+    //add rule
+    [rules addObject:rule];
+    [keys addObject:(nil != key) ? key : @""];
+    ids[rule.uuid] = @(ruleID);
+
+    //previous matches are stale
+    lastQuery = nil;
+    lastMatches = nil;
+
+    //non-ascii?
+    for(NSUInteger i = 0; i < ruleText.length; i++)
+    {
+        if(((const uint8_t*)ruleText.bytes)[i] >= 0x80)
+        {
+            [foldedRules addIndex:ruleID];
+            break;
+        }
+    }
+
+    //too short for trigrams?
+    if(ruleText.length < 3) goto bail;
+
+    //alloc
+    count = ruleText.length - 2;
+    ruleTrigrams = malloc(count * sizeof(uint32_t));
+    if(NULL == ruleTrigrams) goto bail;
+
+    //init
+    for(NSUInteger i = 0; i < count; i++)
+    {
+        ruleTrigrams[i] = TRIGRAM((const uint8_t*)ruleText.bytes + i);
+    }
+
+    //sort & unique
+    qsort(ruleTrigrams, count, sizeof(uint32_t), compareValues);
+    for(NSUInteger i = 0; i < count; i++)
+    {
+        if( (0 == i) || (ruleTrigrams[i] != ruleTrigrams[unique-1]) ) ruleTrigrams[unique++] = ruleTrigrams[i];
+    }
+
+    //add rule (id) to each trigram's rules
+    // ids only grow, so these stay sorted
+    for(NSUInteger i = 0; i < unique; i++)
+    {
+        //trigram's rules
+        NSMutableData* trigramRules = trigrams[@(ruleTrigrams[i])];
+        if(nil == trigramRules)
+        {
+            trigramRules = [NSMutableData data];
+            trigrams[@(ruleTrigrams[i])] = trigramRules;
+        }
+
+        //add
+        [trigramRules appendBytes:&ruleID length:sizeof(ruleID)];
+    }
+
+bail:
+
+    //free
+    if(NULL != ruleTrigrams) free(ruleTrigrams);
+
+    return;
+}
+
+//add all of an item's rules
+-(void)addItem:(NSDictionary*)item key:(NSString*)key
+{
+    for(Rule* rule in item[KEY_RULES])
+    {
+        [self add:rule key:key];
+    }
+}
+
+//remove a rule
+// marked as removed, then dropped once enough have been (see 'compact')
+-(void)remove:(Rule*)rule
+{
+    //rule id
+    NSNumber* ruleID = nil;
+
+    //get id
+    if(nil != rule.uuid) ruleID = ids[rule.uuid];
+    if(nil == ruleID) return;
+
+    //remove
+    [ids removeObjectForKey:rule.uuid];
+    rules[ruleID.unsignedIntValue] = [NSNull null];
+    [foldedRules removeIndex:ruleID.unsignedIntValue];
+    removed++;
+
+    //previous matches are stale
+    lastQuery = nil;
+    lastMatches = nil;
+
+    //compact?
+    if( (removed >= RULE_SEARCH_COMPACT_MIN) &&
+        (removed > ids.count) )
+    {
+        [self compact];
+    }
+
+    return;
+}
+
+//remove all of an item's rules
+-(void)removeItem:(NSDictionary*)item
+{
+    for(Rule* rule in item[KEY_RULES])
+    {
+        [self remove:rule];
+    }
+}
+
+//remove all rules
+-(void)removeAllRules
+{
+    //(re)init
+    text = [NSMutableData data];
+    starts = [NSMutableData data];
+    ends = [NSMutableData data];
+    rules = [NSMutableArray array];
+    keys = [NSMutableArray array];
+    ids = [NSMutableDictionary dictionary];
+    trigrams = [NSMutableDictionary dictionary];
+    foldedRules = [NSMutableIndexSet indexSet];
+    removed = 0;
+    lastQuery = nil;
+    lastMatches = nil;
+}
+
+//compact
+// (re)build w/ just the current rules
+-(void)compact
+{
+    //current rules
+    NSMutableArray* currentRules = nil;
+
+    //their keys
+    NSMutableArray* currentKeys = nil;
+
+    //init
+    currentRules = [NSMutableArray array];
+    currentKeys = [NSMutableArray array];
+
+    //dbg msg
+    os_log_debug(logHandle, "compacting rule search index (%lu rules, %lu removed)", (unsigned long)ids.count, (unsigned long)removed);
+
+    //grab current
+    for(NSUInteger i = 0; i < rules.count; i++)
+    {
+        if([NSNull null] == rules[i]) continue;
+
+        [currentRules addObject:rules[i]];
+        [currentKeys addObject:keys[i]];
+    }
+
+    //rebuild
+    [self removeAllRules];
+    for(NSUInteger i = 0; i < currentRules.count; i++)
+    {
+        [self add:currentRules[i] key:currentKeys[i]];
+    }
+
+    return;
+}
+
+//rules (ids) w/ all of a query's trigrams
+// smallest trigram list first, then intersected w/ the others
+-(NSMutableData*)candidates:(NSData*)query
+{
+    //candidates
+    NSMutableData* candidates = nil;
+
+    //each trigram's rules
+    NSMutableArray<NSData*>* lists = nil;
+
+    //init
+    lists = [NSMutableArray array];
+
+    //get each trigram's rules
+    for(NSUInteger i = 0; i + 3 <= query.length; i++)
+    {
+        //trigram's rules
+        NSData* trigramRules = trigrams[@(TRIGRAM((const uint8_t*)query.bytes + i))];
+
+        //none? no rule can match
+        if(nil == trigramRules) return [NSMutableData data];
+
+        //add
+        [lists addObject:trigramRules];
+    }
+
+    //sort
+    // smallest first
+    [lists sortUsingComparator:^NSComparisonResult(NSData* a, NSData* b) {
+        return [@(a.length) compare:@(b.length)];
+    }];
+
+    //start w/ smallest
+    candidates = [lists.firstObject mutableCopy];
+
+    //intersect w/ others
+    for(NSUInteger list = 1; list < lists.count; list++)
+    {
+        //candidate ids
+        uint32_t* candidateIDs = (uint32_t*)candidates.mutableBytes;
+
+        //list ids
+        const uint32_t* listIDs = (const uint32_t*)lists[list].bytes;
+
+        //counts
+        NSUInteger candidateCount = candidates.length / sizeof(uint32_t);
+        NSUInteger listCount = lists[list].length / sizeof(uint32_t);
+
+        //indices
+        NSUInteger c = 0, l = 0, kept = 0;
+
+        //merge
+        while( (c < candidateCount) && (l < listCount) )
+        {
+            if(candidateIDs[c] < listIDs[l]) c++;
+            else if(candidateIDs[c] > listIDs[l]) l++;
+            else { candidateIDs[kept++] = candidateIDs[c]; c++; l++; }
+        }
+
+        //update
+        candidates.length = kept * sizeof(uint32_t);
+        if(0 == kept) break;
+    }
+
+    return candidates;
+}
+
+//check rules (ids)
+// returns those (still indexed) whose text contains the query
+-(NSMutableData*)check:(NSData*)candidates query:(NSData*)query
+{
+    //matches
+    NSMutableData* matches = nil;
+
+    //ids
+    const uint32_t* candidateIDs = (const uint32_t*)candidates.bytes;
+
+    //offsets
+    const uint32_t* ruleStarts = (const uint32_t*)starts.bytes;
+    const uint32_t* ruleEnds = (const uint32_t*)ends.bytes;
+
+    //text
+    const uint8_t* bytes = (const uint8_t*)text.bytes;
+
+    //init
+    matches = [NSMutableData data];
+
+    //check each
+    for(NSUInteger i = 0; i < candidates.length / sizeof(uint32_t); i++)
+    {
+        //rule id
+        uint32_t ruleID = candidateIDs[i];
+
+        //removed? or non-ascii?
+        if( ([NSNull null] == rules[ruleID]) ||
+            (YES == [foldedRules containsIndex:ruleID]) ) continue;
+
+        //match?
+        if(NULL != memmem(bytes + ruleStarts[ruleID], ruleEnds[ruleID] - ruleStarts[ruleID], query.bytes, query.length))
+        {
+            [matches appendBytes:&ruleID length:sizeof(ruleID)];
+        }
+    }
+
+    return matches;
+}
+
+//scan (all) text
+// for queries too short for trigrams
+-(NSMutableData*)scan:(NSData*)query
+{
+    //matches
+    NSMutableData* matches = nil;
+
+    //offsets
+    const uint32_t* ruleEnds = (const uint32_t*)ends.bytes;
+
+    //text
+    const uint8_t* bytes = (const uint8_t*)text.bytes;
+
+    //position
+    NSUInteger position = 0;
+
+    //number of rules
+    NSUInteger count = ends.length / sizeof(uint32_t);
+
+    //init
+    matches = [NSMutableData data];
+
+    //find each
+    while(position < text.length)
+    {
+        //match
+        const uint8_t* match = memmem(bytes + position, text.length - position, query.bytes, query.length);
+        if(NULL == match) break;
+
+        //find rule
+        // first that ends after match
+        NSUInteger low = 0, high = count;
+        while(low < high)
+        {
+            NSUInteger middle = (low + high) / 2;
+            if(ruleEnds[middle] <= (NSUInteger)(match - bytes)) low = middle + 1;
+            else high = middle;
+        }
+        if(low >= count) break;
+
+        //add
+        // unless removed, or non-ascii
+        if( ([NSNull null] != rules[low]) &&
+            (YES != [foldedRules containsIndex:low]) )
+        {
+            uint32_t ruleID = (uint32_t)low;
+            [matches appendBytes:&ruleID length:sizeof(ruleID)];
+        }
+
+        //skip to next rule
+        position = ruleEnds[low];
+    }
+
+    return matches;
+}
+
+//search
+-(NSDictionary<NSString*, NSArray<Rule*>*>*)search:(NSString*)query
+{
+    //results
+    NSMutableDictionary* results = nil;
+
+    //matches
+    NSData* matches = nil;
+
+    //(lowercased) query
+    NSData* lowercased = nil;
+
+    //plain?
+    BOOL plain = YES;
+
+    //init
+    results = [NSMutableDictionary dictionary];
+
+    //no query?
+    if(0 == query.length) goto bail;
+
+    //plain (ascii, single line) query?
+    // else, (localized) case folding might differ from lowercasing, so check each rule (as before)
+    for(NSUInteger i = 0; i < query.length; i++)
+    {
+        unichar c = [query characterAtIndex:i];
+        if( (c >= 0x80) || ('\n' == c) || ('\r' == c) || (0 == c) ) { plain = NO; break; }
+    }
+
+    //or, one of the 'any' (exact) matches?
+    if( (YES == [query isEqualToString:NSLocalizedString(@"any address", @"any address")]) ||
+        (YES == [query isEqualToString:NSLocalizedString(@"any port", @"any port")]) )
+    {
+        plain = NO;
+    }
+
+    //not plain?
+    // check each rule
+    if(YES != plain)
+    {
+        //check each
+        for(NSUInteger i = 0; i < rules.count; i++)
+        {
+            //removed?
+            if([NSNull null] == rules[i]) continue;
+
+            //match?
+            if(YES == [(Rule*)rules[i] matchesString:query])
+            {
+                if(nil == results[keys[i]]) results[keys[i]] = [NSMutableArray array];
+                [results[keys[i]] addObject:rules[i]];
+            }
+        }
+
+        //previous matches don't apply
+        lastQuery = nil;
+        lastMatches = nil;
+
+        goto bail;
+    }
+
+    //lowercase
+    lowercased = [[query lowercaseString] dataUsingEncoding:NSUTF8StringEncoding];
+
+    //extends previous query?
+    // then only its matches can match
+    if( (nil != lastQuery) &&
+        (lastQuery.length <= lowercased.length) &&
+        (NULL != memmem(lowercased.bytes, lowercased.length, lastQuery.bytes, lastQuery.length)) )
+    {
+        matches = [self check:lastMatches query:lowercased];
+    }
+    //too short for trigrams?
+    else if(lowercased.length < 3)
+    {
+        matches = [self scan:lowercased];
+    }
+    //trigrams
+    else
+    {
+        matches = [self check:[self candidates:lowercased] query:lowercased];
+    }
+
+    //save
+    lastQuery = lowercased;
+    lastMatches = matches;
+
+    //group by item
+    for(NSUInteger i = 0; i < matches.length / sizeof(uint32_t); i++)
+    {
+        //rule id
+        uint32_t ruleID = ((const uint32_t*)matches.bytes)[i];
+
+        //add
+        if(nil == results[keys[ruleID]]) results[keys[ruleID]] = [NSMutableArray array];
+        [results[keys[ruleID]] addObject:rules[ruleID]];
+    }
+
+    //check non-ascii rules
+    // (few), via 'matchesString'
+    [foldedRules enumerateIndexesUsingBlock:^(NSUInteger ruleID, BOOL* stop) {
+
+        //match?
+        if(YES == [(Rule*)self->rules[ruleID] matchesString:query])
+        {
+            if(nil == results[self->keys[ruleID]]) results[self->keys[ruleID]] = [NSMutableArray array];
+            [results[self->keys[ruleID]] addObject:self->rules[ruleID]];
+        }
+    }];
+
+bail:
+
+    return results;
+}
+
+@end
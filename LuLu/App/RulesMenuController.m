@@ -9,6 +9,8 @@
 #import "consts.h"
 #import "utilities.h"
 #import "AppDelegate.h"
+#import "RulesReader.h"
+#import "RulesWriter.h"
 #import "XPCDaemonClient.h"
 #import "RulesMenuController.h"
 
@@ -46,15 +48,9 @@ extern XPCDaemonClient* xpcDaemonClient;
 // show panel then write out rules
 -(void)exportRules
 {
-    //count
-    __block NSUInteger count = 0;
-    
     //rules
     NSDictionary* rules = nil;
     
-    //error
-    __block NSError* error = nil;
-    
     //'browse' panel
     NSSavePanel *panel = nil;
     
@@ -95,101 +91,17 @@ extern XPCDaemonClient* xpcDaemonClient;
             //only user rules?
             BOOL exportUserOnly = (NSControlStateValueOn == userRulesOnly.state);
             
-            //rules (as JSON)
-            NSMutableString* json = [NSMutableString string];
-            
-            //start
-            [json appendString:@"{"];
-            
-            //covert each rule (set)
-            for(NSString* key in rules.allKeys)
-            {
-                //flag
-                BOOL hasPersistentRule = NO;
-                
-                //flag
-                BOOL hasUserCreatedRule = NO;
-                
-                //rule set
-                NSDictionary* ruleSet = nil;
-                
-                //extract
-                ruleSet = rules[key];
-                
-                //for a given item
-                // check all rules for persistent or user created
-                for(Rule* rule in rules[key][KEY_RULES])
-                {
-                    //not temp?
-                    if(!hasPersistentRule && ![rule isTemporary]) {
-                        hasPersistentRule = YES;
-                    }
-                    
-                    //user created (non temp rule)
-                    if(!hasUserCreatedRule && [rule isUserCreated] && ![rule isTemporary]) {
-                        hasUserCreatedRule = YES;
-                    }
-                }
-                
-                //skip if all item's rules are temp
-                if(YES != hasPersistentRule) {
-                    continue;
-                }
-                
-                //when exporting only user rules
-                //skip if all item's rules are *not* user created
-                if(exportUserOnly && !hasUserCreatedRule) {
-                    continue;
-                }
-                
-                //add key
-                [json appendFormat:@"\"%@\" : [", key];
-                
-                //covert each rule
-                for(Rule* rule in rules[key][KEY_RULES])
-                {
-                    //skip temp
-                    if(YES == [rule isTemporary]) {
-                        continue;
-                    }
-                    
-                    //skip non user created
-                    if(exportUserOnly && ![rule isUserCreated]) {
-                        continue;
-                    }
-                        
-                    //append rule
-                    [json appendFormat:@"{%@},", [rule toJSON]];
-                    
-                    //inc
-                    count++;
-                }
-                
-                //remove last ','
-                if(YES == [json hasSuffix:@","])
-                {
-                    //remove
-                    [json deleteCharactersInRange:NSMakeRange(json.length-1, 1)];
-                }
-                
-                //end
-                [json appendString:@"],"];
-            }
-            
-            //remove last ','
-            if(YES == [json hasSuffix:@","])
-            {
-                //remove
-                [json deleteCharactersInRange:NSMakeRange(json.length-1, 1)];
-            }
-            
-            //end
-            [json appendString:@"}"];
+            //writer
+            // streams rules (as JSON) to file
+            RulesWriter* writer = [[RulesWriter alloc] init:[NSOutputStream outputStreamWithURL:panel.URL append:NO]];
             
             //write out (converted) rules
             // then activate Finder and select file
-            if(YES == [json writeToURL:panel.URL atomically:NO encoding:NSUTF8StringEncoding error:&error])
+            if(YES == [writer write:rules userOnly:exportUserOnly])
             {
+                //dbg msg
+                os_log_debug(logHandle, "exported %lu rules", (unsigned long)writer.count);
+                
                 //activate Finder
                 [NSWorkspace.sharedWorkspace selectFile:panel.URL.path inFileViewerRootedAtPath:@""];
             }
@@ -197,7 +109,7 @@ extern XPCDaemonClient* xpcDaemonClient;
             else
             {
                 //err msg
-                os_log_error(logHandle, "ERROR: failed to save rules: %{public}@", error);
+                os_log_error(logHandle, "ERROR: failed to save rules to %{public}@", panel.URL.path);
                 
                 //show alert
                 showAlert(NSAlertStyleWarning, NSLocalizedString(@"ERROR: Failed to export rules",@"ERROR: Failed to export rules"), NSLocalizedString(@"See log for (more) details",@"See log for (more) details"), @[NSLocalizedString(@"OK", @"OK")]);
@@ -228,11 +140,8 @@ extern XPCDaemonClient* xpcDaemonClient;
     //count
     NSUInteger count = 0;
     
-    //rules data
-    NSData* data = nil;
-    
-    //rules from disk
-    NSDictionary* importedRules = nil;
+    //reader
+    RulesReader* reader = nil;
     
     //rules, as rules
     NSMutableDictionary* newRules = nil;
@@ -271,107 +180,58 @@ extern XPCDaemonClient* xpcDaemonClient;
         goto bail;
     }
     
-    //load rules from specified file
-    data = [NSData dataWithContentsOfFile:panel.URL.path options:NSDataReadingMappedIfSafe | NSDataReadingUncached error:&error];
-    if(nil == data)
-    {
-        //err msg
-        os_log_error(logHandle, "ERROR: failed to load (imported) rules from %{public}@ (error: %{public}@)", panel.URL.path, error);
-        goto bail;
-    }
-    
-    //deserialize
-    @try
-    {
-        //convert
-        importedRules = [NSJSONSerialization JSONObjectWithData:data options:kNilOptions error:&error];
-        if(nil == importedRules)
-        {
-            //error msg
-            os_log_error(logHandle, "ERROR: failed to convert imported rules from JSON (error: %{public}@)", error);
-            goto bail;
-        }
-    }
-    @catch(NSException* exception)
-    {
-        //bail
-        goto bail;
-    }
-    
-    //sanity check
-    if(YES != [importedRules isKindOfClass:[NSDictionary class]])
-    {
-        //err msg
-        os_log_error(logHandle, "ERROR: invalid format for imported rules (should be a dictionary, not a %{public}@)", importedRules.className);
-        goto bail;
-    }
-    
     //init
     newRules = [NSMutableDictionary dictionary];
     
-    //add each
-    for(NSString* key in importedRules)
-    {
-        //sanity check
-        if(YES != [importedRules[key] isKindOfClass:[NSArray class]])
-        {
-            //err msg
-            os_log_error(logHandle, "ERROR: invalid format for imported rules (should be an array, not a %{public}@)", [importedRules[key] className]);
-            goto bail;
+    //init reader
+    // streams (and validates) rules from file, so whole file (as JSON objects) is never in memory
+    reader = [[RulesReader alloc] init:[NSInputStream inputStreamWithURL:panel.URL]];
+    
+    //read each rule
+    if(YES != [reader read:^(NSString* key, Rule* rule) {
+        
+        //found a non-user created rule
+        // means we're going to do a full import
+        if(userOnlyImport && ![rule isUserCreated]) {
+            userOnlyImport = NO;
         }
         
-        //create rule obj for each
-        for(NSDictionary* importedRule in importedRules[key])
+        //first rule
+        // init dictionary, array, etc...
+        if(nil == newRules[key])
         {
-            //rule obj
-            Rule* rule = [[Rule alloc] initFromJSON:importedRule];
-           
-            //skip if invalid
-            if(nil == rule)
-            {
-                //err msg
-                os_log_error(logHandle, "ERROR: invalid format for imported rule: %{public}@", importedRule);
-                
-                //skip
-                continue;
-            }
-            
-            //found a non-user created rule
-            // means we're going to do a full import
-            if(userOnlyImport && ![rule isUserCreated]) {
-                userOnlyImport = NO;
-            }
-            
-            //inc
-            count++;
+            //init
+            newRules[key] = [NSMutableDictionary dictionary];
+            newRules[key][KEY_RULES] = [NSMutableArray array];
             
-            //first rule
-            // init dictionary, array, etc...
-            if(nil == newRules[key])
+            //add cs info
+            if(nil != rule.csInfo)
             {
-                //init
-                newRules[key] = [NSMutableDictionary dictionary];
-                newRules[key][KEY_RULES] = [NSMutableArray array];
-                
-                //add cs info
-                if(nil != rule.csInfo)
-                {
-                    //add
-                    newRules[key][KEY_CS_INFO] = rule.csInfo;
-                }
+                //add
+                newRules[key][KEY_CS_INFO] = rule.csInfo;
             }
-            
-            //add rule obj
-            [newRules[key][KEY_RULES] addObject:rule];
         }
+        
+        //add rule obj
+        [newRules[key][KEY_RULES] addObject:rule];
+        
+    }])
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to read (imported) rules from %{public}@ (%{public}@, at offset %lu)", panel.URL.path, reader.error, (unsigned long)reader.offset);
+        goto bail;
     }
     
+    //count
+    count = reader.count;
+    
     //archive rules
     archivedRules = [NSKeyedArchiver archivedDataWithRootObject:newRules requiringSecureCoding:YES error:&error];
     if(nil == archivedRules)
     {
         //err msg
         os_log_error(logHandle, "ERROR: failed to archive rules: %{public}@", error);
+        goto bail;
     }
     
     //dbg msg
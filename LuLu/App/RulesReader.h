@@ -0,0 +1,60 @@
+//
+//  file: RulesReader.h
+//  project: lulu (main app)
+//  description: streaming reader, for importing rules (as JSON) (header)
+//
+//  created by Patrick Wardle
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#ifndef RulesReader_h
+#define RulesReader_h
+
+@import OSLog;
+@import Foundation;
+
+@class Rule;
+
+//size of chunks read (from stream)
+#define RULES_READER_CHUNK_SIZE (64 * 1024)
+
+//max size of a (single) rule
+// larger ones are considered malformed, so memory stays bounded
+#define RULES_READER_MAX_RULE_SIZE (1024 * 1024)
+
+//streaming reader for (imported) rules
+// the document is scanned (in chunks) for each item's key & rules, and each rule is decoded & validated as soon as it's complete
+// ...so only one chunk (and one rule) are ever in memory, no matter how many rules
+// format: { "<item key>" : [ {<rule>}, ... ], ... }, as written by 'RulesWriter'
+@interface RulesReader : NSObject
+
+/* PROPERTIES */
+
+//number of (valid) rules read
+@property(nonatomic, readonly)NSUInteger count;
+
+//number of invalid rules
+// these are skipped (as before)
+@property(nonatomic, readonly)NSUInteger invalid;
+
+//number of bytes read
+// on error, offset of error
+@property(nonatomic, readonly)NSUInteger offset;
+
+//error
+// if document is malformed
+@property(nonatomic, retain, readonly)NSString* error;
+
+/* METHODS */
+
+//init
+-(id)init:(NSInputStream*)stream;
+
+//read (all) rules
+// each valid rule is passed to the block (w/ its item's key) as soon as it's read
+// returns NO if document is malformed, in which case any rules already passed to the block should be discarded
+-(BOOL)read:(void(^)(NSString* key, Rule* rule))block;
+
+@end
+
+#endif /* RulesReader_h */
@@ -0,0 +1,422 @@
+//
+//  file: RulesReader.m
+//  project: lulu (main app)
+//  description: streaming reader, for importing rules (as JSON)
+//
+//  created by Patrick Wardle
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#import "Rule.h"
+#import "consts.h"
+#import "RulesReader.h"
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+//reader states
+// i.e. what's expected next
+typedef NS_ENUM(NSInteger, RulesReaderState)
+{
+    RulesReaderStateDocument = 0,   //'{'
+    RulesReaderStateKey,            //item's key, or (if first) '}'
+    RulesReaderStateKeyString,      //(rest of) item's key
+    RulesReaderStateColon,          //':'
+    RulesReaderStateItem,           //'['
+    RulesReaderStateRule,           //rule, or (if first) ']'
+    RulesReaderStateRuleObject,     //(rest of) rule
+    RulesReaderStateAfterRule,      //',' or ']'
+    RulesReaderStateAfterItem,      //',' or '}'
+    RulesReaderStateDone            //nothing (but whitespace)
+};
+
+@implementation RulesReader
+{
+    //stream
+    NSInputStream* input;
+}
+
+@synthesize count;
+@synthesize error;
+@synthesize offset;
+@synthesize invalid;
+
+//init
+-(id)init:(NSInputStream*)stream
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //save
+        input = stream;
+    }
+
+    return self;
+}
+
+//read (all) rules
+// scans each chunk byte by byte, only buffering (the bytes of) the current key or rule
+-(BOOL)read:(void(^)(NSString* key, Rule* rule))block
+{
+    //result
+    BOOL result = NO;
+
+    //chunk
+    uint8_t* chunk = NULL;
+
+    //length (of chunk)
+    NSInteger length = 0;
+
+    //state
+    RulesReaderState state = RulesReaderStateDocument;
+
+    //first (key or rule)?
+    BOOL first = YES;
+
+    //in (rule's) string?
+    BOOL inString = NO;
+
+    //escaped (string) char?
+    BOOL escaped = NO;
+
+    //depth (of rule's objects/arrays)
+    NSUInteger depth = 0;
+
+    //current key or rule
+    NSMutableData* token = nil;
+
+    //current item's key
+    NSString* key = nil;
+
+    //init
+    count = 0;
+    invalid = 0;
+    offset = 0;
+    error = nil;
+    token = [NSMutableData data];
+
+    //alloc chunk
+    chunk = malloc(RULES_READER_CHUNK_SIZE);
+    if(NULL == chunk)
+    {
+        //error
+        error = @"failed to allocate buffer";
+        goto bail;
+    }
+
+    //open
+    [input open];
+
+    //read each chunk
+    while(YES)
+    {
+        //start of (current) token
+        // within chunk
+        NSInteger tokenStart = 0;
+
+        //read
+        length = [input read:chunk maxLength:RULES_READER_CHUNK_SIZE];
+        if(length < 0)
+        {
+            //error
+            error = [NSString stringWithFormat:@"failed to read (error: %@)", input.streamError];
+            goto bail;
+        }
+
+        //done?
+        if(0 == length) break;
+
+        //scan
+        for(NSInteger i = 0; i < length; i++)
+        {
+            //char
+            uint8_t c = chunk[i];
+
+            //in a token?
+            // just find its end
+            switch(state)
+            {
+                //key
+                case RulesReaderStateKeyString:
+
+                    //escaped? skip
+                    if(YES == escaped) escaped = NO;
+
+                    //escape
+                    else if('\\' == c) escaped = YES;
+
+                    //end
+                    // decode key
+                    else if('"' == c)
+                    {
+                        //append
+                        [token appendBytes:chunk + tokenStart length:i + 1 - tokenStart];
+
+                        //decode
+                        key = [self decodeKey:token];
+                        if(nil == key)
+                        {
+                            //error
+                            offset += i;
+                            error = @"invalid key";
+                            goto bail;
+                        }
+
+                        //next
+                        state = RulesReaderStateColon;
+                    }
+
+                    continue;
+
+                //rule
+                case RulesReaderStateRuleObject:
+
+                    //in string?
+                    if(YES == inString)
+                    {
+                        //escaped? skip
+                        if(YES == escaped) escaped = NO;
+
+                        //escape
+                        else if('\\' == c) escaped = YES;
+
+                        //end (of string)
+                        else if('"' == c) inString = NO;
+                    }
+
+                    //start (of string)
+                    else if('"' == c) inString = YES;
+
+                    //nested object/array
+                    else if( ('{' == c) || ('[' == c) ) depth++;
+
+                    //end (of nested object/array, or rule)
+                    else if( ('}' == c) || (']' == c) )
+                    {
+                        //end of rule?
+                        // decode, validate, & pass to block
+                        if(0 == --depth)
+                        {
+                            //append
+                            [token appendBytes:chunk + tokenStart length:i + 1 - tokenStart];
+
+                            //decode
+                            if(YES != [self decodeRule:token key:key block:block])
+                            {
+                                //error
+                                offset += i;
+                                error = @"invalid rule";
+                                goto bail;
+                            }
+
+                            //next
+                            state = RulesReaderStateAfterRule;
+                        }
+                    }
+
+                    continue;
+
+                default:
+                    break;
+            }
+
+            //skip whitespace
+            if( (' ' == c) || ('\t' == c) || ('\n' == c) || ('\r' == c) ) continue;
+
+            //structure
+            switch(state)
+            {
+                //start of document
+                // note: skip any (UTF-8) BOM
+                case RulesReaderStateDocument:
+
+                    if('{' == c) { state = RulesReaderStateKey; first = YES; continue; }
+                    if( (offset + i < 3) && ((0xEF == c) || (0xBB == c) || (0xBF == c)) ) continue;
+                    break;
+
+                //key
+                // or if first, end of (empty) document
+                case RulesReaderStateKey:
+
+                    if('"' == c) { token.length = 0; tokenStart = i; escaped = NO; state = RulesReaderStateKeyString; continue; }
+                    if( (YES == first) && ('}' == c) ) { state = RulesReaderStateDone; continue; }
+                    break;
+
+                //':'
+                case RulesReaderStateColon:
+
+                    if(':' == c) { state = RulesReaderStateItem; continue; }
+                    break;
+
+                //start of item's rules
+                case RulesReaderStateItem:
+
+                    if('[' == c) { state = RulesReaderStateRule; first = YES; continue; }
+                    break;
+
+                //rule
+                // or if first, end of (empty) item
+                case RulesReaderStateRule:
+
+                    if('{' == c) { token.length = 0; tokenStart = i; depth = 1; inString = NO; escaped = NO; state = RulesReaderStateRuleObject; continue; }
+                    if( (YES == first) && (']' == c) ) { state = RulesReaderStateAfterItem; continue; }
+                    break;
+
+                //next rule, or end of item
+                case RulesReaderStateAfterRule:
+
+                    if(',' == c) { state = RulesReaderStateRule; first = NO; continue; }
+                    if(']' == c) { state = RulesReaderStateAfterItem; continue; }
+                    break;
+
+                //next item, or end of document
+                case RulesReaderStateAfterItem:
+
+                    if(',' == c) { state = RulesReaderStateKey; first = NO; continue; }
+                    if('}' == c) { state = RulesReaderStateDone; continue; }
+                    break;
+
+                default:
+                    break;
+            }
+
+            //unexpected
+            offset += i;
+            error = [NSString stringWithFormat:@"unexpected character (0x%02x)", c];
+            goto bail;
+        }
+
+        //(still) in a token?
+        // save its part of chunk, as next chunk will overwrite it
+        if( (RulesReaderStateKeyString == state) ||
+            (RulesReaderStateRuleObject == state) )
+        {
+            //append
+            [token appendBytes:chunk + tokenStart length:length - tokenStart];
+
+            //too large?
+            if(token.length > RULES_READER_MAX_RULE_SIZE)
+            {
+                //error
+                offset += length;
+                error = @"rule (or key) too large";
+                goto bail;
+            }
+        }
+
+        //inc
+        offset += length;
+    }
+
+    //not done?
+    if(RulesReaderStateDone != state)
+    {
+        //error
+        error = @"truncated";
+        goto bail;
+    }
+
+    //dbg msg
+    os_log_debug(logHandle, "read %lu rules (%lu invalid), %lu bytes", (unsigned long)count, (unsigned long)invalid, (unsigned long)offset);
+
+    //happy
+    result = YES;
+
+bail:
+
+    //error?
+    if(nil != error)
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: malformed (imported) rules: %{public}@ (offset: %lu)", error, (unsigned long)offset);
+    }
+
+    //close
+    [input close];
+
+    //free
+    if(NULL != chunk) free(chunk);
+
+    return result;
+}
+
+//decode (item's) key
+// a JSON string, so unescaped via (fragment) deserialization
+-(NSString*)decodeKey:(NSData*)json
+{
+    //key
+    NSString* key = nil;
+
+    //decode
+    @try
+    {
+        key = [NSJSONSerialization JSONObjectWithData:json options:NSJSONReadingFragmentsAllowed error:nil];
+    }
+    @catch(NSException* exception)
+    {
+        key = nil;
+    }
+
+    //sanity check
+    if(YES != [key isKindOfClass:[NSString class]]) key = nil;
+
+    return key;
+}
+
+//decode (& validate) a rule
+// invalid rules are skipped (so only returns NO if it's not valid JSON)
+-(BOOL)decodeRule:(NSData*)json key:(NSString*)key block:(void(^)(NSString* key, Rule* rule))block
+{
+    //rule (as dictionary)
+    NSDictionary* info = nil;
+
+    //rule
+    Rule* rule = nil;
+
+    //pool
+    // so each rule's intermediate objects are freed as it's read
+    @autoreleasepool
+    {
+        //decode
+        @try
+        {
+            info = [NSJSONSerialization JSONObjectWithData:json options:kNilOptions error:nil];
+        }
+        @catch(NSException* exception)
+        {
+            info = nil;
+        }
+
+        //not JSON?
+        if(nil == info) return NO;
+
+        //create rule obj
+        // validates each field
+        if(YES == [info isKindOfClass:[NSDictionary class]]) rule = [[Rule alloc] initFromJSON:info];
+
+        //skip if invalid
+        if(nil == rule)
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: invalid format for imported rule: %{public}@", info);
+
+            //inc
+            invalid++;
+
+            return YES;
+        }
+    }
+
+    //inc
+    count++;
+
+    //pass on
+    block(key, rule);
+
+    return YES;
+}
+
+@end
@@ -12,6 +12,7 @@
 
 #import "Rule.h"
 #import "XPCDaemonClient.h"
+#import "RuleSearchIndex.h"
 #import "AddRuleWindowController.h"
 #import "ItemPathsWindowController.h"
 
@@ -60,6 +61,14 @@
 //table items
 @property(nonatomic, retain)OrderedDictionary* rules;
 
+//generation of (daemon's) rules
+// so only changes since need to be requested
+@property unsigned long long rulesGeneration;
+
+//search index
+// over all rules, for (fast) filtering
+@property(nonatomic, retain)RuleSearchIndex* searchIndex;
+
 //rules view selector
 @property (weak) IBOutlet NSPopUpButton *rulesViewSelector;
 
@@ -90,8 +90,9 @@ extern XPCDaemonClient* xpcDaemonClient;
         // will be broadcast (via XPC) when daemon updates rules
         self.rulesObserver = [[NSNotificationCenter defaultCenter] addObserverForName:RULES_CHANGED object:nil queue:[NSOperationQueue mainQueue] usingBlock:^(NSNotification *notification)
         {
-            //get new rules
-            [self loadRules:YES select:@(0)];
+            //get (just) changed rules
+            // no overlay, and keep selection, as these are patched in
+            [self loadRules:NO select:nil];
         }];
     }
 
@@ -197,6 +198,9 @@ extern XPCDaemonClient* xpcDaemonClient;
         //current rules (from ext)
         NSDictionary* currentRules = nil;
         
+        //changes (from ext)
+        NSDictionary* changes = nil;
+        
         //sorted keys
         NSArray* sortedKeys = nil;
         
@@ -207,43 +211,73 @@ extern XPCDaemonClient* xpcDaemonClient;
             [NSThread sleepForTimeInterval:0.5f];
         }
         
-        //get rules
-        currentRules = [xpcDaemonClient getRules];
+        //get changes since last load
+        // first time (or generation unknown to daemon), will be all rules
+        changes = [xpcDaemonClient getRulesSince:(nil != self.rules) ? self.rulesGeneration : 0];
+        
+        //changed/all rules
+        currentRules = changes[KEY_RULES_ITEMS];
         
         //dbg msg
-        os_log_debug(logHandle, "received %lu rules from daemon: %{public}@", (unsigned long)currentRules.count, currentRules.allKeys);
+        os_log_debug(logHandle, "received %lu rules (full: %d) from daemon: %{public}@", (unsigned long)currentRules.count, [changes[KEY_RULES_FULL] boolValue], currentRules.allKeys);
         
         //sync rules
         @synchronized (self)
         {
-            //alloc
-            self.rules = [[OrderedDictionary alloc] init];
-        
-            //dbg msg
-            os_log_debug(logHandle, "sorting rules...");
+            //save generation
+            self.rulesGeneration = [changes[KEY_RULES_GENERATION] unsignedLongLongValue];
             
-            //sort by (rule) name
-            sortedKeys = [currentRules keysSortedByValueUsingComparator:^NSComparisonResult(id _Nonnull obj1, id  _Nonnull obj2)
+            //just changes?
+            // patch them in (no need to rebuild/resort everything)
+            if( (nil != self.rules) &&
+                (nil != changes) &&
+                (YES != [changes[KEY_RULES_FULL] boolValue]) )
             {
-                //normal
-                if(YES == self.isAscending)
+                //patch
+                [self patchRules:currentRules removed:changes[KEY_RULES_REMOVED]];
+            }
+            
+            //all rules
+            // (re)build & sort
+            else
+            {
+                //alloc
+                self.rules = [[OrderedDictionary alloc] init];
+                
+                //dbg msg
+                os_log_debug(logHandle, "sorting rules...");
+                
+                //sort by (rule) name
+                sortedKeys = [currentRules keysSortedByValueUsingComparator:^NSComparisonResult(id _Nonnull obj1, id  _Nonnull obj2)
                 {
-                    //compare/return
-                    return [((Rule*)[((NSDictionary*)obj1)[KEY_RULES] firstObject]).name compare:((Rule*)[((NSDictionary*)obj2)[KEY_RULES] firstObject]).name options:NSCaseInsensitiveSearch];
+                    //normal
+                    if(YES == self.isAscending)
+                    {
+                        //compare/return
+                        return [((Rule*)[((NSDictionary*)obj1)[KEY_RULES] firstObject]).name compare:((Rule*)[((NSDictionary*)obj2)[KEY_RULES] firstObject]).name options:NSCaseInsensitiveSearch];
+                    }
+                    //reversed
+                    else
+                    {
+                        //compare/return
+                        return [((Rule*)[((NSDictionary*)obj2)[KEY_RULES] firstObject]).name compare:((Rule*)[((NSDictionary*)obj1)[KEY_RULES] firstObject]).name options:NSCaseInsensitiveSearch];
+                    }
+                }];
+                
+                //add sorted rules
+                for(NSInteger i = 0; i<sortedKeys.count; i++)
+                {
+                    //add to ordered dictionary
+                    [self.rules insertObject:currentRules[sortedKeys[i]] forKey:sortedKeys[i] atIndex:i];
                 }
-                //reversed
-                else
+                
+                //(re)build search index
+                self.searchIndex = [[RuleSearchIndex alloc] init];
+                for(NSString* key in sortedKeys)
                 {
-                    //compare/return
-                    return [((Rule*)[((NSDictionary*)obj2)[KEY_RULES] firstObject]).name compare:((Rule*)[((NSDictionary*)obj1)[KEY_RULES] firstObject]).name options:NSCaseInsensitiveSearch];
+                    //add
+                    [self.searchIndex addItem:currentRules[key] key:key];
                 }
-            }];
-            
-            //add sorted rules
-            for(NSInteger i = 0; i<sortedKeys.count; i++)
-            {
-                //add to ordered dictionary
-                [self.rules insertObject:currentRules[sortedKeys[i]] forKey:sortedKeys[i] atIndex:i];
             }
             
         }//sync
@@ -273,6 +307,74 @@ extern XPCDaemonClient* xpcDaemonClient;
     return;
 }
 
+//patch (sorted) rules with changes
+// changed items are replaced in place, or if new/renamed, (re)inserted at their sorted position
+// note: caller should hold lock
+-(void)patchRules:(NSDictionary*)changedRules removed:(NSArray*)removedKeys
+{
+    //dbg msg
+    os_log_debug(logHandle, "patching rules: %lu changed, %lu removed", (unsigned long)changedRules.count, (unsigned long)removedKeys.count);
+    
+    //remove
+    for(NSString* key in removedKeys)
+    {
+        //remove from search index
+        [self.searchIndex removeItem:self.rules[key]];
+        
+        //remove
+        [self.rules removeObjectForKey:key];
+    }
+    
+    //add/update
+    for(NSString* key in changedRules)
+    {
+        //(new) name
+        NSString* name = ((Rule*)[changedRules[key][KEY_RULES] firstObject]).name;
+        
+        //index
+        NSUInteger index = 0;
+        
+        //update search index
+        [self.searchIndex removeItem:self.rules[key]];
+        [self.searchIndex addItem:changedRules[key] key:key];
+        
+        //existing, w/ same name?
+        // replace in place (keeps position)
+        if( (nil != self.rules[key]) &&
+            (YES == [((Rule*)[self.rules[key][KEY_RULES] firstObject]).name isEqualToString:name]) )
+        {
+            //replace
+            [self.rules setObject:changedRules[key] forKey:key];
+            continue;
+        }
+        
+        //remove any existing
+        [self.rules removeObjectForKey:key];
+        
+        //find sorted position
+        for(index = 0; index < self.rules.count; index++)
+        {
+            //current name
+            NSString* currentName = ((Rule*)[self.rules[[self.rules keyAtIndex:index]][KEY_RULES] firstObject]).name;
+            
+            //compare
+            NSComparisonResult result = [name compare:currentName options:NSCaseInsensitiveSearch];
+            
+            //found?
+            if( ((YES == self.isAscending) && (NSOrderedAscending == result)) ||
+                ((YES != self.isAscending) && (NSOrderedDescending == result)) )
+            {
+                break;
+            }
+        }
+        
+        //insert
+        [self.rules insertObject:changedRules[key] forKey:key atIndex:index];
+    }
+    
+    return;
+}
+
 //update outline view
 -(void)update:(NSNumber*)select
 {
@@ -620,6 +722,10 @@ bail:
     //filter string
     NSString* filter = nil;
     
+    //rules matching filter
+    // key: item key, value: item's rules that match
+    __block NSDictionary* matches = nil;
+    
     //dbg msg
     os_log_debug(logHandle, "filtering rules...");
     
@@ -652,6 +758,10 @@ bail:
     {
         //dbg msg
         os_log_debug(logHandle, "filtering on '%{public}@'", filter);
+        
+        //search
+        // via index, vs. checking each rule
+        matches = [self.searchIndex search:filter];
     }
         
     //scan all rules
@@ -671,6 +781,14 @@ bail:
         //(item's) rules that match
         NSMutableArray* matchedRules = nil;
         
+        //filter, but none of item's rules match?
+        // skip (before any copying)
+        if( (nil != matches) &&
+            (nil == matches[key]) )
+        {
+            return;
+        }
+        
         //make copy
         item = [value mutableCopy];
         
@@ -748,7 +866,7 @@ bail:
         {
             //match?
             // save rule
-            if(YES == [rule matchesString:filter])
+            if(NSNotFound != [matches[key] indexOfObjectIdenticalTo:rule])
             {
                 //add
                 [matchedRules addObject:rule];
@@ -1349,6 +1467,10 @@ bail:
     //set endpoint port
     port = (YES == [rule.endpointPort isEqualToString:VALUE_ANY]) ? NSLocalizedString(@"any port",@"any port") : rule.endpointPort;
     
+    //add protocol (if rule has one)
+    if(IPPROTO_TCP == rule.protocol.intValue) port = [port stringByAppendingString:@" (TCP)"];
+    else if(IPPROTO_UDP == rule.protocol.intValue) port = [port stringByAppendingString:@" (UDP)"];
+    
     //default contents
     // address: port
     contents = [NSMutableString stringWithFormat:@"%@:%@", address, port];
@@ -0,0 +1,44 @@
+//
+//  file: RulesWriter.h
+//  project: lulu (main app)
+//  description: streaming writer, for exporting rules (as JSON) (header)
+//
+//  created by Patrick Wardle
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#ifndef RulesWriter_h
+#define RulesWriter_h
+
+@import OSLog;
+@import Foundation;
+
+//size of buffer
+// once full, it's flushed to the stream
+#define RULES_WRITER_BUFFER_SIZE (64 * 1024)
+
+//streaming writer for (exported) rules
+// rules are encoded one at a time into a (bounded) buffer, that's written out whenever it fills
+// format: { "<item key>" : [ {<rule>}, ... ], ... }, as read by 'RulesReader'
+@interface RulesWriter : NSObject
+
+/* PROPERTIES */
+
+//number of rules written
+@property(nonatomic, readonly)NSUInteger count;
+
+//number of bytes written
+@property(nonatomic, readonly)NSUInteger size;
+
+/* METHODS */
+
+//init
+-(id)init:(NSOutputStream*)stream;
+
+//write (all) rules
+// temporary rules (& if user only, non-user rules) are skipped, as are items w/o any other rules
+-(BOOL)write:(NSDictionary*)rules userOnly:(BOOL)userOnly;
+
+@end
+
+#endif /* RulesWriter_h */
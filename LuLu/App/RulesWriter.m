@@ -0,0 +1,193 @@
+//
+//  file: RulesWriter.m
+//  project: lulu (main app)
+//  description: streaming writer, for exporting rules (as JSON)
+//
+//  created by Patrick Wardle
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#import "Rule.h"
+#import "consts.h"
+#import "utilities.h"
+#import "RulesWriter.h"
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+@implementation RulesWriter
+{
+    //stream
+    NSOutputStream* output;
+
+    //buffer
+    NSMutableData* buffer;
+}
+
+@synthesize size;
+@synthesize count;
+
+//init
+-(id)init:(NSOutputStream*)stream
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //save
+        output = stream;
+
+        //init buffer
+        buffer = [NSMutableData dataWithCapacity:RULES_WRITER_BUFFER_SIZE * 2];
+    }
+
+    return self;
+}
+
+//write (all) rules
+-(BOOL)write:(NSDictionary*)rules userOnly:(BOOL)userOnly
+{
+    //result
+    BOOL result = NO;
+
+    //start (of items)
+    NSUInteger start = 0;
+
+    //init
+    count = 0;
+    size = 0;
+    buffer.length = 0;
+
+    //open
+    [output open];
+    if(NSStreamStatusError == output.streamStatus)
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to open stream for (exported) rules: %{public}@", output.streamError);
+        goto bail;
+    }
+
+    //start
+    [buffer appendBytes:"{" length:1];
+    start = buffer.length;
+
+    //write each item
+    for(NSString* key in rules)
+    {
+        //start (of item's rules)
+        // 0 until first one is written
+        NSUInteger rulesStart = 0;
+
+        //write each rule
+        for(Rule* rule in rules[key][KEY_RULES])
+        {
+            //skip temp
+            if(YES == [rule isTemporary]) continue;
+
+            //skip non user created
+            if( (YES == userOnly) &&
+                (YES != [rule isUserCreated]) ) continue;
+
+            //first (written) rule?
+            // start item
+            if(0 == rulesStart)
+            {
+                //not first item?
+                if( (0 != size) ||
+                    (start != buffer.length) )
+                {
+                    [buffer appendBytes:"," length:1];
+                }
+
+                //key
+                if(YES != appendEscapedJSON(buffer, key))
+                {
+                    //err msg
+                    os_log_error(logHandle, "ERROR: failed to convert (item) key %{public}@", key);
+                    goto bail;
+                }
+
+                //start rules
+                [buffer appendBytes:" : [" length:4];
+                rulesStart = buffer.length;
+            }
+            //not first rule
+            else
+            {
+                [buffer appendBytes:"," length:1];
+            }
+
+            //append rule
+            [rule appendJSON:buffer];
+
+            //inc
+            count++;
+
+            //full?
+            // write out
+            if( (buffer.length >= RULES_WRITER_BUFFER_SIZE) &&
+                (YES != [self flush]) )
+            {
+                goto bail;
+            }
+        }
+
+        //end item
+        if(0 != rulesStart) [buffer appendBytes:"]" length:1];
+    }
+
+    //end
+    [buffer appendBytes:"}" length:1];
+
+    //write out (rest)
+    if(YES != [self flush]) goto bail;
+
+    //dbg msg
+    os_log_debug(logHandle, "wrote %lu rules (%lu bytes)", (unsigned long)count, (unsigned long)size);
+
+    //happy
+    result = YES;
+
+bail:
+
+    //close
+    [output close];
+
+    return result;
+}
+
+//write out buffer
+// loops, as stream may only accept part of it
+-(BOOL)flush
+{
+    //offset
+    NSUInteger offset = 0;
+
+    //write all
+    while(offset < buffer.length)
+    {
+        //write
+        NSInteger written = [output write:(const uint8_t*)buffer.bytes + offset maxLength:buffer.length - offset];
+        if(written <= 0)
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: failed to write (exported) rules: %{public}@", output.streamError);
+            return NO;
+        }
+
+        //inc
+        offset += written;
+    }
+
+    //inc
+    size += buffer.length;
+
+    //reset
+    buffer.length = 0;
+
+    return YES;
+}
+
+@end
@@ -23,6 +23,14 @@
 // set while waiting for the daemon at launch, as errors are expected 'til it's up
 @property (atomic) BOOL suppressXPCErrorAlert;
 
+//statistics (only) client?
+// e.g. 'LuLu -stats', which never registers as *the* (alert) client
+@property (nonatomic, readonly) BOOL statisticsOnly;
+
+//init, for statistics (only)
+// connection exports nothing, and only uses the daemon's statistics interface
+-(id)initForStatistics;
+
 //wait for the daemon to be up & accepting XPC connections
 // note: blocks, so call from a background thread
 -(BOOL)waitForDaemon:(NSUInteger)maxAttempts;
@@ -39,6 +47,10 @@
 // note: synchronous
 -(NSDictionary*)getRules;
 
+//get rules changed since a generation
+// note: synchronous
+-(NSDictionary*)getRulesSince:(unsigned long long)generation;
+
 //add rule
 -(void)addRule:(NSDictionary*)info;
 
@@ -69,6 +81,10 @@
 //delete profile
 -(BOOL)deleteProfile:(NSString*)name;
 
+//get (flow) statistics
+// note: synchronous
+-(NSDictionary*)getStatistics;
+
 //uninstall
 -(BOOL)uninstall;
 
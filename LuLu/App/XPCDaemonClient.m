@@ -31,6 +31,7 @@ extern NSMutableDictionary* alerts;
 @implementation XPCDaemonClient
 
 @synthesize daemon;
+@synthesize statisticsOnly;
 @synthesize reportedXPCConnectionError;
 
 //init
@@ -48,12 +49,43 @@ extern NSMutableDictionary* alerts;
     return self;
 }
 
+//init, for statistics (only)
+// create XPC connection w/ just the statistics interface
+-(id)initForStatistics
+{
+    //super
+    self = [super init];
+    if(nil != self)
+    {
+        //set flag
+        statisticsOnly = YES;
+        
+        //create connection
+        [self createConnection];
+    }
+
+    return self;
+}
+
 //create (or re-create) the XPC connection to the daemon
 -(void)createConnection
 {
     //alloc/init
     daemon = [[NSXPCConnection alloc] initWithMachServiceName:DAEMON_MACH_SERVICE options:0];
 
+    //statistics (only) client?
+    // just statistics interface, nothing exported, and don't register as *the* client
+    if(YES == self.statisticsOnly)
+    {
+        //set remote object interface
+        self.daemon.remoteObjectInterface = [NSXPCInterface interfaceWithProtocol:@protocol(XPCStatsProtocol)];
+        
+        //resume
+        [self.daemon resume];
+        
+        return;
+    }
+
     //set remote object interface
     self.daemon.remoteObjectInterface = [NSXPCInterface interfaceWithProtocol:@protocol(XPCDaemonProtocol)];
 
@@ -66,6 +98,16 @@ extern NSMutableDictionary* alerts;
 
     //resume
     [self.daemon resume];
+    
+    //register as *the* client
+    // messages are ordered, so daemon sees this before any other request
+    // note: if this fails (e.g. daemon not yet up), the next request's error handler reconnects (& re-registers)
+    [[self.daemon remoteObjectProxyWithErrorHandler:^(NSError * proxyError)
+    {
+        //dbg msg
+        os_log_debug(logHandle, "failed to register as XPC client (error: %{public}@)", proxyError);
+        
+    }] registerClient];
 
     return;
 }
@@ -244,8 +286,7 @@ extern NSMutableDictionary* alerts;
     }] getRules:^(NSData* archivedRules)
     {
         //unarchive
-        rules = [NSKeyedUnarchiver unarchivedObjectOfClasses:
-                 [NSSet setWithArray: @[[NSMutableDictionary class], [NSMutableArray class], [NSString class], [NSNumber class], [NSMutableSet class], [NSDate class], [Rule class]]] fromData:archivedRules error:&error];
+        rules = [NSKeyedUnarchiver unarchivedObjectOfClasses:[Rule archiveClasses] fromData:archivedRules error:&error];
         
         if(nil != error)
         {
@@ -258,6 +299,44 @@ extern NSMutableDictionary* alerts;
     return rules;
 }
 
+//get rules changed since a generation
+// note: synchronous, will block until daemon responds
+-(NSDictionary*)getRulesSince:(unsigned long long)generation
+{
+    //changes
+    __block NSDictionary* changes = nil;
+    
+    //error
+    __block NSError* error = nil;
+    
+    //dbg msg
+    os_log_debug(logHandle, "invoking daemon XPC method, '%s' (generation: %llu)", __PRETTY_FUNCTION__, generation);
+    
+    //make XPC request to get changes
+    [[self.daemon synchronousRemoteObjectProxyWithErrorHandler:^(NSError * proxyError)
+    {
+        //handle error
+        [self handleXPCError:proxyError method:__PRETTY_FUNCTION__];
+        
+    }] getRulesSince:generation reply:^(NSData* archivedChanges)
+    {
+        //dbg msg
+        os_log_debug(logHandle, "received %lu bytes of rule changes", (unsigned long)archivedChanges.length);
+        
+        //unarchive
+        changes = [NSKeyedUnarchiver unarchivedObjectOfClasses:[Rule archiveClasses] fromData:archivedChanges error:&error];
+        
+        if(nil != error)
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: failed to unarchive rule changes: %{public}@", error);
+        }
+    
+    }];
+    
+    return changes;
+}
+
 //add rule
 -(void)addRule:(NSDictionary*)info
 {
@@ -324,13 +403,16 @@ extern NSMutableDictionary* alerts;
         //handle error
         [self handleXPCError:proxyError method:__PRETTY_FUNCTION__];
           
-    }] cleanupRules:full reply:^(NSInteger result)
+    }] cleanupRules:full reply:^(NSDictionary* report)
     {
         //dbg msg
-        os_log_debug(logHandle, "daemon XPC method, '%s', done! (returned %ld)", __PRETTY_FUNCTION__, (long)deletedRules);
+        os_log_debug(logHandle, "daemon XPC method, '%s', done! (returned %{public}@)", __PRETTY_FUNCTION__, report);
+        
+        //dbg msg
+        os_log_debug(logHandle, "checked %@ paths (on %@ volumes) in %.2f seconds (rules locked for %.3f seconds)", report[KEY_CLEANUP_PATHS], report[KEY_CLEANUP_VOLUMES], [report[KEY_CLEANUP_CHECK_TIME] doubleValue], [report[KEY_CLEANUP_LOCK_TIME] doubleValue]);
          
         //save result
-        deletedRules = result;
+        if(nil != report[KEY_CLEANUP_DELETED]) deletedRules = [report[KEY_CLEANUP_DELETED] integerValue];
          
     }];
     
@@ -505,6 +587,34 @@ extern NSMutableDictionary* alerts;
     return wasDeleted;
 }
 
+//get (flow) statistics
+-(NSDictionary*)getStatistics
+{
+    //statistics
+    __block NSDictionary* statistics = nil;
+    
+    //dbg msg
+    os_log_debug(logHandle, "invoking daemon XPC method, '%s'", __PRETTY_FUNCTION__);
+    
+    //get statistics
+    [[self.daemon synchronousRemoteObjectProxyWithErrorHandler:^(NSError * proxyError)
+    {
+        //handle error
+        [self handleXPCError:proxyError method:__PRETTY_FUNCTION__];
+          
+    }] getStatistics:^(NSDictionary* statisticsFromDaemon)
+    {
+        //dbg msg
+        os_log_debug(logHandle, "daemon XPC method, '%s', done!", __PRETTY_FUNCTION__);
+        
+        //save
+        statistics = statisticsFromDaemon;
+        
+    }];
+    
+    return statistics;
+}
+
 //uninstall
 -(BOOL)uninstall
 {
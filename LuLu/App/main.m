@@ -9,6 +9,7 @@
 #import "consts.h"
 #import "utilities.h"
 #import "Configure.h"
+#import "XPCDaemonClient.h"
 
 @import Cocoa;
 @import OSLog;
@@ -22,6 +23,34 @@
 //log handle
 os_log_t logHandle = nil;
 
+//print (flow) statistics
+// per stage latencies (in microseconds), then verdict counts
+static void printStatistics(NSDictionary* statistics)
+{
+    //verdicts
+    NSDictionary* verdicts = statistics[KEY_STATS_VERDICTS];
+    
+    //header
+    printf("\nLULU: flow statistics (since %s)\n\n", [statistics[KEY_STATS_SINCE] description].UTF8String);
+    printf("%-14s %10s %10s %10s %10s %10s %10s\n", "stage", "count", "mean", "p50", "p99", "p999", "max");
+    
+    //each stage
+    for(NSDictionary* stage in statistics[KEY_STATS_STAGES])
+    {
+        printf("%-14s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f\n", [stage[KEY_STATS_NAME] UTF8String], [stage[KEY_STATS_COUNT] unsignedLongLongValue],
+               [stage[KEY_STATS_MEAN] doubleValue]/1000, [stage[KEY_STATS_P50] doubleValue]/1000, [stage[KEY_STATS_P99] doubleValue]/1000,
+               [stage[KEY_STATS_P999] doubleValue]/1000, [stage[KEY_STATS_MAX] doubleValue]/1000);
+    }
+    
+    //verdicts
+    printf("\n(latencies in microseconds)\n\nverdicts:");
+    for(NSString* verdict in @[@"allow", @"block", @"pause", @"related", @"cached"])
+    {
+        printf(" %s: %llu", verdict.UTF8String, [verdicts[verdict] unsignedLongLongValue]);
+    }
+    printf("\n\n");
+}
+
 int main(int argc, const char * argv[]) {
     
     //status
@@ -138,6 +167,26 @@ int main(int argc, const char * argv[]) {
             goto bail;
         }
         
+        //stats?
+        // print (flow) statistics from the extension
+        if(YES == [NSProcessInfo.processInfo.arguments containsObject:CMDLINE_FLAG_STATS])
+        {
+            //statistics
+            NSDictionary* statistics = [[[XPCDaemonClient alloc] initForStatistics] getStatistics];
+            if(nil == statistics)
+            {
+                //err msg
+                printf("\nLULU ERROR: failed to get statistics (is the extension running?)\n\n");
+                goto bail;
+            }
+            
+            //print
+            printStatistics(statistics);
+            
+            //done
+            goto bail;
+        }
+        
         //quit?
         // this is the copy, to (just) deactivate extension
         if(YES == [NSProcessInfo.processInfo.arguments containsObject:@"-quit"])
@@ -0,0 +1,42 @@
+//
+//  file: AddressMatcher.h
+//  project: LuLu (launch daemon)
+//  description: interval index for CIDR/range endpoint rules (header)
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#ifndef AddressMatcher_h
+#define AddressMatcher_h
+
+@import OSLog;
+@import Foundation;
+
+@class Rule;
+
+//immutable index over all CIDR/range endpoint rules (e.g. of a rule bucket)
+// each rule's bounds (via 'parseAddressRange') are swept into sorted, non-overlapping segments
+// per family, each w/ the set of rules that cover it, so a lookup is one binary search
+@interface AddressMatcher : NSObject
+
+/* PROPERTIES */
+
+//number of (CIDR/range) rules
+@property(nonatomic, readonly)NSUInteger count;
+
+//number of segments (IPv4 + IPv6)
+@property(nonatomic, readonly)NSUInteger segmentCount;
+
+/* METHODS */
+
+//init with rules
+// only (valid) CIDR/range rules are added, returns nil if there are none
+-(id)init:(NSArray<Rule*>*)rules;
+
+//rules whose range contains an address
+// address is in network byte order, 4 (AF_INET) or 16 (AF_INET6) bytes
+-(NSSet<Rule*>*)match:(const uint8_t*)address family:(int)family;
+
+@end
+
+#endif /* AddressMatcher_h */
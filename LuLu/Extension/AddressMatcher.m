@@ -0,0 +1,391 @@
+//
+//  file: AddressMatcher.m
+//  project: LuLu (launch daemon)
+//  description: interval index for CIDR/range endpoint rules
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#import "Rule.h"
+#import "consts.h"
+#import "utilities.h"
+#import "AddressMatcher.h"
+
+#import <sys/socket.h>
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+//(rule's) range
+// bounds are zero-padded to 16 bytes, so IPv4 & IPv6 compare the same way
+typedef struct
+{
+    //low bound
+    uint8_t lo[16];
+    
+    //high bound
+    uint8_t hi[16];
+    
+    //rule
+    uint32_t rule;
+    
+} AddressRange;
+
+//segment
+// covered by the same set of rules
+typedef struct
+{
+    //low bound
+    uint8_t lo[16];
+    
+    //high bound
+    uint8_t hi[16];
+    
+} AddressSegment;
+
+//increment an address
+// returns NO on overflow (i.e. address was the family's max)
+static BOOL addressIncrement(uint8_t* address, int length)
+{
+    for(int i = length-1; i >= 0; i--)
+    {
+        if(0xFF != address[i])
+        {
+            address[i]++;
+            return YES;
+        }
+        
+        address[i] = 0x00;
+    }
+    
+    return NO;
+}
+
+//decrement an address
+// note: caller ensures it's not zero
+static void addressDecrement(uint8_t* address, int length)
+{
+    for(int i = length-1; i >= 0; i--)
+    {
+        if(0x00 != address[i])
+        {
+            address[i]--;
+            return;
+        }
+        
+        address[i] = 0xFF;
+    }
+}
+
+//compare (zero-padded) addresses
+static int compareAddresses(const void* a, const void* b)
+{
+    return memcmp(a, b, 16);
+}
+
+//compare ranges, by low bound
+static int compareRangesByLo(const void* a, const void* b)
+{
+    return memcmp(((const AddressRange*)a)->lo, ((const AddressRange*)b)->lo, 16);
+}
+
+//compare ranges, by high bound
+static int compareRangesByHi(const void* a, const void* b)
+{
+    return memcmp(((const AddressRange*)a)->hi, ((const AddressRange*)b)->hi, 16);
+}
+
+@implementation AddressMatcher
+{
+    //IPv4 segments & their rules
+    NSData* v4Segments;
+    NSArray<NSSet<Rule*>*>* v4Rules;
+    
+    //IPv6 segments & their rules
+    NSData* v6Segments;
+    NSArray<NSSet<Rule*>*>* v6Rules;
+}
+
+@synthesize count;
+@synthesize segmentCount;
+
+//init with rules
+-(id)init:(NSArray<Rule*>*)addressRules
+{
+    //ranges rules
+    NSMutableArray* rangeRules = nil;
+    
+    //ranges (per family)
+    NSMutableData* v4Ranges = nil;
+    NSMutableData* v6Ranges = nil;
+    
+    //segments
+    NSData* segments = nil;
+    
+    //segment rules
+    NSArray* segmentRules = nil;
+    
+    //init
+    rangeRules = [NSMutableArray array];
+    v4Ranges = [NSMutableData data];
+    v6Ranges = [NSMutableData data];
+    
+    //init super
+    self = [super init];
+    if(nil == self) return nil;
+    
+    //parse each (CIDR/range) rule
+    for(Rule* rule in addressRules)
+    {
+        //range
+        AddressRange range = {0};
+        
+        //family & length
+        int family = 0, length = 0;
+        
+        //skip non-CIDR/range rules
+        if(EndpointTypeCIDR != rule.isEndpointAddrRegex) continue;
+        
+        //parse
+        // skip invalid (as they'd never match)
+        if(YES != parseAddressRange(rule.endpointAddr, &family, range.lo, range.hi, &length)) continue;
+        
+        //add
+        range.rule = (uint32_t)rangeRules.count;
+        [rangeRules addObject:rule];
+        [((AF_INET == family) ? v4Ranges : v6Ranges) appendBytes:&range length:sizeof(range)];
+    }
+    
+    //none?
+    if(0 == rangeRules.count) return nil;
+    
+    //build IPv4
+    [self build:v4Ranges length:4 rules:rangeRules segments:&segments segmentRules:&segmentRules];
+    v4Segments = segments;
+    v4Rules = segmentRules;
+    
+    //build IPv6
+    [self build:v6Ranges length:16 rules:rangeRules segments:&segments segmentRules:&segmentRules];
+    v6Segments = segments;
+    v6Rules = segmentRules;
+    
+    //save
+    count = rangeRules.count;
+    segmentCount = v4Rules.count + v6Rules.count;
+    
+    //dbg msg
+    os_log_debug(logHandle, "indexed %lu CIDR/range rules (%lu segments)", (unsigned long)count, (unsigned long)segmentCount);
+    
+    return self;
+}
+
+//sweep (a family's) ranges into segments
+// boundaries are every range's lo & hi+1, then between each, the covering (i.e. active) rules
+-(void)build:(NSMutableData*)ranges length:(int)length rules:(NSArray*)rangeRules segments:(NSData**)segments segmentRules:(NSArray**)segmentRules
+{
+    //sorted ranges
+    NSMutableData* byLoData = nil;
+    NSMutableData* byHiData = nil;
+    
+    //ranges
+    AddressRange* byLo = NULL;
+    AddressRange* byHi = NULL;
+    
+    //number of ranges
+    NSUInteger rangeCount = 0;
+    
+    //boundaries
+    NSMutableData* points = nil;
+    
+    //number of boundaries
+    NSUInteger pointCount = 0;
+    
+    //active rules
+    NSMutableIndexSet* active = nil;
+    
+    //built segments
+    NSMutableData* built = nil;
+    
+    //rules of each segment
+    NSMutableArray* builtRules = nil;
+    
+    //boundary of last added segment
+    NSUInteger last = NSNotFound;
+    
+    //indices
+    NSUInteger lo = 0, hi = 0;
+    
+    //init
+    rangeCount = ranges.length / sizeof(AddressRange);
+    points = [NSMutableData dataWithCapacity:rangeCount * 2 * 16];
+    active = [NSMutableIndexSet indexSet];
+    built = [NSMutableData data];
+    builtRules = [NSMutableArray array];
+    
+    //none?
+    if(0 == rangeCount) goto bail;
+    
+    //sort (a copy) by lo & by hi
+    // lo: rules become active, hi: rules become inactive
+    byLoData = [ranges mutableCopy];
+    byHiData = [ranges mutableCopy];
+    byLo = byLoData.mutableBytes;
+    byHi = byHiData.mutableBytes;
+    qsort(byLo, rangeCount, sizeof(AddressRange), compareRangesByLo);
+    qsort(byHi, rangeCount, sizeof(AddressRange), compareRangesByHi);
+    
+    //collect boundaries
+    for(NSUInteger i = 0; i < rangeCount; i++)
+    {
+        //after hi
+        uint8_t next[16] = {0};
+        
+        //add lo
+        [points appendBytes:byLo[i].lo length:16];
+        
+        //add hi+1
+        // unless hi is the family's max
+        memcpy(next, byLo[i].hi, 16);
+        if(YES == addressIncrement(next, length)) [points appendBytes:next length:16];
+    }
+    
+    //sort & dedupe boundaries
+    qsort(points.mutableBytes, points.length/16, 16, compareAddresses);
+    for(NSUInteger i = 0; i < points.length/16; i++)
+    {
+        //point
+        uint8_t* point = (uint8_t*)points.mutableBytes + (i * 16);
+        
+        //dupe?
+        if( (0 != pointCount) &&
+            (0 == memcmp(point, (uint8_t*)points.mutableBytes + ((pointCount-1) * 16), 16)) ) continue;
+        
+        //keep
+        memmove((uint8_t*)points.mutableBytes + (pointCount++ * 16), point, 16);
+    }
+    
+    //sweep
+    // segment k covers [point k, point k+1 - 1]
+    for(NSUInteger k = 0; k < pointCount; k++)
+    {
+        //point
+        const uint8_t* point = (const uint8_t*)points.bytes + (k * 16);
+        
+        //segment
+        AddressSegment segment = {0};
+        
+        //segment's rules
+        NSSet* rules = nil;
+        
+        //activate rules starting (at or before) point
+        while( (lo < rangeCount) &&
+               (memcmp(byLo[lo].lo, point, 16) <= 0) ) [active addIndex:byLo[lo++].rule];
+        
+        //deactivate rules ending before point
+        while( (hi < rangeCount) &&
+               (memcmp(byHi[hi].hi, point, 16) < 0) ) [active removeIndex:byHi[hi++].rule];
+        
+        //gap?
+        if(0 == active.count) continue;
+        
+        //init segment
+        // hi is next point - 1 (or family's max)
+        memcpy(segment.lo, point, 16);
+        if(k+1 < pointCount)
+        {
+            memcpy(segment.hi, (const uint8_t*)points.bytes + ((k+1) * 16), 16);
+            addressDecrement(segment.hi, length);
+        }
+        else memset(segment.hi, 0xFF, length);
+        
+        //init rules
+        rules = [NSSet setWithArray:[rangeRules objectsAtIndexes:active]];
+        
+        //same rules as (adjacent) previous segment?
+        // just extend it
+        if( (0 != k) &&
+            (last == k-1) &&
+            (YES == [builtRules.lastObject isEqualToSet:rules]) )
+        {
+            memcpy(((AddressSegment*)built.mutableBytes)[builtRules.count-1].hi, segment.hi, 16);
+        }
+        //add
+        else
+        {
+            [built appendBytes:&segment length:sizeof(segment)];
+            [builtRules addObject:rules];
+        }
+        
+        //save
+        last = k;
+    }
+    
+bail:
+    
+    //save
+    *segments = [built copy];
+    *segmentRules = [builtRules copy];
+    
+    return;
+}
+
+//rules whose range contains an address
+// binary search for last segment starting at or before address
+-(NSSet<Rule*>*)match:(const uint8_t*)address family:(int)family
+{
+    //(zero-padded) address
+    uint8_t key[16] = {0};
+    
+    //segments
+    const AddressSegment* segments = NULL;
+    
+    //rules of segments
+    NSArray* rules = nil;
+    
+    //bounds
+    NSInteger first = 0, middle = 0, last = 0;
+    
+    //match
+    NSInteger match = -1;
+    
+    //IPv4
+    if(AF_INET == family)
+    {
+        memcpy(key, address, 4);
+        segments = v4Segments.bytes;
+        rules = v4Rules;
+    }
+    //IPv6
+    else if(AF_INET6 == family)
+    {
+        memcpy(key, address, 16);
+        segments = v6Segments.bytes;
+        rules = v6Rules;
+    }
+    //other
+    else return nil;
+    
+    //search
+    last = (NSInteger)rules.count - 1;
+    while(first <= last)
+    {
+        middle = (first + last) / 2;
+        
+        if(memcmp(segments[middle].lo, key, 16) <= 0)
+        {
+            match = middle;
+            first = middle + 1;
+        }
+        else last = middle - 1;
+    }
+    
+    //none, or in a gap?
+    if( (-1 == match) ||
+        (memcmp(key, segments[match].hi, 16) > 0) ) return nil;
+    
+    return rules[match];
+}
+
+@end
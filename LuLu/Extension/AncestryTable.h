@@ -0,0 +1,117 @@
+//
+//  file: AncestryTable.h
+//  project: LuLu (launch daemon)
+//  description: shared table of process ancestry (header)
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#ifndef AncestryTable_h
+#define AncestryTable_h
+
+@import OSLog;
+@import Foundation;
+
+#import "ExitMonitor.h"
+
+//default max number of (cached) entries
+#define ANCESTRY_TABLE_COUNT_LIMIT 4096
+
+//max number of hops
+// sanity check, in case (responsible) parents ever form a cycle
+#define ANCESTRY_MAX_DEPTH 64
+
+//entry
+// a process' (immediate) parent, path, & name, as of its pid version
+@interface AncestryEntry : NSObject
+
+//pid
+@property(nonatomic)pid_t pid;
+
+//parent pid
+// real/responsible parent, or ppid
+@property(nonatomic)pid_t parent;
+
+//pid version
+// from audit token (0 if unknown)
+@property(nonatomic)int version;
+
+//path
+@property(nonatomic, retain)NSString* path;
+
+//name
+@property(nonatomic, retain)NSString* name;
+
+@end
+
+//provider of (per-process) ancestry info
+// abstracted, so the table can be driven by a stand-in (e.g. in tests)
+@protocol AncestryProvider <NSObject>
+
+//lookup a pid's parent, path, name, & version
+// returns nil if it's not running
+-(AncestryEntry*)entryForPid:(pid_t)pid;
+
+//watch for a pid's exit
+// returns an (opaque) watch, or nil if it has already exited
+-(id)watch:(pid_t)pid handler:(dispatch_block_t)handler;
+
+//stop watching for a pid's exit
+-(void)unwatch:(id)watch;
+
+@end
+
+//default provider
+// via audit token, proc_pidpath, (responsible) parent, & the exit monitor (EVFILT_PROC/NOTE_EXIT)
+@interface SystemAncestryProvider : NSObject <AncestryProvider>
+
+//init
+// w/ an exit monitor (nil: creates its own)
+-(id)init:(ExitMonitor*)exitMonitor;
+
+@end
+
+//table of process ancestry, shared across processes
+// keyed by pid, entries are filled in lazily (per hop), then reused by any process w/ a common ancestor
+// entries are invalidated when their process exits, or (for the process itself) its pid version changes
+// ...so enumerating a process' ancestors only costs lookups for hops that are new to the table
+@interface AncestryTable : NSObject
+
+/* PROPERTIES */
+
+//max number of entries
+@property(atomic)NSUInteger countLimit;
+
+//number of entries
+@property(nonatomic, readonly)NSUInteger count;
+
+//number of hops found in table
+@property(nonatomic, readonly)uint64_t hits;
+
+//number of hops looked up (via provider)
+@property(nonatomic, readonly)uint64_t misses;
+
+//number of (LRU) evictions
+@property(nonatomic, readonly)uint64_t evictions;
+
+//number of (process exit) invalidations
+@property(nonatomic, readonly)uint64_t exits;
+
+/* METHODS */
+
+//init with a provider
+-(id)init:(id<AncestryProvider>)provider;
+
+//ancestors of a process
+// same format as 'generateProcessHierarchy', i.e. root first, w/ pid, path, name, & index
+-(NSMutableArray*)ancestors:(pid_t)pid version:(int)version;
+
+//invalidate a pid's entry
+-(void)remove:(pid_t)pid;
+
+//remove all entries
+-(void)removeAllObjects;
+
+@end
+
+#endif /* AncestryTable_h */
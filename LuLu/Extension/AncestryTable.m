@@ -0,0 +1,530 @@
+//
+//  file: AncestryTable.m
+//  project: LuLu (launch daemon)
+//  description: shared table of process ancestry
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#import "consts.h"
+#import "utilities.h"
+#import "AncestryTable.h"
+
+#import <signal.h>
+#import <bsm/libbsm.h>
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+@implementation AncestryEntry
+@end
+
+//node
+// in the (doubly) linked LRU list
+@interface AncestryNode : NSObject
+
+//entry
+@property(nonatomic, retain)AncestryEntry* entry;
+
+//exit watch
+@property(nonatomic, retain)id watch;
+
+//more recently used node
+@property(nonatomic, weak)AncestryNode* prev;
+
+//less recently used node
+@property(nonatomic, retain)AncestryNode* next;
+
+@end
+
+@implementation AncestryNode
+@end
+
+@implementation SystemAncestryProvider
+{
+    //exit monitor
+    ExitMonitor* exitMonitor;
+}
+
+//init
+-(id)init
+{
+    return [self init:nil];
+}
+
+//init
+// w/ an exit monitor (nil: creates its own)
+-(id)init:(ExitMonitor*)monitor
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //init exit monitor
+        exitMonitor = monitor ?: [[ExitMonitor alloc] init];
+    }
+
+    return self;
+}
+
+//lookup a pid's parent, path, name, & version
+// same (per hop) logic as 'generateProcessHierarchy'
+-(AncestryEntry*)entryForPid:(pid_t)pid
+{
+    //entry
+    AncestryEntry* entry = nil;
+
+    //token
+    NSData* token = nil;
+
+    //path
+    NSString* path = nil;
+
+    //name
+    NSString* name = nil;
+
+    //not running?
+    if( (0 != kill(pid, 0)) && (ESRCH == errno) ) goto bail;
+
+    //init
+    entry = [[AncestryEntry alloc] init];
+    entry.pid = pid;
+
+    //get version first
+    // so it can't be newer than the path/parent that follow
+    token = tokenForPid(pid);
+    if(sizeof(audit_token_t) == token.length)
+    {
+        //save
+        entry.version = audit_token_to_pidversion(*(audit_token_t*)token.bytes);
+    }
+
+    //get path
+    path = getProcessPath(pid);
+    if(nil == path)
+    {
+        //default
+        path = NSLocalizedString(@"unknown", @"unknown");
+    }
+
+    //get name
+    name = getProcessName(0, path);
+    if(nil == name)
+    {
+        //default
+        name = NSLocalizedString(@"unknown", @"unknown");
+    }
+
+    //save
+    entry.path = path;
+    entry.name = name;
+
+    //get parent
+    entry.parent = getAncestorParent(pid);
+
+bail:
+
+    return entry;
+}
+
+//watch for a pid's exit
+// via the exit monitor (EVFILT_PROC/NOTE_EXIT)
+-(id)watch:(pid_t)pid handler:(dispatch_block_t)handler
+{
+    //watch
+    // nil if already exited
+    return [exitMonitor watch:pid version:0 handler:handler];
+}
+
+//stop watching for a pid's exit
+-(void)unwatch:(id)watch
+{
+    //unwatch
+    [exitMonitor unwatch:watch];
+}
+
+@end
+
+@implementation AncestryTable
+{
+    //provider
+    id<AncestryProvider> provider;
+
+    //nodes
+    // key: pid
+    NSMutableDictionary<NSNumber*, AncestryNode*>* nodes;
+
+    //most recently used node
+    AncestryNode* head;
+
+    //least recently used node
+    __weak AncestryNode* tail;
+}
+
+@synthesize count;
+@synthesize exits;
+@synthesize hits;
+@synthesize misses;
+@synthesize evictions;
+
+//init with a provider
+-(id)init:(id<AncestryProvider>)ancestryProvider
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //save
+        provider = ancestryProvider;
+
+        //init nodes
+        nodes = [NSMutableDictionary dictionary];
+
+        //init limit
+        self.countLimit = ANCESTRY_TABLE_COUNT_LIMIT;
+    }
+
+    return self;
+}
+
+//unlink a node from the LRU list
+// note: caller should hold the lock
+-(void)unlink:(AncestryNode*)node
+{
+    //fix up next
+    if(nil != node.next) node.next.prev = node.prev;
+    else tail = node.prev;
+
+    //fix up prev
+    if(nil != node.prev) node.prev.next = node.next;
+    else head = node.next;
+
+    //reset
+    node.prev = nil;
+    node.next = nil;
+}
+
+//link a node at the head (most recently used) of the LRU list
+// note: caller should hold the lock
+-(void)linkAtHead:(AncestryNode*)node
+{
+    //link
+    node.next = head;
+    if(nil != head) head.prev = node;
+    head = node;
+
+    //first?
+    if(nil == tail) tail = node;
+}
+
+//remove a node
+// note: caller should hold the lock
+-(void)removeNode:(AncestryNode*)node
+{
+    //stop watching for exit
+    if(nil != node.watch) [provider unwatch:node.watch];
+    node.watch = nil;
+
+    //unlink
+    [self unlink:node];
+
+    //remove
+    [nodes removeObjectForKey:[NSNumber numberWithInt:node.entry.pid]];
+
+    //update
+    count = nodes.count;
+}
+
+//lookup entry for a pid
+// marks it as most recently used
+-(AncestryEntry*)lookup:(pid_t)pid
+{
+    //node
+    AncestryNode* node = nil;
+
+    //sync
+    @synchronized(self) {
+
+        //lookup
+        node = nodes[[NSNumber numberWithInt:pid]];
+        if(nil == node) return nil;
+
+        //move to head
+        [self unlink:node];
+        [self linkAtHead:node];
+
+        //inc
+        hits++;
+
+        return node.entry;
+    }
+}
+
+//add an entry
+// watches for its process' exit, then evicts least recently used entries if over limit
+-(void)add:(AncestryEntry*)entry
+{
+    //key
+    NSNumber* key = nil;
+
+    //node
+    AncestryNode* node = nil;
+
+    //existing node
+    AncestryNode* existing = nil;
+
+    //weak self
+    __weak typeof(self) weakSelf = self;
+
+    //weak node
+    __weak AncestryNode* weakNode = nil;
+
+    //init key
+    key = [NSNumber numberWithInt:entry.pid];
+
+    //init node
+    node = [[AncestryNode alloc] init];
+    node.entry = entry;
+    weakNode = node;
+
+    //sync
+    // note: watch is set up under the lock, so an (early) exit can't be handled before the node is added
+    @synchronized(self) {
+
+        //watch for exit
+        node.watch = [provider watch:entry.pid handler:^{
+            [weakSelf exited:weakNode];
+        }];
+
+        //already exited?
+        // don't add, as entry could be stale before it's used
+        if(nil == node.watch) return;
+
+        //replace any existing
+        existing = nodes[key];
+        if(nil != existing) [self removeNode:existing];
+
+        //add
+        nodes[key] = node;
+        [self linkAtHead:node];
+
+        //update
+        count = nodes.count;
+
+        //evict least recently used
+        // until within limit (but always keep the new entry)
+        while( (tail != node) &&
+               (nodes.count > self.countLimit) )
+        {
+            //evict
+            [self removeNode:tail];
+            evictions++;
+        }
+    }
+
+    return;
+}
+
+//process exited
+// invalidate its entry
+-(void)exited:(AncestryNode*)node
+{
+    //gone?
+    if(nil == node) return;
+
+    //sync
+    @synchronized(self) {
+
+        //(still) current?
+        // pid may have been re-added for a new process
+        if(node != nodes[[NSNumber numberWithInt:node.entry.pid]]) return;
+
+        //dbg msg
+        os_log_debug(logHandle, "process %d exited, invalidating its ancestry", node.entry.pid);
+
+        //remove
+        [self removeNode:node];
+        exits++;
+    }
+
+    return;
+}
+
+//ancestors of a process
+// walks up from the process, only looking up (via provider) hops that aren't in the table
+-(NSMutableArray*)ancestors:(pid_t)pid version:(int)version
+{
+    //ancestors
+    NSMutableArray* ancestors = nil;
+
+    //hops
+    // process first
+    NSMutableArray<AncestryEntry*>* hops = nil;
+
+    //entry
+    AncestryEntry* entry = nil;
+
+    //previous hop was from table
+    BOOL previousCached = NO;
+
+    //hop is from table
+    BOOL cached = NO;
+
+    //current pid
+    pid_t currentPID = pid;
+
+    //init
+    ancestors = [NSMutableArray array];
+    hops = [NSMutableArray array];
+
+    //walk up
+    while(hops.count < ANCESTRY_MAX_DEPTH)
+    {
+        //lookup in table
+        entry = [self lookup:currentPID];
+        cached = (nil != entry);
+
+        //process itself, but its pid version changed?
+        // pid was reused, so entry is stale
+        if( (YES == cached) &&
+            (0 == hops.count) &&
+            (0 != version) &&
+            (version != entry.version) )
+        {
+            //invalidate
+            [self remove:currentPID];
+
+            //reset
+            entry = nil;
+            cached = NO;
+        }
+
+        //not in table?
+        // look up (just this hop) via provider
+        if(nil == entry)
+        {
+            //lookup
+            entry = [provider entryForPid:currentPID];
+
+            //inc
+            @synchronized(self) {
+                misses++;
+            }
+
+            //not running?
+            if(nil == entry)
+            {
+                //previous hop was from table?
+                // it may have been re-parented (when this one exited), so refresh it
+                if(YES == previousCached)
+                {
+                    //invalidate
+                    currentPID = hops.lastObject.pid;
+                    [self remove:currentPID];
+                    [hops removeLastObject];
+
+                    //reset
+                    // only refresh once
+                    previousCached = NO;
+
+                    //again
+                    continue;
+                }
+
+                //as 'generateProcessHierarchy'
+                // add as unknown, then stop
+                entry = [[AncestryEntry alloc] init];
+                entry.pid = currentPID;
+                entry.parent = -1;
+                entry.path = NSLocalizedString(@"unknown", @"unknown");
+                entry.name = NSLocalizedString(@"unknown", @"unknown");
+            }
+
+            //add to table
+            else
+            {
+                [self add:entry];
+            }
+        }
+
+        //add
+        [hops addObject:entry];
+        previousCached = cached;
+
+        //done?
+        if( (entry.parent <= 0) ||
+            (entry.parent == currentPID) )
+        {
+            //bail
+            break;
+        }
+
+        //update
+        currentPID = entry.parent;
+    }
+
+    //convert
+    // root first, w/ each item's index for UI purposes
+    for(AncestryEntry* hop in hops.reverseObjectEnumerator)
+    {
+        //add
+        [ancestors addObject:[@{KEY_PROCESS_ID:[NSNumber numberWithInt:hop.pid], KEY_PROCESS_PATH:hop.path, KEY_PROCESS_NAME:hop.name, KEY_INDEX:[NSNumber numberWithUnsignedInteger:ancestors.count]} mutableCopy]];
+    }
+
+    return ancestors;
+}
+
+//invalidate a pid's entry
+-(void)remove:(pid_t)pid
+{
+    //node
+    AncestryNode* node = nil;
+
+    //sync
+    @synchronized(self) {
+
+        //lookup
+        node = nodes[[NSNumber numberWithInt:pid]];
+        if(nil == node) return;
+
+        //remove
+        [self removeNode:node];
+    }
+
+    return;
+}
+
+//remove all entries
+-(void)removeAllObjects
+{
+    //sync
+    @synchronized(self) {
+
+        //stop watching for exits
+        for(AncestryNode* node in nodes.allValues)
+        {
+            if(nil != node.watch) [provider unwatch:node.watch];
+            node.watch = nil;
+        }
+
+        //reset
+        [nodes removeAllObjects];
+        head = nil;
+        tail = nil;
+        count = 0;
+    }
+
+    return;
+}
+
+//dealloc
+// stop watching for exits
+-(void)dealloc
+{
+    //remove all
+    [self removeAllObjects];
+}
+
+@end
@@ -7,6 +7,7 @@
 //
 
 #import "Binary.h"
+#import "SigningCache.h"
 
 @implementation Binary
 
@@ -22,6 +23,9 @@
 //log handle
 extern os_log_t logHandle;
 
+//signing cache
+extern SigningCache* signingCache;
+
 //init binary object
 // note: CPU-intensive logic (code signing, etc) called manually
 -(id)init:(NSString*)binaryPath
@@ -223,7 +227,16 @@ bail:
     NSMutableDictionary* extractedSigningInfo = nil;
     
     //extract signing info
-    extractedSigningInfo = extractSigningInfo(0, self.path, flags);
+    // via cache (keyed on file identity) if there is one, as full validation is (relatively) slow
+    if(nil != signingCache)
+    {
+        //extract
+        extractedSigningInfo = [signingCache signingInfo:self.path token:NULL flags:flags generator:^NSMutableDictionary*{
+            return extractSigningInfo(0, self.path, flags);
+        }];
+    }
+    //no cache
+    else extractedSigningInfo = extractSigningInfo(0, self.path, flags);
     
     //valid?
     // save into iVar
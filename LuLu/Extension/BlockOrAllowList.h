@@ -10,6 +10,9 @@
 @import OSLog;
 @import NetworkExtension;
 
+#import "ListMatcher.h"
+#import "FlowMatchContext.h"
+
 NS_ASSUME_NONNULL_BEGIN
 
 @interface BlockOrAllowList : NSObject
@@ -19,16 +22,31 @@ NS_ASSUME_NONNULL_BEGIN
 //path
 @property(nonatomic, retain)NSString* path;
 
-//block list
-@property(nonatomic, retain)NSMutableSet* items;
+//(compiled) list items
+// swapped atomically on (re)load, so lookups don't need the lock
+@property(atomic, retain, nullable)ListMatcher* items;
 
 //modification time
 @property(nonatomic, retain)NSDate* lastModified;
 
+//validators of (remote) list
+// URL, ETag, and Last-Modified of the last good fetch
+@property(nonatomic, retain, nullable)NSDictionary* validators;
+
+//session for (remote) fetches
+@property(nonatomic, retain, nullable)NSURLSession* session;
+
+//timeout for (remote) fetches
+@property NSTimeInterval timeout;
+
 //timer to (re)load a remote list daily
 // note: a single repeating source, so reloads don't stack
 @property(nonatomic, strong)dispatch_source_t reloadTimer;
 
+//watcher for a local list's file
+// so changes are (re)loaded in the background, instead of checked for on each flow
+@property(nonatomic, strong, nullable)dispatch_source_t fileWatcher;
+
 
 /* METHODS */
 
@@ -44,12 +62,18 @@ NS_ASSUME_NONNULL_BEGIN
 // empties items & stops any (remote) reload timer
 -(void)clear;
 
+//fetch (remote) list
+// async & conditional; on failure the last good list is kept
+-(void)fetch:(nullable void (^)(BOOL fetched))completion;
+
 //should reload
 // checks file modification time
 -(BOOL)shouldReload;
 
 //check if flow matches item on block list
--(BOOL)isMatch:(NEFilterSocketFlow*)flow;
+// flow is passed via its (per-flow) match context
+// note: only reads the current (compiled) list; local lists are reloaded by their file watcher
+-(BOOL)isMatch:(FlowMatchContext*)context;
 
 @end
 
@@ -8,8 +8,11 @@
 
 #import "consts.h"
 #import "Preferences.h"
+#import "VerdictCache.h"
 #import "BlockOrAllowList.h"
 
+#import <fcntl.h>
+
 /* GLOBALS */
 
 //log handle
@@ -18,6 +21,9 @@ extern os_log_t logHandle;
 //preferences
 extern Preferences* preferences;
 
+//verdict cache
+extern VerdictCache* verdictCache;
+
 @implementation BlockOrAllowList
 
 -(id)init:(NSString*)path
@@ -29,6 +35,9 @@ extern Preferences* preferences;
         //save list
         self.path = path;
         
+        //init timeout
+        self.timeout = REMOTE_LIST_TIMEOUT;
+        
         //load
         [self load:self.path];
     }
@@ -93,7 +102,9 @@ extern Preferences* preferences;
     }
 
     //was file modified?
-    if(NSOrderedDescending == [modified compare:self.lastModified])
+    // or (re)created, after failing to load
+    if( (nil == self.lastModified) ||
+        (NSOrderedDescending == [modified compare:self.lastModified]) )
     {
         //dbg msg
         os_log_debug(logHandle, "block list was modified ...will reload");
@@ -117,6 +128,114 @@ bail:
     }
 }
 
+//stop watching (local) list's file, if any
+-(void)stopFileWatcher
+{
+    if(nil != self.fileWatcher)
+    {
+        dispatch_source_cancel(self.fileWatcher);
+        self.fileWatcher = nil;
+    }
+}
+
+//watch (local) list's file
+// (re)armed on each load, as editors often save by replacing the file
+// note: if file is missing, watches its directory, to catch it being (re)created
+-(void)watchFile
+{
+    //path
+    NSString* watchedPath = self.path;
+    
+    //file descriptor
+    int fd = -1;
+    
+    //weak self
+    __weak typeof(self) weakSelf = self;
+    
+    //stop any existing
+    [self stopFileWatcher];
+    
+    //open file
+    fd = open(watchedPath.fileSystemRepresentation, O_EVTONLY);
+    if(-1 == fd)
+    {
+        //missing?
+        // watch directory instead
+        watchedPath = [self.path stringByDeletingLastPathComponent];
+        fd = open(watchedPath.fileSystemRepresentation, O_EVTONLY);
+    }
+    
+    //failed?
+    if(-1 == fd)
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to open %{public}@ to watch for changes (error: %d)", self.path, errno);
+        return;
+    }
+    
+    //create watcher
+    self.fileWatcher = dispatch_source_create(DISPATCH_SOURCE_TYPE_VNODE, fd, DISPATCH_VNODE_WRITE|DISPATCH_VNODE_EXTEND|DISPATCH_VNODE_ATTRIB|DISPATCH_VNODE_DELETE|DISPATCH_VNODE_RENAME, dispatch_get_global_queue(QOS_CLASS_UTILITY, 0));
+    if(nil == self.fileWatcher)
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to create watcher for %{public}@", watchedPath);
+        
+        close(fd);
+        return;
+    }
+    
+    //changed?
+    dispatch_source_set_event_handler(self.fileWatcher, ^{
+        [weakSelf fileChanged];
+    });
+    
+    //close file once done
+    dispatch_source_set_cancel_handler(self.fileWatcher, ^{
+        close(fd);
+    });
+    
+    //start
+    dispatch_resume(self.fileWatcher);
+    
+    //dbg msg
+    os_log_debug(logHandle, "watching %{public}@ for changes", watchedPath);
+    
+    return;
+}
+
+//(local) list's file changed
+// (re)load if needed, in the background, so flows just use whatever list is current
+-(void)fileChanged
+{
+    //sync
+    @synchronized (self) {
+        
+        //no longer a local list?
+        // e.g. cleared, or changed to a remote one
+        if( (0 == self.path.length) ||
+            (YES == [self isRemote]) )
+        {
+            return;
+        }
+        
+        //modified?
+        // (re)load, which also (re)arms watcher
+        if(YES == [self shouldReload])
+        {
+            [self load:self.path];
+        }
+        
+        //just (re)arm watcher
+        // e.g. file was replaced w/o any change
+        else
+        {
+            [self watchFile];
+        }
+    }
+    
+    return;
+}
+
 //clear the list
 // empties items & stops any (remote) reload timer
 -(void)clear
@@ -131,16 +250,358 @@ bail:
         self.path = @"";
 
         //reset list
-        [self.items removeAllObjects];
+        self.items = nil;
+        
+        //list changed
+        // so (cached) verdicts are stale
+        [verdictCache invalidate];
 
         //reset timestamp
         self.lastModified = nil;
 
+        //reset (remote) validators
+        self.validators = nil;
+
         //stop any (remote) reload timer
         [self stopReloadTimer];
+        
+        //stop any (local) file watcher
+        [self stopFileWatcher];
     }
 }
 
+//path to compiled list
+// in lists directory, named by (hash of) list's path
+-(NSString*)compiledPath
+{
+    return [[INSTALL_DIRECTORY stringByAppendingPathComponent:LISTS_DIRECTORY] stringByAppendingPathComponent:[ListMatcher imageNameForList:self.path]];
+}
+
+//compile a (local) list
+// and save, so next load can just map it
+-(ListMatcher*)compile:(NSString*)list attributes:(NSDictionary*)attributes
+{
+    //image
+    NSData* image = nil;
+    
+    //compiled path
+    NSString* compiledPath = nil;
+    
+    //matcher
+    ListMatcher* matcher = nil;
+    
+    //error
+    NSError* error = nil;
+    
+    //compile
+    image = [ListMatcher compile:list source:attributes];
+    if(nil == image)
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to compile list, %{public}@", self.path);
+        
+        //bail
+        goto bail;
+    }
+    
+    //init path
+    compiledPath = [self compiledPath];
+    
+    //create lists directory
+    if(YES != [NSFileManager.defaultManager createDirectoryAtPath:[compiledPath stringByDeletingLastPathComponent] withIntermediateDirectories:YES attributes:nil error:&error])
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to create %{public}@ (error: %{public}@)", [compiledPath stringByDeletingLastPathComponent], error);
+    }
+    
+    //save
+    // then map the saved copy (so in-memory image can be released)
+    else if(YES == [image writeToFile:compiledPath atomically:YES])
+    {
+        //map
+        matcher = [[ListMatcher alloc] initWithFile:compiledPath];
+    }
+    
+    //failed to save/map?
+    // just use in-memory image
+    if(nil == matcher)
+    {
+        //init
+        matcher = [[ListMatcher alloc] initWithImage:image];
+    }
+    
+bail:
+    
+    return matcher;
+}
+
+//path to (remote) list's validators
+// saved next to its compiled list
+-(NSString*)validatorsPath
+{
+    return [[self compiledPath] stringByAppendingPathExtension:@"plist"];
+}
+
+//load last good copy of a (remote) list
+// i.e. its compiled list and validators, saved from the last (successful) fetch
+-(void)loadLastGood
+{
+    //validators
+    NSDictionary* validators = nil;
+    
+    //matcher
+    ListMatcher* matcher = nil;
+    
+    //load validators
+    validators = [NSDictionary dictionaryWithContentsOfFile:[self validatorsPath]];
+    if(YES != [validators[KEY_LIST_URL] isEqualToString:self.path])
+    {
+        //dbg msg
+        os_log_debug(logHandle, "no last good copy of %{public}@", self.path);
+        
+        //bail
+        goto bail;
+    }
+    
+    //map compiled list
+    matcher = [[ListMatcher alloc] initWithFile:[self compiledPath]];
+    if(nil == matcher)
+    {
+        //bail
+        goto bail;
+    }
+    
+    //dbg msg
+    os_log_debug(logHandle, "loaded last good copy of %{public}@ (%lu items)", self.path, (unsigned long)matcher.count);
+    
+    //save
+    self.items = matcher;
+    self.validators = validators;
+    
+bail:
+    
+    return;
+}
+
+//fetch a (remote) list
+// conditional (ETag/Last-Modified) request, with the list parsed/compiled on the session's (background) queue
+// on any failure, the last good list is kept
+-(void)fetch:(void (^)(BOOL fetched))completion
+{
+    //url
+    NSURL* url = nil;
+    
+    //request
+    NSMutableURLRequest* request = nil;
+    
+    //validators
+    NSDictionary* validators = nil;
+    
+    //path being fetched
+    NSString* path = nil;
+    
+    //sync
+    @synchronized (self) {
+        
+        //init path
+        path = self.path;
+        
+        //init validators
+        // only used if we still have the list they're for
+        if( (nil != self.items) &&
+            (YES == [path isEqualToString:self.validators[KEY_LIST_URL]]) )
+        {
+            validators = self.validators;
+        }
+        
+        //init session
+        // ephemeral: nothing cached by the URL system, as we do our own (conditional) caching
+        if(nil == self.session)
+        {
+            self.session = [NSURLSession sessionWithConfiguration:NSURLSessionConfiguration.ephemeralSessionConfiguration];
+        }
+    }
+    
+    //init url
+    url = [NSURL URLWithString:path];
+    if(nil == url)
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: invalid (remote) list URL, %{public}@", path);
+        
+        //done
+        if(nil != completion) completion(NO);
+        
+        return;
+    }
+    
+    //init request
+    // note: compressed (gzip/deflate) transfer is requested, and decoded, by the URL system
+    request = [NSMutableURLRequest requestWithURL:url cachePolicy:NSURLRequestReloadIgnoringLocalCacheData timeoutInterval:self.timeout];
+    
+    //add validators
+    if(nil != validators[KEY_LIST_ETAG]) [request setValue:validators[KEY_LIST_ETAG] forHTTPHeaderField:@"If-None-Match"];
+    if(nil != validators[KEY_LIST_LAST_MODIFIED]) [request setValue:validators[KEY_LIST_LAST_MODIFIED] forHTTPHeaderField:@"If-Modified-Since"];
+    
+    //dbg msg
+    os_log_debug(logHandle, "fetching (remote) list %{public}@ (validators: %{public}@)", path, validators);
+    
+    //fetch
+    [[self.session dataTaskWithRequest:request completionHandler:^(NSData* data, NSURLResponse* response, NSError* error) {
+        
+        //flag
+        BOOL fetched = NO;
+        
+        //status code
+        NSInteger status = 0;
+        
+        //list
+        NSString* list = nil;
+        
+        //matcher
+        ListMatcher* matcher = nil;
+        
+        //new validators
+        NSMutableDictionary* newValidators = nil;
+        
+        //error?
+        if(nil != error)
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: failed to fetch (remote) list, %{public}@ (error: %{public}@) ...keeping last good list", path, error);
+            
+            //bail
+            goto bail;
+        }
+        
+        //get status
+        if(YES == [response isKindOfClass:[NSHTTPURLResponse class]])
+        {
+            status = ((NSHTTPURLResponse*)response).statusCode;
+        }
+        
+        //not modified?
+        // keep current list
+        if(304 == status)
+        {
+            //dbg msg
+            os_log_debug(logHandle, "(remote) list %{public}@ not modified", path);
+            
+            //happy
+            fetched = YES;
+            
+            //bail
+            goto bail;
+        }
+        
+        //not ok?
+        if(200 != status)
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: failed to fetch (remote) list, %{public}@ (status: %ld) ...keeping last good list", path, (long)status);
+            
+            //bail
+            goto bail;
+        }
+        
+        //decode
+        list = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+        if(nil == list)
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: (remote) list %{public}@ isn't UTF-8 ...keeping last good list", path);
+            
+            //bail
+            goto bail;
+        }
+        
+        //init validators
+        newValidators = [NSMutableDictionary dictionaryWithObject:path forKey:KEY_LIST_URL];
+        if(nil != [(NSHTTPURLResponse*)response valueForHTTPHeaderField:@"ETag"]) newValidators[KEY_LIST_ETAG] = [(NSHTTPURLResponse*)response valueForHTTPHeaderField:@"ETag"];
+        if(nil != [(NSHTTPURLResponse*)response valueForHTTPHeaderField:@"Last-Modified"]) newValidators[KEY_LIST_LAST_MODIFIED] = [(NSHTTPURLResponse*)response valueForHTTPHeaderField:@"Last-Modified"];
+        
+        //sync
+        // swap in the (compiled) list, unless path changed while fetching
+        @synchronized (self) {
+            
+            //path changed?
+            if(YES != [path isEqualToString:self.path])
+            {
+                //dbg msg
+                os_log_debug(logHandle, "list path changed while fetching %{public}@ ...ignoring", path);
+                
+                //bail
+                goto bail;
+            }
+            
+            //compile (and save)
+            matcher = [self compile:list attributes:nil];
+            if(nil == matcher)
+            {
+                //bail
+                goto bail;
+            }
+            
+            //save validators
+            // so last good list (and its validators) survive restarts
+            [newValidators writeToFile:[self validatorsPath] atomically:YES];
+            
+            //(atomically) swap in new list
+            self.items = matcher;
+            self.validators = newValidators;
+            
+            //list changed
+            // so (cached) verdicts are stale
+            [verdictCache invalidate];
+        }
+        
+        //dbg msg
+        os_log_debug(logHandle, "fetched (remote) list %{public}@ (%lu items)", path, (unsigned long)matcher.count);
+        
+        //happy
+        fetched = YES;
+        
+    bail:
+        
+        //done
+        if(nil != completion) completion(fetched);
+        
+    }] resume];
+    
+    return;
+}
+
+//fetch a (remote) list
+// and wait for the result (bounded by request's timeout)
+-(BOOL)fetchAndWait
+{
+    //result
+    __block BOOL fetched = NO;
+    
+    //semaphore
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    
+    //fetch
+    [self fetch:^(BOOL result) {
+        
+        //save
+        fetched = result;
+        
+        //signal
+        dispatch_semaphore_signal(semaphore);
+    }];
+    
+    //wait
+    // note: a bit longer than the request's timeout, so a (stuck) server can't hang the caller
+    if(0 != dispatch_semaphore_wait(semaphore, dispatch_time(DISPATCH_TIME_NOW, (int64_t)((self.timeout + 5) * NSEC_PER_SEC))))
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: timed out fetching (remote) list, %{public}@", self.path);
+    }
+    
+    return fetched;
+}
+
 //(re)load
 -(BOOL)load:(NSString*)path
 {
@@ -153,15 +614,21 @@ bail:
     //file contents
     NSString* list = nil;
     
+    //file attributes
+    NSDictionary* attributes = nil;
+    
+    //(compiled) list
+    ListMatcher* matcher = nil;
+    
+    //flag
+    BOOL remote = NO;
+    
     //sync
     @synchronized (self) {
         
     //update path
     self.path = path;
         
-    //reset list
-    [self.items removeAllObjects];
-        
     //dbg msg
     os_log_debug(logHandle, "%s", __PRETTY_FUNCTION__);
     
@@ -172,8 +639,14 @@ bail:
         //dbg msg
         os_log_debug(logHandle, "no list specified...");
 
+        //reset list
+        self.items = nil;
+
         //no remote list -> stop any reload timer
         [self stopReloadTimer];
+        
+        //no local list -> stop any file watcher
+        [self stopFileWatcher];
 
         //nothing to load (success)
         loaded = YES;
@@ -183,21 +656,28 @@ bail:
     }
         
     //remote?
-    // load via URL
+    // fetched (below) outside of the lock, as fetch's completion swaps in the list
     if(YES == [self isRemote])
     {
         //dbg msg
         os_log_debug(logHandle, "(re)loading (remote) list");
         
-        //load
-        list = [NSString stringWithContentsOfURL:[NSURL URLWithString:self.path] encoding:NSUTF8StringEncoding error:&error];
-        if(nil != error)
+        //set flag
+        remote = YES;
+        
+        //not local -> stop any file watcher
+        [self stopFileWatcher];
+        
+        //new list?
+        // start w/ its last good (compiled) copy, if any
+        if(YES != [self.path isEqualToString:self.validators[KEY_LIST_URL]])
         {
-            //err msg
-            os_log_error(logHandle, "ERROR: failed to (re)load (remote) list, %{public}@ (error: %{public}@)", self.path, error);
-
-            //bail
-            goto bail;
+            //reset
+            self.items = nil;
+            self.validators = nil;
+            
+            //load last good
+            [self loadLastGood];
         }
 
         //arm the daily (re)load timer, just once
@@ -213,13 +693,17 @@ bail:
             dispatch_source_set_event_handler(self.reloadTimer, ^{
 
                 //dbg msg
-                os_log_debug(logHandle, "(re)loading (remote) list");
+                os_log_debug(logHandle, "(re)fetching (remote) list");
 
-                //(re)load (current path)
-                [weakSelf load:weakSelf.path];
+                //(re)fetch (current path)
+                // conditional, so unchanged lists aren't re-downloaded
+                [weakSelf fetch:nil];
             });
             dispatch_resume(self.reloadTimer);
         }
+        
+        //done (w/ lock)
+        goto sync;
     }
     
     //local file
@@ -231,32 +715,56 @@ bail:
 
         //local (not remote) -> stop any reload timer
         [self stopReloadTimer];
+        
+        //(re)arm file watcher
+        // before reading file, so no change is missed
+        [self watchFile];
 
-        //(re)load
-        list = [NSString stringWithContentsOfFile:self.path encoding:NSUTF8StringEncoding error:&error];
-        if(nil != error)
+        //get attributes
+        // size & timestamp are used to check if compiled list is current
+        attributes = [NSFileManager.defaultManager attributesOfItemAtPath:self.path error:nil];
+        
+        //first try (previously) compiled list
+        // mmap'd, so no need to (re)parse the text list
+        matcher = [[ListMatcher alloc] initWithFile:[self compiledPath]];
+        if( (nil != matcher) &&
+            (YES != [matcher isCompiledFrom:attributes]) )
         {
-            //err msg
-            os_log_error(logHandle, "ERROR: failed to (re)load (local) list, %{public}@ (error: %{public}@)", self.path, error);
+            //dbg msg
+            os_log_debug(logHandle, "compiled list is stale ...will recompile");
             
-            //bail
-            goto bail;
+            //unset
+            matcher = nil;
+        }
+        
+        //(re)load & compile
+        if(nil == matcher)
+        {
+            //(re)load
+            list = [NSString stringWithContentsOfFile:self.path encoding:NSUTF8StringEncoding error:&error];
+            if(nil != error)
+            {
+                //err msg
+                os_log_error(logHandle, "ERROR: failed to (re)load (local) list, %{public}@ (error: %{public}@)", self.path, error);
+                
+                //reset list
+                self.items = nil;
+                
+                //bail
+                goto bail;
+            }
+            
+            //compile & save
+            matcher = [self compile:list attributes:attributes];
         }
         
         //save timestamp
-        self.lastModified = [[NSFileManager.defaultManager attributesOfItemAtPath:self.path error:nil] objectForKey:NSFileModificationDate];
+        self.lastModified = attributes[NSFileModificationDate];
     }
     
-    //init set
-    // of trimmed/lower-cased items
-    self.items = [NSMutableSet setWithArray:[[[list componentsSeparatedByString:@"\n"] filteredArrayUsingPredicate:[NSPredicate predicateWithBlock:^BOOL(NSString *item, NSDictionary *bindings) {
-                //trim
-                NSString* trimmed = [item stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
-                
-                //make sure its not empty/not a comment
-                return (trimmed.length > 0 && ![trimmed hasPrefix:@"#"]);
-        
-            }]] valueForKey:@"lowercaseString"]];
+    //(atomically) swap in new list
+    // exact, wildcard ('*.domain'), and CIDR/range items
+    self.items = matcher;
         
     //dbg msg
     os_log_debug(logHandle, "(re)loaded %lu list items", (unsigned long)self.items.count);
@@ -264,119 +772,81 @@ bail:
     //success
     loaded = YES;
 
+sync:
+        
+    ;
     } //sync
 
+    //remote?
+    // fetch, and wait for it (as callers want the result)
+    // note: never called on the flow path, which just uses whatever list is current
+    if(YES == remote)
+    {
+        //fetch
+        loaded = [self fetchAndWait];
+    }
+
 bail:
+    
+    //list (maybe) changed
+    // so (cached) verdicts are stale
+    [verdictCache invalidate];
 
     return loaded;
 }
 
 //check if flow matches item on block or allow list
 // note: currently lists don't support port matching
--(BOOL)isMatch:(NEFilterSocketFlow*)flow
+//       flow's (lower-cased) names come (pre-built) from its match context
+-(BOOL)isMatch:(FlowMatchContext*)context
 {
     //match
     BOOL isMatch = NO;
     
-    //remote endpoint
-    NWHostEndpoint* remoteEndpoint = nil;
-    
-    //endpoint url/hosts
-    NSMutableSet* endpointNames = nil;
-    
-    //matches
-    NSSet* matches = nil;
-    
-    //extract remote endpoint
-    remoteEndpoint = (NWHostEndpoint*)flow.remoteEndpoint;
-    
-    //need to reload list?
-    // checks timestamp to see if modified
-    if(YES == [self shouldReload])
-    {
-        //(re)load list
-        [self load:self.path];
-    }
-    
-    //sync
-    @synchronized (self) {
-        
-    //init endpoint names
-    endpointNames = [NSMutableSet set];
-        
-    //add url
-    if(nil != flow.URL.absoluteString)
-    {
-        //add full url
-        [endpointNames addObject:flow.URL.absoluteString.lowercaseString];
-    }
+    //match
+    NSString* match = nil;
     
-    //add host
-    if(nil != flow.URL.host)
-    {
-        //add full url
-        [endpointNames addObject:flow.URL.host.lowercaseString];
-    }
-        
-    //add host name
-    if(nil != remoteEndpoint.hostname)
-    {
-        //add
-        [endpointNames addObject:remoteEndpoint.hostname.lowercaseString];
-    }
+    //(compiled) list
+    ListMatcher* items = nil;
     
-    //macOS 11+?
-    // add remote host name
-    if(@available(macOS 11, *))
+    //grab (current) list
+    // no lock needed, as it's immutable and swapped atomically on (re)load
+    items = self.items;
+    if(0 == items.count)
     {
-        //add remote host name
-        if(nil != flow.remoteHostname)
-        {
-            //add
-            [endpointNames addObject:flow.remoteHostname.lowercaseString];
-         
-            //if it starts w/ 'www.'
-            // strip and add that too
-            if(YES == [flow.remoteHostname hasPrefix:@"www."])
-            {
-                //add
-                [endpointNames addObject:[[flow.remoteHostname substringFromIndex:4] lowercaseString]];
-            }
-        }
+        //bail
+        goto bail;
     }
     
     //first check for "all"
     // for IPV4 -> '0.0.0.0/0'
-    if( (AF_INET == flow.socketFamily) &&
-        ([self.items containsObject:@"0.0.0.0/0"]) )
+    if( (AF_INET == context.family) &&
+        (YES == items.matchesAllIPv4) )
     {
         isMatch = YES;
         goto bail;
     }
     //for IPV6 -> '::/0'
-    else if( (AF_INET6 == flow.socketFamily) &&
-             ([self.items containsObject:@"::/0"]) )
+    else if( (AF_INET6 == context.family) &&
+             (YES == items.matchesAllIPv6) )
     {
         isMatch = YES;
         goto bail;
     }
    
-    //find matches
-    matches = [self.items objectsPassingTest:^BOOL(NSString* item, BOOL* stop) {
-        return [endpointNames containsObject:item];
-    }];
+    //find match
+    // cost is per endpoint name (and label), not per list item
+    match = [items match:context.listNames];
         
-    //any matches?
-    if(0 != matches.count)
+    //any match?
+    if(nil != match)
     {
         //dbg msg
-        os_log_debug(logHandle, "endpoint names %{public}@ matched the following list items %{public}@", endpointNames, matches);
+        os_log_debug(logHandle, "endpoint names %{public}@ matched list item %{public}@", context.listNames, match);
        
         //set flag
         isMatch = YES;
     }
-        
-    }//sync
     
 bail:
     
@@ -0,0 +1,49 @@
+//
+//  file: EndpointMatcher.h
+//  project: LuLu (launch daemon)
+//  description: multi-pattern matcher for regex/glob endpoint rules (header)
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#ifndef EndpointMatcher_h
+#define EndpointMatcher_h
+
+@import OSLog;
+@import Foundation;
+
+@class Rule;
+
+//match a glob (only '*' wildcards) against a whole string
+// non-backtracking (i.e. at most O(pattern * string)), equivalent to the regex from 'regexFromGlob'
+BOOL globMatch(const char* glob, size_t globLength, const char* string, size_t stringLength);
+
+//required literal of a regex
+// longest run of chars any match must contain (nil if none can be safely extracted)
+NSString* requiredLiteralForRegex(NSString* regex);
+
+//immutable matcher over all regex/glob endpoint rules (e.g. of a rule bucket)
+// each pattern's required literal goes into one (Aho-Corasick) automaton
+// so one pass over an endpoint name finds the candidates, which are then verified:
+//   globs: via 'globMatch' (no regex engine)
+//   regexes: via the rule's (anchored) compiled regex
+// patterns w/o a literal (e.g. '.*') are always verified
+@interface EndpointMatcher : NSObject
+
+/* PROPERTIES */
+
+//number of patterns
+@property(nonatomic, readonly)NSUInteger count;
+
+/* METHODS */
+
+//init with rules
+// only regex/glob rules are added, returns nil if there are none
+-(id)init:(NSArray<Rule*>*)rules;
+
+//rules whose endpoint pattern matches any of the endpoint names
+-(NSSet<Rule*>*)match:(NSArray<NSString*>*)endpointNames;
+
+@end
+
+#endif /* EndpointMatcher_h */
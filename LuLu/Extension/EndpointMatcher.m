@@ -0,0 +1,599 @@
+//
+//  file: EndpointMatcher.m
+//  project: LuLu (launch daemon)
+//  description: multi-pattern matcher for regex/glob endpoint rules
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#import "Rule.h"
+#import "consts.h"
+#import "EndpointMatcher.h"
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+//no node
+#define NO_NODE -1
+
+//automaton node
+// children are a (sibling) linked list, except for the root's (a table)
+typedef struct
+{
+    //first child
+    int32_t child;
+    
+    //next sibling
+    int32_t sibling;
+    
+    //failure link
+    int32_t fail;
+    
+    //next node (via failure links) that ends a literal
+    int32_t output;
+    
+    //literal ending at this node
+    int32_t literal;
+    
+    //byte on edge from parent
+    uint8_t byte;
+    
+} MatcherNode;
+
+//child of a node
+// root's are in a table, others are a (sibling) list
+static inline int32_t childOf(const MatcherNode* nodes, const int32_t* rootNext, int32_t index, uint8_t byte)
+{
+    //root?
+    if(0 == index) return rootNext[byte];
+    
+    //walk children
+    for(int32_t child = nodes[index].child; NO_NODE != child; child = nodes[child].sibling)
+    {
+        if(byte == nodes[child].byte) return child;
+    }
+    
+    return NO_NODE;
+}
+
+//match a glob against a whole string
+// on a mismatch, only retries from the last '*' (so no exponential backtracking)
+BOOL globMatch(const char* glob, size_t globLength, const char* string, size_t stringLength)
+{
+    //indices
+    size_t g = 0, s = 0;
+    
+    //last star, and where in string it was matched from
+    size_t star = SIZE_MAX, mark = 0;
+    
+    while(s < stringLength)
+    {
+        //literal match
+        if( (g < globLength) &&
+            ('*' != glob[g]) &&
+            (glob[g] == string[s]) )
+        {
+            g++;
+            s++;
+        }
+        //star
+        // first try it matching nothing
+        else if( (g < globLength) &&
+                 ('*' == glob[g]) )
+        {
+            star = g++;
+            mark = s;
+        }
+        //mismatch after a star
+        // let star eat one more char
+        else if(SIZE_MAX != star)
+        {
+            g = star + 1;
+            s = ++mark;
+        }
+        //mismatch
+        else
+        {
+            return NO;
+        }
+    }
+    
+    //skip any trailing stars
+    while( (g < globLength) &&
+           ('*' == glob[g]) ) g++;
+    
+    return (g == globLength);
+}
+
+//required literal of a regex
+// only top-level (i.e. not in a group), unquantified literal chars are used
+// anything complex (top-level alternation, inline flags, quoting, nested classes) -> nil
+NSString* requiredLiteralForRegex(NSString* regex)
+{
+    //longest run
+    __block NSString* longest = nil;
+    
+    //current run
+    NSMutableString* run = nil;
+    
+    //group depth
+    NSInteger depth = 0;
+    
+    //index
+    NSUInteger i = 0;
+    
+    //length
+    NSUInteger length = regex.length;
+    
+    //inline flags (e.g. '(?i)'), look arounds, or quoting?
+    // ...just don't bother
+    if( (YES == [regex containsString:@"(?"]) ||
+        (YES == [regex containsString:@"\\Q"]) )
+    {
+        return nil;
+    }
+    
+    //init
+    run = [NSMutableString string];
+    
+    //end current run
+    void (^commit)(void) = ^{
+        if(run.length > longest.length) longest = [run copy];
+        [run setString:@""];
+    };
+    
+    //scan
+    while(i < length)
+    {
+        //char
+        unichar c = [regex characterAtIndex:i++];
+        
+        //(literal) value
+        unichar value = c;
+        
+        //next char
+        unichar next = 0;
+        
+        //literal?
+        BOOL literal = NO;
+        
+        switch(c)
+        {
+            //escape
+            // '\d', '\b', '\1', etc. aren't literals
+            case '\\':
+                if(i >= length) return nil;
+                value = [regex characterAtIndex:i++];
+                literal = ![NSCharacterSet.alphanumericCharacterSet characterIsMember:value];
+                break;
+                
+            //class
+            // skip to end
+            case '[':
+                if( (i < length) && ('^' == [regex characterAtIndex:i]) ) i++;
+                if( (i < length) && (']' == [regex characterAtIndex:i]) ) i++;
+                while( (i < length) && (']' != [regex characterAtIndex:i]) )
+                {
+                    if('[' == [regex characterAtIndex:i]) return nil;
+                    if('\\' == [regex characterAtIndex:i]) i++;
+                    i++;
+                }
+                i++;
+                break;
+                
+            //groups
+            case '(':
+                depth++;
+                break;
+            case ')':
+                depth--;
+                break;
+                
+            //alternation
+            // at top-level, no literal is required
+            case '|':
+                if(0 == depth) return nil;
+                break;
+                
+            //(standalone) counted quantifier
+            case '{':
+                while( (i < length) && ('}' != [regex characterAtIndex:i]) ) i++;
+                i++;
+                break;
+                
+            //other meta chars
+            case '.': case '^': case '$': case '?': case '*': case '+':
+                break;
+                
+            default:
+                literal = YES;
+                break;
+        }
+        
+        //not a (top-level) literal?
+        // or a surrogate (as can't split pairs)
+        if( (YES != literal) ||
+            (0 != depth) ||
+            (YES == CFStringIsSurrogateHighCharacter(value)) ||
+            (YES == CFStringIsSurrogateLowCharacter(value)) )
+        {
+            commit();
+            continue;
+        }
+        
+        //peek
+        if(i < length) next = [regex characterAtIndex:i];
+        
+        //optional/repeated?
+        // so not required
+        if( ('?' == next) || ('*' == next) || ('{' == next) )
+        {
+            commit();
+            continue;
+        }
+        
+        //add
+        [run appendFormat:@"%C", value];
+        
+        //one or more?
+        // required once, but ends run
+        if('+' == next) commit();
+    }
+    
+    //last run
+    commit();
+    
+    return longest;
+}
+
+@implementation EndpointMatcher
+{
+    //nodes
+    NSMutableData* nodes;
+    
+    //root's children
+    int32_t rootNext[256];
+    
+    //rule of each pattern
+    NSArray<Rule*>* rules;
+    
+    //verifier of each pattern
+    // glob (UTF-8 bytes), or compiled regex
+    NSArray* verifiers;
+    
+    //patterns of each literal
+    NSArray<NSIndexSet*>* literalPatterns;
+    
+    //patterns w/o a literal
+    NSIndexSet* unfiltered;
+}
+
+@synthesize count;
+
+//init with rules
+-(id)init:(NSArray<Rule*>*)endpointRules
+{
+    //pattern rules
+    NSMutableArray* patternRules = nil;
+    
+    //verifiers
+    NSMutableArray* patternVerifiers = nil;
+    
+    //literals
+    // key: literal, value: id
+    NSMutableDictionary* literals = nil;
+    
+    //patterns of literals
+    NSMutableArray* patternsOfLiterals = nil;
+    
+    //patterns w/o literals
+    NSMutableIndexSet* noLiterals = nil;
+    
+    //init
+    patternRules = [NSMutableArray array];
+    patternVerifiers = [NSMutableArray array];
+    literals = [NSMutableDictionary dictionary];
+    patternsOfLiterals = [NSMutableArray array];
+    noLiterals = [NSMutableIndexSet indexSet];
+    
+    //init super
+    self = [super init];
+    if(nil == self) return nil;
+    
+    //init automaton
+    // just the root
+    nodes = [NSMutableData data];
+    memset(rootNext, 0xFF, sizeof(rootNext));
+    [self addNode:0];
+    
+    //add each (regex/glob) rule
+    for(Rule* rule in endpointRules)
+    {
+        //literal
+        NSString* literal = nil;
+        
+        //verifier
+        id verifier = nil;
+        
+        //glob?
+        // verify w/ glob matcher, and use longest segment as literal
+        if(EndpointTypeGlob == rule.isEndpointAddrRegex)
+        {
+            //verifier
+            verifier = [rule.endpointAddr dataUsingEncoding:NSUTF8StringEncoding];
+            
+            //longest segment
+            for(NSString* segment in [rule.endpointAddr componentsSeparatedByString:@"*"])
+            {
+                if(segment.length > literal.length) literal = segment;
+            }
+        }
+        
+        //regex?
+        // verify w/ (anchored) regex
+        else if(EndpointTypeRegex == rule.isEndpointAddrRegex)
+        {
+            //verifier
+            verifier = [rule compiledEndpointRegex];
+            
+            //literal
+            literal = requiredLiteralForRegex(rule.endpointAddr);
+        }
+        
+        //skip others
+        // and invalid (as they'd never match)
+        if(nil == verifier) continue;
+        
+        //add
+        [patternRules addObject:rule];
+        [patternVerifiers addObject:verifier];
+        
+        //no literal?
+        // will always have to verify
+        if(0 == literal.length)
+        {
+            [noLiterals addIndex:patternRules.count-1];
+            continue;
+        }
+        
+        //new literal?
+        // add to automaton
+        if(nil == literals[literal])
+        {
+            //add
+            literals[literal] = @(patternsOfLiterals.count);
+            [patternsOfLiterals addObject:[NSMutableIndexSet indexSet]];
+            
+            //insert
+            [self insert:[literal dataUsingEncoding:NSUTF8StringEncoding] literal:(int32_t)(patternsOfLiterals.count-1)];
+        }
+        
+        //add pattern to literal
+        [patternsOfLiterals[[literals[literal] integerValue]] addIndex:patternRules.count-1];
+    }
+    
+    //none?
+    if(0 == patternRules.count) return nil;
+    
+    //link
+    [self link];
+    
+    //save
+    rules = [patternRules copy];
+    verifiers = [patternVerifiers copy];
+    literalPatterns = [patternsOfLiterals copy];
+    unfiltered = [noLiterals copy];
+    count = rules.count;
+    
+    //dbg msg
+    os_log_debug(logHandle, "compiled %lu endpoint patterns (%lu literals, %lu unfiltered, %lu nodes)", (unsigned long)count, (unsigned long)literalPatterns.count, (unsigned long)unfiltered.count, (unsigned long)(nodes.length/sizeof(MatcherNode)));
+    
+    return self;
+}
+
+//node at index
+-(MatcherNode*)node:(int32_t)index
+{
+    return ((MatcherNode*)nodes.mutableBytes) + index;
+}
+
+//add a node
+-(int32_t)addNode:(uint8_t)byte
+{
+    //node
+    MatcherNode node = {NO_NODE, NO_NODE, 0, NO_NODE, NO_NODE, byte};
+    
+    //add
+    [nodes appendBytes:&node length:sizeof(node)];
+    
+    return (int32_t)(nodes.length/sizeof(MatcherNode)) - 1;
+}
+
+//insert a literal
+-(void)insert:(NSData*)literal literal:(int32_t)literalID
+{
+    //current
+    int32_t current = 0;
+    
+    //bytes
+    const uint8_t* bytes = literal.bytes;
+    
+    for(NSUInteger i = 0; i < literal.length; i++)
+    {
+        //next
+        int32_t next = childOf(nodes.bytes, rootNext, current, bytes[i]);
+        
+        //new?
+        if(NO_NODE == next)
+        {
+            //add
+            // note: invalidates node pointers
+            next = [self addNode:bytes[i]];
+            
+            //link into parent
+            [self node:next]->sibling = [self node:current]->child;
+            [self node:current]->child = next;
+            if(0 == current) rootNext[bytes[i]] = next;
+        }
+        
+        current = next;
+    }
+    
+    //mark end
+    [self node:current]->literal = literalID;
+    
+    return;
+}
+
+//(breadth first) set failure & output links
+-(void)link
+{
+    //queue
+    NSMutableData* queue = nil;
+    
+    //head
+    NSUInteger head = 0;
+    
+    //init
+    queue = [NSMutableData data];
+    
+    //start w/ root
+    int32_t root = 0;
+    [queue appendBytes:&root length:sizeof(root)];
+    
+    while(head < queue.length/sizeof(int32_t))
+    {
+        //current
+        int32_t current = ((int32_t*)queue.bytes)[head++];
+        
+        //each child
+        for(int32_t child = [self node:current]->child; NO_NODE != child; child = [self node:child]->sibling)
+        {
+            //failure
+            int32_t fail = 0;
+            
+            //not a root child?
+            // follow parent's failure links, until one has an edge for this byte
+            if(0 != current)
+            {
+                //byte
+                uint8_t byte = [self node:child]->byte;
+                
+                //walk
+                fail = [self node:current]->fail;
+                while( (0 != fail) && (NO_NODE == childOf(nodes.bytes, rootNext, fail, byte)) ) fail = [self node:fail]->fail;
+                
+                //take edge (if any)
+                fail = childOf(nodes.bytes, rootNext, fail, byte);
+                if( (NO_NODE == fail) || (child == fail) ) fail = 0;
+            }
+            
+            //set links
+            [self node:child]->fail = fail;
+            [self node:child]->output = (NO_NODE != [self node:fail]->literal) ? fail : [self node:fail]->output;
+            
+            //queue
+            [queue appendBytes:&child length:sizeof(child)];
+        }
+    }
+    
+    //root has no output
+    [self node:0]->output = NO_NODE;
+    
+    return;
+}
+
+//rules whose pattern matches any of the endpoint names
+-(NSSet<Rule*>*)match:(NSArray<NSString*>*)endpointNames
+{
+    //matched rules
+    NSMutableSet* matched = nil;
+    
+    //matched patterns
+    NSMutableIndexSet* verified = nil;
+    
+    //nodes
+    const MatcherNode* base = nodes.bytes;
+    
+    //init
+    matched = [NSMutableSet set];
+    verified = [NSMutableIndexSet indexSet];
+    
+    //check each name
+    for(NSString* endpointName in endpointNames)
+    {
+        //candidates
+        NSMutableIndexSet* candidates = nil;
+        
+        //bytes
+        const char* bytes = endpointName.UTF8String;
+        size_t length = strlen(bytes);
+        
+        //state
+        int32_t state = 0;
+        
+        //init w/ patterns that always need checking
+        candidates = [unfiltered mutableCopy];
+        
+        //single pass
+        // collecting patterns whose literal is found
+        for(size_t i = 0; i < length; i++)
+        {
+            //byte
+            uint8_t byte = (uint8_t)bytes[i];
+            
+            //next
+            int32_t next = NO_NODE;
+            
+            //follow failure links until there's an edge
+            while( (0 != state) && (NO_NODE == childOf(base, rootNext, state, byte)) ) state = base[state].fail;
+            
+            //take edge
+            next = childOf(base, rootNext, state, byte);
+            state = (NO_NODE == next) ? 0 : next;
+            
+            //collect all literals ending here
+            for(int32_t output = (NO_NODE != base[state].literal) ? state : base[state].output; NO_NODE != output; output = base[output].output)
+            {
+                [candidates addIndexes:literalPatterns[base[output].literal]];
+            }
+        }
+        
+        //skip already matched
+        [candidates removeIndexes:verified];
+        
+        //verify candidates
+        [candidates enumerateIndexesUsingBlock:^(NSUInteger index, BOOL* stop) {
+            
+            //verifier
+            id verifier = self->verifiers[index];
+            
+            //match?
+            BOOL isMatch = NO;
+            
+            //glob
+            if(YES == [verifier isKindOfClass:[NSData class]])
+            {
+                isMatch = globMatch(((NSData*)verifier).bytes, ((NSData*)verifier).length, bytes, length);
+            }
+            //regex
+            else
+            {
+                isMatch = (0 != [(NSRegularExpression*)verifier numberOfMatchesInString:endpointName options:0 range:NSMakeRange(0, endpointName.length)]);
+            }
+            
+            //save
+            if(YES == isMatch)
+            {
+                [verified addIndex:index];
+                [matched addObject:self->rules[index]];
+            }
+        }];
+    }
+    
+    return matched;
+}
+
+@end
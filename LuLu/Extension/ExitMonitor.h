@@ -0,0 +1,48 @@
+//
+//  file: ExitMonitor.h
+//  project: LuLu (launch daemon)
+//  description: (single) watcher for process exits (header)
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#ifndef ExitMonitor_h
+#define ExitMonitor_h
+
+@import OSLog;
+@import Foundation;
+
+//max number of (kernel) events, per read
+#define EXIT_MONITOR_EVENTS 64
+
+//watcher for process exits
+// one kqueue (EVFILT_PROC/NOTE_EXIT) for all watched processes, instead of a dispatch source per process
+// watches are for a pid + pid version (from an audit token), and any number of them share a pid's (one) kernel event
+// handlers are invoked (once) on the monitor's (serial) queue, as soon as the process exits
+@interface ExitMonitor : NSObject
+
+/* PROPERTIES */
+
+//number of watched processes
+@property(nonatomic, readonly)NSUInteger count;
+
+//number of watches
+@property(nonatomic, readonly)NSUInteger watchCount;
+
+//number of (process) exits
+@property(nonatomic, readonly)uint64_t exits;
+
+/* METHODS */
+
+//watch for a process' exit
+// version is from the process' audit token (0 if unknown), and checked once registered, so a reused pid isn't watched
+// returns an (opaque) watch, or nil if process has already exited (handler then isn't invoked)
+-(id)watch:(pid_t)pid version:(int)version handler:(dispatch_block_t)handler;
+
+//stop watching
+// handler won't be invoked (unless the exit is already being delivered)
+-(void)unwatch:(id)watch;
+
+@end
+
+#endif /* ExitMonitor_h */
@@ -0,0 +1,361 @@
+//
+//  file: ExitMonitor.m
+//  project: LuLu (launch daemon)
+//  description: (single) watcher for process exits
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#import "ExitMonitor.h"
+
+#import <errno.h>
+#import <unistd.h>
+#import <sys/event.h>
+#import <bsm/libbsm.h>
+#import <mach/mach.h>
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+//watch
+// a handler for a process (pid + version)
+@interface ExitWatch : NSObject
+
+//pid
+@property(nonatomic)pid_t pid;
+
+//pid version
+// 0 if unknown
+@property(nonatomic)int version;
+
+//handler
+@property(nonatomic, copy)dispatch_block_t handler;
+
+@end
+
+@implementation ExitWatch
+@end
+
+//(live) pid version of a process
+// from its audit token, 0 if unknown (e.g. it's already exited)
+static int pidVersion(pid_t pid)
+{
+    //version
+    int version = 0;
+
+    //task
+    task_name_t task = MACH_PORT_NULL;
+
+    //token
+    audit_token_t token = {0};
+
+    //size
+    mach_msg_type_number_t size = TASK_AUDIT_TOKEN_COUNT;
+
+    //get task
+    if(KERN_SUCCESS != task_name_for_pid(mach_task_self(), pid, &task)) goto bail;
+
+    //get token
+    if(KERN_SUCCESS == task_info(task, TASK_AUDIT_TOKEN, (task_info_t)&token, &size))
+    {
+        version = audit_token_to_pidversion(token);
+    }
+
+    //release
+    mach_port_deallocate(mach_task_self(), task);
+
+bail:
+
+    return version;
+}
+
+@implementation ExitMonitor
+{
+    //kqueue
+    int kq;
+
+    //(read) source for kqueue
+    // fires when there are (exit) events to read
+    dispatch_source_t source;
+
+    //queue
+    // for source, and handlers
+    dispatch_queue_t queue;
+
+    //watches
+    // key: pid
+    NSMutableDictionary<NSNumber*, NSMutableArray<ExitWatch*>*>* watches;
+}
+
+@synthesize exits;
+
+//init
+-(id)init
+{
+    //kqueue
+    int kqueue_fd = -1;
+
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //init watches
+        watches = [NSMutableDictionary dictionary];
+
+        //init queue
+        queue = dispatch_queue_create("com.objective-see.lulu.exitMonitor", DISPATCH_QUEUE_SERIAL);
+
+        //create kqueue
+        kq = kqueue();
+        if(-1 == kq)
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: 'kqueue' failed with %d", errno);
+            return nil;
+        }
+
+        //copy, for (cancel) block
+        kqueue_fd = kq;
+
+        //create (read) source
+        source = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, kq, 0, queue);
+        if(nil == source)
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: failed to create dispatch source for kqueue");
+
+            close(kq);
+            return nil;
+        }
+
+        //handle events
+        // note: weak, so source doesn't keep monitor alive
+        __weak typeof(self) weakSelf = self;
+        dispatch_source_set_event_handler(source, ^{
+            [weakSelf read];
+        });
+
+        //close kqueue once source is done
+        dispatch_source_set_cancel_handler(source, ^{
+            close(kqueue_fd);
+        });
+
+        //start
+        dispatch_resume(source);
+    }
+
+    return self;
+}
+
+//number of watched processes
+-(NSUInteger)count
+{
+    @synchronized(self)
+    {
+        return watches.count;
+    }
+}
+
+//number of watches
+-(NSUInteger)watchCount
+{
+    //count
+    NSUInteger count = 0;
+
+    @synchronized(self)
+    {
+        for(NSArray* pidWatches in watches.allValues) count += pidWatches.count;
+    }
+
+    return count;
+}
+
+//watch for a process' exit
+// returns nil if process has already exited
+-(id)watch:(pid_t)pid version:(int)version handler:(dispatch_block_t)handler
+{
+    //watch
+    ExitWatch* watch = nil;
+
+    //watches for pid
+    NSMutableArray<ExitWatch*>* pidWatches = nil;
+
+    //event
+    struct kevent event = {0};
+
+    //sanity check
+    if( (pid <= 0) || (nil == handler) ) return nil;
+
+    //init
+    watch = [[ExitWatch alloc] init];
+    watch.pid = pid;
+    watch.version = version;
+    watch.handler = handler;
+
+    @synchronized(self)
+    {
+        //existing watches
+        pidWatches = watches[@(pid)];
+
+        //first watch for pid?
+        // register (kernel) event
+        if(0 == pidWatches.count)
+        {
+            //register
+            // EV_ADD on an existing registration just updates it
+            EV_SET(&event, pid, EVFILT_PROC, EV_ADD | EV_ONESHOT, NOTE_EXIT, 0, NULL);
+            if(0 != kevent(kq, &event, 1, NULL, 0, NULL))
+            {
+                //already exited?
+                if(ESRCH != errno) os_log_error(logHandle, "ERROR: 'kevent' failed to watch %d, with %d", pid, errno);
+
+                //done w/ pid
+                [watches removeObjectForKey:@(pid)];
+                watch = nil;
+            }
+        }
+
+        //(now) registered, but is pid (still) the process w/ this version?
+        // if pid was reused (i.e. watched process already exited), treat as exited
+        // ...as otherwise handler would only be invoked once the unrelated (new) process exits
+        if( (nil != watch) &&
+            (0 != version) )
+        {
+            //live version
+            int liveVersion = pidVersion(pid);
+            if( (0 != liveVersion) &&
+                (version != liveVersion) )
+            {
+                //dbg msg
+                os_log_debug(logHandle, "pid %d was reused (version %d, now %d), so process has already exited", pid, version, liveVersion);
+
+                //only watch?
+                // unregister (kernel) event
+                if(0 == pidWatches.count)
+                {
+                    EV_SET(&event, pid, EVFILT_PROC, EV_DELETE, 0, 0, NULL);
+                    kevent(kq, &event, 1, NULL, 0, NULL);
+
+                    [watches removeObjectForKey:@(pid)];
+                }
+
+                //already exited
+                watch = nil;
+            }
+        }
+
+        //add
+        if(nil != watch)
+        {
+            if(nil == pidWatches)
+            {
+                pidWatches = [NSMutableArray array];
+                watches[@(pid)] = pidWatches;
+            }
+            [pidWatches addObject:watch];
+        }
+    }
+
+    return watch;
+}
+
+//stop watching
+-(void)unwatch:(id)watch
+{
+    //watches for pid
+    NSMutableArray<ExitWatch*>* pidWatches = nil;
+
+    //event
+    struct kevent event = {0};
+
+    //sanity check
+    if(YES != [watch isKindOfClass:[ExitWatch class]]) return;
+
+    @synchronized(self)
+    {
+        //remove
+        pidWatches = watches[@(((ExitWatch*)watch).pid)];
+        [pidWatches removeObjectIdenticalTo:watch];
+
+        //last watch for pid?
+        // unregister (kernel) event
+        if( (nil != pidWatches) &&
+            (0 == pidWatches.count) )
+        {
+            EV_SET(&event, ((ExitWatch*)watch).pid, EVFILT_PROC, EV_DELETE, 0, 0, NULL);
+            kevent(kq, &event, 1, NULL, 0, NULL);
+
+            [watches removeObjectForKey:@(((ExitWatch*)watch).pid)];
+        }
+    }
+
+    return;
+}
+
+//read (exit) events
+// invoked on queue, when kqueue is readable
+-(void)read
+{
+    //events
+    struct kevent events[EXIT_MONITOR_EVENTS] = {0};
+
+    //no wait
+    struct timespec timeout = {0, 0};
+
+    //count
+    int count = 0;
+
+    //exited watches
+    NSMutableArray<ExitWatch*>* exited = nil;
+
+    //read
+    count = kevent(kq, NULL, 0, events, EXIT_MONITOR_EVENTS, &timeout);
+    if(count <= 0) return;
+
+    //init
+    exited = [NSMutableArray array];
+
+    @synchronized(self)
+    {
+        //grab (and remove) each exited pid's watches
+        for(int i = 0; i < count; i++)
+        {
+            //not an exit?
+            if( (EVFILT_PROC != events[i].filter) ||
+                (0 == (events[i].fflags & NOTE_EXIT)) )
+            {
+                continue;
+            }
+
+            //grab
+            NSNumber* pid = @((pid_t)events[i].ident);
+            if(nil != watches[pid]) [exited addObjectsFromArray:watches[pid]];
+
+            //remove
+            [watches removeObjectForKey:pid];
+
+            //inc
+            exits++;
+        }
+    }
+
+    //dbg msg
+    if(0 != exited.count) os_log_debug(logHandle, "delivering %lu process exit(s)", (unsigned long)exited.count);
+
+    //deliver
+    // outside lock, so handlers can (un)watch
+    for(ExitWatch* watch in exited) watch.handler();
+
+    return;
+}
+
+//dealloc
+// stop source, which closes kqueue
+-(void)dealloc
+{
+    if(nil != source) dispatch_source_cancel(source);
+}
+
+@end
@@ -12,22 +12,26 @@
 @import NetworkExtension;
 
 #import "GrayList.h"
+#import "ProcessCache.h"
+#import "RelatedFlows.h"
 
 @interface FilterDataProvider : NEFilterDataProvider
 
 /* PROPERTIES */
 
 //(process) cache
-@property(atomic, retain)NSCache* cache;
+@property(atomic, retain)ProcessCache* cache;
 
 //graylist obj
 @property(nonatomic, retain)GrayList* grayList;
 
 //related flows
-@property(nonatomic, retain)NSMutableDictionary* relatedFlows;
+// (paused) flows held per process while its alert is shown
+@property(nonatomic, retain)RelatedFlows* relatedFlows;
 
-//timer to reap flows whose process has terminated
-@property(nonatomic, strong)dispatch_source_t reapTimer;
+//exit watches for processes w/ related flows
+// key: (pid << 32) | pid version
+@property(nonatomic, retain)NSMutableDictionary* relatedWatches;
 
 /* METHODS */
 
@@ -42,8 +46,8 @@
 //remove a single (specific) flow from a key's queue
 -(void)removeRelatedFlow:(NEFilterSocketFlow*)flow forKey:(NSString*)key;
 
-//reap flows whose process has terminated
-// invoked periodically (timer) so paused flows of dead processes aren't held forever
--(void)reapDeadFlows;
+//drop (held) flows of a process that has exited
+// invoked by the exit monitor, so paused flows of dead processes aren't held forever
+-(void)relatedFlowsExited:(pid_t)pid version:(int)version;
 
 @end
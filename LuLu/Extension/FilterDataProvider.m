@@ -10,13 +10,19 @@
 #import "Rules.h"
 #import "Alerts.h"
 #import "consts.h"
+#import "FlowStats.h"
+#import "FlowRecorder.h"
 #import "GrayList.h"
 #import "BlockOrAllowList.h"
 #import "utilities.h"
 #import "Preferences.h"
+#import "ExitMonitor.h"
+#import "VerdictCache.h"
 #import "XPCUserProto.h"
 #import "FilterDataProvider.h"
 
+#import <mach/mach_time.h>
+
 //verdicts
 typedef NS_ENUM(NSInteger, FlowVerdict) {
     kFlowVerdictAllow,
@@ -48,6 +54,31 @@ extern BlockOrAllowList* allowList;
 //block list
 extern BlockOrAllowList* blockList;
 
+//verdict cache
+extern VerdictCache* verdictCache;
+
+//flow stats
+extern FlowStats* flowStats;
+
+//flow recorder
+// nil, unless recording is enabled
+extern FlowRecorder* flowRecorder;
+
+//exit monitor
+extern ExitMonitor* exitMonitor;
+
+//map a verdict to its (stats) counter
+static FlowStatsVerdict statsVerdict(FlowVerdict verdict)
+{
+    switch(verdict)
+    {
+        case kFlowVerdictBlock: return FlowStatsVerdictBlock;
+        case kFlowVerdictPause: return FlowStatsVerdictPause;
+        case kFlowVerdictRelated: return FlowStatsVerdictRelated;
+        default: return FlowStatsVerdictAllow;
+    }
+}
+
 @implementation FilterDataProvider
 
 @synthesize cache;
@@ -61,30 +92,24 @@ extern BlockOrAllowList* blockList;
     if(nil != self)
     {
         //init cache
-        cache = [[NSCache alloc] init];
-        
-        //set cache limit
-        self.cache.countLimit = 2048;
+        // LRU, keyed on pid + pid version, w/ entries evicted on process exit
+        // note: shares the (global) exit monitor, or if that's not (yet) created, uses its own
+        cache = [[ProcessCache alloc] init:exitMonitor];
         
         //init gray list
         grayList = [[GrayList alloc] init];
         
         //alloc related flows
-        self.relatedFlows = [NSMutableDictionary dictionary];
+        // note: (optional) per process limit pref is applied when flows are added, as prefs may not be loaded yet
+        self.relatedFlows = [[RelatedFlows alloc] init:RELATED_FLOWS_LIMIT];
 
         //save global handle
         // allows the XPC listener to resume held flows when the client goes away
         provider = self;
 
-        //start timer to reap flows of terminated processes
+        //alloc exit watches
         // a process can exit while its alert is pending; its paused flows would otherwise be held forever
-        __weak typeof(self) weakSelf = self;
-        self.reapTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0));
-        dispatch_source_set_timer(self.reapTimer, dispatch_time(DISPATCH_TIME_NOW, 60 * NSEC_PER_SEC), 60 * NSEC_PER_SEC, 10 * NSEC_PER_SEC);
-        dispatch_source_set_event_handler(self.reapTimer, ^{
-            [weakSelf reapDeadFlows];
-        });
-        dispatch_resume(self.reapTimer);
+        self.relatedWatches = [NSMutableDictionary dictionary];
     }
 
     return self;
@@ -174,12 +199,12 @@ extern BlockOrAllowList* blockList;
         os_log_debug(logHandle, "reason: NEProviderStopReasonUserInitiated");
     }
 
-    //stop the reap timer
-    if(nil != self.reapTimer)
+    //stop watching (related flows') processes
+    @synchronized(self.relatedWatches)
     {
-        //cancel & release
-        dispatch_source_cancel(self.reapTimer);
-        self.reapTimer = nil;
+        //unwatch each
+        for(id watch in self.relatedWatches.allValues) [exitMonitor unwatch:watch];
+        [self.relatedWatches removeAllObjects];
     }
 
     //resume (allow) any still held/paused flows
@@ -275,9 +300,14 @@ extern BlockOrAllowList* blockList;
             verdict = [NEFilterNewFlowVerdict pauseVerdict];
             
             //save as related flow
-            Process* process = [self.cache objectForKey:flow.sourceAppAuditToken];
+            Process* process = [self.cache objectForToken:flow.sourceAppAuditToken];
             if(process) {
-                [self addRelatedFlow:process.key flow:socketFlow];
+                
+                //process' queue is full?
+                // don't hold (pause) it, but apply overflow policy
+                if(YES != [self addRelatedFlow:process.key flow:socketFlow]) {
+                    verdict = [self relatedFlowsOverflowVerdict];
+                }
             }
             //no process
             // just allow
@@ -351,12 +381,37 @@ bail:
     //token
     static dispatch_once_t onceToken = 0;
     
-    //grab console user
-    consoleUser = getConsoleUser();
+    //verdict cache key
+    NSString* cacheKey = nil;
+    
+    //flow's match context
+    // names, addresses, port, etc. (built once, for all list/rule checks)
+    FlowMatchContext* context = nil;
+    
+    //cached verdict
+    NSInteger cachedVerdict = 0;
+    
+    //generation (of rules, prefs, etc.) verdict is evaluated in
+    uint64_t generation = 0;
+    
+    //flag
+    // set for verdicts that only depend on rules, prefs, lists, etc. (not on alerts/clients)
+    BOOL cacheable = NO;
+    
+    //flag
+    // (block/allow) list matched
+    BOOL matched = NO;
 
     //pid
     // extracted from flow's audit token
     pid_t pid = 0;
+    
+    //start time
+    // for (per stage) stats
+    uint64_t start = mach_absolute_time();
+    
+    //stage start time
+    uint64_t stageStart = 0;
 
     //extract pid
     // note: 'audit_token_to_pid' is just a field accessor (can't fail), so only call it on a well-formed token
@@ -376,6 +431,9 @@ bail:
         //bail
         goto bail;
     }
+    
+    //grab console user
+    consoleUser = getConsoleUser();
 
     //CHECK:
     // process already exited (or zombie'd)? ...deny
@@ -389,8 +447,52 @@ bail:
         goto bail;
     }
 
+    //CHECK:
+    // different logged in user?
+    // just allow flow, as we don't want to block their traffic
+    // note: checked (like if process is alive) before verdict cache, as neither is part of a cached verdict
+    if( (nil != consoleUser) && (nil != alerts.consoleUser) &&
+        (YES != [alerts.consoleUser isEqualToString:consoleUser]) )
+    {
+        //dbg msg
+        os_log_debug(logHandle, "current console user '%{public}@', is different than '%{public}@', so allowing flow: %{public}@", consoleUser, alerts.consoleUser, ((NEFilterSocketFlow*)flow).remoteEndpoint);
+        
+        //all set
+        goto bail;
+    }
+    
+    //grab generation
+    // before any checks, so a change mid-evaluation means verdict won't be cached
+    generation = verdictCache.generation;
+    
+    //CHECK:
+    // verdict cached? (same process, endpoint, port, & protocol)
+    // note: skips the full (process, list, rule, etc.) evaluation
+    stageStart = mach_absolute_time();
+    cacheKey = [VerdictCache keyForFlow:(NEFilterSocketFlow*)flow];
+    if( (nil != cacheKey) &&
+        (YES == [verdictCache lookup:cacheKey verdict:&cachedVerdict]) )
+    {
+        //dbg msg
+        os_log_debug(logHandle, "found cached verdict (%ld) for %{public}@", (long)cachedVerdict, cacheKey);
+        
+        //stats
+        [flowStats record:FlowStageVerdictCache start:stageStart];
+        [flowStats record:FlowStageTotal start:start];
+        [flowStats count:statsVerdict((FlowVerdict)cachedVerdict)];
+        [flowStats count:FlowStatsVerdictCached];
+        
+        //done
+        // note: skip bail, as verdict is already cached
+        return (FlowVerdict)cachedVerdict;
+    }
+    
+    //stats
+    [flowStats record:FlowStageVerdictCache start:stageStart];
+    
     //check cache for process
-    process = [self.cache objectForKey:flow.sourceAppAuditToken];
+    stageStart = mach_absolute_time();
+    process = [self.cache objectForToken:flow.sourceAppAuditToken];
     if(!process) {
 
         os_log_debug(logHandle, "no process found in cache, will create");
@@ -406,6 +508,9 @@ bail:
         //dbg msg
         os_log_debug(logHandle, "found process object in cache: %{public}@ (pid: %d)", process.path, process.pid);
     }
+    
+    //stats
+    [flowStats record:FlowStageProcess start:stageStart];
 
     //sanity check
     // couldn't create process obj?
@@ -430,18 +535,13 @@ bail:
         goto bail;
     }
         
-    //CHECK:
-    // different logged in user?
-    // just allow flow, as we don't want to block their traffic
-    if( (nil != consoleUser) && (nil != alerts.consoleUser) &&
-        (YES != [alerts.consoleUser isEqualToString:consoleUser]) )
-    {
-        //dbg msg
-        os_log_debug(logHandle, "current console user '%{public}@', is different than '%{public}@', so allowing flow: %{public}@", consoleUser, alerts.consoleUser, ((NEFilterSocketFlow*)flow).remoteEndpoint);
-        
-        //all set
-        goto bail;
-    }
+    //init flow's match context
+    // shared by all (list & rule) checks below
+    context = [[FlowMatchContext alloc] init:(NEFilterSocketFlow*)flow];
+    
+    //record flow?
+    // (opt-in) so the decision engine can be replayed offline
+    [flowRecorder record:process flow:(NEFilterSocketFlow*)flow];
     
     //CHECK:
     // client in (full) block mode? ...block!
@@ -449,14 +549,23 @@ bail:
     if(YES == [preferences.preferences[PREF_BLOCK_MODE] boolValue])
     {
         //but allow list set?
-        if( (YES == [preferences.preferences[PREF_USE_ALLOW_LIST] boolValue]) &&
-            (YES == [allowList isMatch:(NEFilterSocketFlow*)flow]) )
+        if(YES == [preferences.preferences[PREF_USE_ALLOW_LIST] boolValue])
+        {
+            //match?
+            stageStart = mach_absolute_time();
+            matched = [allowList isMatch:context];
+            [flowStats record:FlowStageAllowList start:stageStart];
+        }
+        
+        //allow list match?
+        if(YES == matched)
         {
             //dbg msg
             os_log_debug(logHandle, "client in block mode, but flow matches item in allow list, so allowing");
                 
             //allow
             verdict = kFlowVerdictAllow;
+            cacheable = YES;
                 
             //all set
             goto bail;
@@ -467,6 +576,7 @@ bail:
         
         //deny
         verdict = kFlowVerdictBlock;
+        cacheable = YES;
         
         //all set
         goto bail;
@@ -481,13 +591,17 @@ bail:
         os_log_debug(logHandle, "client is using block list '%{public}@' (%lu items) ...will check for match", preferences.preferences[PREF_BLOCK_LIST], (unsigned long)blockList.items.count);
         
         //match in block list?
-        if(YES == [blockList isMatch:(NEFilterSocketFlow*)flow])
+        stageStart = mach_absolute_time();
+        matched = [blockList isMatch:context];
+        [flowStats record:FlowStageBlockList start:stageStart];
+        if(YES == matched)
         {
             //dbg msg
             os_log_debug(logHandle, "flow matches item in block list, so denying");
             
             //deny
             verdict = kFlowVerdictBlock;
+            cacheable = YES;
             
             //all set
             goto bail;
@@ -505,13 +619,17 @@ bail:
         os_log_debug(logHandle, "client is using allow list '%{public}@' (%lu items) ...will check for match", preferences.preferences[PREF_ALLOW_LIST], (unsigned long)allowList.items.count);
         
         //match in allow list?
-        if(YES == [allowList isMatch:(NEFilterSocketFlow*)flow])
+        stageStart = mach_absolute_time();
+        matched = [allowList isMatch:context];
+        [flowStats record:FlowStageAllowList start:stageStart];
+        if(YES == matched)
         {
             //dbg msg
             os_log_debug(logHandle, "flow matches item in allow list, so allowing");
             
             //allow
             verdict = kFlowVerdictAllow;
+            cacheable = YES;
             
             //all set
             goto bail;
@@ -525,16 +643,14 @@ bail:
     // allow localhost enabled?
     if([preferences.preferences[PREF_ALLOW_LOCALHOST] boolValue])
     {
-        NEFilterSocketFlow* socketFlow = (NEFilterSocketFlow*)flow;
-        NWHostEndpoint* remoteEndpoint = (NWHostEndpoint*)socketFlow.remoteEndpoint;
-        
         //localhost?
-        if([self isLocalhostHostname:remoteEndpoint.hostname]) {
+        if([self isLocalhostHostname:context.hostname]) {
             
-            os_log_debug(logHandle, "localhost allowed (preferences), so allowing loopback to %{public}@", remoteEndpoint);
+            os_log_debug(logHandle, "localhost allowed (preferences), so allowing loopback to %{public}@", context.hostname);
             
             //allow
             verdict = kFlowVerdictAllow;
+            cacheable = YES;
             
             //all set
             goto bail;
@@ -545,7 +661,9 @@ bail:
     // check for existing rule
     
     //existing rule for process?
-    matchingRule = [rules find:process flow:(NEFilterSocketFlow*)flow];
+    stageStart = mach_absolute_time();
+    matchingRule = [rules find:process context:context];
+    [flowStats record:FlowStageRules start:stageStart];
     if(nil != matchingRule)
     {
         //dbg msg
@@ -576,6 +694,10 @@ bail:
         }
         //allow (msg)
         else os_log_debug(logHandle, "rule says: ALLOW");
+        
+        //cacheable?
+        // not if rule expires, as expiration doesn't change the generation
+        cacheable = (nil == matchingRule.expiration);
     
         //all set
         goto bail;
@@ -594,6 +716,10 @@ bail:
         //dbg msg
         os_log_debug(logHandle, "client in passive mode...");
         
+        //(passive) verdict only depends on prefs
+        // note: if a rule is created, generation changes so this won't be cached anyway
+        cacheable = YES;
+        
         //user action: allow?
         if(PREF_PASSIVE_MODE_ALLOW == [preferences.preferences[PREF_PASSIVE_MODE_ACTION] integerValue])
         {
@@ -620,14 +746,15 @@ bail:
             //dbg msg
             os_log_debug(logHandle, "passive mode: create rules is set, so creating rule for new connection");
             
-            //extract remote endpoint information
-            NWHostEndpoint* remoteEndpoint = (NWHostEndpoint*)((NEFilterSocketFlow*)flow).remoteEndpoint;
+            //start
+            stageStart = mach_absolute_time();
             
             //init info for rule creation with specific endpoint information
             info = [@{KEY_PATH:process.path, KEY_TYPE:@RULE_TYPE_PASSIVE} mutableCopy];
             
             //get best hostname (prioritizes domain names over IP addresses)
-            NSString* bestHostname = [self getBestHostnameFromFlow:(NEFilterSocketFlow*)flow];
+            // already picked by the flow's match context
+            NSString* bestHostname = context.bestHostname;
             
             //add endpoint address (hostname) if available
             if(0!= bestHostname.length) {
@@ -637,16 +764,16 @@ bail:
             }
             
             //add endpoint port if available
-            if(0 != remoteEndpoint.port.length) {
-                info[KEY_ENDPOINT_PORT] = remoteEndpoint.port;
+            if(0 != context.port.length) {
+                info[KEY_ENDPOINT_PORT] = context.port;
             } else {
                 info[KEY_ENDPOINT_PORT] = VALUE_ANY;
             }
             
             //add protocol if available
-            if(((NEFilterSocketFlow*)flow).socketProtocol > 0)
+            if(context.protocol > 0)
             {
-                info[KEY_PROTOCOL] = [NSNumber numberWithInt:((NEFilterSocketFlow*)flow).socketProtocol];
+                info[KEY_PROTOCOL] = [NSNumber numberWithInt:context.protocol];
             }
 
             //add process cs info?
@@ -683,6 +810,9 @@ bail:
             
             //tell user rules changed
             [alerts.xpcUserClient rulesChanged];
+            
+            //stats
+            [flowStats record:FlowStagePassiveRule start:stageStart];
         }
         //no rule creation needed
         else
@@ -716,6 +846,7 @@ bail:
 
             //allow
             verdict = kFlowVerdictAllow;
+            cacheable = YES;
 
             //done
             goto bail;
@@ -939,6 +1070,7 @@ bail:
             
             //allow
             verdict = kFlowVerdictAllow;
+            cacheable = YES;
             
             //done
             goto bail;
@@ -967,6 +1099,19 @@ bail:
     // log stream --level debug --predicate 'subsystem == "com.objective-see.lulu" && composedMessage BEGINSWITH "[LULU]"'
     os_log_debug(logHandle, "[LULU] PROCESS: %{public}@, FLOW (endpoint): %{public}@, RULE: %{public}@, verdict: %ld", process.path, ((NEFilterSocketFlow*)flow).remoteEndpoint, matchingRule, verdict);
     
+    //stats
+    [flowStats record:FlowStageTotal start:start];
+    [flowStats count:statsVerdict(verdict)];
+    
+    //cache verdict?
+    // only allow/block, as others depend on alerts/client
+    if( (YES == cacheable) &&
+        ((kFlowVerdictAllow == verdict) || (kFlowVerdictBlock == verdict)) )
+    {
+        //cache
+        [verdictCache store:cacheKey verdict:verdict generation:generation];
+    }
+    
     return verdict;
 }
 
@@ -979,6 +1124,10 @@ bail:
 
     //rule
     __block Rule* rule = nil;
+    
+    //start time
+    // for stats
+    uint64_t start = mach_absolute_time();
 
     //create alert
     alert = [alerts create:(NEFilterSocketFlow*)flow process:process];
@@ -1037,7 +1186,7 @@ bail:
         [alerts removeShown:alert[KEY_KEY]];
 
         //process remaining paused flows for this process
-        // rule path: each re-evaluates against the new rule & is resumed
+        // rule path: evaluated (in one batch) against the new rule & resumed
         // 'once' path: the next flow finds no rule -> generates its own alert
         [strongSelf processRelatedFlow:alert[KEY_KEY]];
     }])
@@ -1057,10 +1206,18 @@ bail:
         [alerts addShown:alert];
 
         //track the primary (paused) flow alongside related flows
-        // so it's resumed on reply (via processRelatedFlow), reaped if the process dies, or released on disconnect
-        [self addRelatedFlow:alert[KEY_KEY] flow:(NEFilterSocketFlow*)flow];
+        // so it's resumed on reply (via processRelatedFlow), dropped if the process exits, or released on disconnect
+        // note: always held (even if process' queue is full), as it's the flow the user is answering
+        @synchronized(self.relatedWatches)
+        {
+            [self watchRelatedFlow:flow];
+            [self.relatedFlows addAlerted:flow key:alert[KEY_KEY]];
+        }
     }
     
+    //stats
+    [flowStats record:FlowStageAlert start:start];
+    
     return;
 }
 
@@ -1068,108 +1225,233 @@ bail:
 //add an alert to 'related'
 // invoked when there is already an alert shown for process
 // once user responds to alert, these will then be processed
--(void)addRelatedFlow:(NSString*)key flow:(NEFilterSocketFlow*)flow
+// returns NO if process' queue is full, or it has exited (flow isn't held, so caller must apply overflow policy)
+-(BOOL)addRelatedFlow:(NSString*)key flow:(NEFilterSocketFlow*)flow
 {
+    //limit
+    NSUInteger limit = 0;
+    
     //dbg msg
     os_log_debug(logHandle, "adding flow to 'related': %{public}@ / %{public}@", key, flow);
     
     if(!key) {
-        return;
+        return NO;
     }
     
-    //sync/save
-    @synchronized(self.relatedFlows)
+    //(optional) limit from prefs
+    // not in UI, so only set manually
+    limit = [preferences.preferences[PREF_RELATED_FLOWS_LIMIT] unsignedIntegerValue];
+    self.relatedFlows.limit = (0 != limit) ? limit : RELATED_FLOWS_LIMIT;
+
+    //sync
+    // so process' exit can't be handled between watching & adding
+    @synchronized(self.relatedWatches)
     {
-        //first time
-        // init (ordered) set for item (process) flows
-        if(!self.relatedFlows[key]) {
-            self.relatedFlows[key] = [NSMutableOrderedSet orderedSet];
+        //watch process
+        // if it has already exited, don't hold
+        if(YES != [self watchRelatedFlow:flow])
+        {
+            //dbg msg
+            os_log_debug(logHandle, "process (for %{public}@) has already exited, won't hold flow", key);
+            
+            return NO;
         }
-
+        
         //add
-        [self.relatedFlows[key] addObject:flow];
+        return [self.relatedFlows add:flow key:key];
+    }
+}
+
+//watch a related flow's process
+// one watch per process (pid + version), no matter how many of its flows are held
+// note: caller should hold the (related watches) lock; returns NO if process has already exited
+-(BOOL)watchRelatedFlow:(NEFilterSocketFlow*)flow
+{
+    //token
+    audit_token_t* token = NULL;
+    
+    //pid
+    pid_t pid = 0;
+    
+    //pid version
+    int version = 0;
+    
+    //key
+    NSNumber* key = nil;
+    
+    //watch
+    id watch = nil;
+    
+    //weak self
+    __weak typeof(self) weakSelf = self;
+    
+    //sanity check
+    // can't watch, but can still hold
+    if(sizeof(audit_token_t) != flow.sourceAppAuditToken.length) return YES;
+    
+    //init
+    token = (audit_token_t*)flow.sourceAppAuditToken.bytes;
+    pid = audit_token_to_pid(*token);
+    version = audit_token_to_pidversion(*token);
+    key = @(((uint64_t)(uint32_t)pid << 32) | (uint32_t)version);
+    
+    //already watching?
+    if(nil != self.relatedWatches[key]) return YES;
+    
+    //watch
+    watch = [exitMonitor watch:pid version:version handler:^{
+        [weakSelf relatedFlowsExited:pid version:version];
+    }];
+    
+    //exited?
+    // (note: no monitor means exits just aren't watched)
+    if(nil == watch) return (nil == exitMonitor);
+    
+    //save
+    self.relatedWatches[key] = watch;
+    
+    return YES;
+}
+
+//verdict for flows that can't be held
+// i.e. their process already has the max number of related flows
+-(NEFilterNewFlowVerdict*)relatedFlowsOverflowVerdict
+{
+    //allow?
+    if(PREF_RELATED_FLOWS_OVERFLOW_ALLOW == [preferences.preferences[PREF_RELATED_FLOWS_OVERFLOW] integerValue])
+    {
+        return [NEFilterNewFlowVerdict allowVerdict];
     }
+    
+    //default
+    // block, as user hasn't (yet) ok'd the process
+    return [NEFilterNewFlowVerdict dropVerdict];
+}
 
+//(re)hold a flow that's already paused
+// if process' queue is full, resume it now, per overflow policy
+-(void)holdRelatedFlow:(NSString*)key flow:(NEFilterSocketFlow*)flow
+{
+    //add
+    // or resume
+    if(YES != [self addRelatedFlow:key flow:flow])
+    {
+        [self resumeFlow:flow withVerdict:[self relatedFlowsOverflowVerdict]];
+    }
+    
     return;
 }
 
 //process any related flows
+// flows are taken in one batch, then grouped by process + endpoint (i.e. their verdict cache key),
+// as flows in a group will get the same verdict, only one per group is evaluated (vs. all flows).
+// each group then is either resumed, (still) related so held again, or triggers a (re)alert
 -(void)processRelatedFlow:(NSString*)key
 {
+    //groups
+    NSArray<NSArray*>* groups = nil;
+    
+    //flows to resume
+    NSMutableArray<NEFilterSocketFlow*>* resumed = nil;
+    
+    //their verdicts
+    NSMutableArray<NEFilterNewFlowVerdict*>* verdicts = nil;
+    
+    //number of (still) held flows
+    NSUInteger held = 0;
+    
+    //start time
+    // for stats
+    uint64_t start = mach_absolute_time();
+    
+    //take all flows
+    // grouped by process + endpoint
+    groups = [self.relatedFlows take:key groupedBy:^id<NSCopying>(NEFilterSocketFlow* flow) {
+        return [VerdictCache keyForFlow:flow];
+    }];
+    
     //dbg msg
-    @synchronized(self.relatedFlows) {
-        os_log_debug(logHandle, "processing %lu related flow(s) for %{public}@", (unsigned long)[self.relatedFlows[key] count], key);
-    }
-
-    while(YES)
+    os_log_debug(logHandle, "processing %lu group(s) of related flow(s) for %{public}@", (unsigned long)groups.count, key);
+    
+    //init
+    resumed = [NSMutableArray array];
+    verdicts = [NSMutableArray array];
+    
+    //evaluate (first flow of) each group
+    for(NSArray* group in groups)
     {
-        NEFilterSocketFlow* flow = nil;
-
-        //dequeue one flow
-        @synchronized(self.relatedFlows) {
-            
-            NSMutableOrderedSet* queue = self.relatedFlows[key];
-            
-            //done?
-            if(!queue.count) {
-                os_log_debug(logHandle, "drained (processed) all related flows");
-                [self.relatedFlows removeObjectForKey:key];
-                break;
-            }
-            
-            flow = queue.firstObject;
-            [queue removeObjectAtIndex:0];
-        }
-
+        //verdict
+        NEFilterNewFlowVerdict* verdict = nil;
+        
         //process
-        FlowVerdict flowVerdict = [self processEvent:flow];
-
-        //(still) related?
-        // (re)add and be done for now
-        if(flowVerdict == kFlowVerdictRelated) {
-            os_log_debug(logHandle, "flow is (still) related");
-            [self addRelatedFlow:key flow:flow];
-            break;
-        }
+        // note: may (re)alert, or find an alert is (still) shown
+        FlowVerdict flowVerdict = [self processEvent:group.firstObject];
         
-        //paused (asked user)
-        // asked user, so be done for now too
-        else if(flowVerdict == kFlowVerdictPause) {
-            os_log_debug(logHandle, "flow is paused");
-            break;
+        switch(flowVerdict)
+        {
+            //(still) related
+            // (re)hold the whole group, 'til the shown alert is answered
+            case kFlowVerdictRelated:
+                
+                for(NEFilterSocketFlow* flow in group) [self holdRelatedFlow:key flow:flow];
+                held += group.count;
+                continue;
+                
+            //paused
+            // first flow generated a (new) alert, and is now held by it, so hold the rest of its group
+            case kFlowVerdictPause:
+                
+                for(NSUInteger i = 1; i < group.count; i++) [self holdRelatedFlow:key flow:group[i]];
+                held += group.count;
+                continue;
+                
+            //block
+            case kFlowVerdictBlock:
+                verdict = [NEFilterNewFlowVerdict dropVerdict];
+                break;
+                
+            //allow
+            default:
+                verdict = [NEFilterNewFlowVerdict allowVerdict];
+                break;
         }
         
-        //resume flow
-        NEFilterNewFlowVerdict* verdict = (flowVerdict == kFlowVerdictBlock)
-            ? [NEFilterNewFlowVerdict dropVerdict]
-            : [NEFilterNewFlowVerdict allowVerdict];
-        
+        //save (whole group)
+        for(NEFilterSocketFlow* flow in group)
+        {
+            [resumed addObject:flow];
+            [verdicts addObject:verdict];
+        }
+    }
     
-        os_log_debug(logHandle, "resuming related flow with %{public}@", verdict);
-
-        [self resumeFlow:flow withVerdict:verdict];
+    //dbg msg
+    os_log_debug(logHandle, "resuming %lu related flow(s), %lu (still) held", (unsigned long)resumed.count, (unsigned long)held);
+    
+    //resume (all at once)
+    // done after evaluating, so no flow waits on another group's evaluation
+    for(NSUInteger i = 0; i < resumed.count; i++)
+    {
+        [self resumeFlow:resumed[i] withVerdict:verdicts[i]];
     }
     
     os_log_debug(logHandle, "done processing related flows");
+    
+    //stats
+    [flowStats record:FlowStageRelatedFlows start:start];
 }
 
 //resume flows + drop their key(s)
 // pass a (process) key to resume just that one; pass nil to resume all keys
 -(void)resumeFlowsForKey:(NSString*)key verdict:(NEFilterNewFlowVerdict*)verdict
 {
-    //sync
-    @synchronized(self.relatedFlows)
+    //one key, or all keys (nil)
+    NSArray* keys = (nil != key) ? @[key] : [self.relatedFlows keys];
+    for(NSString* k in keys)
     {
-        //one key, or all keys (nil)
-        NSArray* keys = (nil != key) ? @[key] : self.relatedFlows.allKeys;
-        for(NSString* k in keys)
+        //take & resume each held flow
+        for(NEFilterSocketFlow* flow in [self.relatedFlows take:k])
         {
-            //resume each held flow, then drop the key
-            for(NEFilterSocketFlow* flow in self.relatedFlows[k])
-            {
-                [self resumeFlow:flow withVerdict:verdict];
-            }
-            [self.relatedFlows removeObjectForKey:k];
+            [self resumeFlow:flow withVerdict:verdict];
         }
     }
 
@@ -1180,68 +1462,60 @@ bail:
 // (e.g. an 'allow/block once' flow that was resumed directly)
 -(void)removeRelatedFlow:(NEFilterSocketFlow*)flow forKey:(NSString*)key
 {
-    //sync
-    @synchronized(self.relatedFlows)
-    {
-        //remove the flow
-        [self.relatedFlows[key] removeObject:flow];
-
-        //drop the key if now empty
-        if(0 == [self.relatedFlows[key] count])
-        {
-            [self.relatedFlows removeObjectForKey:key];
-        }
-    }
+    //remove
+    // also drops the key if now empty
+    [self.relatedFlows remove:flow key:key];
 
     return;
 }
 
-//reap artifacts of terminated processes
-// 1. paused flows held for a process that exited (would otherwise be held/leaked forever)
-// 2. temporary ('while process runs') rules whose process exited, plus any expired rules
--(void)reapDeadFlows
+//drop (held) flows of a process that has exited
+// and, if it had the process' (shown) alert, clear that too
+-(void)relatedFlowsExited:(pid_t)pid version:(int)version
 {
-    //dbg msg
-    os_log_debug(logHandle, "cleaning up flows from terminated processes...");
-
+    //flows
+    // key -> (held) flows of process
+    NSDictionary<NSString*, NSArray*>* flows = nil;
+    
     //sync
-    @synchronized(self.relatedFlows)
+    // take flows & drop watch, together
+    @synchronized(self.relatedWatches)
     {
-        //note: iterating a snapshot (allKeys), so safe to mutate the dict in the loop
-        for(NSString* key in self.relatedFlows.allKeys)
+        //drop watch
+        [self.relatedWatches removeObjectForKey:@(((uint64_t)(uint32_t)pid << 32) | (uint32_t)version)];
+        
+        //take process' flows
+        flows = [self.relatedFlows takeMatching:^BOOL(NEFilterSocketFlow* flow) {
+            
+            //token
+            audit_token_t* token = (audit_token_t*)flow.sourceAppAuditToken.bytes;
+            
+            return ( (sizeof(audit_token_t) == flow.sourceAppAuditToken.length) &&
+                     (pid == audit_token_to_pid(*token)) &&
+                     (version == audit_token_to_pidversion(*token)) );
+        }];
+    }
+    
+    //process each key
+    for(NSString* key in flows)
+    {
+        //dbg msg
+        os_log_debug(logHandle, "process %d (key: %{public}@) has exited; dropping its %lu held flow(s)", pid, key, (unsigned long)flows[key].count);
+        
+        //drop each
+        for(NEFilterSocketFlow* flow in flows[key])
+        {
+            [self resumeFlow:flow withVerdict:[NEFilterNewFlowVerdict dropVerdict]];
+        }
+        
+        //no more flows for key?
+        // clear its (now-stale) alert state
+        if(0 == [self.relatedFlows countForKey:key])
         {
-            //pid via the flow's (kernel) audit token; all flows for a key share the process
-            NEFilterSocketFlow* flow = [self.relatedFlows[key] firstObject];
-            if(nil == flow) continue;
-            pid_t pid = audit_token_to_pid(*(audit_token_t*)flow.sourceAppAuditToken.bytes);
-
-            //process still alive?
-            // leave its flows be (still awaiting a verdict)
-            if((0 != pid) &&
-               (YES == isAlive(pid)))
-            {
-                continue;
-            }
-
-            //process is gone
-            // drop all its held flows, then clear its (now-stale) alert state
-            os_log_debug(logHandle, "process %d (key: %{public}@) has exited; reaping its flows", pid, key);
-            [self resumeFlowsForKey:key verdict:[NEFilterNewFlowVerdict dropVerdict]];
             [alerts removeShown:key];
         }
-
-        //dbg msg
-        os_log_debug(logHandle, "related flows remaining: %lu key(s)", (unsigned long)self.relatedFlows.count);
-    }
-
-    //also clean up rules whose process has exited (temp/process rules) or that have expired
-    // note: cleanup persists to disk; notify the UI if anything was removed (temp rules show in the rules window)
-    if(0 != [rules cleanup:NO])
-    {
-        //rules changed
-        [alerts.xpcUserClient rulesChanged];
     }
-
+    
     return;
 }
 
@@ -1268,12 +1542,9 @@ bail:
         goto bail;
     }
     
-    //sync to add to cache
-    @synchronized(self.cache) {
-        
-        //add to cache
-        [self.cache setObject:process forKey:flow.sourceAppAuditToken];
-    }
+    //add to cache
+    // note: cache is synchronized
+    [self.cache setObject:process forToken:flow.sourceAppAuditToken cost:process.cost];
     
 bail:
     
@@ -1286,54 +1557,8 @@ bail:
 -(NSString*)getBestHostnameFromFlow:(NEFilterSocketFlow*)flow
 {
     //best hostname
-    NSString* bestHostname = nil;
-    
-    //remote endpoint
-    NWHostEndpoint* remoteEndpoint = nil;
-    
-    //extract remote endpoint
-    remoteEndpoint = (NWHostEndpoint*)flow.remoteEndpoint;
-    
-    //priority 1: try flow.URL.host (best for domain names)
-    if(flow.URL.host.length)
-    {
-        //dbg msg
-        os_log_debug(logHandle, "using flow.URL.host as best hostname: %{public}@", flow.URL.host);
-        
-        //use it
-        bestHostname = flow.URL.host;
-        
-        //done
-        goto bail;
-    }
-    
-    //priority 2: try flow.remoteHostname (macOS 11+)
-    if(@available(macOS 11, *))
-    {
-        if(flow.remoteHostname.length)
-        {
-            //dbg msg
-            os_log_debug(logHandle, "using flow.remoteHostname as best hostname: %{public}@", flow.remoteHostname);
-            
-            //use it
-            bestHostname = flow.remoteHostname;
-            
-            //done
-            goto bail;
-        }
-    }
-    
-    //priority 3: fallback to remoteEndpoint.hostname (may be IP address)
-    if(remoteEndpoint.hostname.length)
-    {
-        //dbg msg
-        os_log_debug(logHandle, "using remoteEndpoint.hostname as fallback hostname: %{public}@", remoteEndpoint.hostname);
-        
-        //use it
-        bestHostname = remoteEndpoint.hostname;
-    }
-    
-bail:
+    // url host, then remote host name, then endpoint (may be IP address)
+    NSString* bestHostname = [[FlowMatchContext alloc] init:flow].bestHostname;
     
     //dbg msg
     os_log_debug(logHandle, "best hostname for flow: %{public}@", bestHostname);
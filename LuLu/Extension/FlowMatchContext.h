@@ -0,0 +1,85 @@
+//
+//  file: FlowMatchContext.h
+//  project: LuLu (launch daemon)
+//  description: per-flow match context, shared by all rule/list checks (header)
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#ifndef FlowMatchContext_h
+#define FlowMatchContext_h
+
+@import OSLog;
+@import Foundation;
+@import NetworkExtension;
+
+//max (numeric) addresses per flow
+// a flow has at most: url host, endpoint host name, and remote host name
+#define FLOW_MATCH_MAX_ADDRESSES 4
+
+//a (parsed) numeric address
+typedef struct
+{
+    //family (AF_INET/AF_INET6)
+    int family;
+    
+    //bytes (network order)
+    uint8_t bytes[16];
+    
+} FlowAddress;
+
+//everything rule/list checks need from a flow
+// built once per flow (in 'processEvent:'), so names aren't rebuilt, lower-cased, or parsed per rule/list
+@interface FlowMatchContext : NSObject
+
+/* PROPERTIES */
+
+//endpoint names (url, its host, and host names)
+// original case, de-duplicated, in order (for regex/glob rules)
+@property(nonatomic, retain, readonly)NSArray<NSString*>* names;
+
+//lower-cased endpoint names
+// for exact (rule) matches
+@property(nonatomic, retain, readonly)NSSet<NSString*>* lowercaseNames;
+
+//lower-cased endpoint names, plus remote host name w/o 'www.'
+// for block/allow list matches
+@property(nonatomic, retain, readonly)NSSet<NSString*>* listNames;
+
+//endpoint (ip) host name
+@property(nonatomic, retain, readonly)NSString* hostname;
+
+//best host name
+// prioritizes domain names over IP addresses (url host, then remote host name, then endpoint)
+@property(nonatomic, retain, readonly)NSString* bestHostname;
+
+//remote port
+@property(nonatomic, retain, readonly)NSString* port;
+
+//remote port (numeric)
+@property(nonatomic, readonly)uint16_t portNumber;
+
+//socket family
+@property(nonatomic, readonly)int family;
+
+//socket protocol
+@property(nonatomic, readonly)int protocol;
+
+//number of (parsed) numeric addresses
+@property(nonatomic, readonly)NSUInteger addressCount;
+
+/* METHODS */
+
+//init with a flow
+-(id)init:(NEFilterSocketFlow*)flow;
+
+//init with a flow's components
+// note: also used by tests, as flows can't be created directly
+-(id)initWithURL:(NSURL*)url hostname:(NSString*)hostname remoteHostname:(NSString*)remoteHostname port:(NSString*)port family:(int)family protocol:(int)protocol;
+
+//(parsed) numeric address at index
+-(const FlowAddress*)addressAtIndex:(NSUInteger)index;
+
+@end
+
+#endif /* FlowMatchContext_h */
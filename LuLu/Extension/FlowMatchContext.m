@@ -0,0 +1,170 @@
+//
+//  file: FlowMatchContext.m
+//  project: LuLu (launch daemon)
+//  description: per-flow match context, shared by all rule/list checks
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#import "consts.h"
+#import "FlowMatchContext.h"
+
+#import <arpa/inet.h>
+#import <sys/socket.h>
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+@implementation FlowMatchContext
+{
+    //(parsed) numeric addresses
+    FlowAddress addresses[FLOW_MATCH_MAX_ADDRESSES];
+}
+
+@synthesize names;
+@synthesize port;
+@synthesize family;
+@synthesize hostname;
+@synthesize protocol;
+@synthesize listNames;
+@synthesize portNumber;
+@synthesize bestHostname;
+@synthesize addressCount;
+@synthesize lowercaseNames;
+
+//init with a flow
+-(id)init:(NEFilterSocketFlow*)flow
+{
+    //remote endpoint
+    NWHostEndpoint* remoteEndpoint = nil;
+    
+    //remote host name
+    NSString* remoteHostname = nil;
+    
+    //extract remote endpoint
+    remoteEndpoint = (NWHostEndpoint*)flow.remoteEndpoint;
+    
+    //macOS 11+?
+    // grab remote host name
+    if(@available(macOS 11, *))
+    {
+        //grab
+        remoteHostname = flow.remoteHostname;
+    }
+    
+    return [self initWithURL:flow.URL hostname:remoteEndpoint.hostname remoteHostname:remoteHostname port:remoteEndpoint.port family:flow.socketFamily protocol:flow.socketProtocol];
+}
+
+//init with a flow's components
+// builds names (in the same order rules were always checked against), then parses any numeric ones
+-(id)initWithURL:(NSURL*)url hostname:(NSString*)endpointHostname remoteHostname:(NSString*)remoteHostname port:(NSString*)remotePort family:(int)socketFamily protocol:(int)socketProtocol
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //names
+        NSMutableOrderedSet* orderedNames = nil;
+        
+        //lower-cased names
+        NSMutableSet* lowercased = nil;
+        
+        //init
+        orderedNames = [NSMutableOrderedSet orderedSetWithCapacity:4];
+        
+        //add url
+        // and just host (as this is what is shown in alert)
+        if(nil != url.absoluteString)
+        {
+            //add full url
+            [orderedNames addObject:url.absoluteString];
+            
+            //add host
+            if(nil != url.host) [orderedNames addObject:url.host];
+        }
+        
+        //add host name
+        if(nil != endpointHostname) [orderedNames addObject:endpointHostname];
+        
+        //add remote host name
+        if(nil != remoteHostname) [orderedNames addObject:remoteHostname];
+        
+        //save
+        names = orderedNames.array;
+        
+        //lower-case each (once)
+        lowercased = [NSMutableSet setWithCapacity:names.count];
+        for(NSString* name in names)
+        {
+            [lowercased addObject:name.lowercaseString];
+        }
+        lowercaseNames = [lowercased copy];
+        
+        //list names also match remote host name, w/o 'www.'
+        if( (nil != remoteHostname) &&
+            (YES == [remoteHostname.lowercaseString hasPrefix:@"www."]) )
+        {
+            [lowercased addObject:[remoteHostname.lowercaseString substringFromIndex:4]];
+        }
+        listNames = [lowercased copy];
+        
+        //parse numeric names (once)
+        // only IPs will parse, so urls/host names are skipped
+        for(NSString* name in names)
+        {
+            //address
+            FlowAddress* address = NULL;
+            
+            //full?
+            if(FLOW_MATCH_MAX_ADDRESSES == addressCount) break;
+            
+            //next
+            address = &addresses[addressCount];
+            
+            //IPv4?
+            if(1 == inet_pton(AF_INET, name.UTF8String, address->bytes))
+            {
+                address->family = AF_INET;
+                addressCount++;
+            }
+            //IPv6?
+            else if(1 == inet_pton(AF_INET6, name.UTF8String, address->bytes))
+            {
+                address->family = AF_INET6;
+                addressCount++;
+            }
+        }
+        
+        //best host name
+        // url host, then remote host name, then endpoint (likely an ip)
+        if(0 != url.host.length) bestHostname = url.host;
+        else if(0 != remoteHostname.length) bestHostname = remoteHostname;
+        else if(0 != endpointHostname.length) bestHostname = endpointHostname;
+        
+        //save endpoint host name
+        hostname = endpointHostname;
+        
+        //save port
+        port = remotePort;
+        portNumber = (uint16_t)remotePort.intValue;
+        
+        //save family & protocol
+        family = socketFamily;
+        protocol = socketProtocol;
+    }
+    
+    return self;
+}
+
+//(parsed) numeric address at index
+-(const FlowAddress*)addressAtIndex:(NSUInteger)index
+{
+    //out of bounds?
+    if(index >= addressCount) return NULL;
+    
+    return &addresses[index];
+}
+
+@end
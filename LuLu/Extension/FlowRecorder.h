@@ -0,0 +1,126 @@
+//
+//  file: FlowRecorder.h
+//  project: LuLu (launch daemon)
+//  description: records (anonymized) flows, for offline replay (header)
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#ifndef FlowRecorder_h
+#define FlowRecorder_h
+
+@import OSLog;
+@import Foundation;
+@import NetworkExtension;
+
+@class Process;
+
+//magic
+#define FLOW_RECORDING_MAGIC "LUFR"
+
+//format version
+#define FLOW_RECORDING_VERSION 1
+
+//record types
+// strings are defined (once) before the first flow that uses them, then referenced by id
+#define FLOW_RECORD_STRING 0x01
+#define FLOW_RECORD_FLOW 0x02
+
+//max recording size
+// recording stops once hit
+#define FLOW_RECORDING_MAX_SIZE (64 * 1024 * 1024)
+
+//buffered bytes, before writing out
+#define FLOW_RECORDING_BUFFER_SIZE (64 * 1024)
+
+//interval (seconds) to write out buffered flows
+#define FLOW_RECORDING_FLUSH_INTERVAL 30
+
+//a recorded flow
+// everything the flow's verdict depends on, but no pid/uid/args/timestamps
+@interface RecordedFlow : NSObject
+
+/* PROPERTIES */
+
+//process key
+// signing id, or path (if unsigned)
+@property(nonatomic, retain)NSString* key;
+
+//process path
+// user's home directory is anonymized
+@property(nonatomic, retain)NSString* path;
+
+//signing id
+@property(nonatomic, retain)NSString* signingID;
+
+//signer
+@property(nonatomic)int signer;
+
+//ancestors
+// canonical paths (w/o self & system roots), for tree ('process + kids') rules
+@property(nonatomic, retain)NSArray<NSString*>* ancestors;
+
+//url
+// w/o query or fragment
+@property(nonatomic, retain)NSString* url;
+
+//endpoint (ip) host name
+@property(nonatomic, retain)NSString* hostname;
+
+//remote host name
+@property(nonatomic, retain)NSString* remoteHostname;
+
+//remote port
+@property(nonatomic, retain)NSString* port;
+
+//socket protocol
+@property(nonatomic)int protocol;
+
+//socket family
+@property(nonatomic)int family;
+
+@end
+
+//flow recorder
+// appends flows to a compact binary file: interned strings + (varint) string ids per flow
+@interface FlowRecorder : NSObject
+
+/* PROPERTIES */
+
+//path
+@property(nonatomic, retain, readonly)NSString* path;
+
+//number of recorded flows
+@property(readonly)NSUInteger count;
+
+//size (incl. buffered bytes)
+@property(readonly)NSUInteger size;
+
+/* METHODS */
+
+//init
+// creates (truncates) file at path, and writes header
+-(id)init:(NSString*)path;
+
+//record a flow
+-(void)record:(Process*)process flow:(NEFilterSocketFlow*)flow;
+
+//record a flow's components
+// note: also used by tests, as flows can't be created directly
+-(void)record:(Process*)process url:(NSURL*)url hostname:(NSString*)hostname remoteHostname:(NSString*)remoteHostname port:(NSString*)port family:(int)family protocol:(int)protocol;
+
+//write out (any) buffered flows
+-(void)flush;
+
+//load a recording
+// returns flows in recorded order, or nil if file isn't a (valid) recording
+// a truncated (last) record, e.g. from a crash, is ignored
++(NSArray<RecordedFlow*>*)load:(NSString*)path;
+
+//anonymize a path
+// user names (in /Users/<user>/) are replaced
++(NSString*)anonymizePath:(NSString*)path;
+
+@end
+
+#endif /* FlowRecorder_h */
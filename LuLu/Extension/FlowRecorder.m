@@ -0,0 +1,577 @@
+//
+//  file: FlowRecorder.m
+//  project: LuLu (launch daemon)
+//  description: records (anonymized) flows, for offline replay
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#import "consts.h"
+#import "Process.h"
+#import "FlowRecorder.h"
+
+#import <fcntl.h>
+#import <unistd.h>
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+//append a (LEB128) varint
+static void appendVarint(NSMutableData* data, uint64_t value)
+{
+    //bytes
+    uint8_t bytes[10] = {0};
+
+    //length
+    NSUInteger length = 0;
+
+    //encode
+    // 7 bits at a time, high bit set if more follow
+    do
+    {
+        bytes[length] = (uint8_t)(value & 0x7F);
+        value >>= 7;
+        if(0 != value) bytes[length] |= 0x80;
+        length++;
+
+    } while(0 != value);
+
+    //append
+    [data appendBytes:bytes length:length];
+}
+
+//read a (LEB128) varint
+// returns NO if truncated (or too long)
+static BOOL readVarint(const uint8_t* bytes, NSUInteger length, NSUInteger* offset, uint64_t* value)
+{
+    //shift
+    int shift = 0;
+
+    //init
+    *value = 0;
+
+    //decode
+    while(*offset < length)
+    {
+        //byte
+        uint8_t byte = bytes[(*offset)++];
+
+        //add
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+
+        //done?
+        if(0 == (byte & 0x80)) return YES;
+
+        //next
+        shift += 7;
+        if(shift >= 64) return NO;
+    }
+
+    return NO;
+}
+
+@implementation RecordedFlow
+@end
+
+@implementation FlowRecorder
+{
+    //file
+    int fd;
+
+    //buffered (not yet written) bytes
+    NSMutableData* buffer;
+
+    //interned strings
+    // key: string, value: id (0 is nil)
+    NSMutableDictionary<NSString*, NSNumber*>* strings;
+
+    //timer to (periodically) write out buffered flows
+    dispatch_source_t flushTimer;
+}
+
+@synthesize path;
+@synthesize size;
+@synthesize count;
+
+//init
+// creates (truncates) file at path, and writes header
+-(id)init:(NSString*)recordingPath
+{
+    //version
+    uint8_t version = FLOW_RECORDING_VERSION;
+
+    //weak self
+    __weak typeof(self) weakSelf = nil;
+
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //save
+        path = recordingPath;
+
+        //init
+        buffer = [NSMutableData dataWithCapacity:FLOW_RECORDING_BUFFER_SIZE];
+        strings = [NSMutableDictionary dictionary];
+
+        //create
+        fd = open(path.fileSystemRepresentation, O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0600);
+        if(-1 == fd)
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: failed to create flow recording %{public}@ (errno: %d)", path, errno);
+
+            //bail
+            return nil;
+        }
+
+        //header
+        [buffer appendBytes:FLOW_RECORDING_MAGIC length:strlen(FLOW_RECORDING_MAGIC)];
+        [buffer appendBytes:&version length:sizeof(version)];
+        size = buffer.length;
+
+        //write out buffered flows periodically
+        // so a quiet system's flows still make it to disk
+        weakSelf = self;
+        flushTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, dispatch_get_global_queue(QOS_CLASS_UTILITY, 0));
+        dispatch_source_set_timer(flushTimer, dispatch_time(DISPATCH_TIME_NOW, FLOW_RECORDING_FLUSH_INTERVAL * NSEC_PER_SEC), FLOW_RECORDING_FLUSH_INTERVAL * NSEC_PER_SEC, NSEC_PER_SEC);
+        dispatch_source_set_event_handler(flushTimer, ^{
+            [weakSelf flush];
+        });
+        dispatch_resume(flushTimer);
+
+        //dbg msg
+        os_log_debug(logHandle, "recording flows to %{public}@", path);
+    }
+
+    return self;
+}
+
+//record a flow
+-(void)record:(Process*)process flow:(NEFilterSocketFlow*)flow
+{
+    //remote endpoint
+    NWHostEndpoint* remoteEndpoint = nil;
+
+    //remote host name
+    NSString* remoteHostname = nil;
+
+    //extract remote endpoint
+    remoteEndpoint = (NWHostEndpoint*)flow.remoteEndpoint;
+
+    //macOS 11+?
+    // grab remote host name
+    if(@available(macOS 11, *))
+    {
+        //grab
+        remoteHostname = flow.remoteHostname;
+    }
+
+    //record
+    [self record:process url:flow.URL hostname:remoteEndpoint.hostname remoteHostname:remoteHostname port:remoteEndpoint.port family:flow.socketFamily protocol:flow.socketProtocol];
+}
+
+//record a flow's components
+// anonymizes, then appends (string definitions &) flow record to buffer
+-(void)record:(Process*)process url:(NSURL*)url hostname:(NSString*)hostname remoteHostname:(NSString*)remoteHostname port:(NSString*)port family:(int)family protocol:(int)protocol
+{
+    //url components
+    NSURLComponents* components = nil;
+
+    //ancestors
+    NSMutableArray* ancestors = nil;
+
+    //(flow's) string ids
+    uint64_t ids[7] = {0};
+
+    //ancestors' string ids
+    NSMutableArray<NSNumber*>* ancestorIDs = nil;
+
+    //buffered bytes (before flow)
+    NSUInteger buffered = 0;
+
+    //strip url's query, fragment, & credentials
+    // only scheme, host, & path are kept
+    if(nil != url)
+    {
+        components = [NSURLComponents componentsWithURL:url resolvingAgainstBaseURL:NO];
+        components.user = nil;
+        components.password = nil;
+        components.query = nil;
+        components.fragment = nil;
+    }
+
+    //anonymize ancestors
+    ancestors = [NSMutableArray array];
+    for(NSDictionary* ancestor in process.canonicalAncestors)
+    {
+        [ancestors addObject:[FlowRecorder anonymizePath:ancestor[KEY_PROCESS_PATH]]];
+    }
+
+    //sync
+    @synchronized(self)
+    {
+        //stopped?
+        if( (-1 == fd) ||
+            (size >= FLOW_RECORDING_MAX_SIZE) )
+        {
+            return;
+        }
+
+        //init
+        buffered = buffer.length;
+
+        //intern strings
+        // ...defining any new ones
+        ids[0] = [self intern:[FlowRecorder anonymizePath:process.key]];
+        ids[1] = [self intern:[FlowRecorder anonymizePath:process.path]];
+        ids[2] = [self intern:process.csInfo[KEY_CS_ID]];
+        ids[3] = [self intern:components.string];
+        ids[4] = [self intern:hostname];
+        ids[5] = [self intern:remoteHostname];
+        ids[6] = [self intern:port];
+
+        ancestorIDs = [NSMutableArray arrayWithCapacity:ancestors.count];
+        for(NSString* ancestor in ancestors)
+        {
+            [ancestorIDs addObject:[NSNumber numberWithUnsignedLongLong:[self intern:ancestor]]];
+        }
+
+        //type
+        appendVarint(buffer, FLOW_RECORD_FLOW);
+
+        //strings
+        for(NSUInteger i = 0; i < sizeof(ids)/sizeof(ids[0]); i++)
+        {
+            appendVarint(buffer, ids[i]);
+        }
+
+        //signer, protocol, & family
+        appendVarint(buffer, (uint32_t)[process.csInfo[KEY_CS_SIGNER] intValue]);
+        appendVarint(buffer, (uint32_t)protocol);
+        appendVarint(buffer, (uint32_t)family);
+
+        //ancestors
+        appendVarint(buffer, ancestorIDs.count);
+        for(NSNumber* ancestorID in ancestorIDs)
+        {
+            appendVarint(buffer, ancestorID.unsignedLongLongValue);
+        }
+
+        //inc
+        count++;
+        size += buffer.length - buffered;
+
+        //write out?
+        if( (buffer.length >= FLOW_RECORDING_BUFFER_SIZE) ||
+            (size >= FLOW_RECORDING_MAX_SIZE) )
+        {
+            [self flush];
+        }
+    }
+
+    return;
+}
+
+//intern a string
+// new strings are defined (in the buffer) and assigned the next id
+// note: caller should hold the lock
+-(uint64_t)intern:(NSString*)string
+{
+    //id
+    NSNumber* stringID = nil;
+
+    //utf-8
+    NSData* bytes = nil;
+
+    //nil?
+    if(nil == string) return 0;
+
+    //known?
+    stringID = strings[string];
+    if(nil != stringID) return stringID.unsignedLongLongValue;
+
+    //assign
+    stringID = [NSNumber numberWithUnsignedLongLong:strings.count + 1];
+    strings[string] = stringID;
+
+    //define
+    bytes = [string dataUsingEncoding:NSUTF8StringEncoding];
+    appendVarint(buffer, FLOW_RECORD_STRING);
+    appendVarint(buffer, bytes.length);
+    [buffer appendData:bytes];
+
+    return stringID.unsignedLongLongValue;
+}
+
+//write out (any) buffered flows
+-(void)flush
+{
+    //bytes written
+    ssize_t written = 0;
+
+    //offset
+    NSUInteger offset = 0;
+
+    //sync
+    @synchronized(self)
+    {
+        //nothing to do?
+        if( (-1 == fd) ||
+            (0 == buffer.length) )
+        {
+            return;
+        }
+
+        //write
+        while(offset < buffer.length)
+        {
+            written = write(fd, (const uint8_t*)buffer.bytes + offset, buffer.length - offset);
+            if(written <= 0)
+            {
+                //retry?
+                if( (-1 == written) && (EINTR == errno) ) continue;
+
+                //err msg
+                os_log_error(logHandle, "ERROR: failed to write flow recording (errno: %d), will stop recording", errno);
+
+                //stop
+                close(fd);
+                fd = -1;
+
+                break;
+            }
+
+            offset += written;
+        }
+
+        //reset
+        buffer.length = 0;
+
+        //full?
+        if( (-1 != fd) &&
+            (size >= FLOW_RECORDING_MAX_SIZE) )
+        {
+            //dbg msg
+            os_log(logHandle, "flow recording %{public}@ is full (%lu flows), will stop recording", path, (unsigned long)count);
+
+            //stop
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    return;
+}
+
+//load a recording
+// strings are (re)built as they're defined, then each flow's ids are resolved
++(NSArray<RecordedFlow*>*)load:(NSString*)path
+{
+    //flows
+    NSMutableArray<RecordedFlow*>* flows = nil;
+
+    //data
+    NSData* data = nil;
+
+    //bytes
+    const uint8_t* bytes = NULL;
+
+    //offset
+    NSUInteger offset = 0;
+
+    //strings
+    // index 0 is nil
+    NSMutableArray* strings = nil;
+
+    //load
+    data = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:NULL];
+    if(data.length < strlen(FLOW_RECORDING_MAGIC) + 1) goto bail;
+
+    //init
+    bytes = data.bytes;
+
+    //check magic & version
+    if( (0 != memcmp(bytes, FLOW_RECORDING_MAGIC, strlen(FLOW_RECORDING_MAGIC))) ||
+        (FLOW_RECORDING_VERSION != bytes[strlen(FLOW_RECORDING_MAGIC)]) )
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: %{public}@ is not a (v%d) flow recording", path, FLOW_RECORDING_VERSION);
+
+        //bail
+        goto bail;
+    }
+
+    //init
+    offset = strlen(FLOW_RECORDING_MAGIC) + 1;
+    flows = [NSMutableArray array];
+    strings = [NSMutableArray arrayWithObject:[NSNull null]];
+
+    //parse records
+    while(offset < data.length)
+    {
+        //type
+        uint64_t type = 0;
+
+        //value
+        uint64_t value = 0;
+
+        //read type
+        if(YES != readVarint(bytes, data.length, &offset, &type)) break;
+
+        //string?
+        if(FLOW_RECORD_STRING == type)
+        {
+            //string
+            NSString* string = nil;
+
+            //read length
+            if( (YES != readVarint(bytes, data.length, &offset, &value)) ||
+                (value > data.length - offset) )
+            {
+                break;
+            }
+
+            //init
+            string = [[NSString alloc] initWithBytes:bytes + offset length:(NSUInteger)value encoding:NSUTF8StringEncoding];
+            if(nil == string) string = @"";
+
+            //add
+            [strings addObject:string];
+            offset += (NSUInteger)value;
+        }
+
+        //flow?
+        else if(FLOW_RECORD_FLOW == type)
+        {
+            //flow
+            RecordedFlow* flow = nil;
+
+            //(flow's) strings
+            NSString* values[7] = {nil};
+
+            //numbers
+            uint64_t numbers[4] = {0};
+
+            //ancestors
+            NSMutableArray* ancestors = nil;
+
+            //flag
+            BOOL truncated = NO;
+
+            //read strings
+            for(NSUInteger i = 0; i < sizeof(values)/sizeof(values[0]); i++)
+            {
+                //read
+                if( (YES != readVarint(bytes, data.length, &offset, &value)) ||
+                    (value >= strings.count) )
+                {
+                    truncated = YES;
+                    break;
+                }
+
+                //resolve
+                if(0 != value) values[i] = strings[(NSUInteger)value];
+            }
+
+            //read signer, protocol, family, & ancestor count
+            for(NSUInteger i = 0; (YES != truncated) && (i < sizeof(numbers)/sizeof(numbers[0])); i++)
+            {
+                if(YES != readVarint(bytes, data.length, &offset, &numbers[i])) truncated = YES;
+            }
+
+            //read ancestors
+            ancestors = [NSMutableArray array];
+            for(uint64_t i = 0; (YES != truncated) && (i < numbers[3]); i++)
+            {
+                //read
+                if( (YES != readVarint(bytes, data.length, &offset, &value)) ||
+                    (0 == value) || (value >= strings.count) )
+                {
+                    truncated = YES;
+                    break;
+                }
+
+                //add
+                [ancestors addObject:strings[(NSUInteger)value]];
+            }
+
+            //truncated/corrupt?
+            if(YES == truncated) break;
+
+            //init flow
+            flow = [[RecordedFlow alloc] init];
+            flow.key = values[0];
+            flow.path = values[1];
+            flow.signingID = values[2];
+            flow.url = values[3];
+            flow.hostname = values[4];
+            flow.remoteHostname = values[5];
+            flow.port = values[6];
+            flow.signer = (int)numbers[0];
+            flow.protocol = (int)numbers[1];
+            flow.family = (int)numbers[2];
+            flow.ancestors = ancestors;
+
+            //add
+            [flows addObject:flow];
+        }
+
+        //unknown
+        // can't skip it, as its length isn't known
+        else
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: unknown record type (%llu) in flow recording, at offset %lu", type, (unsigned long)offset);
+
+            break;
+        }
+    }
+
+bail:
+
+    return flows;
+}
+
+//anonymize a path
+// user names (in /Users/<user>/) are replaced
++(NSString*)anonymizePath:(NSString*)path
+{
+    //components
+    NSMutableArray* components = nil;
+
+    //not in a user's home directory?
+    if(YES != [path hasPrefix:@"/Users/"]) return path;
+
+    //split
+    // note: first component is '/'
+    components = [path.pathComponents mutableCopy];
+    if( (components.count < 3) ||
+        (YES == [components[2] isEqualToString:@"Shared"]) )
+    {
+        return path;
+    }
+
+    //replace
+    components[2] = @"user";
+
+    return [NSString pathWithComponents:components];
+}
+
+//dealloc
+// write out any buffered flows, then close
+-(void)dealloc
+{
+    //stop timer
+    if(nil != flushTimer) dispatch_source_cancel(flushTimer);
+
+    //flush
+    [self flush];
+
+    //close
+    if(-1 != fd) close(fd);
+}
+
+@end
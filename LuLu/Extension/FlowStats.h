@@ -0,0 +1,86 @@
+//
+//  file: FlowStats.h
+//  project: LuLu (launch daemon)
+//  description: (always-on) flow decision statistics (header)
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#ifndef FlowStats_h
+#define FlowStats_h
+
+@import OSLog;
+@import Foundation;
+
+//sub-buckets per power of two
+// 16, so values are recorded within ~6% (log-linear, HDR-style)
+#define FLOW_HISTOGRAM_SUB_BITS 4
+
+//max value (bits)
+// 2^40 ns, ~18 minutes, larger values are clamped
+#define FLOW_HISTOGRAM_MAX_BITS 40
+
+//number of buckets
+#define FLOW_HISTOGRAM_BUCKETS ((FLOW_HISTOGRAM_MAX_BITS - FLOW_HISTOGRAM_SUB_BITS + 1) << FLOW_HISTOGRAM_SUB_BITS)
+
+//stages of a flow's decision
+typedef NS_ENUM(NSInteger, FlowStage) {
+    FlowStageTotal,             // 'processEvent:', end to end
+    FlowStageVerdictCache,      // verdict cache lookup
+    FlowStageProcess,           // process lookup/creation
+    FlowStageSigning,           // code signing (new processes)
+    FlowStageBlockList,         // block list check
+    FlowStageAllowList,         // allow list check
+    FlowStageRules,             // 'Rules find:'
+    FlowStagePassiveRule,       // passive mode rule creation
+    FlowStageAlert,             // alert creation & delivery
+    FlowStageRelatedFlows,      // related flow drain
+    FlowStageCount
+};
+
+//verdicts
+typedef NS_ENUM(NSInteger, FlowStatsVerdict) {
+    FlowStatsVerdictAllow,
+    FlowStatsVerdictBlock,
+    FlowStatsVerdictPause,
+    FlowStatsVerdictRelated,
+    FlowStatsVerdictCached,     // (also) served from verdict cache
+    FlowStatsVerdictCount
+};
+
+//flow decision statistics
+// per stage latency histograms & per verdict counters, updated w/ (relaxed) atomics, so no locks on the flow's path
+// stages are timed via 'mach_absolute_time', i.e. callers grab a start time, then record once the stage is done
+@interface FlowStats : NSObject
+
+/* PROPERTIES */
+
+//start time
+@property(nonatomic, retain, readonly)NSDate* since;
+
+/* METHODS */
+
+//record a stage's latency
+// from a start time ('mach_absolute_time') to now
+-(void)record:(FlowStage)stage start:(uint64_t)start;
+
+//record a stage's latency (in nanoseconds)
+-(void)record:(FlowStage)stage nanoseconds:(uint64_t)nanoseconds;
+
+//count a verdict
+-(void)count:(FlowStatsVerdict)verdict;
+
+//number of recorded values for a stage
+-(uint64_t)count:(FlowStage)stage;
+
+//latency percentile for a stage (in nanoseconds)
+// upper bound of the matching bucket (so within ~6%), or 0 if nothing recorded
+-(uint64_t)percentile:(double)percentile stage:(FlowStage)stage;
+
+//snapshot
+// per stage count, mean, p50/p99/p999, & max (in nanoseconds), plus verdict counts
+-(NSDictionary*)snapshot;
+
+@end
+
+#endif /* FlowStats_h */
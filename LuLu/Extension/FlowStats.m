@@ -0,0 +1,301 @@
+//
+//  file: FlowStats.m
+//  project: LuLu (launch daemon)
+//  description: (always-on) flow decision statistics
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#import "consts.h"
+#import "FlowStats.h"
+
+#import <stdatomic.h>
+#import <mach/mach_time.h>
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+//stage names
+// for snapshots, in 'FlowStage' order
+static NSString* const stageNames[FlowStageCount] = {@"total", @"verdictCache", @"process", @"signing", @"blockList", @"allowList", @"rules", @"passiveRule", @"alert", @"relatedFlows"};
+
+//verdict names
+// for snapshots, in 'FlowStatsVerdict' order
+static NSString* const verdictNames[FlowStatsVerdictCount] = {@"allow", @"block", @"pause", @"related", @"cached"};
+
+//histogram
+// log-linear buckets: first (1 << SUB_BITS) are exact, then (1 << SUB_BITS) per power of two
+typedef struct {
+
+    //number of values
+    _Atomic uint64_t count;
+
+    //sum of values
+    _Atomic uint64_t total;
+
+    //max value
+    _Atomic uint64_t max;
+
+    //buckets
+    _Atomic uint64_t buckets[FLOW_HISTOGRAM_BUCKETS];
+
+} FlowHistogram;
+
+//bucket for a value
+static NSUInteger bucketForValue(uint64_t value)
+{
+    //highest bit
+    int msb = 0;
+
+    //shift
+    int shift = 0;
+
+    //clamp
+    if(value >= (1ULL << FLOW_HISTOGRAM_MAX_BITS)) value = (1ULL << FLOW_HISTOGRAM_MAX_BITS) - 1;
+
+    //small values are exact
+    if(value < (1ULL << FLOW_HISTOGRAM_SUB_BITS)) return (NSUInteger)value;
+
+    //power of two, then sub-bucket within it
+    msb = 63 - __builtin_clzll(value);
+    shift = msb - FLOW_HISTOGRAM_SUB_BITS;
+
+    return ((NSUInteger)(shift + 1) << FLOW_HISTOGRAM_SUB_BITS) | (NSUInteger)((value >> shift) & ((1ULL << FLOW_HISTOGRAM_SUB_BITS) - 1));
+}
+
+//highest value of a bucket
+static uint64_t valueForBucket(NSUInteger bucket)
+{
+    //shift
+    int shift = 0;
+
+    //exact
+    if(bucket < (1 << FLOW_HISTOGRAM_SUB_BITS)) return bucket;
+
+    //init shift
+    shift = (int)(bucket >> FLOW_HISTOGRAM_SUB_BITS) - 1;
+
+    return ((((1ULL << FLOW_HISTOGRAM_SUB_BITS) | (bucket & ((1 << FLOW_HISTOGRAM_SUB_BITS) - 1))) << shift) + (1ULL << shift) - 1);
+}
+
+@implementation FlowStats
+{
+    //histograms
+    // one per stage
+    FlowHistogram* histograms;
+
+    //verdict counters
+    _Atomic uint64_t verdicts[FlowStatsVerdictCount];
+
+    //timebase
+    // to convert mach time to nanoseconds
+    mach_timebase_info_data_t timebase;
+}
+
+@synthesize since;
+
+//init
+-(id)init
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //alloc histograms
+        // zero'd, so (atomic) counters all start at 0
+        histograms = calloc(FlowStageCount, sizeof(FlowHistogram));
+        if(NULL == histograms) return nil;
+
+        //init counters
+        for(NSInteger verdict = 0; verdict < FlowStatsVerdictCount; verdict++)
+        {
+            atomic_init(&verdicts[verdict], 0);
+        }
+
+        //init timebase
+        mach_timebase_info(&timebase);
+
+        //init start
+        since = [NSDate date];
+    }
+
+    return self;
+}
+
+//record a stage's latency
+// from a start time ('mach_absolute_time') to now
+-(void)record:(FlowStage)stage start:(uint64_t)start
+{
+    //elapsed
+    uint64_t elapsed = mach_absolute_time() - start;
+
+    //convert to nanoseconds
+    // note: 1/1 on Intel, so skip the math
+    if(timebase.numer != timebase.denom) elapsed = elapsed * timebase.numer / timebase.denom;
+
+    //record
+    [self record:stage nanoseconds:elapsed];
+}
+
+//record a stage's latency (in nanoseconds)
+-(void)record:(FlowStage)stage nanoseconds:(uint64_t)nanoseconds
+{
+    //histogram
+    FlowHistogram* histogram = NULL;
+
+    //current max
+    uint64_t max = 0;
+
+    //sanity check
+    if( (stage < 0) || (stage >= FlowStageCount) ) return;
+
+    //init
+    histogram = &histograms[stage];
+
+    //update
+    atomic_fetch_add_explicit(&histogram->buckets[bucketForValue(nanoseconds)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->total, nanoseconds, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->count, 1, memory_order_relaxed);
+
+    //update max
+    max = atomic_load_explicit(&histogram->max, memory_order_relaxed);
+    while( (nanoseconds > max) &&
+           (YES != atomic_compare_exchange_weak_explicit(&histogram->max, &max, nanoseconds, memory_order_relaxed, memory_order_relaxed)) );
+
+    return;
+}
+
+//count a verdict
+-(void)count:(FlowStatsVerdict)verdict
+{
+    //sanity check
+    if( (verdict < 0) || (verdict >= FlowStatsVerdictCount) ) return;
+
+    //inc
+    atomic_fetch_add_explicit(&verdicts[verdict], 1, memory_order_relaxed);
+}
+
+//number of recorded values for a stage
+-(uint64_t)count:(FlowStage)stage
+{
+    //sanity check
+    if( (stage < 0) || (stage >= FlowStageCount) ) return 0;
+
+    return atomic_load_explicit(&histograms[stage].count, memory_order_relaxed);
+}
+
+//latency percentile for a stage (in nanoseconds)
+// walks buckets 'til enough values are covered
+-(uint64_t)percentile:(double)percentile stage:(FlowStage)stage
+{
+    //histogram
+    FlowHistogram* histogram = NULL;
+
+    //counts
+    // copied, as they may change while walking
+    uint64_t counts[FLOW_HISTOGRAM_BUCKETS] = {0};
+
+    //total
+    uint64_t total = 0;
+
+    //target
+    uint64_t target = 0;
+
+    //seen
+    uint64_t seen = 0;
+
+    //max
+    uint64_t max = 0;
+
+    //sanity check
+    if( (stage < 0) || (stage >= FlowStageCount) ) return 0;
+
+    //init
+    histogram = &histograms[stage];
+
+    //copy
+    for(NSUInteger bucket = 0; bucket < FLOW_HISTOGRAM_BUCKETS; bucket++)
+    {
+        counts[bucket] = atomic_load_explicit(&histogram->buckets[bucket], memory_order_relaxed);
+        total += counts[bucket];
+    }
+
+    //none?
+    if(0 == total) return 0;
+
+    //target
+    // i.e. ceil(percentile * total), at least 1
+    target = (uint64_t)ceil(percentile / 100.0 * total);
+    if(0 == target) target = 1;
+
+    //max
+    max = atomic_load_explicit(&histogram->max, memory_order_relaxed);
+
+    //walk
+    for(NSUInteger bucket = 0; bucket < FLOW_HISTOGRAM_BUCKETS; bucket++)
+    {
+        //add
+        seen += counts[bucket];
+
+        //found
+        // ...but never report more than max
+        if(seen >= target) return MIN(valueForBucket(bucket), max);
+    }
+
+    return max;
+}
+
+//snapshot
+// plist types only, so it can be sent over XPC
+-(NSDictionary*)snapshot
+{
+    //stages
+    NSMutableArray* stages = nil;
+
+    //verdict counts
+    NSMutableDictionary* counts = nil;
+
+    //init
+    stages = [NSMutableArray array];
+    counts = [NSMutableDictionary dictionary];
+
+    //add each stage
+    for(NSInteger stage = 0; stage < FlowStageCount; stage++)
+    {
+        //count
+        uint64_t count = [self count:stage];
+
+        //total
+        uint64_t total = atomic_load_explicit(&histograms[stage].total, memory_order_relaxed);
+
+        //add
+        [stages addObject:@{KEY_STATS_NAME:stageNames[stage],
+                            KEY_STATS_COUNT:[NSNumber numberWithUnsignedLongLong:count],
+                            KEY_STATS_MEAN:[NSNumber numberWithUnsignedLongLong:(0 != count) ? total/count : 0],
+                            KEY_STATS_P50:[NSNumber numberWithUnsignedLongLong:[self percentile:50 stage:stage]],
+                            KEY_STATS_P99:[NSNumber numberWithUnsignedLongLong:[self percentile:99 stage:stage]],
+                            KEY_STATS_P999:[NSNumber numberWithUnsignedLongLong:[self percentile:99.9 stage:stage]],
+                            KEY_STATS_MAX:[NSNumber numberWithUnsignedLongLong:atomic_load_explicit(&histograms[stage].max, memory_order_relaxed)]}];
+    }
+
+    //add each verdict
+    for(NSInteger verdict = 0; verdict < FlowStatsVerdictCount; verdict++)
+    {
+        counts[verdictNames[verdict]] = [NSNumber numberWithUnsignedLongLong:atomic_load_explicit(&verdicts[verdict], memory_order_relaxed)];
+    }
+
+    return @{KEY_STATS_SINCE:self.since, KEY_STATS_STAGES:stages, KEY_STATS_VERDICTS:counts};
+}
+
+//dealloc
+// free histograms
+-(void)dealloc
+{
+    //free
+    if(NULL != histograms) free(histograms);
+    histograms = NULL;
+}
+
+@end
@@ -0,0 +1,77 @@
+//
+//  file: ListMatcher.h
+//  project: LuLu (launch daemon)
+//  description: compiled matcher for block/allow list items (header)
+//
+//  copyright (c) 2020 Objective-See. All rights reserved.
+//
+
+#ifndef ListMatcher_h
+#define ListMatcher_h
+
+@import OSLog;
+@import Foundation;
+
+//image magic ('LULI')
+#define LIST_IMAGE_MAGIC 0x494C554C
+
+//image version
+// bump on any change to the layout
+#define LIST_IMAGE_VERSION 1
+
+//immutable matcher, backed by a compiled (binary) image of a list
+// the image is flat (sorted arrays only), so it can be mmap'd & queried in place
+// items are matched by:
+//   exact:    host names, IPs, and full URLs (case insensitive)
+//   wildcard: '*.domain' matches any sub-domain, looked up per label of a host name
+//   range:    IPv4/IPv6 CIDRs or 'ipA - ipB' ranges, merged into sorted intervals
+@interface ListMatcher : NSObject
+
+/* PROPERTIES */
+
+//compiled image
+// either mmap'd (from disk) or in memory
+@property(nonatomic, retain, readonly)NSData* image;
+
+//number of (unique) items
+@property(nonatomic, readonly)NSUInteger count;
+
+//list contains '0.0.0.0/0'
+@property(nonatomic, readonly)BOOL matchesAllIPv4;
+
+//list contains '::/0'
+@property(nonatomic, readonly)BOOL matchesAllIPv6;
+
+/* METHODS */
+
+//name for a list's compiled image
+// derived from (a hash of) the list's path
++(NSString*)imageNameForList:(NSString*)path;
+
+//compile a (text) list into an image
+// one item per line ('#' for comments), source's attributes are saved to detect changes
++(NSData*)compile:(NSString*)list source:(NSDictionary*)attributes;
+
+//init with a (text) list
+// compiles it in memory
+-(id)init:(NSString*)list;
+
+//init with a compiled image
+// returns nil if it's not valid (magic, version, checksum, bounds)
+-(id)initWithImage:(NSData*)image;
+
+//init with a compiled image on disk
+// mmap'd read-only, so it's paged in on demand
+-(id)initWithFile:(NSString*)path;
+
+//was image compiled from (the current version of) a source?
+// checks source's size & modification date
+-(BOOL)isCompiledFrom:(NSDictionary*)attributes;
+
+//check endpoint names (which should be lower-cased)
+// returns matching list item (or nil if none)
+-(NSString*)match:(NSSet*)endpointNames;
+
+@end
+
+#endif /* ListMatcher_h */
@@ -0,0 +1,686 @@
+//
+//  file: ListMatcher.m
+//  project: LuLu (launch daemon)
+//  description: compiled matcher for block/allow list items
+//
+//  copyright (c) 2020 Objective-See. All rights reserved.
+//
+
+#import "consts.h"
+#import "utilities.h"
+#import "ListMatcher.h"
+
+#import <arpa/inet.h>
+#import <sys/socket.h>
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+/* IMAGE LAYOUT */
+
+//section of image
+// an array, at an offset (from start of image)
+typedef struct
+{
+    uint64_t offset;
+    uint64_t count;
+
+} ListSection;
+
+//image header
+// followed by: exact offsets, wildcard offsets, IPv4 intervals, IPv6 intervals, strings
+typedef struct
+{
+    //magic ('LULI')
+    uint32_t magic;
+
+    //version
+    uint32_t version;
+
+    //checksum (FNV-1a) of everything after the header
+    uint32_t checksum;
+
+    //flags
+    uint32_t flags;
+
+    //source's size
+    uint64_t sourceSize;
+
+    //source's modification time (ms since 1970)
+    int64_t sourceModified;
+
+    //exact items
+    // sorted (uint32) offsets of NUL-terminated strings
+    ListSection exact;
+
+    //wildcard ('*.domain') items
+    // sorted (uint32) offsets of NUL-terminated strings (w/o the '*.')
+    ListSection wildcards;
+
+    //IPv4 intervals
+    // sorted, non-overlapping IPv4Interval
+    ListSection ipv4;
+
+    //IPv6 intervals
+    // sorted, non-overlapping IPv6Interval
+    ListSection ipv6;
+
+    //number of range items (before merging)
+    uint64_t ranges;
+
+} ListImageHeader;
+
+//flags
+#define LIST_FLAG_ALL_IPV4 0x1
+#define LIST_FLAG_ALL_IPV6 0x2
+
+//IPv4 interval (host order)
+typedef struct
+{
+    uint32_t lo;
+    uint32_t hi;
+
+} IPv4Interval;
+
+//IPv6 interval (network order)
+typedef struct
+{
+    uint8_t lo[16];
+    uint8_t hi[16];
+
+} IPv6Interval;
+
+//FNV-1a (32 bit)
+static uint32_t fnv1a(const uint8_t* bytes, size_t length)
+{
+    uint32_t hash = 2166136261u;
+
+    for(size_t i = 0; i < length; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+//source's modification time (ms since 1970)
+static int64_t modifiedMS(NSDictionary* attributes)
+{
+    return (int64_t)([attributes[NSFileModificationDate] timeIntervalSince1970] * 1000);
+}
+
+//compare (string) offsets
+// 'context' is the strings blob
+static int compareOffsets(void* context, const void* a, const void* b)
+{
+    const char* strings = context;
+
+    return strcmp(strings + *(const uint32_t*)a, strings + *(const uint32_t*)b);
+}
+
+//compare IPv4 intervals (by lo)
+static int compareIPv4(const void* a, const void* b)
+{
+    uint32_t loA = ((const IPv4Interval*)a)->lo;
+    uint32_t loB = ((const IPv4Interval*)b)->lo;
+
+    return (loA < loB) ? -1 : (loA > loB);
+}
+
+//compare IPv6 intervals (by lo)
+static int compareIPv6(const void* a, const void* b)
+{
+    return memcmp(((const IPv6Interval*)a)->lo, ((const IPv6Interval*)b)->lo, 16);
+}
+
+//increment an (IPv6) address
+// returns NO on overflow
+static BOOL incrementAddress(uint8_t* bytes, int length)
+{
+    for(int i = length-1; i >= 0; i--)
+    {
+        if(0xFF != bytes[i])
+        {
+            bytes[i]++;
+            return YES;
+        }
+        bytes[i] = 0;
+    }
+
+    return NO;
+}
+
+//sort & merge IPv4 intervals
+// returns new count
+static NSUInteger mergeIPv4(IPv4Interval* intervals, NSUInteger count)
+{
+    NSUInteger merged = 0;
+
+    if(0 == count) return 0;
+
+    qsort(intervals, count, sizeof(IPv4Interval), compareIPv4);
+
+    for(NSUInteger i = 1; i < count; i++)
+    {
+        //overlaps/adjacent? extend
+        if( (UINT32_MAX == intervals[merged].hi) ||
+            (intervals[i].lo <= intervals[merged].hi + 1) )
+        {
+            intervals[merged].hi = MAX(intervals[merged].hi, intervals[i].hi);
+            continue;
+        }
+
+        intervals[++merged] = intervals[i];
+    }
+
+    return merged + 1;
+}
+
+//sort & merge IPv6 intervals
+// returns new count
+static NSUInteger mergeIPv6(IPv6Interval* intervals, NSUInteger count)
+{
+    NSUInteger merged = 0;
+
+    if(0 == count) return 0;
+
+    qsort(intervals, count, sizeof(IPv6Interval), compareIPv6);
+
+    for(NSUInteger i = 1; i < count; i++)
+    {
+        //end of current (+1)
+        uint8_t next[16] = {0};
+        memcpy(next, intervals[merged].hi, 16);
+
+        //overlaps/adjacent? extend
+        if( (YES != incrementAddress(next, 16)) ||
+            (memcmp(intervals[i].lo, next, 16) <= 0) )
+        {
+            if(memcmp(intervals[i].hi, intervals[merged].hi, 16) > 0)
+            {
+                memcpy(intervals[merged].hi, intervals[i].hi, 16);
+            }
+            continue;
+        }
+
+        intervals[++merged] = intervals[i];
+    }
+
+    return merged + 1;
+}
+
+@implementation ListMatcher
+{
+    //header
+    const ListImageHeader* header;
+
+    //sections
+    const uint32_t* exact;
+    const uint32_t* wildcards;
+    const IPv4Interval* ipv4;
+    const IPv6Interval* ipv6;
+
+    //base (for string offsets)
+    const char* base;
+}
+
+@synthesize image;
+
+//name for a list's compiled image
+// derived from (a hash of) the list's path
++(NSString*)imageNameForList:(NSString*)path
+{
+    return [NSString stringWithFormat:@"%08x.list", fnv1a((const uint8_t*)path.UTF8String, strlen(path.UTF8String))];
+}
+
+//compile a (text) list into an image
+// one item per line ('#' for comments), source's attributes are saved to detect changes
++(NSData*)compile:(NSString*)list source:(NSDictionary*)attributes
+{
+    //image
+    NSMutableData* image = nil;
+
+    //header
+    ListImageHeader header = {0};
+
+    //strings blob
+    NSMutableData* strings = nil;
+
+    //exact & wildcard items
+    // offsets into strings blob
+    NSMutableData* exactOffsets = nil;
+    NSMutableData* wildcardOffsets = nil;
+
+    //intervals
+    NSMutableData* ipv4Intervals = nil;
+    NSMutableData* ipv6Intervals = nil;
+
+    //unique items
+    NSMutableSet* items = nil;
+
+    //whitespace
+    NSCharacterSet* whitespace = nil;
+
+    //counts
+    NSUInteger ipv4Count = 0;
+    NSUInteger ipv6Count = 0;
+
+    //offsets
+    uint64_t stringsOffset = 0;
+
+    //init
+    strings = [NSMutableData data];
+    exactOffsets = [NSMutableData data];
+    wildcardOffsets = [NSMutableData data];
+    ipv4Intervals = [NSMutableData data];
+    ipv6Intervals = [NSMutableData data];
+    items = [NSMutableSet set];
+    whitespace = [NSCharacterSet whitespaceAndNewlineCharacterSet];
+
+    //parse each line
+    [list enumerateLinesUsingBlock:^(NSString* line, BOOL* stop) {
+
+        //range bounds
+        int family = 0, length = 0;
+        uint8_t lo[16] = {0}, hi[16] = {0};
+
+        //string offset
+        uint32_t offset = 0;
+
+        //trim
+        NSString* item = [line stringByTrimmingCharactersInSet:whitespace];
+
+        //skip empty/comments
+        if( (0 == item.length) || (YES == [item hasPrefix:@"#"]) ) return;
+
+        //lower-case
+        item = item.lowercaseString;
+
+        //skip dups
+        if(YES == [items containsObject:item]) return;
+        [items addObject:item];
+
+        //CIDR / range?
+        if(YES == parseAddressRange(item, &family, lo, hi, &length))
+        {
+            //IPv4
+            if(AF_INET == family)
+            {
+                IPv4Interval interval = {0};
+                memcpy(&interval.lo, lo, 4);
+                memcpy(&interval.hi, hi, 4);
+                interval.lo = ntohl(interval.lo);
+                interval.hi = ntohl(interval.hi);
+
+                [ipv4Intervals appendBytes:&interval length:sizeof(interval)];
+            }
+            //IPv6
+            else
+            {
+                IPv6Interval interval = {0};
+                memcpy(interval.lo, lo, 16);
+                memcpy(interval.hi, hi, 16);
+
+                [ipv6Intervals appendBytes:&interval length:sizeof(interval)];
+            }
+
+            return;
+        }
+
+        //save string
+        // note: wildcards are saved w/o their '*.'
+        offset = (uint32_t)strings.length;
+
+        //wildcard?
+        if( (YES == [item hasPrefix:@"*."]) && (item.length > 2) )
+        {
+            item = [item substringFromIndex:2];
+            [wildcardOffsets appendBytes:&offset length:sizeof(offset)];
+        }
+        //exact
+        else
+        {
+            [exactOffsets appendBytes:&offset length:sizeof(offset)];
+        }
+
+        //add (w/ NUL)
+        [strings appendBytes:item.UTF8String length:strlen(item.UTF8String) + 1];
+    }];
+
+    //sort exact & wildcard items
+    qsort_r(exactOffsets.mutableBytes, exactOffsets.length/sizeof(uint32_t), sizeof(uint32_t), strings.mutableBytes, compareOffsets);
+    qsort_r(wildcardOffsets.mutableBytes, wildcardOffsets.length/sizeof(uint32_t), sizeof(uint32_t), strings.mutableBytes, compareOffsets);
+
+    //merge intervals
+    ipv4Count = mergeIPv4(ipv4Intervals.mutableBytes, ipv4Intervals.length/sizeof(IPv4Interval));
+    ipv6Count = mergeIPv6(ipv6Intervals.mutableBytes, ipv6Intervals.length/sizeof(IPv6Interval));
+
+    //init header
+    header.magic = LIST_IMAGE_MAGIC;
+    header.version = LIST_IMAGE_VERSION;
+    header.sourceSize = [attributes[NSFileSize] unsignedLongLongValue];
+    header.sourceModified = modifiedMS(attributes);
+    header.ranges = (ipv4Intervals.length/sizeof(IPv4Interval)) + (ipv6Intervals.length/sizeof(IPv6Interval));
+
+    //layout sections
+    header.exact.offset = sizeof(ListImageHeader);
+    header.exact.count = exactOffsets.length/sizeof(uint32_t);
+
+    header.wildcards.offset = header.exact.offset + exactOffsets.length;
+    header.wildcards.count = wildcardOffsets.length/sizeof(uint32_t);
+
+    header.ipv4.offset = header.wildcards.offset + wildcardOffsets.length;
+    header.ipv4.count = ipv4Count;
+
+    header.ipv6.offset = header.ipv4.offset + (ipv4Count * sizeof(IPv4Interval));
+    header.ipv6.count = ipv6Count;
+
+    stringsOffset = header.ipv6.offset + (ipv6Count * sizeof(IPv6Interval));
+
+    //too big for (32 bit) string offsets?
+    if(stringsOffset + strings.length + 1 > UINT32_MAX)
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: list is too large to compile (%llu bytes)", stringsOffset + strings.length);
+        return nil;
+    }
+
+    //rebase string offsets
+    for(NSUInteger i = 0; i < header.exact.count; i++) ((uint32_t*)exactOffsets.mutableBytes)[i] += (uint32_t)stringsOffset;
+    for(NSUInteger i = 0; i < header.wildcards.count; i++) ((uint32_t*)wildcardOffsets.mutableBytes)[i] += (uint32_t)stringsOffset;
+
+    //'all' flags
+    if( (0 != ipv4Count) &&
+        (0 == ((IPv4Interval*)ipv4Intervals.bytes)[0].lo) &&
+        (UINT32_MAX == ((IPv4Interval*)ipv4Intervals.bytes)[0].hi) ) header.flags |= LIST_FLAG_ALL_IPV4;
+
+    if(0 != ipv6Count)
+    {
+        uint8_t zeros[16] = {0};
+        uint8_t ones[16];
+        memset(ones, 0xFF, sizeof(ones));
+
+        if( (0 == memcmp(((IPv6Interval*)ipv6Intervals.bytes)[0].lo, zeros, 16)) &&
+            (0 == memcmp(((IPv6Interval*)ipv6Intervals.bytes)[0].hi, ones, 16)) ) header.flags |= LIST_FLAG_ALL_IPV6;
+    }
+
+    //build image
+    image = [NSMutableData dataWithBytes:&header length:sizeof(header)];
+    [image appendData:exactOffsets];
+    [image appendData:wildcardOffsets];
+    [image appendBytes:ipv4Intervals.bytes length:ipv4Count * sizeof(IPv4Interval)];
+    [image appendBytes:ipv6Intervals.bytes length:ipv6Count * sizeof(IPv6Interval)];
+    [image appendData:strings];
+
+    //always end w/ NUL
+    // ensures any (valid) string offset terminates within the image
+    [image appendBytes:"" length:1];
+
+    //checksum
+    ((ListImageHeader*)image.mutableBytes)->checksum = fnv1a((const uint8_t*)image.bytes + sizeof(ListImageHeader), image.length - sizeof(ListImageHeader));
+
+    //dbg msg
+    os_log_debug(logHandle, "compiled list: %llu exact, %llu wildcard, %lu/%lu IPv4/IPv6 intervals (%lu bytes)", header.exact.count, header.wildcards.count, (unsigned long)ipv4Count, (unsigned long)ipv6Count, (unsigned long)image.length);
+
+    return image;
+}
+
+//init with a (text) list
+// compiles it in memory
+-(id)init:(NSString*)list
+{
+    return [self initWithImage:[ListMatcher compile:list source:nil]];
+}
+
+//init with a compiled image on disk
+// mmap'd read-only, so it's paged in on demand
+-(id)initWithFile:(NSString*)path
+{
+    //image
+    NSData* mapped = nil;
+
+    //error
+    NSError* error = nil;
+
+    //map
+    mapped = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedAlways error:&error];
+    if(nil == mapped)
+    {
+        //dbg msg
+        os_log_debug(logHandle, "failed to map compiled list %{public}@ (error: %{public}@)", path, error);
+
+        return nil;
+    }
+
+    return [self initWithImage:mapped];
+}
+
+//init with a compiled image
+// returns nil if it's not valid (magic, version, checksum, bounds)
+-(id)initWithImage:(NSData*)data
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //bytes
+        const uint8_t* bytes = data.bytes;
+
+        //end of sections
+        uint64_t end = 0;
+
+        //too small?
+        if(data.length < sizeof(ListImageHeader) + 1)
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: compiled list is truncated");
+            return nil;
+        }
+
+        //init header
+        header = (const ListImageHeader*)bytes;
+
+        //check magic/version
+        if( (LIST_IMAGE_MAGIC != header->magic) ||
+            (LIST_IMAGE_VERSION != header->version) )
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: compiled list has an unsupported format (magic: %#x, version: %d)", header->magic, header->version);
+            return nil;
+        }
+
+        //check sections
+        // each must be in bounds, and in order
+        end = sizeof(ListImageHeader);
+        if( (header->exact.offset != end) ||
+            (header->wildcards.offset != (end += header->exact.count * sizeof(uint32_t))) ||
+            (header->ipv4.offset != (end += header->wildcards.count * sizeof(uint32_t))) ||
+            (header->ipv6.offset != (end += header->ipv4.count * sizeof(IPv4Interval))) ||
+            ((end += header->ipv6.count * sizeof(IPv6Interval)) > data.length) ||
+            (0 != bytes[data.length-1]) )
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: compiled list has invalid sections");
+            return nil;
+        }
+
+        //check checksum
+        if(header->checksum != fnv1a(bytes + sizeof(ListImageHeader), data.length - sizeof(ListImageHeader)))
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: compiled list failed checksum");
+            return nil;
+        }
+
+        //save
+        image = data;
+        base = (const char*)bytes;
+
+        //init sections
+        exact = (const uint32_t*)(bytes + header->exact.offset);
+        wildcards = (const uint32_t*)(bytes + header->wildcards.offset);
+        ipv4 = (const IPv4Interval*)(bytes + header->ipv4.offset);
+        ipv6 = (const IPv6Interval*)(bytes + header->ipv6.offset);
+
+        //check string offsets
+        for(uint64_t i = 0; i < header->exact.count; i++)
+        {
+            if( (exact[i] < end) || (exact[i] >= data.length) ) return nil;
+        }
+        for(uint64_t i = 0; i < header->wildcards.count; i++)
+        {
+            if( (wildcards[i] < end) || (wildcards[i] >= data.length) ) return nil;
+        }
+    }
+
+    return self;
+}
+
+//number of items
+-(NSUInteger)count
+{
+    return (NSUInteger)(header->exact.count + header->wildcards.count + header->ranges);
+}
+
+//list contains '0.0.0.0/0'
+-(BOOL)matchesAllIPv4
+{
+    return (0 != (header->flags & LIST_FLAG_ALL_IPV4));
+}
+
+//list contains '::/0'
+-(BOOL)matchesAllIPv6
+{
+    return (0 != (header->flags & LIST_FLAG_ALL_IPV6));
+}
+
+//was image compiled from (the current version of) a source?
+// checks source's size & modification date
+-(BOOL)isCompiledFrom:(NSDictionary*)attributes
+{
+    return ( (header->sourceSize == [attributes[NSFileSize] unsignedLongLongValue]) &&
+             (header->sourceModified == modifiedMS(attributes)) );
+}
+
+//binary search a (sorted) string section
+-(BOOL)find:(const char*)string in:(const uint32_t*)offsets count:(uint64_t)count
+{
+    uint64_t lo = 0;
+    uint64_t hi = count;
+
+    while(lo < hi)
+    {
+        uint64_t mid = lo + (hi - lo) / 2;
+        int result = strcmp(string, base + offsets[mid]);
+
+        if(0 == result) return YES;
+        if(result < 0) hi = mid;
+        else lo = mid + 1;
+    }
+
+    return NO;
+}
+
+//check if a (numeric) address falls in an interval
+-(BOOL)inRange:(const char*)address
+{
+    //bytes
+    uint8_t bytes[16] = {0};
+
+    //IPv4
+    if( (0 != header->ipv4.count) &&
+        (1 == inet_pton(AF_INET, address, bytes)) )
+    {
+        uint32_t ip = 0;
+        uint64_t lo = 0;
+        uint64_t hi = header->ipv4.count;
+
+        memcpy(&ip, bytes, 4);
+        ip = ntohl(ip);
+
+        //find last interval w/ lo <= ip
+        while(lo < hi)
+        {
+            uint64_t mid = lo + (hi - lo) / 2;
+            if(ipv4[mid].lo <= ip) lo = mid + 1;
+            else hi = mid;
+        }
+
+        return ( (0 != lo) && (ip <= ipv4[lo-1].hi) );
+    }
+
+    //IPv6
+    if( (0 != header->ipv6.count) &&
+        (1 == inet_pton(AF_INET6, address, bytes)) )
+    {
+        uint64_t lo = 0;
+        uint64_t hi = header->ipv6.count;
+
+        //find last interval w/ lo <= ip
+        while(lo < hi)
+        {
+            uint64_t mid = lo + (hi - lo) / 2;
+            if(memcmp(ipv6[mid].lo, bytes, 16) <= 0) lo = mid + 1;
+            else hi = mid;
+        }
+
+        return ( (0 != lo) && (memcmp(bytes, ipv6[lo-1].hi, 16) <= 0) );
+    }
+
+    return NO;
+}
+
+//check endpoint names (which should be lower-cased)
+// returns matching list item (or nil if none)
+-(NSString*)match:(NSSet*)endpointNames
+{
+    //match
+    NSString* match = nil;
+
+    //check each name
+    for(NSString* name in endpointNames)
+    {
+        //name (as C-string)
+        const char* string = name.UTF8String;
+        if(NULL == string) continue;
+
+        //exact?
+        if(YES == [self find:string in:exact count:header->exact.count])
+        {
+            match = name;
+            goto bail;
+        }
+
+        //wildcard?
+        // check each parent domain (per label), skipping URLs
+        if( (0 != header->wildcards.count) &&
+            (NULL == strchr(string, '/')) )
+        {
+            for(const char* dot = strchr(string, '.'); NULL != dot; dot = strchr(dot + 1, '.'))
+            {
+                //match?
+                if(YES == [self find:dot + 1 in:wildcards count:header->wildcards.count])
+                {
+                    match = [NSString stringWithFormat:@"*.%s", dot + 1];
+                    goto bail;
+                }
+            }
+        }
+
+        //range?
+        if(YES == [self inRange:string])
+        {
+            match = name;
+            goto bail;
+        }
+    }
+
+bail:
+
+    return match;
+}
+
+@end
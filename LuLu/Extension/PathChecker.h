@@ -0,0 +1,55 @@
+//
+//  file: PathChecker.h
+//  project: LuLu (launch daemon)
+//  description: (parallel) checks for deleted paths (header)
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#ifndef PathChecker_h
+#define PathChecker_h
+
+@import OSLog;
+@import Foundation;
+
+//max number of concurrent checks (per volume), local volumes
+#define PATH_CHECKS_PER_LOCAL_VOLUME 4
+
+//max number of concurrent checks (per volume), network/other volumes
+// lower, so a slow (remote) server isn't flooded
+#define PATH_CHECKS_PER_REMOTE_VOLUME 2
+
+//(parallel) checks for deleted paths
+// paths are grouped by volume (mount point), and each volume is checked by a few (bounded) workers
+// ...so one slow (e.g. network) volume doesn't hold up checks of the others
+@interface PathChecker : NSObject
+
+/* PROPERTIES */
+
+//max number of concurrent checks, local volumes
+@property(nonatomic)NSUInteger localWorkers;
+
+//max number of concurrent checks, network/other volumes
+@property(nonatomic)NSUInteger remoteWorkers;
+
+//number of paths checked (so far)
+// can be read during a check, for progress
+@property(readonly)NSUInteger checked;
+
+//number of volumes (of last check)
+@property(nonatomic, readonly)NSUInteger volumes;
+
+/* METHODS */
+
+//check paths
+// returns those that were deleted (don't exist)
+// note: only a 'not found' counts as deleted, any other error (e.g. volume not responding) doesn't
+-(NSSet<NSString*>*)missing:(NSSet<NSString*>*)paths;
+
+//mount point (of volume) for a path
+// longest matching mount point, w/o touching the path itself
+-(NSString*)volume:(NSString*)path;
+
+@end
+
+#endif /* PathChecker_h */
@@ -0,0 +1,245 @@
+//
+//  file: PathChecker.m
+//  project: LuLu (launch daemon)
+//  description: (parallel) checks for deleted paths
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#import "PathChecker.h"
+
+#import <errno.h>
+#import <stdatomic.h>
+#import <sys/stat.h>
+#import <sys/mount.h>
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+@implementation PathChecker
+{
+    //number of paths checked
+    atomic_ulong checkedPaths;
+
+    //mount points
+    // longest first, so first (prefix) match is a path's volume
+    NSArray<NSString*>* mounts;
+
+    //local mount points
+    NSSet<NSString*>* localMounts;
+}
+
+@synthesize volumes;
+@synthesize localWorkers;
+@synthesize remoteWorkers;
+
+//init
+-(id)init
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //init workers
+        localWorkers = PATH_CHECKS_PER_LOCAL_VOLUME;
+        remoteWorkers = PATH_CHECKS_PER_REMOTE_VOLUME;
+
+        //init mounts
+        [self loadMounts];
+    }
+
+    return self;
+}
+
+//number of paths checked
+-(NSUInteger)checked
+{
+    return atomic_load(&checkedPaths);
+}
+
+//(re)load mount points
+// note: 'MNT_NOWAIT' so an unresponsive (network) volume doesn't block
+-(void)loadMounts
+{
+    //mounts
+    struct statfs* mountInfo = NULL;
+
+    //count
+    int count = 0;
+
+    //mount points
+    NSMutableArray* mountPoints = nil;
+
+    //local mount points
+    NSMutableSet* localMountPoints = nil;
+
+    //init
+    mountPoints = [NSMutableArray arrayWithObject:@"/"];
+    localMountPoints = [NSMutableSet setWithObject:@"/"];
+
+    //get mounts
+    count = getmntinfo(&mountInfo, MNT_NOWAIT);
+    for(int i = 0; i < count; i++)
+    {
+        //mount point
+        NSString* mountPoint = [NSString stringWithUTF8String:mountInfo[i].f_mntonname];
+        if( (nil == mountPoint) ||
+            (YES == [mountPoint isEqualToString:@"/"]) )
+        {
+            continue;
+        }
+
+        //add
+        [mountPoints addObject:mountPoint];
+
+        //local?
+        if(0 != (mountInfo[i].f_flags & MNT_LOCAL)) [localMountPoints addObject:mountPoint];
+    }
+
+    //sort
+    // longest first
+    mounts = [mountPoints sortedArrayUsingComparator:^NSComparisonResult(NSString* a, NSString* b) {
+        return [@(b.length) compare:@(a.length)];
+    }];
+
+    //save
+    localMounts = localMountPoints;
+
+    return;
+}
+
+//mount point (of volume) for a path
+-(NSString*)volume:(NSString*)path
+{
+    //check each
+    // longest first
+    for(NSString* mount in mounts)
+    {
+        //match?
+        if( (YES == [mount isEqualToString:@"/"]) ||
+            (YES == [path isEqualToString:mount]) ||
+            ( (YES == [path hasPrefix:mount]) && ('/' == [path characterAtIndex:mount.length]) ) )
+        {
+            return mount;
+        }
+    }
+
+    return @"/";
+}
+
+//check paths
+// each volume's paths are split (strided) across its workers, and all workers run concurrently
+-(NSSet<NSString*>*)missing:(NSSet<NSString*>*)paths
+{
+    //missing paths
+    NSMutableSet* missing = nil;
+
+    //paths, by volume
+    NSMutableDictionary<NSString*, NSMutableArray<NSString*>*>* volumePaths = nil;
+
+    //worker's paths
+    NSMutableArray<NSArray<NSString*>*>* workerPaths = nil;
+
+    //worker's offset (into its paths)
+    NSMutableArray<NSNumber*>* workerOffsets = nil;
+
+    //worker's stride
+    NSMutableArray<NSNumber*>* workerStrides = nil;
+
+    //init
+    missing = [NSMutableSet set];
+    volumePaths = [NSMutableDictionary dictionary];
+    workerPaths = [NSMutableArray array];
+    workerOffsets = [NSMutableArray array];
+    workerStrides = [NSMutableArray array];
+    atomic_store(&checkedPaths, 0);
+
+    //(re)load mounts
+    // as volumes may have been (un)mounted
+    [self loadMounts];
+
+    //group by volume
+    for(NSString* path in paths)
+    {
+        //volume
+        NSString* volume = [self volume:path];
+
+        //first for volume?
+        if(nil == volumePaths[volume]) volumePaths[volume] = [NSMutableArray array];
+
+        //add
+        [volumePaths[volume] addObject:path];
+    }
+
+    //save
+    volumes = volumePaths.count;
+
+    //assign workers
+    // each volume gets (up to) its max
+    for(NSString* volume in volumePaths)
+    {
+        //max workers
+        NSUInteger max = [localMounts containsObject:volume] ? self.localWorkers : self.remoteWorkers;
+
+        //workers
+        NSUInteger workers = MAX(1, MIN(max, volumePaths[volume].count));
+
+        //add each
+        for(NSUInteger worker = 0; worker < workers; worker++)
+        {
+            [workerPaths addObject:volumePaths[volume]];
+            [workerOffsets addObject:@(worker)];
+            [workerStrides addObject:@(workers)];
+        }
+
+        //dbg msg
+        os_log_debug(logHandle, "checking %lu paths on %{public}@ (%lu workers)", (unsigned long)volumePaths[volume].count, volume, (unsigned long)workers);
+    }
+
+    //check
+    // bounded (by GCD) to the number of cores
+    dispatch_apply(workerPaths.count, dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^(size_t worker) {
+
+        //this worker's paths
+        NSArray<NSString*>* checkPaths = workerPaths[worker];
+
+        //stride
+        NSUInteger stride = workerStrides[worker].unsignedIntegerValue;
+
+        //worker's missing paths
+        NSMutableArray* gone = [NSMutableArray array];
+
+        //check each
+        for(NSUInteger i = workerOffsets[worker].unsignedIntegerValue; i < checkPaths.count; i += stride)
+        {
+            //info
+            struct stat info = {0};
+
+            //skip blank
+            if(0 == checkPaths[i].length) continue;
+
+            //not found?
+            // note: other errors (e.g. timeouts) don't mean deleted
+            if( (0 != stat(checkPaths[i].fileSystemRepresentation, &info)) &&
+                ((ENOENT == errno) || (ENOTDIR == errno)) )
+            {
+                [gone addObject:checkPaths[i]];
+            }
+
+            //inc
+            atomic_fetch_add(&self->checkedPaths, 1);
+        }
+
+        //sync to add
+        @synchronized(missing)
+        {
+            [missing addObjectsFromArray:gone];
+        }
+    });
+
+    return missing;
+}
+
+@end
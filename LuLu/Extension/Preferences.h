@@ -14,18 +14,24 @@
 /* PROPERTIES */
 
 //preferences
-@property(nonatomic, retain)NSMutableDictionary* preferences;
+// atomic, as (on profile switch) it's swapped while being read
+@property(atomic, retain)NSMutableDictionary* preferences;
 
 /* METHODS */
 
 //load prefs from disk
 -(BOOL)load;
 
+//activate (already loaded) prefs
+// e.g. of a compiled profile, so just a swap (of the prefs, and the file they're saved to)
+-(void)activate:(NSMutableDictionary*)loadedPreferences file:(NSString*)file;
+
 //update prefs
 // saves and handles logic for specific prefs
 -(BOOL)update:(NSDictionary*)updates replace:(BOOL)replace;
 
 //save to disk
+// into the file the (active) prefs were loaded from
 -(BOOL)save;
 
 //get current profile
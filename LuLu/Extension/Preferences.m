@@ -9,6 +9,7 @@
 #import "consts.h"
 #import "BlockOrAllowList.h"
 #import "Preferences.h"
+#import "VerdictCache.h"
 
 /* GLOBALS */
 
@@ -21,7 +22,15 @@ extern BlockOrAllowList* allowList;
 //block list
 extern BlockOrAllowList* blockList;
 
+//verdict cache
+extern VerdictCache* verdictCache;
+
 @implementation Preferences
+{
+    //file (active) prefs were loaded from
+    // saved back to it, as the current profile pref can be switched before (or after) the prefs are
+    NSString* file;
+}
 
 @synthesize preferences;
 
@@ -121,12 +130,19 @@ bail:
         goto bail;
     }
     
+    //save file
+    file = prefsFile;
+    
     //dbg msg
     os_log_debug(logHandle, "from %{public}@, loaded preferences: %{public}@", prefsFile, self.preferences);
     
     //set any defaults
     [self setDefaults];
     
+    //prefs changed
+    // so (cached) verdicts are stale
+    [verdictCache invalidate];
+    
     //happy
     loaded = YES;
     
@@ -135,6 +151,34 @@ bail:
     return loaded;
 }
 
+//activate (already loaded) prefs
+// note: caller should hold the rules lock, so the prefs & rules (of a profile) are activated together
+-(void)activate:(NSMutableDictionary*)loadedPreferences file:(NSString*)loadedFile
+{
+    //sync
+    // as 'save' reads the file
+    @synchronized(self)
+    {
+        //swap
+        self.preferences = loadedPreferences;
+        
+        //and file
+        file = loadedFile;
+    }
+    
+    //dbg msg
+    os_log_debug(logHandle, "activated preferences: %{public}@", self.preferences);
+    
+    //set any defaults
+    [self setDefaults];
+    
+    //prefs changed
+    // so (cached) verdicts are stale
+    [verdictCache invalidate];
+    
+    return;
+}
+
 //set any defaults
 // needed as upgrades don't (re)display welcome window
 -(void)setDefaults {
@@ -195,6 +239,10 @@ bail:
         //add in (new) prefs
         [self.preferences addEntriesFromDictionary:updates];
     }
+    
+    //prefs changed
+    // so (cached) verdicts are stale
+    [verdictCache invalidate];
         
     //save
     if(YES != [self save])
@@ -285,16 +333,26 @@ bail:
 }
 
 //save to disk
+// into the file (active) prefs were loaded from, never (just) the current profile pref's
 -(BOOL)save
 {
     //flag
     BOOL wasSaved = NO;
     
+    //prefs file
+    NSString* prefsFile = nil;
+    
     //dbg msg
     os_log_debug(logHandle, "method '%s' invoked", __PRETTY_FUNCTION__);
     
-    //init w/ default
-    NSString* prefsFile = [self path];
+    //sync
+    // so file & prefs are always of the same (active) profile
+    @synchronized(self)
+    {
+    
+    //init w/ file (active) prefs were loaded from
+    // or if none (i.e. first time), default
+    prefsFile = (nil != file) ? file : [self path];
     
     //write out preferences
     if(YES != [self.preferences writeToFile:prefsFile atomically:YES])
@@ -304,6 +362,11 @@ bail:
         goto bail;
     }
     
+    //save file
+    file = prefsFile;
+    
+    } //sync
+    
     //dbg msg
     os_log_debug(logHandle, "saved preferences to %{public}@", prefsFile);
     
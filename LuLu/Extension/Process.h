@@ -13,6 +13,8 @@
 
 #import "Binary.h"
 
+@class RuleIndex;
+
 @interface Process : NSObject
 
 /* PROPERTIES */
@@ -40,11 +42,25 @@
 @property(nonatomic, retain)NSString* _Nullable path;
 
 //args
+// extracted on first access
 @property(nonatomic, retain)NSMutableArray* _Nullable arguments;
 
 //ancestors
+// enumerated on first access
 @property(nonatomic, retain)NSMutableArray* _Nullable ancestors;
 
+//canonical ancestors
+// pid & canonical (symlink-resolved) path of each ancestor (w/o self & system roots), resolved on first access
+@property(nonatomic, retain, readonly)NSArray* _Nullable canonicalAncestors;
+
+//rule index the tree ('process + kids') rules were looked up in
+// weak, so a stale index isn't kept alive (and a new one forces a new lookup)
+@property(nonatomic, weak)RuleIndex* _Nullable treeRulesIndex;
+
+//tree ('process + kids') rules that apply via ancestors
+// (per index) cache, empty if none, so later flows skip the ancestor walk
+@property(nonatomic, retain)NSArray* _Nullable treeRules;
+
 //signing info
 @property(nonatomic, retain)NSMutableDictionary* _Nullable csInfo;
 
@@ -52,7 +68,7 @@
 @property(nonatomic, retain)NSString* _Nonnull key;
 
 //Binary object
-// has path, hash, etc
+// has path, hash, etc (created on first access)
 @property(nonatomic, retain)Binary* _Nonnull binary;
 
 //timestamp
@@ -64,6 +80,15 @@
 // method will then (try) fill out rest of object
 -(id _Nullable)init:(audit_token_t* _Nonnull)token;
 
+//enrich
+// (eagerly) generate binary, args, & ancestors
+// note: otherwise, these are generated on first access
+-(void)enrich;
+
+//approximate (memory) cost
+// used to keep the process cache within its budget
+-(NSUInteger)cost;
+
 @end
 
 #endif /* Process_h */
@@ -8,25 +8,63 @@
 
 #import "signing.h"
 #import "Process.h"
+#import "FlowStats.h"
 #import "Utilities.h"
+#import "SigningCache.h"
+#import "AncestryTable.h"
 
 #import <dlfcn.h>
 #import <libproc.h>
 #import <bsm/libbsm.h>
 #import <sys/sysctl.h>
+#import <mach/mach_time.h>
 
 /* GLOBALS */
 
 //log handle
 extern os_log_t logHandle;
 
+//signing cache
+extern SigningCache* signingCache;
+
+//ancestry table
+extern AncestryTable* ancestryTable;
+
+//flow stats
+extern FlowStats* flowStats;
+
+//private
+@interface Process ()
+
+//audit token
+// saved to (lazily) enrich process, and check pid wasn't reused
+@property(nonatomic, retain)NSData* auditToken;
+
+//flag
+// set once args have been (lazily) extracted
+@property BOOL argumentsLoaded;
+
+//flag
+// set once ancestors have been (lazily) enumerated
+@property BOOL ancestorsLoaded;
+
+//canonical ancestors
+// set once ancestors have been (lazily) resolved
+@property(nonatomic, retain, readwrite)NSArray* canonicalAncestors;
+
+@end
+
 @implementation Process
 
 @synthesize pid;
 @synthesize exit;
 @synthesize path;
 @synthesize csInfo;
+@synthesize binary = _binary;
 @synthesize ancestors;
+@synthesize treeRules;
+@synthesize treeRulesIndex;
+@synthesize canonicalAncestors = _canonicalAncestors;
 @synthesize arguments;
 @synthesize timestamp;
 
@@ -63,8 +101,9 @@ extern os_log_t logHandle;
 // method will then (try) fill out rest of object
 -(id)init:(audit_token_t*)token
 {
-    //current token
-    NSData* currentToken = nil;
+    //start time
+    // for (signing) stats
+    uint64_t start = 0;
     
     //init self/super
     self = [self init];
@@ -108,45 +147,183 @@ extern os_log_t logHandle;
         self.uid = audit_token_to_euid(*token);
         
         //generate (dynamic) code information
+        // timed, as (for new processes) it's usually the slowest stage of a flow
+        start = mach_absolute_time();
         [self generateSigningInfo:token];
+        [flowStats record:FlowStageSigning start:start];
         
         //generate key
         // based on cs info, or path
         self.key = [self generateKey];
         
-        //init binary
-        self.binary = [[Binary alloc] init:self.path];
+        //save token
+        // binary, args, & ancestors are only needed for alerts (and tree rules),
+        // so are (lazily) generated on first access, rather than here, on the flow's path
+        self.auditToken = [NSData dataWithBytes:token length:sizeof(audit_token_t)];
+    }
         
-        /* pid specific logic
-           note: pids can wrap,
-           so we check audit token is still same!
-         */
+    return self;
+}
+
+//check pid still refers to this process
+// pids can wrap, so check audit token (pid version) is still same!
+-(BOOL)isCurrent
+{
+    //current token
+    NSData* currentToken = nil;
+    
+    //grab current (audit) token
+    currentToken = tokenForPid(self.pid);
+    if( (0 != currentToken.length) &&
+        (sizeof(audit_token_t) == self.auditToken.length) )
+    {
+        //check!
+        // if it's changed, means pid points to new process
+        if(audit_token_to_pidversion(*(audit_token_t*)self.auditToken.bytes) != audit_token_to_pidversion(*(audit_token_t*)currentToken.bytes))
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: audit token mismatch ...pid re-used?");
+            
+            return NO;
+        }
+    }
+    
+    return YES;
+}
+
+//binary
+// created on first access, as it's only needed for alerts
+-(Binary*)binary
+{
+    //sync
+    @synchronized(self) {
         
-        //set args
-        [self getArgs];
+        //create
+        if( (nil == _binary) &&
+            (0 != self.path.length) )
+        {
+            _binary = [[Binary alloc] init:self.path];
+        }
         
-        //enum ancestors
-        self.ancestors = generateProcessHierarchy(self.pid);
+        return _binary;
+    }
+}
+
+//args
+// extracted on first access, as they're only needed for alerts
+-(NSMutableArray*)arguments
+{
+    //sync
+    @synchronized(self) {
         
-        //grab current (audit) token
-        currentToken = tokenForPid(self.pid);
-        if(0 != currentToken.length)
+        //extract
+        // note: only for processes init'd via a token
+        if( (YES != self.argumentsLoaded) &&
+            (nil != self.auditToken) )
         {
-            //check!
-            // if it's changed, means pid points to new process, so unset parent, args, etc as these may be invalid!
-            if(audit_token_to_pidversion(*token) != audit_token_to_pidversion(*(audit_token_t*)currentToken.bytes))
+            //set flag
+            self.argumentsLoaded = YES;
+            
+            //set args
+            [self getArgs];
+            
+            //pid reused?
+            // args may be invalid, so unset
+            if(YES != [self isCurrent]) arguments = nil;
+        }
+        
+        return arguments;
+    }
+}
+
+//ancestors
+// enumerated on first access, as they're only needed for alerts & tree ('process + kids') rules
+-(NSMutableArray*)ancestors
+{
+    //sync
+    @synchronized(self) {
+        
+        //enumerate
+        // note: only for processes init'd via a token
+        if( (YES != self.ancestorsLoaded) &&
+            (nil != self.auditToken) )
+        {
+            //set flag
+            self.ancestorsLoaded = YES;
+            
+            //enum ancestors
+            // via (shared) table, so hops common w/ other processes aren't looked up again
+            if(nil != ancestryTable)
             {
-                //err msg
-                os_log_error(logHandle, "ERROR: audit token mismatch ...pid re-used?");
-                
-                //unset
-                arguments = nil;
-                ancestors = nil;
+                ancestors = [ancestryTable ancestors:self.pid version:audit_token_to_pidversion(*(audit_token_t*)self.auditToken.bytes)];
             }
+            else
+            {
+                ancestors = generateProcessHierarchy(self.pid);
+            }
+            
+            //pid reused?
+            // ancestors may be invalid, so unset
+            if(YES != [self isCurrent]) ancestors = nil;
         }
+        
+        return ancestors;
     }
+}
+
+//canonical ancestors
+// resolved once, so tree ('process + kids') rule lookups don't touch the file system per flow
+-(NSArray*)canonicalAncestors
+{
+    //sync
+    @synchronized(self) {
         
-    return self;
+        //resolve
+        if(nil == _canonicalAncestors)
+        {
+            //ancestors
+            NSMutableArray* resolved = [NSMutableArray array];
+            
+            //resolve each
+            for(NSDictionary* ancestor in self.ancestors)
+            {
+                //ancestor pid
+                pid_t ancestorPID = [ancestor[KEY_PROCESS_ID] intValue];
+                
+                //skip self
+                // ...its own (item) rules apply directly
+                if(ancestorPID == self.pid) continue;
+                
+                //skip system roots (kernel/launchd)
+                if(ancestorPID <= 1) continue;
+                
+                //skip if no path
+                if(0 == [ancestor[KEY_PROCESS_PATH] length]) continue;
+                
+                //add
+                [resolved addObject:@{KEY_PROCESS_ID:ancestor[KEY_PROCESS_ID], KEY_PROCESS_PATH:canonicalPath(ancestor[KEY_PROCESS_PATH])}];
+            }
+            
+            //save
+            _canonicalAncestors = [resolved copy];
+        }
+        
+        return _canonicalAncestors;
+    }
+}
+
+//enrich
+// (eagerly) generate binary, args, & ancestors
+-(void)enrich
+{
+    //binary
+    [self binary];
+    
+    //args
+    [self arguments];
+    
+    //ancestors
+    [self ancestors];
 }
 
 //generate key
@@ -428,7 +605,7 @@ extern os_log_t logHandle;
                 if(nil != argument)
                 {
                     //save
-                    [self.arguments addObject:argument];
+                    [arguments addObject:argument];
                 }
             }
             
@@ -436,7 +613,7 @@ extern os_log_t logHandle;
             argStart = ++parser;
             
             //bail if we've hit arg cnt
-            if(self.arguments.count == numberOfArgs)
+            if(arguments.count == numberOfArgs)
             {
                 //bail
                 break;
@@ -469,7 +646,16 @@ bail:
     NSMutableDictionary* extractedSigningInfo = nil;
     
     //extract signing info
-    extractedSigningInfo = extractSigningInfo(token, nil, kSecCSDefaultFlags);
+    // via cache (keyed on file identity & cdhash) if there is one, as full validation is (relatively) slow
+    if(nil != signingCache)
+    {
+        //extract
+        extractedSigningInfo = [signingCache signingInfo:self.path token:token flags:kSecCSDefaultFlags generator:^NSMutableDictionary*{
+            return extractSigningInfo(token, nil, kSecCSDefaultFlags);
+        }];
+    }
+    //no cache
+    else extractedSigningInfo = extractSigningInfo(token, nil, kSecCSDefaultFlags);
     
     //valid?
     // save into iVar
@@ -489,6 +675,34 @@ bail:
     return;
 }
 
+//approximate (memory) cost
+// fixed overhead (object, binary, signing info) plus its strings
+-(NSUInteger)cost
+{
+    //cost
+    // start w/ fixed overhead
+    NSUInteger cost = 2048;
+    
+    //add path, name, key
+    cost += (self.path.length + self.name.length + self.key.length) * sizeof(unichar);
+    
+    //add args
+    // note: ivar, so cost doesn't trigger (lazy) extraction
+    for(NSString* argument in arguments)
+    {
+        cost += argument.length * sizeof(unichar);
+    }
+    
+    //add ancestors
+    // each: pid, path, and name
+    cost += ancestors.count * 512;
+    
+    //add signing authorities
+    cost += [self.csInfo[KEY_CS_AUTHS] count] * 256;
+    
+    return cost;
+}
+
 //for pretty printing
 -(NSString *)description
 {
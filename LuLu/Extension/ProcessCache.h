@@ -0,0 +1,77 @@
+//
+//  file: ProcessCache.h
+//  project: LuLu (launch daemon)
+//  description: LRU cache of process objects (header)
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#ifndef ProcessCache_h
+#define ProcessCache_h
+
+@import OSLog;
+@import Foundation;
+
+#import "ExitMonitor.h"
+
+//default max number of (cached) processes
+#define PROCESS_CACHE_COUNT_LIMIT 2048
+
+//default memory budget (bytes)
+#define PROCESS_CACHE_COST_LIMIT (8 * 1024 * 1024)
+
+//LRU cache of processes
+// keyed on (pid, pid version) from an audit token, so a reused pid never maps to an old process
+// evicts least recently used entries to stay within its count & cost limits,
+// and evicts entries as soon as their process exits (via the exit monitor, i.e. EVFILT_PROC/NOTE_EXIT)
+@interface ProcessCache : NSObject
+
+/* PROPERTIES */
+
+//max number of entries
+@property(atomic)NSUInteger countLimit;
+
+//max total cost (approx. bytes)
+@property(atomic)NSUInteger costLimit;
+
+//number of entries
+@property(nonatomic, readonly)NSUInteger count;
+
+//total cost
+@property(nonatomic, readonly)NSUInteger totalCost;
+
+//number of hits
+@property(nonatomic, readonly)uint64_t hits;
+
+//number of misses
+@property(nonatomic, readonly)uint64_t misses;
+
+//number of (LRU) evictions
+@property(nonatomic, readonly)uint64_t evictions;
+
+//number of (process exit) evictions
+@property(nonatomic, readonly)uint64_t exits;
+
+/* METHODS */
+
+//init
+// w/ an exit monitor (nil: creates its own)
+-(id)init:(ExitMonitor*)exitMonitor;
+
+//lookup object for an audit token
+// marks it as most recently used
+-(id)objectForToken:(NSData*)token;
+
+//add object for an audit token
+// cost is its (approx.) size, then evicts least recently used entries if over limits
+-(void)setObject:(id)object forToken:(NSData*)token cost:(NSUInteger)cost;
+
+//remove object for an audit token
+-(void)removeObjectForToken:(NSData*)token;
+
+//remove all objects
+-(void)removeAllObjects;
+
+@end
+
+#endif /* ProcessCache_h */
@@ -0,0 +1,342 @@
+//
+//  file: ProcessCache.m
+//  project: LuLu (launch daemon)
+//  description: LRU cache of process objects
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#import "ProcessCache.h"
+
+#import <signal.h>
+#import <bsm/libbsm.h>
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+//entry
+// node in the (doubly) linked LRU list
+@interface ProcessCacheEntry : NSObject
+
+//key
+// (pid << 32) | pid version
+@property(nonatomic, retain)NSNumber* key;
+
+//object
+@property(nonatomic, retain)id object;
+
+//cost
+@property(nonatomic)NSUInteger cost;
+
+//exit watch
+@property(nonatomic, retain)id exitWatch;
+
+//more recently used entry
+@property(nonatomic, weak)ProcessCacheEntry* prev;
+
+//less recently used entry
+@property(nonatomic, retain)ProcessCacheEntry* next;
+
+@end
+
+@implementation ProcessCacheEntry
+@end
+
+@implementation ProcessCache
+{
+    //entries
+    // key: (pid << 32) | pid version
+    NSMutableDictionary<NSNumber*, ProcessCacheEntry*>* entries;
+    
+    //most recently used entry
+    ProcessCacheEntry* head;
+    
+    //least recently used entry
+    __weak ProcessCacheEntry* tail;
+    
+    //exit monitor
+    ExitMonitor* exitMonitor;
+}
+
+@synthesize count;
+@synthesize exits;
+@synthesize hits;
+@synthesize misses;
+@synthesize totalCost;
+@synthesize evictions;
+
+//init
+-(id)init
+{
+    return [self init:nil];
+}
+
+//init
+// w/ an exit monitor (nil: creates its own)
+-(id)init:(ExitMonitor*)monitor
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //init entries
+        entries = [NSMutableDictionary dictionary];
+        
+        //init exit monitor
+        exitMonitor = monitor ?: [[ExitMonitor alloc] init];
+        
+        //init limits
+        self.countLimit = PROCESS_CACHE_COUNT_LIMIT;
+        self.costLimit = PROCESS_CACHE_COST_LIMIT;
+    }
+    
+    return self;
+}
+
+//key for a token
+// (pid << 32) | pid version, or nil if token is malformed
+static NSNumber* keyForToken(NSData* token)
+{
+    //sanity check
+    if(sizeof(audit_token_t) != token.length) return nil;
+    
+    return @(((uint64_t)(uint32_t)audit_token_to_pid(*(audit_token_t*)token.bytes) << 32) | (uint32_t)audit_token_to_pidversion(*(audit_token_t*)token.bytes));
+}
+
+//unlink an entry from the LRU list
+// note: caller should hold the lock
+-(void)unlink:(ProcessCacheEntry*)entry
+{
+    //fix up next
+    if(nil != entry.next) entry.next.prev = entry.prev;
+    else tail = entry.prev;
+    
+    //fix up prev
+    if(nil != entry.prev) entry.prev.next = entry.next;
+    else head = entry.next;
+    
+    //reset
+    entry.prev = nil;
+    entry.next = nil;
+}
+
+//link an entry at the head (most recently used) of the LRU list
+// note: caller should hold the lock
+-(void)linkAtHead:(ProcessCacheEntry*)entry
+{
+    //link
+    entry.next = head;
+    if(nil != head) head.prev = entry;
+    head = entry;
+    
+    //first?
+    if(nil == tail) tail = entry;
+}
+
+//remove an entry
+// note: caller should hold the lock
+-(void)remove:(ProcessCacheEntry*)entry
+{
+    //stop watching for exit
+    if(nil != entry.exitWatch) [exitMonitor unwatch:entry.exitWatch];
+    entry.exitWatch = nil;
+    
+    //unlink
+    [self unlink:entry];
+    
+    //remove
+    [entries removeObjectForKey:entry.key];
+    
+    //update
+    totalCost -= entry.cost;
+    count = entries.count;
+}
+
+//lookup object for an audit token
+-(id)objectForToken:(NSData*)token
+{
+    //key
+    NSNumber* key = keyForToken(token);
+    
+    //entry
+    ProcessCacheEntry* entry = nil;
+    
+    //sync
+    @synchronized(self) {
+        
+        //lookup
+        entry = (nil != key) ? entries[key] : nil;
+        if(nil == entry)
+        {
+            //miss
+            misses++;
+            return nil;
+        }
+        
+        //hit
+        hits++;
+        
+        //move to head
+        if(head != entry)
+        {
+            [self unlink:entry];
+            [self linkAtHead:entry];
+        }
+        
+        return entry.object;
+    }
+}
+
+//add object for an audit token
+-(void)setObject:(id)object forToken:(NSData*)token cost:(NSUInteger)cost
+{
+    //key
+    NSNumber* key = keyForToken(token);
+    
+    //pid
+    pid_t pid = 0;
+    
+    //entry
+    ProcessCacheEntry* entry = nil;
+    
+    //weak self
+    __weak typeof(self) weakSelf = self;
+    
+    //sanity check
+    if( (nil == key) || (nil == object) ) return;
+    
+    //init pid
+    pid = audit_token_to_pid(*(audit_token_t*)token.bytes);
+    
+    //sync
+    @synchronized(self) {
+        
+        //already cached?
+        // just replace the object (it's the same process)
+        entry = entries[key];
+        if(nil != entry)
+        {
+            //update
+            totalCost = totalCost - entry.cost + cost;
+            entry.object = object;
+            entry.cost = cost;
+            
+            //move to head
+            [self unlink:entry];
+            [self linkAtHead:entry];
+        }
+        
+        //new
+        else
+        {
+            //init entry
+            entry = [[ProcessCacheEntry alloc] init];
+            entry.key = key;
+            entry.object = object;
+            entry.cost = cost;
+            
+            //watch for exit
+            // evicts as soon as process exits, instead of waiting for it to age out
+            entry.exitWatch = [exitMonitor watch:pid version:audit_token_to_pidversion(*(audit_token_t*)token.bytes) handler:^{
+                [weakSelf exited:key];
+            }];
+            
+            //add
+            entries[key] = entry;
+            [self linkAtHead:entry];
+            
+            //update
+            totalCost += cost;
+            count = entries.count;
+        }
+        
+        //evict least recently used
+        // until within limits (but always keep the new entry)
+        while( (tail != entry) &&
+               ((entries.count > self.countLimit) || (totalCost > self.costLimit)) )
+        {
+            //evict
+            [self remove:tail];
+            evictions++;
+        }
+    }
+    
+    //already exited?
+    // would have missed the exit event, so evict now
+    if( (0 != kill(pid, 0)) && (ESRCH == errno) )
+    {
+        //evict
+        [self exited:key];
+    }
+    
+    return;
+}
+
+//process exited
+// evict its entry
+-(void)exited:(NSNumber*)key
+{
+    //entry
+    ProcessCacheEntry* entry = nil;
+    
+    //sync
+    @synchronized(self) {
+        
+        //lookup
+        entry = entries[key];
+        if(nil == entry) return;
+        
+        //dbg msg
+        os_log_debug(logHandle, "process %llu exited, evicting from (process) cache", key.unsignedLongLongValue >> 32);
+        
+        //remove
+        [self remove:entry];
+        exits++;
+    }
+    
+    return;
+}
+
+//remove object for an audit token
+-(void)removeObjectForToken:(NSData*)token
+{
+    //key
+    NSNumber* key = keyForToken(token);
+    
+    //sync
+    @synchronized(self) {
+        
+        //remove
+        if( (nil != key) && (nil != entries[key]) ) [self remove:entries[key]];
+    }
+    
+    return;
+}
+
+//remove all objects
+-(void)removeAllObjects
+{
+    //sync
+    @synchronized(self) {
+        
+        //remove each
+        while(nil != head) [self remove:head];
+    }
+    
+    return;
+}
+
+//dealloc
+// stop any exit watches
+-(void)dealloc
+{
+    //unwatch each
+    for(ProcessCacheEntry* entry in entries.allValues)
+    {
+        if(nil != entry.exitWatch) [exitMonitor unwatch:entry.exitWatch];
+    }
+}
+
+@end
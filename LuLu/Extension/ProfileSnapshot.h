@@ -0,0 +1,64 @@
+//
+//  file: ProfileSnapshot.h
+//  project: LuLu (launch daemon)
+//  description: compiled (i.e. ready to activate) rules & preferences of a profile (header)
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#ifndef ProfileSnapshot_h
+#define ProfileSnapshot_h
+
+@import OSLog;
+@import Foundation;
+
+@class RuleIndex;
+@class RuleJournal;
+@class RuleExpirations;
+
+//compiled profile
+// its rules (journal replayed, indexed, & expirations ordered) and preferences, loaded ahead of time
+// ...so activating it is just a swap, instead of a (full) load from disk
+// note: records the state of its files when created, so any later (on disk) changes can be detected
+@interface ProfileSnapshot : NSObject
+
+/* PROPERTIES */
+
+//(profile) directory
+@property(nonatomic, retain, readonly)NSString* directory;
+
+//rules
+@property(nonatomic, retain)NSMutableDictionary* rules;
+
+//journal
+@property(nonatomic, retain)RuleJournal* journal;
+
+//index
+@property(nonatomic, retain)RuleIndex* compiledRules;
+
+//expirations
+@property(nonatomic, retain)RuleExpirations* expirations;
+
+//preferences
+@property(nonatomic, retain)NSMutableDictionary* preferences;
+
+//time to compile (seconds)
+@property(nonatomic)NSTimeInterval compileTime;
+
+/* METHODS */
+
+//init w/ (profile) directory
+// records the state of its rules, journal, & preferences files
+-(id)init:(NSString*)directory;
+
+//(still) current?
+// i.e. none of its files have changed since it was compiled
+-(BOOL)isCurrent;
+
+//(re)record state of files
+// for when its files were changed in a known way (e.g. current profile saved in default prefs), that's also applied to the snapshot
+-(void)restamp;
+
+@end
+
+#endif /* ProfileSnapshot_h */
@@ -0,0 +1,98 @@
+//
+//  file: ProfileSnapshot.m
+//  project: LuLu (launch daemon)
+//  description: compiled (i.e. ready to activate) rules & preferences of a profile
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#import "consts.h"
+#import "ProfileSnapshot.h"
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+@implementation ProfileSnapshot
+{
+    //state of files
+    // when snapshot was created
+    NSArray* stamps;
+}
+
+@synthesize directory;
+
+//init w/ (profile) directory
+-(id)init:(NSString*)profileDirectory
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //save
+        directory = profileDirectory;
+        
+        //record state of files
+        stamps = [self stamp];
+    }
+    
+    return self;
+}
+
+//state of (profile's) files
+// size & modification date of its rules, journal, & preferences
+-(NSArray*)stamp
+{
+    //stamps
+    NSMutableArray* fileStamps = [NSMutableArray array];
+    
+    //rules file
+    NSString* rulesFile = [self.directory stringByAppendingPathComponent:RULES_FILE];
+    
+    //stamp each
+    for(NSString* file in @[rulesFile, [rulesFile stringByAppendingString:RULES_JOURNAL_SUFFIX], [self.directory stringByAppendingPathComponent:PREFS_FILE]])
+    {
+        //attributes
+        NSDictionary* attributes = [NSFileManager.defaultManager attributesOfItemAtPath:file error:nil];
+        
+        //missing or empty?
+        // same thing (e.g. replaying a missing journal creates an empty one)
+        if(0 == attributes.fileSize)
+        {
+            [fileStamps addObject:@0];
+            continue;
+        }
+        
+        //add
+        [fileStamps addObject:[NSString stringWithFormat:@"%llu:%f", attributes.fileSize, attributes.fileModificationDate.timeIntervalSinceReferenceDate]];
+    }
+    
+    return fileStamps;
+}
+
+//(still) current?
+-(BOOL)isCurrent
+{
+    //current?
+    BOOL isCurrent = [stamps isEqualToArray:[self stamp]];
+    
+    //dbg msg
+    if(YES != isCurrent)
+    {
+        os_log_debug(logHandle, "compiled profile %{public}@ is stale (files changed)", self.directory);
+    }
+    
+    return isCurrent;
+}
+
+//(re)record state of files
+-(void)restamp
+{
+    //record
+    stamps = [self stamp];
+    
+    return;
+}
+
+@end
@@ -15,11 +15,18 @@
 //profiles directory
 @property(nonatomic, retain)NSString* directory;
 
+//time to activate (last) profile
+// seconds, for perf checks
+@property(atomic)NSTimeInterval activationTime;
+
 /* METHODS */
 
 -(NSMutableArray*)enumerate;
 -(NSString*)resolve:(NSString*)name;
 -(void)set:(NSString*)profilePath;
+-(BOOL)activate:(NSString*)profilePath;
+-(void)compile:(NSString*)profilePath;
+-(void)compileAll;
 -(BOOL)add:(NSString*)name preferences:(NSDictionary*)preferences;
 -(BOOL)delete:(NSString*)name;
 
@@ -9,6 +9,7 @@
 #import "consts.h"
 #import "Profiles.h"
 #import "Preferences.h"
+#import "ProfileSnapshot.h"
 
 /* GLOBALS */
 
@@ -22,6 +23,18 @@ extern Rules* rules;
 extern Preferences* preferences;
 
 @implementation Profiles
+{
+    //compiled profiles
+    // key: profile directory (default: install directory), never the current one
+    NSMutableDictionary* snapshots;
+    
+    //current profile directory
+    NSString* current;
+    
+    //queue
+    // for compiling (inactive) profiles in the background
+    dispatch_queue_t queue;
+}
 
 //init
 // loads profiles
@@ -33,11 +46,27 @@ extern Preferences* preferences;
     {
         //set (base) directory
         self.directory = [INSTALL_DIRECTORY stringByAppendingPathComponent:PROFILE_DIRECTORY];
+        
+        //init snapshots
+        snapshots = [NSMutableDictionary dictionary];
+        
+        //init current
+        current = [self directoryFor:[preferences getCurrentProfile]];
+        
+        //init queue
+        queue = dispatch_queue_create("com.objective-see.lulu.profiles", dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_UTILITY, 0));
     }
         
     return self;
 }
 
+//directory of a profile
+// default profile (nil) is in the install directory
+-(NSString*)directoryFor:(NSString*)profilePath
+{
+    return (nil != profilePath) ? profilePath : INSTALL_DIRECTORY;
+}
+
 //enumerate
 // return list of just profile *names*
 -(NSMutableArray*)enumerate
@@ -127,6 +156,7 @@ bail:
     BOOL wasAdded = NO;
     NSError* error = nil;
     NSString *newProfilePath = nil;
+    NSMutableDictionary* defaultRules = nil;
     
     //dbg msg
     os_log_debug(logHandle, "method '%s' invoked with %{public}@ / %{public}@", __PRETTY_FUNCTION__, name, newPreferences);
@@ -182,21 +212,12 @@ bail:
     //dbg msg
     os_log_debug(logHandle, "created profile directory: %{public}@", newProfilePath);
     
-    //set as current
-    [self set:newProfilePath];
-    
-    //save new prefs
-    // replacing all
-    [preferences update:newPreferences replace:YES];
-    
-    //clear out all rules
-    @synchronized (rules) {
-        
-        [rules.rules removeAllObjects];
-    }
+    //init
+    defaultRules = [NSMutableDictionary dictionary];
     
     //generate default rules
-    if(YES != [rules generateDefaultRules])
+    // into the new profile's rules, not the (live) ones, which are still the previous profile's
+    if(YES != [rules generateDefaultRules:defaultRules])
     {
         //err msg
         os_log_error(logHandle, "ERROR: failed to generate default rules");
@@ -206,13 +227,29 @@ bail:
     }
     
     //save
-    [rules save];
+    [rules save:defaultRules to:[newProfilePath stringByAppendingPathComponent:RULES_FILE]];
+    
+    //save new prefs
+    if(YES != [newPreferences writeToFile:[newProfilePath stringByAppendingPathComponent:PREFS_FILE] atomically:YES])
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to save preferences of new profile %{public}@", newProfilePath);
+        
+        //bail
+        goto bail;
+    }
     
-    //reload rules
-    [rules load];
+    //activate (and set as current)
+    // swaps in its rules & prefs together, then sets it as current
+    if(YES != [self activate:newProfilePath])
+    {
+        //bail
+        goto bail;
+    }
     
-    //reload prefs
-    [preferences load];
+    //apply new prefs
+    // e.g. (re)loads any allow/block lists
+    [preferences update:newPreferences replace:NO];
 
     //happy
     wasAdded = YES;
@@ -224,10 +261,248 @@ bail:
 
 //set current profile path in *default* prefs
 // note: can be called with nil to reset back to default profile
+// also updates compiled profiles: new one is dropped (as it'll be changed), previous one is (re)compiled
 -(void)set:(NSString*)profilePath
 {
+    //previous
+    NSString* previous = nil;
+    
+    //compiled default profile
+    ProfileSnapshot* defaultSnapshot = nil;
+    
+    //sync
+    @synchronized(snapshots)
+    {
+        //save previous
+        previous = current;
+        
+        //update current
+        current = [self directoryFor:profilePath];
+        
+        //drop (new) current
+        [snapshots removeObjectForKey:current];
+        
+        //compiled default profile
+        // its prefs file is (re)written below, so check if it's current before
+        defaultSnapshot = snapshots[INSTALL_DIRECTORY];
+        if(YES != [defaultSnapshot isCurrent])
+        {
+            [snapshots removeObjectForKey:INSTALL_DIRECTORY];
+            defaultSnapshot = nil;
+        }
+        
+        //set
+        [preferences setCurrentProfile:profilePath];
+        
+        //keep compiled default profile in sync
+        // i.e. only (our) change to its prefs file was the current profile
+        if(nil != defaultSnapshot)
+        {
+            defaultSnapshot.preferences[PREF_CURRENT_PROFILE] = profilePath;
+            [defaultSnapshot restamp];
+        }
+    }
+    
+    //compile previous
+    // so switching back to it is instant
+    if(YES != [previous isEqualToString:current])
+    {
+        [self compile:previous];
+    }
+    
+    return;
+}
+
+//activate profile
+// uses compiled profile (if not stale), so it's just a swap of its rules & prefs
+// ...otherwise compiles it now (w/o the rules lock), falling back to a (full) load if that fails
+-(BOOL)activate:(NSString*)profilePath
+{
+    //flag
+    BOOL activated = NO;
+    
+    //directory
+    NSString* profileDirectory = [self directoryFor:profilePath];
+    
+    //compiled profile
+    ProfileSnapshot* snapshot = nil;
+    
+    //start
+    NSDate* start = [NSDate date];
+    
+    //grab compiled profile
+    // removed, as once activated, its rules are the (live) rules
+    @synchronized(snapshots)
+    {
+        snapshot = snapshots[profileDirectory];
+        [snapshots removeObjectForKey:profileDirectory];
+    }
+    
+    //not compiled (yet) or stale?
+    // compile now
+    if( (nil == snapshot) ||
+        (YES != [snapshot isCurrent]) )
+    {
+        //dbg msg
+        os_log_debug(logHandle, "profile %{public}@ not compiled (or stale), will compile now", profileDirectory);
+        
+        //compile
+        snapshot = [self snapshot:profileDirectory];
+    }
+    
+    //failed to compile?
+    // fall back to (full) load
+    if(nil == snapshot)
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to compile profile %{public}@, will (re)load", profileDirectory);
+        
+        //set
+        // first, as a (full) load goes by the current profile pref
+        [self set:profilePath];
+        
+        //reload rules
+        activated = [rules load];
+        
+        //reload prefs
+        [preferences load];
+        
+        //bail
+        goto bail;
+    }
+    
+    //default profile?
+    // its prefs are also where the current profile is saved, which was just reset
+    if(nil == profilePath)
+    {
+        [snapshot.preferences removeObjectForKey:PREF_CURRENT_PROFILE];
+    }
+    
+    //activate rules & prefs
+    // together, under the rules lock, so flows (and saves) never see one profile's rules w/ another's prefs
+    @synchronized(rules)
+    {
+        //activate rules
+        [rules activate:snapshot];
+        
+        //activate prefs
+        [preferences activate:snapshot.preferences file:[profileDirectory stringByAppendingPathComponent:PREFS_FILE]];
+    }
+    
     //set
-    [preferences setCurrentProfile:profilePath];
+    // only now that it's live, as rules & prefs are saved to the files they were activated from
+    [self set:profilePath];
+    
+    //happy
+    activated = YES;
+    
+bail:
+    
+    //save time
+    self.activationTime = [[NSDate date] timeIntervalSinceDate:start];
+    
+    //dbg msg
+    os_log_debug(logHandle, "activated profile %{public}@ in %.2f ms", profileDirectory, self.activationTime * 1000);
+    
+    return activated;
+}
+
+//compile profile (now)
+// rules (via rules obj) & prefs, which are loaded, but not activated
+-(ProfileSnapshot*)snapshot:(NSString*)profileDirectory
+{
+    //compiled profile
+    ProfileSnapshot* snapshot = nil;
+    
+    //prefs
+    NSMutableDictionary* profilePreferences = nil;
+    
+    //compile rules
+    // note: first, as this records the state of (all) the profile's files
+    snapshot = [rules compile:[profileDirectory stringByAppendingPathComponent:RULES_FILE]];
+    if(nil == snapshot)
+    {
+        //bail
+        goto bail;
+    }
+    
+    //load prefs
+    profilePreferences = [NSMutableDictionary dictionaryWithContentsOfFile:[profileDirectory stringByAppendingPathComponent:PREFS_FILE]];
+    if(nil == profilePreferences)
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to load preferences of profile %{public}@", profileDirectory);
+        
+        //unset
+        snapshot = nil;
+        
+        //bail
+        goto bail;
+    }
+    
+    //save
+    snapshot.preferences = profilePreferences;
+    
+bail:
+    
+    return snapshot;
+}
+
+//compile profile (in the background)
+// skipped if it's (now) the current profile, as it'll be changed
+-(void)compile:(NSString*)profilePath
+{
+    //directory
+    NSString* profileDirectory = [self directoryFor:profilePath];
+    
+    //compile in background
+    dispatch_async(queue, ^{
+        
+        //compiled profile
+        ProfileSnapshot* snapshot = nil;
+        
+        //current?
+        @synchronized(self->snapshots)
+        {
+            if(YES == [profileDirectory isEqualToString:self->current]) return;
+        }
+        
+        //gone?
+        // e.g. (previous) profile was deleted
+        if(YES != [NSFileManager.defaultManager fileExistsAtPath:profileDirectory]) return;
+        
+        //compile
+        snapshot = [self snapshot:profileDirectory];
+        if(nil == snapshot) return;
+        
+        //save
+        // unless it became current (while compiling)
+        @synchronized(self->snapshots)
+        {
+            if(YES == [profileDirectory isEqualToString:self->current]) return;
+            
+            self->snapshots[profileDirectory] = snapshot;
+        }
+        
+        //dbg msg
+        os_log_debug(logHandle, "compiled profile %{public}@ (%lu rules) in %.2f ms", profileDirectory, (unsigned long)snapshot.rules.count, snapshot.compileTime * 1000);
+    });
+    
+    return;
+}
+
+//compile all (inactive) profiles
+// in the background, so switching to any is instant
+-(void)compileAll
+{
+    //default
+    [self compile:nil];
+    
+    //each profile
+    for(NSString* name in [self enumerate])
+    {
+        [self compile:[self.directory stringByAppendingPathComponent:name]];
+    }
     
     return;
 }
@@ -242,8 +517,8 @@ bail:
     //error
     NSError* error = nil;
     
-    //current
-    NSString* current = nil;
+    //active profile
+    NSString* activeProfile = nil;
     
     //path
     // note: resolves (client-supplied) name, ensuring it's within the profiles directory
@@ -270,26 +545,26 @@ bail:
     //dbg msg
     os_log_debug(logHandle, "deleted profile directory: %{public}@", profile);
     
-    //get current
-    current = [preferences getCurrentProfile];
+    //drop compiled profile
+    @synchronized(snapshots)
+    {
+        [snapshots removeObjectForKey:profile];
+    }
+    
+    //get active profile
+    activeProfile = [preferences getCurrentProfile];
     
     //dbg msg
-    os_log_debug(logHandle, "checking if %{public}@ matches current %{public}@", profile, current);
+    os_log_debug(logHandle, "checking if %{public}@ matches current %{public}@", profile, activeProfile);
     
     //was current?
-    if(YES == [profile isEqualToString:current])
+    if(YES == [profile isEqualToString:activeProfile])
     {
         //dbg msg
         os_log_debug(logHandle, "'%{public}@' was current profile, so will reset back to default", profile);
         
-        //unset path
-        [self set:nil];
-        
-        //reload rules
-        [rules load];
-        
-        //reload prefs
-        [preferences load];
+        //activate default
+        [self activate:nil];
     }
     
     //happy
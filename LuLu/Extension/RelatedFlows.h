@@ -0,0 +1,81 @@
+//
+//  file: RelatedFlows.h
+//  project: LuLu (launch daemon)
+//  description: (paused) flows held while a process' alert is shown (header)
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#ifndef RelatedFlows_h
+#define RelatedFlows_h
+
+@import OSLog;
+@import Foundation;
+
+//default max number of (held) flows, per key
+// beyond this, new flows aren't held, but resumed per the overflow policy
+#define RELATED_FLOWS_LIMIT 256
+
+//(paused) flows, queued per (process) key
+// held 'til the user responds to the key's alert, then drained in one batch
+// note: flows are typed as 'id' (NEFilterSocketFlow in the extension) so tests can use stand-ins
+@interface RelatedFlows : NSObject
+
+/* PROPERTIES */
+
+//max number of flows, per key
+@property(atomic)NSUInteger limit;
+
+//number of keys
+@property(nonatomic, readonly)NSUInteger count;
+
+//number of flows
+// across all keys
+@property(nonatomic, readonly)NSUInteger flowCount;
+
+//number of flows not held, as their key was full
+@property(nonatomic, readonly)uint64_t overflows;
+
+/* METHODS */
+
+//init
+// w/ a per key limit
+-(id)init:(NSUInteger)limit;
+
+//hold a flow
+// returns NO (and doesn't hold it) if key's queue is full
+-(BOOL)add:(id)flow key:(NSString*)key;
+
+//hold an alert's flow
+// ignores the limit, as this is the flow the user is answering (so it's only ever one per alert)
+-(void)addAlerted:(id)flow key:(NSString*)key;
+
+//remove a (specific) flow
+// drops the key if now empty
+-(void)remove:(id)flow key:(NSString*)key;
+
+//first (oldest) flow for a key
+-(id)first:(NSString*)key;
+
+//number of flows for a key
+-(NSUInteger)countForKey:(NSString*)key;
+
+//all keys
+-(NSArray<NSString*>*)keys;
+
+//take all flows for a key
+// removes the key, and returns its flows (oldest first)
+-(NSArray*)take:(NSString*)key;
+
+//take (matching) flows, across all keys
+// removes any keys that are now empty, and returns key -> taken flows (oldest first)
+-(NSDictionary<NSString*, NSArray*>*)takeMatching:(BOOL(^)(id flow))match;
+
+//take all flows for a key, grouped
+// flows w/ equal group ids (e.g. same process & endpoint) will get the same verdict, so only need one evaluation
+// groups are ordered by their oldest flow; flows w/ a nil group id get their own group
+-(NSArray<NSArray*>*)take:(NSString*)key groupedBy:(id<NSCopying>(^)(id flow))group;
+
+@end
+
+#endif /* RelatedFlows_h */
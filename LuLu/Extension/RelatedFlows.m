@@ -0,0 +1,303 @@
+//
+//  file: RelatedFlows.m
+//  project: LuLu (launch daemon)
+//  description: (paused) flows held while a process' alert is shown
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#import "RelatedFlows.h"
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+@implementation RelatedFlows
+{
+    //flows
+    // key -> ordered set of flows
+    NSMutableDictionary<NSString*, NSMutableOrderedSet*>* flows;
+
+    //overflows
+    uint64_t overflowCount;
+}
+
+//init
+-(id)init
+{
+    return [self init:RELATED_FLOWS_LIMIT];
+}
+
+//init
+// w/ a per key limit
+-(id)init:(NSUInteger)limit
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //init flows
+        flows = [NSMutableDictionary dictionary];
+
+        //save limit
+        // 0: use default
+        self.limit = (0 != limit) ? limit : RELATED_FLOWS_LIMIT;
+    }
+
+    return self;
+}
+
+//number of keys
+-(NSUInteger)count
+{
+    @synchronized(self)
+    {
+        return flows.count;
+    }
+}
+
+//number of flows
+-(NSUInteger)flowCount
+{
+    //count
+    NSUInteger count = 0;
+
+    @synchronized(self)
+    {
+        for(NSMutableOrderedSet* queue in flows.allValues) count += queue.count;
+    }
+
+    return count;
+}
+
+//number of overflows
+-(uint64_t)overflows
+{
+    @synchronized(self)
+    {
+        return overflowCount;
+    }
+}
+
+//hold a flow
+// returns NO (and doesn't hold it) if key's queue is full
+-(BOOL)add:(id)flow key:(NSString*)key
+{
+    //queue
+    NSMutableOrderedSet* queue = nil;
+
+    //sanity check
+    if( (nil == flow) ||
+        (nil == key) )
+    {
+        return NO;
+    }
+
+    @synchronized(self)
+    {
+        //first time
+        // init (ordered) set for key's flows
+        queue = flows[key];
+        if(nil == queue)
+        {
+            queue = [NSMutableOrderedSet orderedSet];
+            flows[key] = queue;
+        }
+
+        //already held?
+        if(YES == [queue containsObject:flow]) return YES;
+
+        //full?
+        // don't hold it, caller applies overflow policy
+        if(queue.count >= self.limit)
+        {
+            //inc
+            overflowCount++;
+
+            //dbg msg
+            os_log_debug(logHandle, "related flows for %{public}@ at limit (%lu), won't hold flow", key, (unsigned long)self.limit);
+
+            return NO;
+        }
+
+        //add
+        [queue addObject:flow];
+    }
+
+    return YES;
+}
+
+//hold an alert's flow
+// ignores the limit, as it's only ever one per alert
+-(void)addAlerted:(id)flow key:(NSString*)key
+{
+    //sanity check
+    if( (nil == flow) ||
+        (nil == key) )
+    {
+        return;
+    }
+
+    @synchronized(self)
+    {
+        //first time
+        // init (ordered) set for key's flows
+        if(nil == flows[key]) flows[key] = [NSMutableOrderedSet orderedSet];
+
+        //add
+        [flows[key] addObject:flow];
+    }
+
+    return;
+}
+
+//remove a (specific) flow
+// drops the key if now empty
+-(void)remove:(id)flow key:(NSString*)key
+{
+    //sanity check
+    if(nil == key) return;
+
+    @synchronized(self)
+    {
+        //remove
+        if(nil != flow) [flows[key] removeObject:flow];
+
+        //drop key if empty
+        if(0 == flows[key].count) [flows removeObjectForKey:key];
+    }
+
+    return;
+}
+
+//first (oldest) flow for a key
+-(id)first:(NSString*)key
+{
+    //sanity check
+    if(nil == key) return nil;
+
+    @synchronized(self)
+    {
+        return flows[key].firstObject;
+    }
+}
+
+//number of flows for a key
+-(NSUInteger)countForKey:(NSString*)key
+{
+    //sanity check
+    if(nil == key) return 0;
+
+    @synchronized(self)
+    {
+        return flows[key].count;
+    }
+}
+
+//all keys
+-(NSArray<NSString*>*)keys
+{
+    @synchronized(self)
+    {
+        return flows.allKeys;
+    }
+}
+
+//take all flows for a key
+// removes the key, and returns its flows (oldest first)
+-(NSArray*)take:(NSString*)key
+{
+    //flows
+    NSArray* taken = nil;
+
+    //sanity check
+    if(nil == key) return @[];
+
+    @synchronized(self)
+    {
+        //grab
+        taken = [flows[key].array copy] ?: @[];
+
+        //remove
+        [flows removeObjectForKey:key];
+    }
+
+    return taken;
+}
+
+//take (matching) flows, across all keys
+// removes any keys that are now empty
+-(NSDictionary<NSString*, NSArray*>*)takeMatching:(BOOL(^)(id flow))match
+{
+    //taken
+    NSMutableDictionary* taken = nil;
+
+    //init
+    taken = [NSMutableDictionary dictionary];
+
+    @synchronized(self)
+    {
+        //check each key
+        // note: iterating a snapshot (allKeys), so safe to remove keys in the loop
+        for(NSString* key in flows.allKeys)
+        {
+            //matching flows
+            NSIndexSet* matches = [flows[key] indexesOfObjectsPassingTest:^BOOL(id flow, NSUInteger index, BOOL* stop) {
+                return match(flow);
+            }];
+            if(0 == matches.count) continue;
+
+            //take
+            taken[key] = [flows[key] objectsAtIndexes:matches];
+            [flows[key] removeObjectsAtIndexes:matches];
+
+            //drop key if empty
+            if(0 == flows[key].count) [flows removeObjectForKey:key];
+        }
+    }
+
+    return taken;
+}
+
+//take all flows for a key, grouped
+// groups are ordered by their oldest flow; flows w/ a nil group id get their own group
+-(NSArray<NSArray*>*)take:(NSString*)key groupedBy:(id<NSCopying>(^)(id flow))group
+{
+    //groups
+    NSMutableArray<NSMutableArray*>* groups = nil;
+
+    //group id -> group
+    NSMutableDictionary* groupsByID = nil;
+
+    //init
+    groups = [NSMutableArray array];
+    groupsByID = [NSMutableDictionary dictionary];
+
+    //take, then group outside the lock
+    // group ids may be (relatively) expensive to build
+    for(id flow in [self take:key])
+    {
+        //group id
+        id<NSCopying> groupID = group(flow);
+
+        //existing group?
+        NSMutableArray* existing = (nil != groupID) ? groupsByID[groupID] : nil;
+        if(nil != existing)
+        {
+            [existing addObject:flow];
+            continue;
+        }
+
+        //new group
+        existing = [NSMutableArray arrayWithObject:flow];
+        [groups addObject:existing];
+
+        //save
+        if(nil != groupID) groupsByID[groupID] = existing;
+    }
+
+    return groups;
+}
+
+@end
@@ -0,0 +1,42 @@
+//
+//  file: RuleChanges.h
+//  project: LuLu (launch daemon)
+//  description: versioned log of changed rule (items), for delta syncs (header)
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#ifndef RuleChanges_h
+#define RuleChanges_h
+
+@import OSLog;
+@import Foundation;
+
+//max (distinct) changed keys to track
+// beyond this, clients just get all rules
+#define RULE_CHANGES_LIMIT 4096
+
+//log of changed keys
+// each change bumps the generation, and records it for the changed key
+// note: not thread safe, caller (rules) should hold its lock
+@interface RuleChanges : NSObject
+
+/* PROPERTIES */
+
+//current generation
+// seeded from the time, so generations from a previous (daemon) instance are never current
+@property(nonatomic, readonly)unsigned long long generation;
+
+/* METHODS */
+
+//record a change to an item's rules
+// nil key: all rules changed (e.g. loaded/imported), so any client will need a full sync
+-(unsigned long long)changed:(NSString*)key;
+
+//keys changed since a generation
+// returns nil if that's unknown (too old, or from a previous instance), meaning a full sync is needed
+-(NSSet*)keysSince:(unsigned long long)generation;
+
+@end
+
+#endif /* RuleChanges_h */
@@ -0,0 +1,104 @@
+//
+//  file: RuleChanges.m
+//  project: LuLu (launch daemon)
+//  description: versioned log of changed rule (items), for delta syncs
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#import "RuleChanges.h"
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+@implementation RuleChanges
+{
+    //changed keys
+    // key: item key, value: generation of its last change
+    NSMutableDictionary* keys;
+    
+    //oldest generation that deltas can be computed from
+    unsigned long long base;
+}
+
+@synthesize generation;
+
+//init
+-(id)init
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //init
+        keys = [NSMutableDictionary dictionary];
+        
+        //seed generation from time (in microseconds)
+        generation = (unsigned long long)([NSDate date].timeIntervalSince1970 * USEC_PER_SEC);
+        
+        //nothing before this
+        base = generation;
+    }
+    
+    return self;
+}
+
+//record a change
+-(unsigned long long)changed:(NSString*)key
+{
+    //bump
+    generation++;
+    
+    //all changed?
+    // or too many to track? reset
+    if( (nil == key) ||
+        (keys.count >= RULE_CHANGES_LIMIT) )
+    {
+        //dbg msg
+        os_log_debug(logHandle, "rule change log reset at generation %llu", generation);
+        
+        //reset
+        [keys removeAllObjects];
+        base = generation;
+        
+        //all changed?
+        if(nil == key) return generation;
+    }
+    
+    //save
+    keys[key] = @(generation);
+    
+    return generation;
+}
+
+//keys changed since a generation
+-(NSSet*)keysSince:(unsigned long long)since
+{
+    //changed keys
+    NSMutableSet* changed = nil;
+    
+    //unknown?
+    // before last reset, or from the future (i.e. a previous instance)
+    if( (since < base) ||
+        (since > generation) )
+    {
+        return nil;
+    }
+    
+    //init
+    changed = [NSMutableSet set];
+    
+    //collect newer
+    [keys enumerateKeysAndObjectsUsingBlock:^(NSString* key, NSNumber* keyGeneration, BOOL* stop) {
+        
+        //changed since?
+        if(keyGeneration.unsignedLongLongValue > since) [changed addObject:key];
+        
+    }];
+    
+    return changed;
+}
+
+@end
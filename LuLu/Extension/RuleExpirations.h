@@ -0,0 +1,51 @@
+//
+//  file: RuleExpirations.h
+//  project: LuLu (launch daemon)
+//  description: (min) heap of rules, by expiration (header)
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#ifndef RuleExpirations_h
+#define RuleExpirations_h
+
+@import OSLog;
+@import Foundation;
+
+@class Rule;
+
+//window (seconds) for batching expirations
+// rules expiring within this of the first due one, are expired with it (i.e. up to this early)
+#define RULE_EXPIRATION_WINDOW 1.0
+
+//rules, ordered by expiration
+// a (binary) min-heap, so the next expiration is O(1) and adds/removes are O(log n)
+// ...instead of a (pending) dispatch block per rule
+// note: not thread safe, caller (rules) should hold its lock
+@interface RuleExpirations : NSObject
+
+/* PROPERTIES */
+
+//number of rules
+@property(nonatomic, readonly)NSUInteger count;
+
+//next (earliest) expiration
+// nil if there are none
+@property(nonatomic, readonly)NSDate* next;
+
+/* METHODS */
+
+//add a rule
+// ignored if it has no expiration
+-(void)add:(Rule*)rule;
+
+//remove (and return) all rules that are due
+// i.e. that expire before 'now' (plus the batching window), earliest first
+-(NSArray<Rule*>*)due:(NSDate*)now;
+
+//remove all rules
+-(void)removeAllRules;
+
+@end
+
+#endif /* RuleExpirations_h */
@@ -0,0 +1,188 @@
+//
+//  file: RuleExpirations.m
+//  project: LuLu (launch daemon)
+//  description: (min) heap of rules, by expiration
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#import "Rule.h"
+#import "RuleExpirations.h"
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+@implementation RuleExpirations
+{
+    //heap
+    // rules, w/ (parallel) expiration times
+    NSMutableArray<Rule*>* rules;
+
+    //expiration times
+    // seconds since reference date, so comparisons don't (re)read dates
+    NSMutableData* times;
+}
+
+//init
+-(id)init
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //init
+        rules = [NSMutableArray array];
+        times = [NSMutableData data];
+    }
+
+    return self;
+}
+
+//number of rules
+-(NSUInteger)count
+{
+    return rules.count;
+}
+
+//next (earliest) expiration
+-(NSDate*)next
+{
+    //none?
+    if(0 == rules.count) return nil;
+
+    return [NSDate dateWithTimeIntervalSinceReferenceDate:((NSTimeInterval*)times.bytes)[0]];
+}
+
+//swap two heap entries
+-(void)swap:(NSUInteger)a with:(NSUInteger)b
+{
+    //times
+    NSTimeInterval* when = (NSTimeInterval*)times.mutableBytes;
+
+    //time
+    NSTimeInterval time = when[a];
+
+    //swap
+    when[a] = when[b];
+    when[b] = time;
+    [rules exchangeObjectAtIndex:a withObjectAtIndex:b];
+}
+
+//add a rule
+-(void)add:(Rule*)rule
+{
+    //index
+    NSUInteger index = 0;
+
+    //time
+    NSTimeInterval time = 0;
+
+    //times
+    NSTimeInterval* when = NULL;
+
+    //no expiration?
+    if(nil == rule.expiration) return;
+
+    //init
+    time = rule.expiration.timeIntervalSinceReferenceDate;
+
+    //append
+    [rules addObject:rule];
+    [times appendBytes:&time length:sizeof(time)];
+
+    //sift up
+    index = rules.count - 1;
+    when = (NSTimeInterval*)times.mutableBytes;
+    while( (0 != index) &&
+           (when[(index - 1) / 2] > when[index]) )
+    {
+        [self swap:index with:(index - 1) / 2];
+        index = (index - 1) / 2;
+    }
+
+    return;
+}
+
+//remove (earliest) rule
+-(Rule*)pop
+{
+    //rule
+    Rule* rule = nil;
+
+    //index
+    NSUInteger index = 0;
+
+    //last
+    NSUInteger last = 0;
+
+    //times
+    NSTimeInterval* when = NULL;
+
+    //none?
+    if(0 == rules.count) return nil;
+
+    //grab
+    rule = rules.firstObject;
+
+    //move last to top
+    last = rules.count - 1;
+    [self swap:0 with:last];
+    [rules removeLastObject];
+    times.length -= sizeof(NSTimeInterval);
+
+    //sift down
+    when = (NSTimeInterval*)times.mutableBytes;
+    while(YES)
+    {
+        //children
+        NSUInteger left = (2 * index) + 1;
+        NSUInteger right = left + 1;
+        NSUInteger smallest = index;
+
+        if( (left < last) && (when[left] < when[smallest]) ) smallest = left;
+        if( (right < last) && (when[right] < when[smallest]) ) smallest = right;
+
+        //done?
+        if(smallest == index) break;
+
+        //swap down
+        [self swap:index with:smallest];
+        index = smallest;
+    }
+
+    return rule;
+}
+
+//remove (and return) all rules that are due
+-(NSArray<Rule*>*)due:(NSDate*)now
+{
+    //due
+    NSMutableArray* due = nil;
+
+    //deadline
+    NSTimeInterval deadline = 0;
+
+    //init
+    due = [NSMutableArray array];
+    deadline = now.timeIntervalSinceReferenceDate + RULE_EXPIRATION_WINDOW;
+
+    //pop while due
+    while( (0 != rules.count) &&
+           (((NSTimeInterval*)times.bytes)[0] <= deadline) )
+    {
+        [due addObject:[self pop]];
+    }
+
+    return due;
+}
+
+//remove all rules
+-(void)removeAllRules
+{
+    [rules removeAllObjects];
+    times.length = 0;
+}
+
+@end
@@ -0,0 +1,121 @@
+//
+//  file: RuleIndex.h
+//  project: LuLu (launch daemon)
+//  description: immutable, precompiled index of rules (header)
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#ifndef RuleIndex_h
+#define RuleIndex_h
+
+@import OSLog;
+@import Foundation;
+
+@class Rule;
+@class AddressMatcher;
+@class EndpointMatcher;
+
+//rule match tiers
+// ordered by precedence, lowest first
+typedef NS_ENUM(NSInteger, RuleTier)
+{
+    RuleTierAny = 0,
+    RuleTierPartial,
+    RuleTierExact,
+    RuleTierCount
+};
+
+//socket family slots
+// as '0.0.0.0/0' & '::/0' are only 'any' for their own family
+typedef NS_ENUM(NSInteger, RuleFamily)
+{
+    RuleFamilyIPv4 = 0,
+    RuleFamilyIPv6,
+    RuleFamilyOther,
+    RuleFamilyCount
+};
+
+//map a socket family (AF_*) to a family slot
+RuleFamily ruleFamilyForSocketFamily(int socketFamily);
+
+//check if a rule's endpoint addr matches "any" for a socket family
+// either '*' or (IPv4) '0.0.0.0/0' or (IPv6) '::/0'
+BOOL ruleMatchesAnyEndpoint(Rule* rule, int socketFamily);
+
+
+/* RULE BUCKET */
+
+//set of (enabled) rules, pre-split by tier
+// arrays keep the insertion order of the rules, as the last match (within a tier) wins
+@interface RuleBucket : NSObject
+
+//all rules
+@property(nonatomic, retain, readonly)NSArray* rules;
+
+//matcher for all (enabled) regex/glob endpoint rules
+// nil if there are none
+@property(nonatomic, retain, readonly)EndpointMatcher* endpointMatcher;
+
+//interval index for all (enabled) CIDR/range endpoint rules
+// nil if there are none
+@property(nonatomic, retain, readonly)AddressMatcher* addressMatcher;
+
+//earliest expiration of any (enabled) rule
+// seconds since reference date (DBL_MAX if none); disabled rules never match, so are left to the expiration timer
+@property(nonatomic, readonly)NSTimeInterval expires;
+
+//init with rules
+-(id)init:(NSArray*)rules;
+
+//rules for a tier/family
+-(NSArray*)rules:(RuleTier)tier family:(RuleFamily)family;
+
+@end
+
+
+/* RULE INDEX */
+
+//immutable snapshot of all rules
+// built (under the rules lock) on any change, then published via an atomic pointer swap
+// as buckets are immutable, unchanged ones are shared with the previous snapshot
+@interface RuleIndex : NSObject
+
+//global ('*') rules
+@property(nonatomic, retain, readonly)RuleBucket* globalRules;
+
+//item rules
+// key: item key (signing id, or path)
+@property(nonatomic, retain, readonly)NSDictionary<NSString*, RuleBucket*>* itemRules;
+
+//directory rules
+// key: directory (with trailing '/')
+@property(nonatomic, retain, readonly)NSDictionary<NSString*, RuleBucket*>* directoryRules;
+
+//tree ('process + kids') rules
+// key: rule's path, with symlinks resolved
+@property(nonatomic, retain, readonly)NSDictionary<NSString*, RuleBucket*>* treeRules;
+
+//number of rules indexed
+@property(nonatomic, readonly)NSUInteger count;
+
+//earliest expiration of any indexed (enabled) rule
+// seconds since reference date (DBL_MAX if none), so lookups can check it once, instead of per rule
+@property(nonatomic, readonly)NSTimeInterval expires;
+
+//build index from rules dictionary
+// note: caller should hold the rules lock
+-(id)init:(NSDictionary*)rules;
+
+//build index from rules dictionary, and a previous index
+// only rebuilds the changed keys' buckets (and tree paths), all others are shared
+// note: caller should hold the rules lock; no previous index or changed keys, means a full build
+-(id)init:(NSDictionary*)rules previous:(RuleIndex*)previous changed:(NSSet<NSString*>*)keys;
+
+//all directory buckets that contain a path
+// ordered from the shallowest directory to the deepest
+-(NSArray<RuleBucket*>*)directoryRulesForPath:(NSString*)path;
+
+@end
+
+#endif /* RuleIndex_h */
@@ -0,0 +1,491 @@
+//
+//  file: RuleIndex.m
+//  project: LuLu (launch daemon)
+//  description: immutable, precompiled index of rules
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#import "Rule.h"
+#import "consts.h"
+#import "RuleIndex.h"
+#import "AddressMatcher.h"
+#import "EndpointMatcher.h"
+
+#import <float.h>
+#import <sys/socket.h>
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+//map a socket family (AF_*) to a family slot
+RuleFamily ruleFamilyForSocketFamily(int socketFamily)
+{
+    //IPv4
+    if(AF_INET == socketFamily) return RuleFamilyIPv4;
+
+    //IPv6
+    if(AF_INET6 == socketFamily) return RuleFamilyIPv6;
+
+    //other
+    return RuleFamilyOther;
+}
+
+//check if a rule's endpoint addr matches "any" for a socket family
+// either '*' or (IPv4) '0.0.0.0/0' or (IPv6) '::/0'
+BOOL ruleMatchesAnyEndpoint(Rule* rule, int socketFamily)
+{
+    //any '*'
+    if(YES == [rule.endpointAddr isEqualToString:VALUE_ANY]) return YES;
+
+    //IPv4 -> '0.0.0.0/0'
+    if( (AF_INET == socketFamily) &&
+        (YES == [rule.endpointAddr isEqualToString:@"0.0.0.0/0"]) ) return YES;
+
+    //IPv6 -> '::/0'
+    if( (AF_INET6 == socketFamily) &&
+        (YES == [rule.endpointAddr isEqualToString:@"::/0"]) ) return YES;
+
+    return NO;
+}
+
+//representative socket family for each family slot
+static const int familySlots[RuleFamilyCount] = {AF_INET, AF_INET6, AF_UNSPEC};
+
+@implementation RuleBucket
+{
+    //rules by family, then tier
+    // i.e. tiers[family][tier]
+    NSArray* tiers;
+}
+
+@synthesize rules;
+@synthesize expires;
+@synthesize addressMatcher;
+@synthesize endpointMatcher;
+
+//init with rules
+// split (enabled) rules into any/partial/exact, for each family
+-(id)init:(NSArray*)itemRules
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //per family tiers
+        NSMutableArray* familyTiers = [NSMutableArray array];
+
+        //(immutable) copy
+        rules = [itemRules copy];
+
+        //init earliest expiration
+        // 'never', unless a rule has one
+        expires = DBL_MAX;
+
+        //track earliest expiration
+        // of enabled rules only, as disabled ones never match
+        for(Rule* rule in rules)
+        {
+            if( (0 == rule.isDisabled.intValue) &&
+                (nil != rule.expiration) ) expires = MIN(expires, rule.expiration.timeIntervalSinceReferenceDate);
+        }
+
+        //build tiers for each family
+        for(NSInteger family = 0; family < RuleFamilyCount; family++)
+        {
+            //tiers
+            NSArray* buckets = @[[NSMutableArray array], [NSMutableArray array], [NSMutableArray array]];
+
+            //classify each rule
+            for(Rule* rule in rules)
+            {
+                //flags
+                BOOL portAny = NO;
+                BOOL endpointAny = NO;
+
+                //skip disabled rules
+                if(0 != rule.isDisabled.intValue) continue;
+
+                //set flag: any port ('*')
+                portAny = [rule.endpointPort isEqualToString:VALUE_ANY];
+
+                //set flag: any endpoint ('*', '0.0.0.0/0', or '::/0')
+                endpointAny = ruleMatchesAnyEndpoint(rule, familySlots[family]);
+
+                //any addr and any port
+                if( (YES == portAny) && (YES == endpointAny) )
+                {
+                    [buckets[RuleTierAny] addObject:rule];
+                }
+                //any addr or any port
+                else if( (YES == portAny) || (YES == endpointAny) )
+                {
+                    [buckets[RuleTierPartial] addObject:rule];
+                }
+                //both set
+                else
+                {
+                    [buckets[RuleTierExact] addObject:rule];
+                }
+            }
+
+            //add
+            [familyTiers addObject:buckets];
+        }
+
+        //save
+        tiers = [familyTiers copy];
+        
+        //enabled rules
+        NSArray* enabled = [rules filteredArrayUsingPredicate:[NSPredicate predicateWithBlock:^BOOL(Rule* rule, NSDictionary* bindings) {
+            return (0 == rule.isDisabled.intValue);
+        }]];
+        
+        //compile (enabled) regex/glob rules into a single matcher
+        endpointMatcher = [[EndpointMatcher alloc] init:enabled];
+        
+        //index (enabled) CIDR/range rules
+        addressMatcher = [[AddressMatcher alloc] init:enabled];
+    }
+
+    return self;
+}
+
+//rules for a tier/family
+-(NSArray*)rules:(RuleTier)tier family:(RuleFamily)family
+{
+    return tiers[family][tier];
+}
+
+@end
+
+@implementation RuleIndex
+{
+    //keys with tree rules
+    // key: resolved path, value: item keys (so a key's change only rebuilds its paths)
+    NSDictionary<NSString*, NSSet<NSString*>*>* treeKeys;
+}
+
+@synthesize count;
+@synthesize expires;
+@synthesize treeRules;
+@synthesize itemRules;
+@synthesize globalRules;
+@synthesize directoryRules;
+
+//build index from rules dictionary
+// note: caller should hold the rules lock
+-(id)init:(NSDictionary*)rules
+{
+    return [self init:rules previous:nil changed:nil];
+}
+
+//build index from rules dictionary, and a previous index
+// copy previous (immutable) buckets, then rebuild only the changed keys' buckets and tree paths
+// note: caller should hold the rules lock; no previous index or changed keys, means a full build
+-(id)init:(NSDictionary*)rules previous:(RuleIndex*)previous changed:(NSSet<NSString*>*)keys
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //item buckets
+        NSMutableDictionary* items = nil;
+
+        //directory buckets
+        NSMutableDictionary* directories = nil;
+
+        //tree buckets
+        // key: resolved path
+        NSMutableDictionary* trees = nil;
+
+        //keys with tree rules
+        // key: resolved path
+        NSMutableDictionary* paths = nil;
+
+        //changed keys with tree rules
+        // key: resolved path
+        NSMutableDictionary* changedPaths = nil;
+
+        //flag
+        // set if a removed bucket held the earliest expiration
+        BOOL rescan = NO;
+
+        //init
+        changedPaths = [NSMutableDictionary dictionary];
+
+        //no previous index, or unknown changes?
+        // (re)build all keys, from scratch
+        if( (nil == previous) ||
+            (nil == keys) )
+        {
+            //no previous
+            previous = nil;
+
+            //all keys
+            keys = [NSSet setWithArray:rules.allKeys];
+
+            //init
+            items = [NSMutableDictionary dictionary];
+            directories = [NSMutableDictionary dictionary];
+            trees = [NSMutableDictionary dictionary];
+            paths = [NSMutableDictionary dictionary];
+
+            //init earliest expiration
+            // 'never', unless a rule has one
+            expires = DBL_MAX;
+        }
+
+        //start from previous
+        // buckets are immutable, so can be shared
+        else
+        {
+            //copy
+            items = [previous.itemRules mutableCopy];
+            directories = [previous.directoryRules mutableCopy];
+            trees = [previous.treeRules mutableCopy];
+            paths = [previous->treeKeys mutableCopy];
+
+            //copy
+            globalRules = previous.globalRules;
+            count = previous.count;
+            expires = previous.expires;
+        }
+
+        //process each (changed) key
+        for(NSString* key in keys)
+        {
+            //previous bucket
+            RuleBucket* bucket = nil;
+
+            //item rules
+            NSArray* keyRules = rules[key][KEY_RULES];
+
+            //directory
+            // key, minus the trailing '*'
+            NSString* directory = (0 != key.length) ? [key substringToIndex:(key.length-1)] : key;
+
+            //remove previous bucket
+            if(nil != previous)
+            {
+                //global rules
+                if(YES == [key isEqualToString:VALUE_ANY])
+                {
+                    bucket = globalRules;
+                    globalRules = nil;
+                }
+
+                //directory rules (for this key)?
+                else if(YES == [((Rule*)((RuleBucket*)directories[directory]).rules.firstObject).key isEqualToString:key])
+                {
+                    bucket = directories[directory];
+                    [directories removeObjectForKey:directory];
+                }
+
+                //item rules
+                else
+                {
+                    bucket = items[key];
+                    [items removeObjectForKey:key];
+                }
+
+                //dec
+                count -= bucket.rules.count;
+
+                //held earliest expiration?
+                // will have to check all (remaining) buckets
+                if( (nil != bucket) &&
+                    (DBL_MAX != bucket.expires) &&
+                    (bucket.expires <= expires) ) rescan = YES;
+
+                //tree paths of previous rules
+                // note: rules are toggled in place, so don't skip disabled ones here
+                for(Rule* rule in bucket.rules)
+                {
+                    //skip non-tree rules
+                    if(ACTION_SCOPE_PROCESS_TREE != rule.scope.intValue) continue;
+
+                    //skip unresolved
+                    if(0 == rule.canonicalPath.length) continue;
+
+                    //changed
+                    if(nil == changedPaths[rule.canonicalPath]) changedPaths[rule.canonicalPath] = [NSMutableSet set];
+                }
+            }
+
+            //no rules?
+            if(0 == keyRules.count) continue;
+
+            //inc
+            count += keyRules.count;
+
+            //global rules
+            if(YES == [key isEqualToString:VALUE_ANY])
+            {
+                bucket = [[RuleBucket alloc] init:keyRules];
+                globalRules = bucket;
+            }
+
+            //directory rule?
+            // grab first/any rule and check, then key by directory (by removing *)
+            else if(YES == ((Rule*)keyRules.firstObject).isDirectory.boolValue)
+            {
+                bucket = [[RuleBucket alloc] init:keyRules];
+                directories[directory] = bucket;
+            }
+
+            //item rules
+            else
+            {
+                bucket = [[RuleBucket alloc] init:keyRules];
+                items[key] = bucket;
+            }
+
+            //track earliest expiration
+            expires = MIN(expires, bucket.expires);
+
+            //collect tree ('process + kids') paths
+            // keyed by canonical path, as rule paths (via flow) and ancestor paths (via 'proc_pidpath') can differ
+            // note: resolved (& cached) once per rule, not on every reindex
+            for(Rule* rule in keyRules)
+            {
+                //skip non-tree rules
+                if(ACTION_SCOPE_PROCESS_TREE != rule.scope.intValue) continue;
+
+                //skip unresolved
+                if(0 == rule.canonicalPath.length) continue;
+
+                //first?
+                if(nil == changedPaths[rule.canonicalPath]) changedPaths[rule.canonicalPath] = [NSMutableSet set];
+
+                //add
+                [changedPaths[rule.canonicalPath] addObject:key];
+            }
+        }
+
+        //(re)build changed tree paths
+        // from all keys with rules for that path: unchanged ones, and (now) changed ones
+        for(NSString* path in changedPaths)
+        {
+            //keys
+            NSMutableSet* pathKeys = nil;
+
+            //tree rules
+            NSMutableArray* pathRules = nil;
+
+            //init w/ unchanged keys
+            pathKeys = [NSMutableSet setWithSet:(paths[path] ?: [NSSet set])];
+            [pathKeys minusSet:keys];
+
+            //add changed keys
+            [pathKeys unionSet:changedPaths[path]];
+
+            //init
+            pathRules = [NSMutableArray array];
+
+            //collect (enabled) tree rules for path
+            for(NSString* key in pathKeys)
+            {
+                for(Rule* rule in rules[key][KEY_RULES])
+                {
+                    //skip non-tree rules
+                    if(ACTION_SCOPE_PROCESS_TREE != rule.scope.intValue) continue;
+
+                    //skip disabled
+                    if(0 != rule.isDisabled.intValue) continue;
+
+                    //skip other paths
+                    if(YES != [rule.canonicalPath isEqualToString:path]) continue;
+
+                    //add
+                    [pathRules addObject:rule];
+                }
+            }
+
+            //save keys
+            // or remove, if none are left
+            if(0 != pathKeys.count) paths[path] = [pathKeys copy];
+            else [paths removeObjectForKey:path];
+
+            //save bucket
+            // or remove, if no (enabled) rules are left
+            if(0 != pathRules.count) trees[path] = [[RuleBucket alloc] init:pathRules];
+            else [trees removeObjectForKey:path];
+        }
+
+        //(re)scan for earliest expiration?
+        // only needed if a removed bucket held it
+        if(YES == rescan)
+        {
+            //init
+            expires = (nil != globalRules) ? globalRules.expires : DBL_MAX;
+
+            //items
+            for(RuleBucket* bucket in items.objectEnumerator)
+            {
+                expires = MIN(expires, bucket.expires);
+            }
+
+            //directories
+            for(RuleBucket* bucket in directories.objectEnumerator)
+            {
+                expires = MIN(expires, bucket.expires);
+            }
+        }
+
+        //save
+        itemRules = [items copy];
+        directoryRules = [directories copy];
+        treeRules = [trees copy];
+        treeKeys = [paths copy];
+
+        //dbg msg
+        os_log_debug(logHandle, "indexed %lu rules (changed keys: %lu, items: %lu, directories: %lu, tree paths: %lu)", (unsigned long)count, (unsigned long)keys.count, (unsigned long)itemRules.count, (unsigned long)directoryRules.count, (unsigned long)treeRules.count);
+    }
+
+    return self;
+}
+
+//all directory buckets that contain a path
+// walk path components, looking up each parent directory (w/ trailing '/')
+-(NSArray<RuleBucket*>*)directoryRulesForPath:(NSString*)path
+{
+    //buckets
+    NSMutableArray* buckets = nil;
+
+    //range of next '/'
+    NSRange range = {0};
+
+    //no directory rules?
+    if(0 == self.directoryRules.count) return nil;
+
+    //init
+    buckets = [NSMutableArray array];
+
+    //init range
+    range = NSMakeRange(0, path.length);
+
+    //check each parent directory
+    while(YES)
+    {
+        //bucket
+        RuleBucket* bucket = nil;
+
+        //find next '/'
+        NSRange slash = [path rangeOfString:@"/" options:NSLiteralSearch range:range];
+        if(NSNotFound == slash.location) break;
+
+        //lookup directory
+        bucket = self.directoryRules[[path substringToIndex:NSMaxRange(slash)]];
+        if(nil != bucket) [buckets addObject:bucket];
+
+        //advance
+        range = NSMakeRange(NSMaxRange(slash), path.length - NSMaxRange(slash));
+    }
+
+    return buckets;
+}
+
+@end
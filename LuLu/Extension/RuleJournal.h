@@ -0,0 +1,56 @@
+//
+//  file: RuleJournal.h
+//  project: LuLu (launch daemon)
+//  description: append-only journal of rule changes (header)
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#ifndef RuleJournal_h
+#define RuleJournal_h
+
+@import OSLog;
+@import Foundation;
+
+//journal magic ('LUJR')
+#define RULE_JOURNAL_MAGIC 0x524A554C
+
+//journal version
+#define RULE_JOURNAL_VERSION 1
+
+//append-only journal
+// each record is a (secure coded) dictionary, framed as: length, checksum, payload
+// a torn/corrupt tail (e.g. crash mid-append) is detected on replay, and truncated
+@interface RuleJournal : NSObject
+
+/* PROPERTIES */
+
+//path
+@property(nonatomic, retain, readonly)NSString* path;
+
+//number of records
+@property(nonatomic, readonly)NSUInteger count;
+
+//size (bytes)
+@property(nonatomic, readonly)unsigned long long size;
+
+/* METHODS */
+
+//init w/ path
+// note: call 'replay:' before appending, to validate (and if needed, repair) the journal
+-(id)init:(NSString*)path;
+
+//replay
+// returns all (valid) records, truncating anything after the last valid one
+-(NSArray<NSDictionary*>*)replay:(NSSet*)classes;
+
+//append a record
+-(BOOL)append:(NSDictionary*)record;
+
+//reset
+// i.e. once all records are in a snapshot
+-(BOOL)reset;
+
+@end
+
+#endif /* RuleJournal_h */
@@ -0,0 +1,354 @@
+//
+//  file: RuleJournal.m
+//  project: LuLu (launch daemon)
+//  description: append-only journal of rule changes
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#import "RuleJournal.h"
+
+#import <fcntl.h>
+#import <unistd.h>
+#import <sys/stat.h>
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+//journal header
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    
+} RuleJournalHeader;
+
+//record header
+typedef struct
+{
+    uint32_t length;
+    uint32_t checksum;
+    
+} RuleJournalRecord;
+
+//max record size
+// anything larger is treated as corruption
+#define RULE_JOURNAL_MAX_RECORD (1024 * 1024)
+
+//FNV-1a
+static uint32_t checksum(const uint8_t* bytes, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for(size_t i = 0; i < length; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+@implementation RuleJournal
+{
+    //file descriptor
+    int fd;
+}
+
+@synthesize path;
+@synthesize size;
+@synthesize count;
+
+//init w/ path
+-(id)init:(NSString*)journalPath
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //save
+        path = journalPath;
+        
+        //init
+        fd = -1;
+    }
+    
+    return self;
+}
+
+//dealloc
+-(void)dealloc
+{
+    //close
+    if(-1 != fd) close(fd);
+}
+
+//(re)open
+// creating w/ header if needed
+// note: caller should hold lock
+-(BOOL)open
+{
+    //header
+    RuleJournalHeader header = {RULE_JOURNAL_MAGIC, RULE_JOURNAL_VERSION};
+    
+    //stat
+    struct stat info = {0};
+    
+    //already open?
+    if(-1 != fd) return YES;
+    
+    //open
+    fd = open(path.fileSystemRepresentation, O_RDWR|O_CREAT|O_APPEND|O_CLOEXEC, S_IRUSR|S_IWUSR);
+    if(-1 == fd)
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to open rule journal %{public}@ (error: %d)", path, errno);
+        return NO;
+    }
+    
+    //new?
+    // write header
+    if( (0 == fstat(fd, &info)) &&
+        (0 == info.st_size) )
+    {
+        if(sizeof(header) != write(fd, &header, sizeof(header)))
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: failed to write rule journal header (error: %d)", errno);
+            
+            close(fd);
+            fd = -1;
+            return NO;
+        }
+        info.st_size = sizeof(header);
+    }
+    
+    //save size
+    size = info.st_size;
+    
+    return YES;
+}
+
+//replay
+-(NSArray<NSDictionary*>*)replay:(NSSet*)classes
+{
+    //records
+    NSMutableArray* records = nil;
+    
+    //data
+    NSData* data = nil;
+    
+    //offset
+    // of end of last valid record
+    NSUInteger offset = 0;
+    
+    //header
+    const RuleJournalHeader* header = NULL;
+    
+    //init
+    records = [NSMutableArray array];
+    
+    //sync
+    @synchronized(self) {
+        
+    //(re)open
+    if(-1 != fd)
+    {
+        close(fd);
+        fd = -1;
+    }
+    if(YES != [self open]) goto bail;
+    
+    //read
+    data = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:nil];
+    
+    //check header
+    // unknown/corrupt? start over
+    header = (const RuleJournalHeader*)data.bytes;
+    if( (data.length < sizeof(RuleJournalHeader)) ||
+        (RULE_JOURNAL_MAGIC != header->magic) ||
+        (RULE_JOURNAL_VERSION != header->version) )
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: rule journal %{public}@ has an invalid header, resetting", path);
+        
+        //reset
+        [self truncate:0];
+        close(fd);
+        fd = -1;
+        [self open];
+        
+        //no records
+        count = 0;
+        
+        goto bail;
+    }
+    
+    //parse records
+    offset = sizeof(RuleJournalHeader);
+    while(offset + sizeof(RuleJournalRecord) <= data.length)
+    {
+        //record
+        RuleJournalRecord record = {0};
+        
+        //payload
+        NSData* payload = nil;
+        
+        //entry
+        NSDictionary* entry = nil;
+        
+        //read header
+        memcpy(&record, (const uint8_t*)data.bytes + offset, sizeof(record));
+        
+        //torn/corrupt?
+        if( (0 == record.length) ||
+            (record.length > RULE_JOURNAL_MAX_RECORD) ||
+            (offset + sizeof(record) + record.length > data.length) ||
+            (record.checksum != checksum((const uint8_t*)data.bytes + offset + sizeof(record), record.length)) )
+        {
+            break;
+        }
+        
+        //decode
+        payload = [data subdataWithRange:NSMakeRange(offset + sizeof(record), record.length)];
+        entry = [NSKeyedUnarchiver unarchivedObjectOfClasses:classes fromData:payload error:nil];
+        if(YES != [entry isKindOfClass:[NSDictionary class]]) break;
+        
+        //save
+        [records addObject:entry];
+        
+        //next
+        offset += sizeof(record) + record.length;
+    }
+    
+    //torn tail?
+    // truncate, so new records are appended after last valid one
+    if(offset != data.length)
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: rule journal %{public}@ has an invalid tail (%lu bytes), truncating", path, (unsigned long)(data.length - offset));
+        
+        //truncate
+        [self truncate:offset];
+    }
+    
+    //save
+    count = records.count;
+    size = offset;
+    
+    //dbg msg
+    os_log_debug(logHandle, "replayed %lu records from rule journal %{public}@", (unsigned long)records.count, path);
+        
+    } //sync
+    
+bail:
+    
+    return records;
+}
+
+//truncate
+// note: caller should hold lock
+-(BOOL)truncate:(unsigned long long)length
+{
+    //truncate
+    if(0 != ftruncate(fd, (off_t)length))
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to truncate rule journal (error: %d)", errno);
+        return NO;
+    }
+    
+    //update
+    size = length;
+    
+    return YES;
+}
+
+//append a record
+-(BOOL)append:(NSDictionary*)record
+{
+    //result
+    BOOL appended = NO;
+    
+    //payload
+    NSData* payload = nil;
+    
+    //buffer
+    NSMutableData* buffer = nil;
+    
+    //record header
+    RuleJournalRecord header = {0};
+    
+    //error
+    NSError* error = nil;
+    
+    //serialize
+    payload = [NSKeyedArchiver archivedDataWithRootObject:record requiringSecureCoding:YES error:&error];
+    if( (nil == payload) ||
+        (payload.length > RULE_JOURNAL_MAX_RECORD) )
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to serialize rule journal record (error: %{public}@)", error);
+        return NO;
+    }
+    
+    //init header
+    header.length = (uint32_t)payload.length;
+    header.checksum = checksum(payload.bytes, payload.length);
+    
+    //build record
+    // single write, so it's appended in one go
+    buffer = [NSMutableData dataWithBytes:&header length:sizeof(header)];
+    [buffer appendData:payload];
+    
+    //sync
+    @synchronized(self) {
+        
+        //open
+        if(YES != [self open]) goto bail;
+        
+        //write
+        if(buffer.length != write(fd, buffer.bytes, buffer.length))
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: failed to append to rule journal (error: %d)", errno);
+            
+            //undo any partial write
+            [self truncate:size];
+            
+            goto bail;
+        }
+        
+        //update
+        size += buffer.length;
+        count++;
+        
+        //happy
+        appended = YES;
+    }
+    
+bail:
+    
+    return appended;
+}
+
+//reset
+-(BOOL)reset
+{
+    //sync
+    @synchronized(self) {
+        
+        //open
+        if(YES != [self open]) return NO;
+        
+        //truncate to just header
+        if(YES != [self truncate:sizeof(RuleJournalHeader)]) return NO;
+        
+        //reset
+        count = 0;
+    }
+    
+    return YES;
+}
+
+@end
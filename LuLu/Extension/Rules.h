@@ -12,6 +12,10 @@
 #define Rules_h
 
 #import "Process.h"
+#import "RuleIndex.h"
+#import "RuleChanges.h"
+#import "RuleJournal.h"
+#import "FlowMatchContext.h"
 #import "XPCUserClient.h"
 
 @import OSLog;
@@ -19,6 +23,7 @@
 @import NetworkExtension;
 
 @class Rule;
+@class ProfileSnapshot;
 
 
 @interface Rules : NSObject
@@ -31,9 +36,21 @@
 //rules
 @property(nonatomic, retain)NSMutableDictionary* rules;
 
+//compiled (immutable) index of rules
+// rebuilt on any change, and swapped atomically so lookups don't need the lock
+@property(atomic, retain)RuleIndex* compiledRules;
+
 //xpc client for talking to login item
 @property(nonatomic, retain)XPCUserClient* xpcUserClient;
 
+//log of changed items
+// lets clients sync just what changed
+@property(nonatomic, retain)RuleChanges* changes;
+
+//journal of changes (since last save)
+// opened (and replayed) on load, reset on each (full) save
+@property(nonatomic, retain)RuleJournal* journal;
+
 /* METHODS */
 
 //prepare
@@ -42,16 +59,34 @@
 -(BOOL)prepare;
 
 //load from disk
+// i.e. compile, then activate
 -(BOOL)load;
 
+//compile rules (file)
+// unarchived, journal replayed, & indexed, w/o the lock, so can be done ahead of time (e.g. for a profile)
+-(ProfileSnapshot*)compile:(NSString*)rulesFile;
+
+//activate (compiled) rules
+// swapped in under the lock (index via one atomic pointer swap), then any expired rules are deleted
+-(void)activate:(ProfileSnapshot*)snapshot;
+
 //generate default rules
--(BOOL)generateDefaultRules;
+// into rules that aren't (yet) active, e.g. first run's or a new profile's
+-(BOOL)generateDefaultRules:(NSMutableDictionary*)items;
 
 //add a rule
 -(BOOL)add:(Rule*)rule save:(BOOL)save;
 
+//(re)build compiled rule index
+-(void)reindex;
+
+//(re)build compiled rule index, for changed keys
+// other keys' (immutable) buckets are reused from the current index
+-(void)reindex:(NSSet<NSString*>*)keys;
+
 //find (matching) rule
--(Rule*)find:(Process*)process flow:(NEFilterSocketFlow*)flow;
+// flow is passed via its (per-flow) match context
+-(Rule*)find:(Process*)process context:(FlowMatchContext*)context;
 
 //disable (or re-enable)
 -(BOOL)toggleRule:(NSString*)key rule:(NSString*)uuid state:(NSNumber*)state;
@@ -60,9 +95,19 @@
 -(BOOL)delete:(NSString*)key rule:(NSString*)uuid;
 
 //save
+// into the file the (live) rules were loaded from
 -(BOOL)save;
 
+//save rules to a file
+// e.g. a new profile's (not yet active) default rules
+-(BOOL)save:(NSDictionary*)items to:(NSString*)rulesFile;
+
+//changes since a generation
+// either changed (and removed) items, or if that's unknown, all rules
+-(NSDictionary*)changesSince:(unsigned long long)generation;
+
 //import rules
+// built (& indexed) w/o the lock, then swapped in & saved once
 -(BOOL)import:(NSData*)rules userOnly:(BOOL)userOnly;
 
 //number of rules for a given key
@@ -71,8 +116,18 @@
 //add an (external) path to an item's paths
 -(void)addPath:(NSString*)path forKey:(NSString*)key;
 
+//delete all expired rules
+// in one batch (one save, one notification), returns number of rules deleted
+// invoked by (the one) expiration timer, but 'now' can be passed in (e.g. tests w/ a virtual clock)
+-(NSUInteger)expire:(NSDate*)now;
+
+//remove a process' (temporary) rules
+// invoked once the process exits, returns number of rules removed
+-(NSUInteger)removeProcessRules:(pid_t)pid;
+
 //cleanup rules
--(NSUInteger)cleanup:(BOOL)full;
+// returns report: number of deleted rules, paths checked, & timings (see KEY_CLEANUP_*)
+-(NSDictionary*)cleanup:(BOOL)full;
 
 @end
 
@@ -12,8 +12,19 @@
 #import "Alerts.h"
 #import "consts.h"
 #import "Process.h"
+#import "RuleIndex.h"
 #import "utilities.h"
 #import "Preferences.h"
+#import "ExitMonitor.h"
+#import "PathChecker.h"
+#import "VerdictCache.h"
+#import "ProfileSnapshot.h"
+#import "AddressMatcher.h"
+#import "EndpointMatcher.h"
+#import "RuleExpirations.h"
+
+#import <stdatomic.h>
+#import <bsm/libbsm.h>
 
 //default systems 'allow' rules
 NSString* const DEFAULT_RULES[] =
@@ -52,9 +63,45 @@ extern Alerts* alerts;
 //prefs obj
 extern Preferences* preferences;
 
+//verdict cache
+extern VerdictCache* verdictCache;
+
+//exit monitor
+extern ExitMonitor* exitMonitor;
+
 @implementation Rules
+{
+    //process (temporary) rules
+    // key: pid, so they can be removed as soon as their process exits
+    NSMutableDictionary<NSNumber*, NSMutableArray<Rule*>*>* processRules;
+    
+    //(exit) watches of process rules' processes
+    // key: pid, so they can be stopped if rules are swapped out (e.g. profile switch)
+    NSMutableDictionary<NSNumber*, id>* processWatches;
+    
+    //rules w/ an expiration
+    // ordered, so one timer (for the next one) covers all
+    RuleExpirations* expirations;
+    
+    //expiration timer
+    // (re)armed for the next expiration
+    dispatch_source_t expirationTimer;
+    
+    //queue for (background) compaction of journal
+    dispatch_queue_t compactionQueue;
+    
+    //compaction scheduled?
+    BOOL compactionPending;
+    
+    //expiration scheduled?
+    // set (w/o the lock) by lookups that see an expired rule
+    atomic_bool expirationPending;
+}
 
 @synthesize rules;
+@synthesize changes;
+@synthesize journal;
+@synthesize compiledRules;
 @synthesize xpcUserClient;
 
 //init method
@@ -67,8 +114,34 @@ extern Preferences* preferences;
         //alloc rules dictionary
         rules = [NSMutableDictionary dictionary];
         
+        //init (empty) index
+        compiledRules = [[RuleIndex alloc] init:rules];
+        
+        //init change log
+        changes = [[RuleChanges alloc] init];
+        
+        //init process rules
+        processRules = [NSMutableDictionary dictionary];
+        processWatches = [NSMutableDictionary dictionary];
+        
+        //init expirations
+        expirations = [[RuleExpirations alloc] init];
+        
+        //init expiration timer
+        // on main queue (as before), armed once there's a rule w/ an expiration
+        __weak typeof(self) weakSelf = self;
+        expirationTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, dispatch_get_main_queue());
+        dispatch_source_set_timer(expirationTimer, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+        dispatch_source_set_event_handler(expirationTimer, ^{
+            [weakSelf expire:[NSDate date]];
+        });
+        dispatch_resume(expirationTimer);
+        
         //init XPC client
         xpcUserClient = [[XPCUserClient alloc] init];
+        
+        //init compaction queue
+        compactionQueue = dispatch_queue_create("com.objective-see.lulu.rules.compaction", DISPATCH_QUEUE_SERIAL);
     }
     
     return self;
@@ -91,6 +164,9 @@ extern Preferences* preferences;
     //rule's file
     NSString* rulesFile = nil;
     
+    //default rules
+    NSMutableDictionary* defaultRules = nil;
+    
     //init path to old rule's file
     rulesFile_V1 = [INSTALL_DIRECTORY stringByAppendingPathComponent:RULES_FILE_V1];
     
@@ -131,8 +207,11 @@ extern Preferences* preferences;
         //dbg msg
         os_log_debug(logHandle, "no rules found");
         
+        //init
+        defaultRules = [NSMutableDictionary dictionary];
+        
         //generate
-        if(YES != [self generateDefaultRules])
+        if(YES != [self generateDefaultRules:defaultRules])
         {
             //err msg
             os_log_error(logHandle, "ERROR: failed to generate default rules");
@@ -142,7 +221,8 @@ extern Preferences* preferences;
         }
         
         //save (generated rules)
-        if(YES != [self save])
+        // note: not (yet) active, they're loaded along w/ the rest, once prepared
+        if(YES != [self save:defaultRules to:rulesFile])
         {
             //err msg
             os_log_error(logHandle, "ERROR: failed to save (generated) rules");
@@ -291,7 +371,7 @@ bail:
     NSError* error = nil;
 
     //unarchive
-    rules = [NSKeyedUnarchiver unarchivedObjectOfClasses:[NSSet setWithArray:@[[NSDictionary class], [NSArray class], [NSString class], [NSNumber class], [NSMutableSet class], [NSDate class], [Rule class]]] fromData:data error:&error];
+    rules = [NSKeyedUnarchiver unarchivedObjectOfClasses:[self archivedClasses] fromData:data error:&error];
     if(nil == rules)
     {
         //err msg
@@ -301,35 +381,75 @@ bail:
     return rules;
 }
 
+//classes allowed in archived rules (and journal records)
+-(NSSet*)archivedClasses
+{
+    return [NSSet setWithArray:@[[NSDictionary class], [NSArray class], [NSString class], [NSNumber class], [NSMutableSet class], [NSDate class], [Rule class]]];
+}
+
 //load rules from disk
 // either default location, or from current profile
+// compiled w/o the lock, then activated (swapped in), so concurrent rule lookups aren't stalled
 -(BOOL)load
 {
     //result
     BOOL result = NO;
     
+    //compiled rules
+    ProfileSnapshot* snapshot = nil;
     
-    //rule's file
-    NSString* rulesFile = nil;
+    //compile
+    snapshot = [self compile:[self getPath]];
+    if(nil == snapshot)
+    {
+        //bail
+        goto bail;
+    }
+    
+    //activate
+    [self activate:snapshot];
+    
+    //happy
+    result = YES;
+    
+bail:
+    
+    return result;
+}
+
+//compile rules (file)
+// unarchive, replay its journal, & build its index & expirations
+// nothing here is active (yet), so no lock is needed, and it can be done ahead of time (e.g. for a profile)
+-(ProfileSnapshot*)compile:(NSString*)rulesFile
+{
+    //snapshot
+    ProfileSnapshot* snapshot = nil;
     
     //archived rules
     NSData* archivedRules = nil;
     
-    //item rules
-    NSArray* itemRules = nil;
-
-    //expired rules
-    NSMutableArray* expiredRules = nil;
-
-    //interval for expirations
-    NSTimeInterval timeInterval = 0;
+    //rules
+    NSMutableDictionary* items = nil;
+    
+    //journal
+    RuleJournal* ruleJournal = nil;
     
-    //init path
-    rulesFile = [self getPath];
+    //expirations
+    RuleExpirations* ruleExpirations = nil;
+    
+    //start
+    NSDate* start = nil;
     
     //dbg msg
     os_log_debug(logHandle, "loading rules from: %{public}@", rulesFile);
     
+    //init
+    start = [NSDate date];
+    
+    //init snapshot
+    // first, as it records the state of the (profile's) files
+    snapshot = [[ProfileSnapshot alloc] init:[rulesFile stringByDeletingLastPathComponent]];
+    
     //(now) load archived rules from disk
     archivedRules = [NSData dataWithContentsOfFile:rulesFile];
     if(nil == archivedRules)
@@ -341,25 +461,20 @@ bail:
         goto bail;
     }
     
-    //unarchive & process rules under lock
-    // load reassigns self.rules at runtime (e.g. profile switch), so must exclude concurrent rule lookups
-    @synchronized(self)
-    {
-
     //unarchive
-    self.rules = [self unarchiveRulesData:archivedRules];
-    if(nil == self.rules)
+    items = [self unarchiveRulesData:archivedRules];
+    if(YES != [items isKindOfClass:[NSMutableDictionary class]])
     {
         //err msg
-        os_log_error(logHandle, "ERROR: failed to unarchive rules from %{public}@", RULES_FILE);
-
+        os_log_error(logHandle, "ERROR: failed to unarchive rules from %{public}@", rulesFile);
+        
         //bail
         goto bail;
     }
     
     //make sure all item rules have a set for 'external' paths
     // older rules didn't use this, so let's make do it here manually
-    for(NSString* key in self.rules)
+    for(NSString* key in items)
     {
         //skip global rules
         if(YES == [key isEqualToString:VALUE_ANY])
@@ -369,102 +484,112 @@ bail:
         
         //skip directory rules
         // grab first/any rule and check
-        if(YES == ((Rule*)[self.rules[key][KEY_RULES] firstObject]).isDirectory.boolValue)
+        if(YES == ((Rule*)[items[key][KEY_RULES] firstObject]).isDirectory.boolValue)
         {
             continue;
         }
         
         //paths set nil?
         // alloc for paths
-        if(nil == self.rules[key][KEY_PATHS])
+        if(nil == items[key][KEY_PATHS])
         {
             //alloc
-            self.rules[key][KEY_PATHS] = [NSMutableSet set];
+            items[key][KEY_PATHS] = [NSMutableSet set];
         }
     }
     
-    //init list for expired rules
-    expiredRules = [NSMutableArray array];
-
-    //setup deletion for any rules that have an expiration
-    // note: can't delete mid-enumeration, so expired ones are collected, then deleted below
-    for(NSString* key in self.rules)
+    //open journal
+    // and replay any changes made since the rules were last saved
+    ruleJournal = [[RuleJournal alloc] init:[rulesFile stringByAppendingString:RULES_JOURNAL_SUFFIX]];
+    [self replay:[ruleJournal replay:[self archivedClasses]] in:items];
+    
+    //track rules that have an expiration
+    // note: any already expired ones are deleted (in one batch) once activated
+    ruleExpirations = [[RuleExpirations alloc] init];
+    for(NSString* key in items)
     {
-        //item rules
-        itemRules = self.rules[key][KEY_RULES];
-        
-        //check each
-        for(Rule* rule in itemRules)
+        for(Rule* rule in items[key][KEY_RULES])
         {
-            //skip
-            if(nil == rule.expiration)
-            {
-                continue;
-            }
-            
-            //dbg msg
-            os_log_debug(logHandle, "loaded rule has an expiration date set: %{public}@", rule.expiration);
-            
-            //interval
-            timeInterval = [rule.expiration timeIntervalSinceNow];
-            
-            //already expired?
-            // save, so can be deleted (below, once enumeration is done)
-            if(timeInterval <= 0)
-            {
-                //save
-                [expiredRules addObject:rule];
-            }
-            
-            //setup dispatch to delete
-            else
-            {
-                //dbg msg
-                os_log_debug(logHandle, "setting up dispatch to delete once expiration is hit");
-                
-                dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(timeInterval * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
-                    
-                    //dbg msg
-                    os_log_debug(logHandle, "rule expiration hit, will delete");
-                    
-                    //delete
-                    [self delete:rule.key rule:rule.uuid];
-                    
-                    //tell user rules changed
-                    [alerts.xpcUserClient rulesChanged];
-                    
-                });
-            }
+            [ruleExpirations add:rule];
         }
     }
+    
+    //save
+    snapshot.rules = items;
+    snapshot.journal = ruleJournal;
+    snapshot.expirations = ruleExpirations;
+    
+    //build index
+    snapshot.compiledRules = [[RuleIndex alloc] init:items];
+    
+    //save time
+    snapshot.compileTime = [[NSDate date] timeIntervalSinceDate:start];
+    
+    //dbg msg
+    os_log_debug(logHandle, "compiled %lu rules in %.2f ms", (unsigned long)items.count, snapshot.compileTime * 1000);
+    
+bail:
+    
+    //failed?
+    if(nil == snapshot.compiledRules) snapshot = nil;
+    
+    return snapshot;
+}
 
-    //now, enumeration done
-    // can safely delete any/all expired rules
-    for(Rule* rule in expiredRules)
+//activate (compiled) rules
+// all swapped in at once under the lock, and index is published via one (atomic) pointer swap
+// ...so lookups see either all of the previous rules or all of the new ones, never a partially loaded state
+// note: snapshot's rules become the (live) rules, so a snapshot can only be activated once
+-(void)activate:(ProfileSnapshot*)snapshot
+{
+    //sync
+    @synchronized(self)
     {
-        //delete
-        [self delete:rule.key rule:rule.uuid];
+        //swap in rules, journal, & expirations
+        self.rules = snapshot.rules;
+        self.journal = snapshot.journal;
+        expirations = snapshot.expirations;
+        
+        //swap in index
+        self.compiledRules = snapshot.compiledRules;
+        
+        //process rules were for (now) previous rules
+        // so stop watching their processes, as their exits shouldn't delete from the new rules
+        for(id watch in processWatches.allValues) [exitMonitor unwatch:watch];
+        [processWatches removeAllObjects];
+        [processRules removeAllObjects];
+        
+        //rules changed
+        // so (cached) verdicts are stale
+        [verdictCache invalidate];
+        
+        //(re)arm expiration timer
+        [self armExpirationTimer];
+        
+        //all changed
+        [self.changes changed:nil];
     }
-
+    
+    //delete any expired
+    // e.g. since snapshot was compiled
+    [self expire:[NSDate date]];
+    
     //dbg msg
-    os_log_debug(logHandle, "loaded %lu rules", (unsigned long)self.rules.count);
-
-    //happy
-    result = YES;
-
-    }//sync
-
-bail:
+    os_log_debug(logHandle, "activated %lu rules", (unsigned long)snapshot.rules.count);
     
-    return result;
+    return;
 }
 
 //generate default rules
--(BOOL)generateDefaultRules
+// into rules that aren't (yet) active, e.g. first run's or a new profile's, which are then saved
+-(BOOL)generateDefaultRules:(NSMutableDictionary*)items
 {
     //flag
     BOOL generated = NO;
     
+    //rule
+    Rule* rule = nil;
+    
     //default binary
     NSString* defaultBinary = nil;
     
@@ -514,8 +639,9 @@ bail:
         //add binary cs info
         if(nil != binary.csInfo) info[KEY_CS_INFO] = binary.csInfo;
         
-        //add
-        if(YES != [self add:[[Rule alloc] init:info] save:NO])
+        //init rule
+        rule = [[Rule alloc] init:info];
+        if(nil == rule)
         {
             //err msg
             os_log_error(logHandle, "ERROR: failed to add rule");
@@ -523,6 +649,9 @@ bail:
             //skip
             continue;
         }
+        
+        //add
+        [self insert:rule in:items];
     }
 
     //happy
@@ -540,9 +669,6 @@ bail:
     //result
     BOOL added = NO;
     
-    //interval for expirations
-    NSTimeInterval timeInterval = 0;
-    
     //dbg msg
     os_log_debug(logHandle, "adding rule: %{public}@ -> %{public}@", rule.key, rule);
 
@@ -559,73 +685,49 @@ bail:
     //sync to access
     @synchronized(self)
     {
-        //new rule for item
-        // need to init array for rules, paths, & cs info
-        if(nil == self.rules[rule.key])
-        {
-            //init
-            self.rules[rule.key] = [NSMutableDictionary dictionary];
-            
-            //init (proc) rules
-            self.rules[rule.key][KEY_RULES] = [NSMutableArray array];
-            
-            //add cs info
-            if(nil != rule.csInfo)
-            {
-                //add
-                self.rules[rule.key][KEY_CS_INFO] = rule.csInfo;
-            }
-            
-            //init set for all paths
-            self.rules[rule.key][KEY_PATHS] = [NSMutableSet set];
-        }
+        //add
+        [self insert:rule in:self.rules];
         
-        //always add path (for UI)
-        // note, insertion into a set is unique
-        if(0 != rule.path.length)
-        {
-            //add
-            [self.rules[rule.key][KEY_PATHS] addObject:rule.path];
-        }
+        //changed
+        [self.changes changed:rule.key];
         
-        //(now) add rule
-        [self.rules[rule.key][KEY_RULES] addObject:rule];
+        //(re)build index
+        [self reindex:[NSSet setWithObject:rule.key]];
 
     } //sync
     
+    //handle process (temporary) rules
+    // watch for process' exit, to delete once it hits
+    if(YES == [rule isTemporary])
+    {
+        //watch
+        [self watchProcess:rule];
+    }
+    
     //handle expirations
-    // setup dispatch to delete once it hit
+    // track, and (re)arm timer if it's now the next one
     if(nil != rule.expiration)
     {
         //dbg msg
         os_log_debug(logHandle, "rule has an expiration date set: %{public}@", rule.expiration);
         
-        timeInterval = [rule.expiration timeIntervalSinceNow];
-        if(timeInterval > 0) {
-            
-            //dbg msg
-            os_log_debug(logHandle, "setting up dispatch to delete one expiration is hit");
+        //sync
+        @synchronized(self)
+        {
+            //add
+            [expirations add:rule];
             
-            dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(timeInterval * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
-                
-                //dbg msg
-                os_log_debug(logHandle, "rule expiration hit, will delete!");
-                
-                //delete
-                [self delete:rule.key rule:rule.uuid];
-                
-                //tell user rules changed
-                [alerts.xpcUserClient rulesChanged];
-                
-            });
+            //(re)arm
+            [self armExpirationTimer];
         }
     }
 
     //save
+    // via journal, so whole rules file isn't rewritten on each add
     if(YES == save)
     {
         //save
-        if(YES != [self save])
+        if(YES != [self persist:@{KEY_JOURNAL_OP:JOURNAL_OP_ADD, KEY_JOURNAL_RULE:rule}])
         {
             //err msg
             os_log_error(logHandle, "ERROR: failed to save rules");
@@ -652,6 +754,46 @@ bail:
     return added;
 }
 
+//insert a rule
+// into rules (or a snapshot's, not yet active, rules)
+// note: caller should hold lock (if rules are active)
+-(void)insert:(Rule*)rule in:(NSMutableDictionary*)items
+{
+    //new rule for item
+    // need to init array for rules, paths, & cs info
+    if(nil == items[rule.key])
+    {
+        //init
+        items[rule.key] = [NSMutableDictionary dictionary];
+        
+        //init (proc) rules
+        items[rule.key][KEY_RULES] = [NSMutableArray array];
+        
+        //add cs info
+        if(nil != rule.csInfo)
+        {
+            //add
+            items[rule.key][KEY_CS_INFO] = rule.csInfo;
+        }
+        
+        //init set for all paths
+        items[rule.key][KEY_PATHS] = [NSMutableSet set];
+    }
+    
+    //always add path (for UI)
+    // note, insertion into a set is unique
+    if(0 != rule.path.length)
+    {
+        //add
+        [items[rule.key][KEY_PATHS] addObject:rule.path];
+    }
+    
+    //(now) add rule
+    [items[rule.key][KEY_RULES] addObject:rule];
+    
+    return;
+}
+
 //number of rules for a given key
 -(NSUInteger)ruleCountForKey:(NSString*)key
 {
@@ -663,279 +805,238 @@ bail:
 }
 
 //add an (external) path to an item's paths
+// only new paths are journaled, as this is called for each matched flow
 -(void)addPath:(NSString*)path forKey:(NSString*)key
 {
+    //paths
+    NSMutableSet* paths = nil;
+    
     //sync
     @synchronized(self)
     {
-        [self.rules[key][KEY_PATHS] addObject:path];
+        //paths
+        paths = self.rules[key][KEY_PATHS];
+        
+        //none or known?
+        if( (nil == paths) ||
+            (YES == [paths containsObject:path]) )
+        {
+            return;
+        }
+        
+        //add
+        [paths addObject:path];
+        
+        //changed
+        [self.changes changed:key];
     }
+    
+    //journal
+    [self persist:@{KEY_JOURNAL_OP:JOURNAL_OP_PATH, KEY_KEY:key, KEY_PATH:path}];
 
     return;
 }
 
 //find (matching) rule
--(Rule*)find:(Process*)process flow:(NEFilterSocketFlow*)flow
+// note: no lock, as rules are looked up via the (immutable) compiled index
+//       and flow's names/addresses come (pre-built) from its match context
+-(Rule*)find:(Process*)process context:(FlowMatchContext*)context
 {
     //matching rule
     Rule* matchingRule = nil;
     
-    //global rules
-    NSArray* globalRules = nil;
+    //index
+    RuleIndex* index = nil;
     
-    //directory rules
-    NSMutableArray* directoryRules = nil;
-
-    //tree ('process + kids') rules
-    NSMutableArray* treeRules = nil;
-
     //item's rules
-    NSArray* itemRules = nil;
+    RuleBucket* itemRules = nil;
     
-    //canidate rules
-    NSMutableArray* candidateRules = nil;
+    //candidate rules
+    NSMutableArray* candidates = nil;
     
-    //flag(s)
-    BOOL portAny = NO;
-    BOOL endpointAny = NO;
+    //pid each candidate's temporary rules must match
+    NSMutableArray* candidatePIDs = nil;
     
-    //any match
-    // item has a '*:*' rule
-    Rule* anyMatch = nil;
+    //family
+    RuleFamily family = RuleFamilyOther;
     
-    //partial match
-    // *:port or ip:*
-    Rule* partialMatch = nil;
+    //regex/glob & CIDR/range rules matched, per candidate
+    // computed (once) when first needed
+    NSMutableArray* endpointMatches = nil;
     
-    //exact match
-    Rule* exactMatch = nil;
+    //now
+    NSTimeInterval now = 0;
     
-    //remote endpoint
-    NWHostEndpoint* remoteEndpoint = nil;
+    //flag
+    // set if any (indexed) rule has expired
+    BOOL expired = NO;
     
     //dbg msg
     os_log_debug(logHandle, "looking for rule for %{public}@ -> %{public}@", process.key, process.path);
     
-    //sync to access
-    @synchronized(self)
+    //grab (current) index
+    index = self.compiledRules;
+    
+    //any (indexed) rule expired?
+    // i.e. timer hasn't fired yet (e.g. system just woke), so skip expired rules, and expire them off the flow thread
+    // note: a single check per lookup, vs. one per rule (unless some have expired)
+    now = [NSDate timeIntervalSinceReferenceDate];
+    if(index.expires <= now)
     {
-        //item rules
-        itemRules = self.rules[process.key][KEY_RULES];
-
-        //grab global rules
-        globalRules = self.rules[VALUE_ANY][KEY_RULES];
-        
-        //init directory rules
-        directoryRules = [NSMutableArray array];
-
-        //init tree rules
-        treeRules = [NSMutableArray array];
+        //set
+        expired = YES;
         
-        //add any directory rules
-        // i.e. any rule that's '/<anything>*'
-        for(NSString* key in self.rules)
-        {
-            //directory
-            NSString* directory = nil;
-            
-            //directory rule?
-            // grab first/any rule and check
-            if(YES == ((Rule*)[self.rules[key][KEY_RULES] firstObject]).isDirectory.boolValue)
-            {
-                //init directory
-                // ...by removing *
-                directory = [key substringToIndex:(key.length-1)];
-                
-                //does item fall within dir?
-                if(YES == [process.path hasPrefix:directory])
-                {
-                    //add
-                    [directoryRules addObjectsFromArray:self.rules[key][KEY_RULES]];
-                }
-            }
-        }
-
-        //add any tree ('process + kids') rules
-        // check each ancestor against rules w/ scope 'ACTION_SCOPE_PROCESS_TREE'
-        // note: ancestors are matched (simply) by path, so no signing validation of the ancestor
-        //       and ancestry is from the ppid/responsible-pid walk, so breaks if an intermediate parent has exited
-        for(NSDictionary* ancestor in process.ancestors)
-        {
-            //ancestor pid
-            pid_t ancestorPID = [ancestor[KEY_PROCESS_ID] intValue];
-
-            //skip self
-            // ...its own (item) rules apply directly
-            if(ancestorPID == process.pid) continue;
-
-            //skip system roots (kernel/launchd)
-            if(ancestorPID <= 1) continue;
-
-            //resolve ancestor's path
-            // as rule paths (via flow) and ancestor paths (via 'proc_pidpath') can differ (e.g. /tmp vs /private/tmp)
-            NSString* ancestorPath = [ancestor[KEY_PROCESS_PATH] stringByResolvingSymlinksInPath];
-
-            //check all rules for tree-scoped match
-            for(NSString* key in self.rules)
-            {
-                //check each rule
-                for(Rule* rule in self.rules[key][KEY_RULES])
-                {
-                    //skip non-tree rules
-                    if(ACTION_SCOPE_PROCESS_TREE != rule.scope.intValue) continue;
-
-                    //skip if rule's (resolved) path doesn't match ancestor's
-                    if(YES != [[rule.path stringByResolvingSymlinksInPath] isEqualToString:ancestorPath]) continue;
-
-                    //temporary ('process lifetime') rule?
-                    // check ancestor's pid matches rule's pid
-                    if( (nil != rule.pid) &&
-                        (rule.pid.intValue != ancestorPID) ) continue;
-
-                    //dbg msg
-                    os_log_debug(logHandle, "found tree ('process + kids') rule via ancestor %{public}@", ancestor);
-
-                    //add
-                    [treeRules addObject:rule];
-                }
-            }
-        }
-
-        //no global, directory, tree, nor item rules
-        // bail, with no match so user is prompted
-        if( (nil == itemRules) &&
-            (nil == globalRules) &&
-            (0 == directoryRules.count) &&
-            (0 == treeRules.count) )
+        //expire
+        // (async) on the expiration timer's queue
+        [self scheduleExpire];
+    }
+    
+    //init candidates
+    candidates = [NSMutableArray array];
+    candidatePIDs = [NSMutableArray array];
+    
+    //add global rules first
+    if(nil != index.globalRules)
+    {
+        [candidates addObject:index.globalRules];
+        [candidatePIDs addObject:@(process.pid)];
+    }
+    
+    //add any directory rules next
+    // i.e. any rule that's '/<anything>*', looked up per parent directory
+    for(RuleBucket* directoryRules in [index directoryRulesForPath:process.path])
+    {
+        [candidates addObject:directoryRules];
+        [candidatePIDs addObject:@(process.pid)];
+    }
+    
+    //add any tree ('process + kids') rules next
+    // note: before item rules, so an item's own rules take precedence
+    //       ancestors are matched (simply) by (canonical) path, so no signing validation of the ancestor
+    //       and ancestry is from the ppid/responsible-pid walk, so breaks if an intermediate parent has exited
+    if(0 != index.treeRules.count)
+    {
+        for(NSArray* treeRules in [self treeRules:index process:process])
         {
-            //no match
-            goto bail;
+            //add
+            // temporary ('process lifetime') tree rules must match the ancestor's pid
+            [candidates addObject:treeRules.firstObject];
+            [candidatePIDs addObject:treeRules.lastObject];
         }
-        
-        //init candidate rules
-        candidateRules = [NSMutableArray array];
-        
-        //add global rules first
-        if(nil != globalRules) [candidateRules addObject:globalRules];
-        
-        //add directory rules next
-        if(0 != directoryRules.count) [candidateRules addObject:directoryRules];
-
-        //add tree ('process + kids') rules next
-        // note: before item rules, so an item's own rules take precedence
-        if(0 != treeRules.count) [candidateRules addObject:treeRules];
-
-        //add item's rules last...
-        if(nil != itemRules) [candidateRules addObject:itemRules];
-        
-        //extract remote endpoint
-        remoteEndpoint = (NWHostEndpoint*)flow.remoteEndpoint;
-        
-        //check each set of rules
-        // set: global, directory, and/or item rules
-        for(NSArray* rules in candidateRules)
+    }
+    
+    //add item's rules last...
+    itemRules = index.itemRules[process.key];
+    if(nil != itemRules)
+    {
+        [candidates addObject:itemRules];
+        [candidatePIDs addObject:@(process.pid)];
+    }
+    
+    //no global, directory, tree, nor item rules
+    // bail, with no match so user is prompted
+    if(0 == candidates.count)
+    {
+        //no match
+        goto bail;
+    }
+    
+    //init family
+    family = ruleFamilyForSocketFamily(context.family);
+    
+    //init endpoint matches
+    endpointMatches = [NSMutableArray array];
+    for(NSUInteger i = 0; i < candidates.count; i++) [endpointMatches addObject:NSNull.null];
+    
+    //check tiers, from highest precedence (exact) to lowest (any)
+    // and within a tier, last rule wins, so walk candidates (and their rules) in reverse
+    for(NSInteger tier = RuleTierExact; tier >= RuleTierAny; tier--)
+    {
+        for(NSInteger i = candidates.count-1; i >= 0; i--)
         {
-            //check all set of rules
-            // note: * is a wildcard, meaning any match
-            for(Rule* rule in rules)
+            //pid for temp rules
+            pid_t pid = [candidatePIDs[i] intValue];
+            
+            //check each rule
+            for(Rule* rule in [[candidates[i] rules:tier family:family] reverseObjectEnumerator])
             {
-                //set flag: any port ('*')
-                portAny = [rule.endpointPort isEqualToString:VALUE_ANY];
+                //skip any disabled rule(s)
+                // note: index is rebuilt on toggle, but rules are toggled in place
+                if(0 != rule.isDisabled.intValue) continue;
                 
-                //set flag: any endpoint ('*', '0.0.0.0/0', or '::/0')
-                endpointAny = [self matchAnyEndpoint:rule flow:flow];
+                //skip any expired rule(s)
+                // i.e. not yet deleted, as that's done off the flow thread
+                if( (YES == expired) &&
+                    (nil != rule.expiration) &&
+                    (rule.expiration.timeIntervalSinceReferenceDate <= now) ) continue;
                 
-                //skip any disabled rule(s)
-                if(0 != rule.isDisabled.intValue) {
-                    
-                    //dbg msg
-                    os_log_debug(logHandle, "skipping disabled rule match %{public}@", rule);
-                    
+                //temp rule?
+                // check (process or ancestor's) pid matches rule's pid
+                if( (nil != rule.pid) &&
+                    (rule.pid.intValue != pid) )
+                {
                     //skip
                     continue;
                 }
                 
-                //checks for temp rules
-                if(YES == [rule isTemporary])
+                //protocol set?
+                // check it matches flow's (e.g. a TCP/443 rule shouldn't cover UDP/443, i.e. QUIC)
+                if(YES != [rule protocolMatches:context.protocol])
                 {
-                    //process?
-                    // check process's pid matches rule's pid
-                    // note: tree rules are exempt, as their pid was already checked against the ancestor's
-                    if( (rules != treeRules) &&
-                        (nil != rule.pid) &&
-                        (rule.pid.unsignedIntValue != process.pid) )
-                    {
-                        //skip
-                        continue;
-                    }
+                    //skip
+                    continue;
                 }
                 
-                //expiration?
-                // double check if 'now' is after expiration
-                if( (nil != rule.expiration) &&
-                    ([[NSDate date] compare:rule.expiration] == NSOrderedDescending) )
+                //regex/glob or CIDR/range rule?
+                // match all of candidate's patterns & ranges in one pass (first time only)
+                if( (RuleTierAny != tier) &&
+                    (NSNull.null == endpointMatches[i]) &&
+                    (EndpointTypeExact != rule.isEndpointAddrRegex) )
                 {
-                    //err msg
-                    os_log_error(logHandle, "ERROR: rule %{public}@ has expired, should already have been removed", rule);
-                    
-                    //skip
-                    continue;
+                    //match
+                    endpointMatches[i] = [self endpointMatches:candidates[i] context:context];
                 }
                 
                 //match on any (addr) and any (port)
-                if( (YES == portAny) &&
-                    (YES == endpointAny) )
+                if(RuleTierAny == tier)
                 {
                     //dbg msg
                     os_log_debug(logHandle, "rule match: 'any' address and port");
                     
                     //any
-                    anyMatch = rule;
-                    
-                    //next
-                    continue;
+                    matchingRule = rule;
+                    goto bail;
                 }
                 
                 //port is any?
                 // check for (partial) rule match: endpoint addr
-                else if(YES == portAny)
+                else if(RuleTierPartial == tier)
                 {
-                    //dbg msg
-                    os_log_debug(logHandle, "rule port is any ('*'), will check host/url");
-                    
-                    //check endpoint host/url
-                    if(YES == [self endpointAddrMatch:flow rule:rule])
+                    //port any?
+                    if(YES == [rule.endpointPort isEqualToString:VALUE_ANY])
                     {
-                        //dbg msg
-                        os_log_debug(logHandle, "rule match: 'partial' (addr)");
-                        
-                        //partial
-                        partialMatch = rule;
-                        
-                        //next
-                        continue;
+                        //check endpoint host/url
+                        if(YES == [self endpointAddrMatch:context rule:rule endpointMatches:endpointMatches[i]])
+                        {
+                            //dbg msg
+                            os_log_debug(logHandle, "rule match: 'partial' (addr)");
+                            
+                            //partial
+                            matchingRule = rule;
+                            goto bail;
+                        }
                     }
-                }
-                
-                //endpoint addr is any?
-                // check for (partial) rule match: endpoint port
-                else if(YES == endpointAny)
-                {
-                    //dbg msg
-                    os_log_debug(logHandle, "rule address is any ('*', '0.0.0.0/0', or '::/0'), will check port");
                     
-                    //addr is any
-                    //so check the port
-                    if(YES == [rule.endpointPort isEqualToString:remoteEndpoint.port])
+                    //endpoint addr is any
+                    // so check the port (or port range/list)
+                    else if(YES == [rule endpointPortMatches:context.portNumber])
                     {
                         //dbg msg
                         os_log_debug(logHandle, "rule match: 'partial' (port)");
                         
                         //partial
-                        partialMatch = rule;
-                        
-                        //next
-                        continue;
+                        matchingRule = rule;
+                        goto bail;
                     }
                 }
                 
@@ -943,244 +1044,173 @@ bail:
                 // check that both endpoint addr and port match
                 else
                 {
-                    //dbg msg
-                    os_log_debug(logHandle, "address and port set (%{public}@:%{public}@), will check both for match", rule.endpointAddr, rule.endpointPort);
-                    
                     //match?
-                    if( (YES == [self endpointAddrMatch:flow rule:rule]) &&
-                        (YES == [rule.endpointPort isEqualToString:remoteEndpoint.port]) )
+                    if( (YES == [rule endpointPortMatches:context.portNumber]) &&
+                        (YES == [self endpointAddrMatch:context rule:rule endpointMatches:endpointMatches[i]]) )
                     {
                         //dbg msg
                         os_log_debug(logHandle, "rule match: 'exact' address and port");
-                            
-                        //exact
-                        exactMatch = rule;
                         
-                        //next
-                        continue;
+                        //exact
+                        matchingRule = rule;
+                        goto bail;
                     }
                 }
-                    
-            } //all rule set
-        
-        } //all candidate rules
-        
-        //extact match?
-        if(nil != exactMatch) matchingRule = exactMatch;
-        
-        //partial match?
-        else if (nil != partialMatch) matchingRule = partialMatch;
-        
-        //any match?
-        else if (nil != anyMatch) matchingRule = anyMatch;
-    
-    }//sync
+            }
+        }
+    }
         
 bail:
     
     return matchingRule;
 }
 
-//check if endpoint addr matches "any"
-// either '*' or (IPv4) '0.0.0.0/0' or (IPv6) '::/0'
--(BOOL)matchAnyEndpoint:(Rule*)rule flow:(NEFilterSocketFlow*)flow
+//tree ('process + kids') rules that apply to a process, via its ancestors
+// looked up once per process (& index), as ancestors' canonical paths are resolved once too
+// returns array of [bucket, ancestor pid] pairs, outermost ancestor last
+-(NSArray*)treeRules:(RuleIndex*)index process:(Process*)process
 {
-    //flag
-    BOOL matchesAny = NO;
+    //tree rules
+    NSMutableArray* treeRules = nil;
     
-    //first check any '*'
-    if([rule.endpointAddr isEqualToString:VALUE_ANY])
+    //cached (for this index)?
+    @synchronized(process)
     {
-        //dbg msg
-        os_log_debug(logHandle, "rule match: 'any' ('*')");
-        
-        matchesAny = YES;
-        goto bail;
+        if(index == process.treeRulesIndex) return process.treeRules;
     }
     
-    //check for IPV4 -> '0.0.0.0/0'
-    if( (AF_INET == flow.socketFamily) &&
-        ([rule.endpointAddr isEqualToString:@"0.0.0.0/0"]) )
+    //init
+    treeRules = [NSMutableArray array];
+    
+    //check each ancestor
+    for(NSDictionary* ancestor in process.canonicalAncestors)
     {
-        //dbg msg
-        os_log_debug(logHandle, "rule match: 'any' (IPv4: '0.0.0.0/0')");
+        //lookup by ancestor's canonical path
+        RuleBucket* bucket = index.treeRules[ancestor[KEY_PROCESS_PATH]];
+        if(nil == bucket) continue;
         
-        matchesAny = YES;
-        goto bail;
-    }
-    //check for IPV6 -> '::/0'
-    if( (AF_INET6 == flow.socketFamily) &&
-        ([rule.endpointAddr isEqualToString:@"::/0"]) )
-    {
         //dbg msg
-        os_log_debug(logHandle, "rule match: 'any' (IPv6: '::/0')");
+        os_log_debug(logHandle, "found tree ('process + kids') rules via ancestor %{public}@", ancestor);
         
-        matchesAny = YES;
-        goto bail;
-
+        //add
+        [treeRules addObject:@[bucket, ancestor[KEY_PROCESS_ID]]];
     }
     
-bail:
+    //cache
+    // empty, if none apply, so later flows skip the walk
+    @synchronized(process)
+    {
+        process.treeRules = treeRules;
+        process.treeRulesIndex = index;
+    }
     
-    return matchesAny;
+    return treeRules;
 }
 
-//check if endpoint host or url matches
-// extra logic for checking/applying regex, etc...
--(BOOL)endpointAddrMatch:(NEFilterSocketFlow*)flow rule:(Rule*)rule
+//(re)build compiled rule index
+// and publish it (atomically), for lock-free lookups
+-(void)reindex
 {
-    //match
-    BOOL isMatch = NO;
-
-    //endpoint url/hosts
-    NSMutableArray* endpointNames = nil;
-
-    //endpoint regex
-    NSRegularExpression* endpointAddrRegex = nil;
-    
-    //remote endpoint
-    NWHostEndpoint* remoteEndpoint = nil;
-    
-    //dbg msg
-    os_log_debug(logHandle, "%s", __PRETTY_FUNCTION__);
-    
-    //extract remote endpoint
-    remoteEndpoint = (NWHostEndpoint*)flow.remoteEndpoint;
-    
-    //init endpoint names
-    endpointNames = [NSMutableArray array];
+    //all keys
+    [self reindex:nil];
     
-    //add url
-    // and just host (as this is what is shown in alert)
-    if(nil != flow.URL.absoluteString)
-    {
-        //add full url
-        [endpointNames addObject:flow.URL.absoluteString];
+    return;
+}
 
-        //add host
-        if(nil != flow.URL.host)
-        {
-            [endpointNames addObject:flow.URL.host];
-        }
-    }
-    
-    //add host name
-    if(nil != remoteEndpoint.hostname)
+//(re)build compiled rule index, for changed keys
+// only their buckets are rebuilt, so a single rule change doesn't recompile every bucket (under the lock)
+-(void)reindex:(NSSet<NSString*>*)keys
+{
+    //sync
+    @synchronized(self)
     {
-        //add
-        [endpointNames addObject:remoteEndpoint.hostname];
+        //build (from current) & swap
+        // note: nil keys, means a full build
+        self.compiledRules = [[RuleIndex alloc] init:self.rules previous:self.compiledRules changed:keys];
+        
+        //rules changed
+        // so (cached) verdicts are stale
+        [verdictCache invalidate];
     }
     
-    //macOS 11+?
-    // add remote host name
-    if(@available(macOS 11, *))
+    return;
+}
+
+//match a bucket's regex/glob & CIDR/range rules
+// patterns against flow's names, ranges against flow's (numeric) addresses
+-(NSSet*)endpointMatches:(RuleBucket*)bucket context:(FlowMatchContext*)context
+{
+    //matches
+    NSMutableSet* matches = nil;
+    
+    //init w/ pattern matches
+    matches = [NSMutableSet setWithSet:([bucket.endpointMatcher match:context.names] ?: [NSSet set])];
+    
+    //add range matches
+    // a lookup (binary search) per address
+    if(nil != bucket.addressMatcher)
     {
-        //add remote host name
-        if(nil != flow.remoteHostname)
+        for(NSUInteger i = 0; i < context.addressCount; i++)
         {
+            //address
+            const FlowAddress* address = [context addressAtIndex:i];
+            
             //add
-            [endpointNames addObject:flow.remoteHostname];
+            [matches unionSet:([bucket.addressMatcher match:address->bytes family:address->family] ?: [NSSet set])];
         }
     }
     
+    return matches;
+}
+
+//check if endpoint host or url matches
+// regex/glob & CIDR/range rules are matched up front (per bucket), so just check if rule is in those matches
+// exact rules are checked against context's (pre-built) lower-cased names
+-(BOOL)endpointAddrMatch:(FlowMatchContext*)context rule:(Rule*)rule endpointMatches:(NSSet*)endpointMatches
+{
+    //match
+    BOOL isMatch = NO;
+    
+    //dbg msg
+    os_log_debug(logHandle, "%s", __PRETTY_FUNCTION__);
+    
     //dbg msg
-    os_log_debug(logHandle, "checking rule's endpoint address (%{public}@) and rule's endpoint host %{public}@ against %{public}@", rule.endpointAddr, rule.endpointHost, endpointNames);
+    os_log_debug(logHandle, "checking rule's endpoint address (%{public}@) and rule's endpoint host %{public}@ against %{public}@", rule.endpointAddr, rule.endpointHost, context.names);
     
-    //endpoint addr a regex (or glob)?
-    // init regex and check for match
-    if( (EndpointTypeRegex == rule.isEndpointAddrRegex) ||
-        (EndpointTypeGlob == rule.isEndpointAddrRegex) )
+    //endpoint addr a regex, glob, or CIDR / IP range?
+    // already matched (w/ all of bucket's patterns/ranges), so just check
+    if(EndpointTypeExact != rule.isEndpointAddrRegex)
     {
         //dbg msg
-        os_log_debug(logHandle, "rule's endpoint address is a regex (or glob)...");
+        os_log_debug(logHandle, "rule's endpoint address is a regex, glob, or CIDR/range...");
 
-        //grab (lazily compiled & cached) regex
-        endpointAddrRegex = [rule compiledEndpointRegex];
-        if(nil == endpointAddrRegex)
+        //match?
+        if(YES == [endpointMatches containsObject:rule])
         {
-            //err msg
-            os_log_error(logHandle, "ERROR: failed to create regex from %{public}@", rule.endpointAddr);
-
+            //dbg msg
+            os_log_debug(logHandle, "rule match: regex/glob/CIDR on %{public}@", context.names);
+            
+            //match
+            isMatch = YES;
+            
             //bail
             goto bail;
         }
-
-        //check each
-        for(NSString* endpointName in endpointNames)
-        {
-            //match?
-            if(0 != [endpointAddrRegex numberOfMatchesInString:endpointName options:0 range:NSMakeRange(0, endpointName.length)])
-            {
-                //dbg msg
-                os_log_debug(logHandle, "rule match: regex on %{public}@", endpointName);
-                
-                //match
-                isMatch = YES;
-                
-                //bail
-                goto bail;
-            }
-        }
-    }
-    
-    //endpoint addr a CIDR / IP range?
-    // bounds are parsed & cached on the rule (first use)
-    else if(EndpointTypeCIDR == rule.isEndpointAddrRegex)
-    {
-        //dbg msg
-        os_log_debug(logHandle, "rule's endpoint address is a CIDR/range...");
-
-        //check each
-        // note: only numeric IPs of the rule's family will match (hostnames/URLs fail to parse)
-        for(NSString* endpointName in endpointNames)
-        {
-            //match?
-            if(YES == [rule endpointAddrInRange:endpointName])
-            {
-                //dbg msg
-                os_log_debug(logHandle, "rule match: CIDR/range on %{public}@", endpointName);
-
-                //match
-                isMatch = YES;
-
-                //bail
-                goto bail;
-            }
-        }
     }
 
-    //not regex / cidr
-    // check rule's endpoint address and host for (exact) match
+    //not regex / glob / cidr
+    // check rule's endpoint address and host for (exact, case-insensitive) match
     else
     {
-        //check each
-        for(NSString* endpointName in endpointNames)
+        //match?
+        if(YES == [rule endpointAddrInNames:context.lowercaseNames])
         {
             //dbg msg
-            os_log_debug(logHandle, "checking %{public}@ vs. %{public}@", rule.endpointAddr, endpointName);
-            
-            //check against rule's endpoint address
-            if(NSOrderedSame == [rule.endpointAddr caseInsensitiveCompare:endpointName])
-            {
-                //dbg msg
-                os_log_debug(logHandle, "rule match (endpoint address): %{public}@", endpointName);
-                
-                //match
-                isMatch = YES;
-                goto bail;
-            }
+            os_log_debug(logHandle, "rule match (endpoint address/host): %{public}@", context.names);
             
-            //(also) check against rule's endpoint host
-            if( (nil != rule.endpointHost) &&
-                (NSOrderedSame == [rule.endpointHost caseInsensitiveCompare:endpointName]) )
-            {
-                //dbg msg
-                os_log_debug(logHandle, "rule match: (endpoint host) %{public}@", endpointName);
-                
-                //match
-                isMatch = YES;
-                goto bail;
-            }
+            //match
+            isMatch = YES;
+            goto bail;
         }
     }
     
@@ -1196,67 +1226,37 @@ bail:
     //result
     BOOL result = NO;
     
+    //journal record
+    NSMutableDictionary* record = nil;
+    
     //dbg msg
     os_log_debug(logHandle, "toggling rule, key: %{public}@, rule id: %{public}@", key, uuid);
     
     //sync to access
     @synchronized(self)
     {
-        //no uuid
-        // set all (process') rules to specified state
-        if(nil == uuid)
-        {
-            //toggle all
-            for(Rule* rule in self.rules[key][KEY_RULES])
-            {
-                //enable
-                if(RULE_TOGGLE_STATE_ENABLE == state.intValue) {
-                    rule.isDisabled = nil;
-                }
-                //disable
-                else
-                {
-                    rule.isDisabled = @YES;
-                }
-            }
-            
-            //happy
-            result = YES;
-            
-            //done
-            goto bail;
-        }
+        //toggle
+        [self toggle:key rule:uuid state:state in:self.rules];
         
-        //find matching rule
-        [self.rules[key][KEY_RULES] enumerateObjectsUsingBlock:^(Rule* currentRule, NSUInteger index, BOOL* stop)
-        {
-            //is match?
-            if(YES == [currentRule.uuid isEqualToString:uuid])
-            {
-                //enable
-                if(RULE_TOGGLE_STATE_ENABLE == state.intValue) {
-                    currentRule.isDisabled = nil;
-                }
-                //disable
-                else
-                {
-                    currentRule.isDisabled = @YES;
-                }
-                
-                //done
-                *stop = YES;
-            }
-        }];
+        //changed
+        if(nil != key) [self.changes changed:key];
+        
+        //(re)build index
+        // just this key's buckets (or all, if no key)
+        [self reindex:(nil != key) ? [NSSet setWithObject:key] : nil];
         
     } //sync
         
     //happy
     result = YES;
     
-bail:
+    //init record
+    record = [@{KEY_JOURNAL_OP:JOURNAL_OP_TOGGLE, KEY_JOURNAL_STATE:@(state.intValue)} mutableCopy];
+    if(nil != key) record[KEY_KEY] = key;
+    if(nil != uuid) record[KEY_JOURNAL_UUID] = uuid;
     
     //always save to disk
-    if(YES != [self save])
+    if(YES != [self persist:record])
     {
         //err msg
         os_log_error(logHandle, "ERROR: failed to save (toggled) rules");
@@ -1268,14 +1268,46 @@ bail:
     return result;
 }
 
+//set state of a rule (or all an item's rules, if no uuid)
+// in rules (or a snapshot's, not yet active, rules)
+// note: caller should hold lock (if rules are active)
+-(void)toggle:(NSString*)key rule:(NSString*)uuid state:(NSNumber*)state in:(NSMutableDictionary*)items
+{
+    //check each
+    for(Rule* rule in items[key][KEY_RULES])
+    {
+        //not a match?
+        if( (nil != uuid) &&
+            (YES != [rule.uuid isEqualToString:uuid]) )
+        {
+            continue;
+        }
+        
+        //enable
+        if(RULE_TOGGLE_STATE_ENABLE == state.intValue) {
+            rule.isDisabled = nil;
+        }
+        //disable
+        else
+        {
+            rule.isDisabled = @YES;
+        }
+        
+        //done?
+        if(nil != uuid) break;
+    }
+    
+    return;
+}
+
 //delete rule
 -(BOOL)delete:(NSString*)key rule:(NSString*)uuid
 {
     //result
     BOOL result = NO;
     
-    //rule index
-    __block NSUInteger ruleIndex = -1;
+    //journal record
+    NSMutableDictionary* record = nil;
     
     //dbg msg
     os_log_debug(logHandle, "deleting rule, key: %{public}@, rule id: %{public}@", key, uuid);
@@ -1283,63 +1315,28 @@ bail:
     //sync to access
     @synchronized(self)
     {
-        //no uuid
-        // delete all (process') rules
-        if(nil == uuid)
-        {
-            //remove
-            [self.rules removeObjectForKey:key];
-            
-            //happy
-            result = YES;
-            
-            //done
-            goto bail;
-        }
-        
-        //find matching rule
-        [self.rules[key][KEY_RULES] enumerateObjectsUsingBlock:^(Rule* currentRule, NSUInteger index, BOOL* stop)
-        {
-            //is match?
-            if(YES == [currentRule.uuid isEqualToString:uuid])
-            {
-                //save index
-                ruleIndex = index;
-            
-                //stop
-                *stop = YES;
-            }
-        }];
+        //remove
+        [self remove:key rule:uuid in:self.rules];
         
-        //dbg msg
-        os_log_debug(logHandle, "found rule at index: %lu", (unsigned long)ruleIndex);
+        //changed
+        if(nil != key) [self.changes changed:key];
         
-        //remove
-        if(-1 != ruleIndex)
-        {
-            //remove
-            [self.rules[key][KEY_RULES] removeObjectAtIndex:ruleIndex];
-            
-            //last (item) rule?
-            if(0 == ((NSMutableArray*)self.rules[key][KEY_RULES]).count)
-            {
-                //dbg msg
-                os_log_debug(logHandle, "rule was only/last one for %{public}@, so removing item entry", key);
-                
-                //remove process
-                [self.rules removeObjectForKey:key];
-            }
-        }
+        //(re)build index
+        // just this key's buckets (or all, if no key)
+        [self reindex:(nil != key) ? [NSSet setWithObject:key] : nil];
         
     } //sync
         
     //happy
     result = YES;
     
-bail:
+    //init record
+    record = [@{KEY_JOURNAL_OP:JOURNAL_OP_DELETE} mutableCopy];
+    if(nil != key) record[KEY_KEY] = key;
+    if(nil != uuid) record[KEY_JOURNAL_UUID] = uuid;
     
     //always save to disk
-    if(YES != [self save])
+    if(YES != [self persist:record])
     {
         //err msg
         os_log_error(logHandle, "ERROR: failed to save (updated) rules");
@@ -1351,114 +1348,231 @@ bail:
     return result;
 }
 
-//save to disk
-// note: temporary rules are ignored
--(BOOL)save
+//remove a rule (or all an item's rules, if no uuid)
+// from rules (or a snapshot's, not yet active, rules)
+// note: caller should hold lock (if rules are active)
+-(void)remove:(NSString*)key rule:(NSString*)uuid in:(NSMutableDictionary*)items
 {
-    //result
-    BOOL result = NO;
-    
-    //error
-    NSError* error = nil;
-    
-    //rule's file
-    NSString* rulesFile = nil;
+    //rule index
+    __block NSUInteger ruleIndex = -1;
     
-    //persistent rules
-    NSMutableDictionary* persistentRules = nil;
+    //no uuid
+    // delete all (process') rules
+    if(nil == uuid)
+    {
+        //remove
+        [items removeObjectForKey:key];
+        
+        //done
+        return;
+    }
     
-    //archived rules
-    NSData* archivedRules = nil;
+    //find matching rule
+    [items[key][KEY_RULES] enumerateObjectsUsingBlock:^(Rule* currentRule, NSUInteger index, BOOL* stop)
+    {
+        //is match?
+        if(YES == [currentRule.uuid isEqualToString:uuid])
+        {
+            //save index
+            ruleIndex = index;
+        
+            //stop
+            *stop = YES;
+        }
+    }];
     
     //dbg msg
-    os_log_debug(logHandle, "method '%s' invoked", __PRETTY_FUNCTION__);
+    os_log_debug(logHandle, "found rule at index: %lu", (unsigned long)ruleIndex);
     
-    //init
-    persistentRules = [NSMutableDictionary dictionary];
+    //remove
+    if(-1 != ruleIndex)
+    {
+        //remove
+        [items[key][KEY_RULES] removeObjectAtIndex:ruleIndex];
+        
+        //last (item) rule?
+        if(0 == ((NSMutableArray*)items[key][KEY_RULES]).count)
+        {
+            //dbg msg
+            os_log_debug(logHandle, "rule was only/last one for %{public}@, so removing item entry", key);
+            
+            //remove process
+            [items removeObjectForKey:key];
+        }
+    }
     
-    //init path
-    rulesFile = [self getPath];
+    return;
+}
+
+//persist a change
+// appended to journal, which is compacted (into the rules file) in the background once large enough
+// no journal (e.g. rules not yet loaded) or append failed? fall back to saving all rules
+-(BOOL)persist:(NSDictionary*)record
+{
+    //journal
+    RuleJournal* currentJournal = nil;
     
-    //dbg msg
-    os_log_debug(logHandle, "saving (non-temp) rules to %{public}@", rulesFile);
+    //grab journal
+    @synchronized(self)
+    {
+        currentJournal = self.journal;
+    }
     
-    //sync to save
-    @synchronized(self) {
-        
-        //generate list of non-temp rules
-        // these are the ones we'll write out
-        for(NSString* key in self.rules.allKeys)
+    //append
+    if( (nil == currentJournal) ||
+        (YES != [currentJournal append:record]) )
+    {
+        //save all
+        return [self save];
+    }
+    
+    //time to compact?
+    if(currentJournal.count >= RULES_JOURNAL_LIMIT)
+    {
+        //sync
+        @synchronized(self)
         {
-            //item's rules
-            NSMutableArray* itemRules = nil;
+            //already scheduled?
+            if(YES == compactionPending) return YES;
             
-            //init
-            itemRules = [NSMutableArray array];
+            //set
+            compactionPending = YES;
+        }
+        
+        //dbg msg
+        os_log_debug(logHandle, "rules journal has %lu records, will compact", (unsigned long)currentJournal.count);
+        
+        //compact
+        // a full save writes out all rules, and resets the journal
+        dispatch_async(compactionQueue, ^{
             
-            //add only non-temporary rules
-            for(Rule* itemRule in self.rules[key][KEY_RULES])
+            //sync
+            @synchronized(self)
             {
-                //temp?
-                if(YES == [itemRule isTemporary])
-                {
-                    //skip
-                    continue;
-                }
-                
-                //add
-                [itemRules addObject:itemRule];
+                //reset
+                self->compactionPending = NO;
             }
             
-            //any non-temp rules?
-            // add to rules we're going to write out
-            if(0 != itemRules.count)
+            //save
+            if(YES != [self save])
             {
-                //start w/ empty dictionary
-                persistentRules[key] = [NSMutableDictionary dictionary];
-                                
-                //add (non-temp) rules
-                persistentRules[key][KEY_RULES] = itemRules;
-                
-                //add cs info
-                if(nil != self.rules[key][KEY_CS_INFO])
-                {
-                    //add
-                    persistentRules[key][KEY_CS_INFO] = self.rules[key][KEY_CS_INFO];
-                }
-                
-                //add paths info
-                if(nil != self.rules[key][KEY_PATHS])
-                {
-                    //add
-                    persistentRules[key][KEY_PATHS] = self.rules[key][KEY_PATHS];
-                }
+                //err msg
+                os_log_error(logHandle, "ERROR: failed to compact rules journal");
             }
-        }
-        
-        //serialize
-        archivedRules = [NSKeyedArchiver archivedDataWithRootObject:persistentRules requiringSecureCoding:YES error:&error];
-        if(nil == archivedRules)
-        {
-            //err msg
-            os_log_error(logHandle, "ERROR: failed to serialize rules: %{public}@", error);
-                
-            //bail
-            goto bail;
-        }
+        });
+    }
+    
+    return YES;
+}
+
+//replay journal records
+// records may already be in the rules file (e.g. crash after save, before journal reset), so each is idempotent
+// note: replayed into (not yet active) rules, e.g. a snapshot's, so no lock needed
+-(void)replay:(NSArray*)records in:(NSMutableDictionary*)items
+{
+    //dbg msg
+    if(0 != records.count) os_log_debug(logHandle, "replaying %lu journaled rule changes", (unsigned long)records.count);
+    
+    //apply each
+    for(NSDictionary* record in records)
+    {
+        //op
+        NSString* op = record[KEY_JOURNAL_OP];
         
-        //dbg msg
-        os_log_debug(logHandle, "serialized rules");
+        //key
+        NSString* key = record[KEY_KEY];
         
-        //write out rules
-        if(YES != [archivedRules writeToFile:rulesFile atomically:YES])
+        //add
+        // skip if rule is already present
+        if(YES == [op isEqualToString:JOURNAL_OP_ADD])
         {
-            //err msg
-            os_log_error(logHandle, "ERROR: failed to save archived rules to: %{public}@", rulesFile);
+            //rule
+            Rule* rule = record[KEY_JOURNAL_RULE];
+            if( (YES != [rule isKindOfClass:[Rule class]]) ||
+                (nil == rule.key) ) continue;
             
+            //already present?
+            if(NSNotFound != [items[rule.key][KEY_RULES] indexOfObjectPassingTest:^BOOL(Rule* existingRule, NSUInteger index, BOOL* stop) {
+                return [existingRule.uuid isEqualToString:rule.uuid];
+            }]) continue;
+            
+            //add
+            [self insert:rule in:items];
+        }
+        
+        //(all other ops) need a key
+        else if(YES != [key isKindOfClass:[NSString class]])
+        {
+            continue;
+        }
+        
+        //path
+        else if(YES == [op isEqualToString:JOURNAL_OP_PATH])
+        {
+            //add
+            if(nil != record[KEY_PATH]) [items[key][KEY_PATHS] addObject:record[KEY_PATH]];
+        }
+        
+        //toggle
+        else if(YES == [op isEqualToString:JOURNAL_OP_TOGGLE])
+        {
+            //toggle
+            [self toggle:key rule:record[KEY_JOURNAL_UUID] state:record[KEY_JOURNAL_STATE] in:items];
+        }
+        
+        //delete
+        else if(YES == [op isEqualToString:JOURNAL_OP_DELETE])
+        {
+            //remove
+            [self remove:key rule:record[KEY_JOURNAL_UUID] in:items];
+        }
+    }
+    
+    return;
+}
+
+//save to disk
+// into the file the (live) rules were loaded from, i.e. its journal's, never the current profile pref
+// ...as that's switched (e.g. profile activation) independently of the rules, which could then be saved into the wrong profile
+-(BOOL)save
+{
+    //result
+    BOOL result = NO;
+    
+    //rule's file
+    NSString* rulesFile = nil;
+    
+    //dbg msg
+    os_log_debug(logHandle, "method '%s' invoked", __PRETTY_FUNCTION__);
+    
+    //sync to save
+    // note: file is captured under the same lock, so it's always the one of the rules being written out
+    @synchronized(self) {
+        
+        //loaded?
+        // rules file is the journal's path, minus its suffix
+        if(nil != self.journal)
+        {
+            rulesFile = [self.journal.path substringToIndex:(self.journal.path.length - RULES_JOURNAL_SUFFIX.length)];
+        }
+        //not (yet) loaded
+        // i.e. first run or upgrade (see: 'prepare'), which is always the default rules
+        else
+        {
+            rulesFile = [INSTALL_DIRECTORY stringByAppendingPathComponent:RULES_FILE];
+        }
+        
+        //save
+        if(YES != [self save:self.rules to:rulesFile])
+        {
             //bail
             goto bail;
         }
         
+        //all changes now in rules file
+        // so reset journal
+        [self.journal reset];
+        
     } //sync
     
     //happy
@@ -1469,7 +1583,183 @@ bail:
     return result;
 }
 
+//save rules to a file
+// either (live) rules, or (not yet active) ones, e.g. a new profile's defaults
+// note: temporary rules are ignored, and caller should hold lock (if rules are active)
+-(BOOL)save:(NSDictionary*)items to:(NSString*)rulesFile
+{
+    //result
+    BOOL result = NO;
+    
+    //error
+    NSError* error = nil;
+    
+    //persistent rules
+    NSMutableDictionary* persistentRules = nil;
+    
+    //archived rules
+    NSData* archivedRules = nil;
+    
+    //dbg msg
+    os_log_debug(logHandle, "saving (non-temp) rules to %{public}@", rulesFile);
+    
+    //init
+    persistentRules = [NSMutableDictionary dictionary];
+    
+    //generate list of non-temp rules
+    // these are the ones we'll write out
+    for(NSString* key in items.allKeys)
+    {
+        //item's rules
+        NSMutableArray* itemRules = nil;
+        
+        //init
+        itemRules = [NSMutableArray array];
+        
+        //add only non-temporary rules
+        for(Rule* itemRule in items[key][KEY_RULES])
+        {
+            //temp?
+            if(YES == [itemRule isTemporary])
+            {
+                //skip
+                continue;
+            }
+            
+            //add
+            [itemRules addObject:itemRule];
+        }
+        
+        //any non-temp rules?
+        // add to rules we're going to write out
+        if(0 != itemRules.count)
+        {
+            //start w/ empty dictionary
+            persistentRules[key] = [NSMutableDictionary dictionary];
+                            
+            //add (non-temp) rules
+            persistentRules[key][KEY_RULES] = itemRules;
+            
+            //add cs info
+            if(nil != items[key][KEY_CS_INFO])
+            {
+                //add
+                persistentRules[key][KEY_CS_INFO] = items[key][KEY_CS_INFO];
+            }
+            
+            //add paths info
+            if(nil != items[key][KEY_PATHS])
+            {
+                //add
+                persistentRules[key][KEY_PATHS] = items[key][KEY_PATHS];
+            }
+        }
+    }
+    
+    //serialize
+    archivedRules = [NSKeyedArchiver archivedDataWithRootObject:persistentRules requiringSecureCoding:YES error:&error];
+    if(nil == archivedRules)
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to serialize rules: %{public}@", error);
+            
+        //bail
+        goto bail;
+    }
+    
+    //dbg msg
+    os_log_debug(logHandle, "serialized rules");
+    
+    //write out rules
+    if(YES != [archivedRules writeToFile:rulesFile atomically:YES])
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to save archived rules to: %{public}@", rulesFile);
+        
+        //bail
+        goto bail;
+    }
+    
+    //happy
+    result = YES;
+    
+bail:
+    
+    return result;
+}
+
+//changes since a generation
+// note: items are returned as is, so caller should archive them while holding the rules lock
+// ...and all containers are mutable, as that's all the app allows when unarchiving (see: '+[Rule archiveClasses]')
+-(NSDictionary*)changesSince:(unsigned long long)generation
+{
+    //changes
+    NSMutableDictionary* changes = nil;
+    
+    //changed keys
+    NSSet* keys = nil;
+    
+    //changed items
+    NSMutableDictionary* items = nil;
+    
+    //removed items
+    NSMutableArray* removed = nil;
+    
+    //init
+    changes = [NSMutableDictionary dictionary];
+    removed = [NSMutableArray array];
+    
+    //sync
+    @synchronized(self)
+    {
+        //get changed keys
+        keys = [self.changes keysSince:generation];
+        
+        //unknown?
+        // client needs everything
+        if(nil == keys)
+        {
+            //dbg msg
+            os_log_debug(logHandle, "generation %llu is unknown (current: %llu), returning all rules", generation, self.changes.generation);
+            
+            //all
+            changes[KEY_RULES_FULL] = @YES;
+            items = self.rules;
+        }
+        
+        //delta
+        else
+        {
+            //init
+            changes[KEY_RULES_FULL] = @NO;
+            items = [NSMutableDictionary dictionary];
+            
+            //split into changed/removed
+            for(NSString* key in keys)
+            {
+                //changed
+                if(nil != self.rules[key]) items[key] = self.rules[key];
+                
+                //removed
+                else [removed addObject:key];
+            }
+            
+            //dbg msg
+            os_log_debug(logHandle, "since generation %llu: %lu changed, %lu removed", generation, (unsigned long)items.count, (unsigned long)removed.count);
+        }
+        
+        //add
+        changes[KEY_RULES_GENERATION] = @(self.changes.generation);
+        changes[KEY_RULES_ITEMS] = items;
+        changes[KEY_RULES_REMOVED] = removed;
+    }
+    
+    return changes;
+}
+
 //import rules
+// one bulk transaction: the new rules (and their index) are built w/o the lock, then swapped in (and saved) at once
+// ...so flow decisions aren't stalled while (e.g. 100Ks of) imported rules are merged & indexed
 -(BOOL)import:(NSData*)importedRules userOnly:(BOOL)userOnly
 {
     //flag
@@ -1478,8 +1768,21 @@ bail:
     //unserialized rules
     NSDictionary* unarchivedRules = nil;
     
+    //(snapshot of) current rules
+    // only for a user-only import, as its non-user rules are kept
+    NSDictionary* currentRules = nil;
+    
+    //generation of snapshot
+    unsigned long long generation = 0;
+    
+    //new rules
+    NSMutableDictionary* newRules = nil;
+    
+    //new index
+    RuleIndex* newIndex = nil;
+    
     //dbg msg
-    os_log_debug(logHandle, "method '%s' invoked with %{public}@", __PRETTY_FUNCTION__, importedRules);
+    os_log_debug(logHandle, "method '%s' invoked with %lu bytes", __PRETTY_FUNCTION__, (unsigned long)importedRules.length);
     
     //sanity check
     if(YES != [importedRules isKindOfClass:[NSData class]])
@@ -1493,7 +1796,8 @@ bail:
     unarchivedRules = [self unarchiveRulesData:importedRules];
 
     //error?
-    if(nil == unarchivedRules)
+    if( (nil == unarchivedRules) ||
+        (YES != [unarchivedRules isKindOfClass:[NSDictionary class]]) )
     {
         //err msg
         os_log_error(logHandle, "ERROR: failed to unarchive (imported) rules");
@@ -1503,63 +1807,65 @@ bail:
     //dbg msg
     os_log_debug(logHandle, "unarchived (imported) %lu rules", (unsigned long)unarchivedRules.count);
     
-    //update
-    @synchronized(self)
+    //user-only import?
+    // snapshot current rules, as their non-user rules are kept
+    if(YES == userOnly)
     {
-        //full update
-        if(!userOnly) {
-            
-            //dbg msg
-            os_log_debug(logHandle, "full import");
-            
-            //update all
-            self.rules = [unarchivedRules mutableCopy];
+        //dbg msg
+        os_log_debug(logHandle, "partial (user-created only) import");
+        
+        //snapshot
+        @synchronized(self)
+        {
+            currentRules = [self snapshot];
+            generation = self.changes.generation;
         }
-        //user-only update
-        else
+    }
+    //full import
+    else
+    {
+        //dbg msg
+        os_log_debug(logHandle, "full import");
+    }
+    
+    //build new rules & index
+    // w/o lock
+    newRules = [self merge:unarchivedRules current:currentRules];
+    newIndex = [[RuleIndex alloc] init:newRules];
+    
+    //swap in
+    @synchronized(self)
+    {
+        //user-only import, and rules changed (e.g. new rule) since snapshot?
+        // rebuild from current rules, now under lock, so that change isn't lost
+        if( (YES == userOnly) &&
+            (generation != self.changes.generation) )
         {
             //dbg msg
-            os_log_debug(logHandle, "partial (user-created only) import");
+            os_log_debug(logHandle, "rules changed during import, (re)merging under lock");
             
-            //first: remove all existing user-created rules
-            for(NSString* key in self.rules.allKeys) {
-                
-                //get rules for key
-                NSMutableArray* existingRules = self.rules[key][KEY_RULES];
-                
-                //remove user-created rules
-                [existingRules filterUsingPredicate:
-                    [NSPredicate predicateWithBlock:^BOOL(Rule* rule, NSDictionary* bindings) {
-                        return (rule.type.intValue != RULE_TYPE_USER);
-                    }]
-                ];
-                
-                //no rules left?
-                // remove entire key
-                if(0 == existingRules.count) {
-                    [self.rules removeObjectForKey:key];
-                }
-            }
-            
-            //second: merge in imported user rules
-            for(NSString* key in unarchivedRules) {
-                
-                //key exists?
-                // (has non-user rules)
-                if(nil != self.rules[key]){
-                    //append imported rules
-                    [self.rules[key][KEY_RULES] addObjectsFromArray:unarchivedRules[key][KEY_RULES]];
-                }
-                //new key
-                else{
-                    //add entire entry
-                    self.rules[key] = [unarchivedRules[key] mutableCopy];
-                }
-            }
+            //rebuild
+            newRules = [self merge:unarchivedRules current:self.rules];
+            newIndex = [[RuleIndex alloc] init:newRules];
         }
+        
+        //swap
+        self.rules = newRules;
+        self.compiledRules = newIndex;
+        
+        //rules changed
+        // so (cached) verdicts are stale
+        [verdictCache invalidate];
+        
+        //(re)track rules that have an expiration
+        [self trackExpirations];
+        
+        //all changed
+        [self.changes changed:nil];
     }
     
     //save
+    // once, for all imported rules
     if(YES != [self save])
     {
         //err msg
@@ -1580,11 +1886,409 @@ bail:
     return result;
 }
 
+//snapshot of rules
+// copies of each item (and its rules), so they can be read w/o the lock
+// note: caller should hold lock
+-(NSDictionary*)snapshot
+{
+    //snapshot
+    NSMutableDictionary* snapshot = [NSMutableDictionary dictionaryWithCapacity:self.rules.count];
+    
+    //copy each item
+    for(NSString* key in self.rules)
+    {
+        //item
+        NSMutableDictionary* item = [self.rules[key] mutableCopy];
+        
+        //copy its rules
+        item[KEY_RULES] = [self.rules[key][KEY_RULES] copy];
+        
+        //add
+        snapshot[key] = item;
+    }
+    
+    return snapshot;
+}
+
+//merge imported rules
+// into (new) items w/ any current non-user rules (user-only import), validating each as it's added
+// note: current rules aren't modified, so this can run w/o the lock on a snapshot
+-(NSMutableDictionary*)merge:(NSDictionary*)importedRules current:(NSDictionary*)currentRules
+{
+    //merged rules
+    NSMutableDictionary* mergedRules = nil;
+    
+    //init
+    mergedRules = [NSMutableDictionary dictionaryWithCapacity:importedRules.count + currentRules.count];
+    
+    //first: current items' non-user rules
+    for(NSString* key in currentRules)
+    {
+        //non-user rules
+        NSMutableArray* keptRules = [NSMutableArray array];
+        
+        //item
+        NSMutableDictionary* item = nil;
+        
+        //keep non-user rules
+        for(Rule* rule in currentRules[key][KEY_RULES])
+        {
+            if(RULE_TYPE_USER != rule.type.intValue) [keptRules addObject:rule];
+        }
+        
+        //no rules left?
+        // skip entire item
+        if(0 == keptRules.count) continue;
+        
+        //(new) item
+        // note: paths are shared, as current item is replaced
+        item = [currentRules[key] mutableCopy];
+        item[KEY_RULES] = keptRules;
+        
+        //add
+        mergedRules[key] = item;
+    }
+    
+    //second: imported rules
+    for(NSString* key in importedRules)
+    {
+        //imported item
+        NSDictionary* importedItem = importedRules[key];
+        
+        //item
+        NSMutableDictionary* item = nil;
+        
+        //sanity check
+        if( (YES != [key isKindOfClass:[NSString class]]) ||
+            (YES != [importedItem isKindOfClass:[NSDictionary class]]) ||
+            (YES != [importedItem[KEY_RULES] isKindOfClass:[NSArray class]]) )
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: invalid (imported) item: %{public}@", key);
+            continue;
+        }
+        
+        //existing item?
+        // (has non-user rules)
+        item = mergedRules[key];
+        if(nil == item)
+        {
+            //first rule
+            Rule* firstRule = [importedItem[KEY_RULES] firstObject];
+            
+            //(new) item
+            item = [importedItem mutableCopy];
+            item[KEY_RULES] = [NSMutableArray arrayWithCapacity:[importedItem[KEY_RULES] count]];
+            
+            //(mutable) copy of 'external' paths
+            if(YES == [importedItem[KEY_PATHS] isKindOfClass:[NSSet class]])
+            {
+                //copy
+                item[KEY_PATHS] = [importedItem[KEY_PATHS] mutableCopy];
+            }
+            
+            //no paths?
+            // make sure it has a set for them, as done on load (unless global or directory rules)
+            else if( (YES != [key isEqualToString:VALUE_ANY]) &&
+                     (YES != ([firstRule isKindOfClass:[Rule class]] && firstRule.isDirectory.boolValue)) )
+            {
+                //alloc
+                item[KEY_PATHS] = [NSMutableSet set];
+            }
+            
+            //global/directory rules (or invalid paths)
+            // no paths
+            else
+            {
+                //remove
+                [item removeObjectForKey:KEY_PATHS];
+            }
+        }
+        
+        //add each rule
+        for(Rule* rule in importedItem[KEY_RULES])
+        {
+            //sanity check
+            if(YES != [rule isKindOfClass:[Rule class]])
+            {
+                //err msg
+                os_log_error(logHandle, "ERROR: invalid (imported) rule for %{public}@", key);
+                continue;
+            }
+            
+            //add
+            [item[KEY_RULES] addObject:rule];
+        }
+        
+        //add
+        // unless (new item) w/o any (valid) rules
+        if(0 != [item[KEY_RULES] count]) mergedRules[key] = item;
+    }
+    
+    return mergedRules;
+}
+
+//(re)track all rules that have an expiration
+// e.g. once rules are (re)loaded or imported, then (re)arm timer
+// note: caller should hold lock
+-(void)trackExpirations
+{
+    //reset
+    [expirations removeAllRules];
+    
+    //add each
+    for(NSString* key in self.rules)
+    {
+        for(Rule* rule in self.rules[key][KEY_RULES])
+        {
+            [expirations add:rule];
+        }
+    }
+    
+    //dbg msg
+    os_log_debug(logHandle, "tracking %lu rules w/ an expiration", (unsigned long)expirations.count);
+    
+    //(re)arm
+    [self armExpirationTimer];
+    
+    return;
+}
+
+//(re)arm expiration timer
+// for next expiration, or never (if none)
+// note: caller should hold lock
+-(void)armExpirationTimer
+{
+    //next
+    NSDate* next = expirations.next;
+    
+    //wall time
+    struct timespec when = {0};
+    
+    //none?
+    if(nil == next)
+    {
+        //disarm
+        dispatch_source_set_timer(expirationTimer, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+        return;
+    }
+    
+    //init wall time
+    // (vs. uptime), so a sleep doesn't delay it
+    when.tv_sec = (time_t)next.timeIntervalSince1970;
+    when.tv_nsec = (long)((next.timeIntervalSince1970 - when.tv_sec) * NSEC_PER_SEC);
+    
+    //arm
+    // w/ leeway, as any rules within the (batching) window will be expired together anyways
+    dispatch_source_set_timer(expirationTimer, dispatch_walltime(&when, 0), DISPATCH_TIME_FOREVER, (uint64_t)(RULE_EXPIRATION_WINDOW * NSEC_PER_SEC));
+    
+    return;
+}
+
+//schedule expiration (now)
+// async, on the expiration timer's queue, as it saves & tells the user, so shouldn't be done on a flow thread
+// note: only once, until it runs, no matter how many lookups see an expired rule
+-(void)scheduleExpire
+{
+    //already scheduled?
+    if(YES == atomic_exchange(&expirationPending, YES)) return;
+    
+    //expire
+    dispatch_async(dispatch_get_main_queue(), ^{
+        
+        //reset
+        atomic_store(&self->expirationPending, NO);
+        
+        //expire
+        [self expire:[NSDate date]];
+    });
+    
+    return;
+}
+
+//delete all expired rules
+// one batch: rules are removed & reindexed once, then saved (once), and user told (once)
+-(NSUInteger)expire:(NSDate*)now
+{
+    //expired rules
+    NSMutableArray<Rule*>* expired = nil;
+    
+    //init
+    expired = [NSMutableArray array];
+    
+    //sync
+    @synchronized(self)
+    {
+        //remove each that's due
+        for(Rule* rule in [expirations due:now])
+        {
+            //already deleted (e.g. by user)?
+            if(NSNotFound == [self.rules[rule.key][KEY_RULES] indexOfObjectIdenticalTo:rule]) continue;
+            
+            //dbg msg
+            os_log_debug(logHandle, "rule's expiration has hit (%{public}@) - will delete rule", rule.expiration);
+            
+            //remove
+            [self remove:rule.key rule:rule.uuid in:self.rules];
+            
+            //changed
+            [self.changes changed:rule.key];
+            
+            //save
+            [expired addObject:rule];
+        }
+        
+        //(re)build index
+        // just the expired rules' keys
+        if(0 != expired.count) [self reindex:[NSSet setWithArray:[expired valueForKey:@"key"]]];
+        
+        //(re)arm for next
+        [self armExpirationTimer];
+    }
+    
+    //none?
+    if(0 == expired.count) return 0;
+    
+    //dbg msg
+    os_log_debug(logHandle, "expired %lu rule(s)", (unsigned long)expired.count);
+    
+    //save (once)
+    if(YES != [self save])
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to save rules (after expiring %lu)", (unsigned long)expired.count);
+    }
+    
+    //tell user rules changed (once)
+    [alerts.xpcUserClient rulesChanged];
+    
+    return expired.count;
+}
+
+//watch for a process (temporary) rule's process to exit
+// rules are indexed by pid, w/ one watch per process (no matter how many of its rules)
+-(void)watchProcess:(Rule*)rule
+{
+    //pid
+    pid_t pid = rule.pid.intValue;
+    
+    //token
+    // for pid version
+    NSData* token = nil;
+    
+    //watch
+    id watch = nil;
+    
+    //exited?
+    BOOL exited = NO;
+    
+    //weak self
+    __weak typeof(self) weakSelf = self;
+    
+    //sync
+    @synchronized(self)
+    {
+        //already watching?
+        // just add rule
+        if(nil != processRules[@(pid)])
+        {
+            [processRules[@(pid)] addObject:rule];
+            return;
+        }
+        
+        //get token
+        // for (current) pid version, so a reused pid isn't mistaken for the rule's process
+        token = tokenForPid(pid);
+        
+        //watch
+        watch = [exitMonitor watch:pid version:(nil != token) ? audit_token_to_pidversion(*(audit_token_t*)token.bytes) : 0 handler:^{
+            
+            //dbg msg
+            os_log_debug(logHandle, "process %d exited, will delete its (temporary) rules", pid);
+            
+            //remove, and if any, tell user rules changed
+            if(0 != [weakSelf removeProcessRules:pid]) [alerts.xpcUserClient rulesChanged];
+        }];
+        
+        //save
+        processRules[@(pid)] = [NSMutableArray arrayWithObject:rule];
+        if(nil != watch) processWatches[@(pid)] = watch;
+        
+        //already exited?
+        // (note: nil monitor, e.g. tests, means exits just aren't watched)
+        exited = ( (nil == watch) && (nil != exitMonitor) );
+    }
+    
+    //already exited?
+    // remove now
+    if(YES == exited)
+    {
+        //dbg msg
+        os_log_debug(logHandle, "process %d already exited, will delete its (temporary) rules", pid);
+        
+        //remove
+        [self removeProcessRules:pid];
+    }
+    
+    return;
+}
+
+//remove a process' (temporary) rules
+// via pid index, so no need to walk all rules
+// one batch: rules are removed & reindexed once, and as they were never saved, nothing is journaled (or saved)
+-(NSUInteger)removeProcessRules:(pid_t)pid
+{
+    //rules
+    NSArray<Rule*>* pidRules = nil;
+    
+    //deleted rules
+    NSMutableArray<Rule*>* deleted = nil;
+    
+    //init
+    deleted = [NSMutableArray array];
+    
+    //sync
+    @synchronized(self)
+    {
+        //grab & remove
+        pidRules = processRules[@(pid)];
+        [processRules removeObjectForKey:@(pid)];
+        [processWatches removeObjectForKey:@(pid)];
+        
+        //remove each
+        for(Rule* rule in pidRules)
+        {
+            //already deleted (e.g. by user, or a full cleanup)?
+            if(NSNotFound == [self.rules[rule.key][KEY_RULES] indexOfObjectIdenticalTo:rule]) continue;
+            
+            //remove
+            [self remove:rule.key rule:rule.uuid in:self.rules];
+            
+            //changed
+            [self.changes changed:rule.key];
+            
+            //save
+            [deleted addObject:rule];
+        }
+        
+        //(re)build index
+        // just the deleted rules' keys
+        if(0 != deleted.count) [self reindex:[NSSet setWithArray:[deleted valueForKey:@"key"]]];
+    }
+    
+    //dbg msg
+    if(0 != deleted.count) os_log_debug(logHandle, "removed %lu rule(s) of (exited) process %d", (unsigned long)deleted.count, pid);
+    
+    return deleted.count;
+}
+
 //cleanup
 // a) rule expired
 // a) path was deleted
 // b) point to non-existent processes (temp rule)
--(NSUInteger)cleanup:(BOOL)full
+// paths are snapshot (under lock), checked in parallel (w/o lock), then all deletions are applied in one (locked) batch w/ one save
+// ...so flow decisions aren't stalled behind (slow, e.g. network) file system checks
+-(NSDictionary*)cleanup:(BOOL)full
 {
     //count
     NSUInteger deletedRules = 0;
@@ -1592,44 +2296,57 @@ bail:
     //rules to delete
     NSMutableArray* rules2Delete = nil;
     
+    //rules (snapshot)
+    // key: item key, value: its rules
+    NSMutableDictionary<NSString*, NSArray<Rule*>*>* snapshot = nil;
+    
+    //'external' paths (snapshot)
+    NSMutableDictionary<NSString*, NSSet<NSString*>*>* snapshotPaths = nil;
+    
+    //paths to check
+    NSMutableSet<NSString*>* checkPaths = nil;
+    
+    //missing (deleted) paths
+    NSSet<NSString*>* missing = nil;
+    
+    //path checker
+    PathChecker* pathChecker = nil;
+    
+    //start
+    NSDate* start = nil;
+    
+    //phase start
+    NSDate* phaseStart = nil;
+    
+    //time under lock
+    NSTimeInterval lockTime = 0;
+    
+    //time checking paths
+    NSTimeInterval checkTime = 0;
+    
     //dbg msg
     os_log_debug(logHandle, "cleaning up rules (full?: %d)", full);
     
     //alloc
     rules2Delete = [NSMutableArray array];
+    snapshot = [NSMutableDictionary dictionary];
+    snapshotPaths = [NSMutableDictionary dictionary];
+    checkPaths = [NSMutableSet set];
     
-    //sync to access
+    //init
+    start = [NSDate date];
+    
+    //sync to snapshot
     @synchronized(self)
     {
         //gather all rules
-        for(NSString* key in self.rules.allKeys)
+        for(NSString* key in self.rules)
         {
-            //paths
-            NSArray* paths = nil;
-            
-            //path
-            NSString* path = nil;
-            
             //rules for item
-            NSArray* rules = nil;
+            NSArray* rules = [self.rules[key][KEY_RULES] copy];
             
             //(first) rule
-            Rule* rule = nil;
-            
-            //flag
-            BOOL allDeleted = YES;
-            
-            //interval for expiration check
-            NSTimeInterval timeInterval = 0;
-            
-            //extract 'external' paths
-            paths = self.rules[key][KEY_PATHS];
-            
-            //extract rules for item
-            rules = self.rules[key][KEY_RULES];
-            
-            //extract (first) rule
-            rule = rules.firstObject;
+            Rule* rule = rules.firstObject;
             
             //skip global rules
             if(YES == rule.isGlobal.boolValue)
@@ -1638,120 +2355,199 @@ bail:
                 continue;
             }
             
+            //save
+            snapshot[key] = rules;
+            snapshotPaths[key] = [self.rules[key][KEY_PATHS] copy];
+            
             //only do path checks on full cleanup
-            if(full)
+            if(YES != full)
             {
-                //directory rule?
-                // check if directory has been deleted
-                if(YES == rule.isDirectory.boolValue)
-                {
-                    //directory rules end in /*
-                    // so first remove the trailing '*'
-                    path = [rule.path substringToIndex:rule.path.length - 1];
-                    
-                    //was directory deleted?
-                    if(YES != [NSFileManager.defaultManager fileExistsAtPath:path])
-                    {
-                        //dbg msg
-                        os_log_debug(logHandle, "%{public}@ is gone, will delete directory rule", path);
-                        
-                        //add to list
-                        [rules2Delete addObject:rule];
-                    }
-                    
-                    //next
-                    continue;
-                }
-                
-                //for (normal) item rules
-                // first set flag if all 'external' paths have been deleted
-                for(NSString* path in paths)
-                {
-                    //path still there?
-                    if(YES == [NSFileManager.defaultManager fileExistsAtPath:path])
-                    {
-                        //toggle
-                        allDeleted = NO;
-                        
-                        //done
-                        break;
-                    }
-                }
+                continue;
+            }
+            
+            //directory rule?
+            // directory rules end in /*, so first remove the trailing '*'
+            if(YES == rule.isDirectory.boolValue)
+            {
+                [checkPaths addObject:[rule.path substringToIndex:rule.path.length - 1]];
+                continue;
             }
             
-            //check each rule's 'internal' path
-            // and expiration, and process id (temp rules)
+            //'external' paths
+            [checkPaths unionSet:snapshotPaths[key]];
+            
+            //each rule's 'internal' path
             for(Rule* rule in rules)
             {
-                //only do path checks on full cleanup
-                if(full)
-                {
-                    //was path deleted?
-                    // and all 'external' paths too?
-                    if( (YES == allDeleted) &&
-                       (YES != [NSFileManager.defaultManager fileExistsAtPath:rule.path]))
-                    {
-                        //dbg msg
-                        os_log_debug(logHandle, "%{public}@ is gone - will delete rule", rule.path);
-                        
-                        //add to list
-                        [rules2Delete addObject:rule];
-                        
-                        //next
-                        continue;
-                    }
-                }
-                
-                //did process (for temp rule) exit?
-                if( (YES == [rule isTemporary]) &&
-                    (YES != isAlive(rule.pid.intValue)) )
+                if(nil != rule.path) [checkPaths addObject:rule.path];
+            }
+        }
+    }
+    
+    //update
+    lockTime += [[NSDate date] timeIntervalSinceDate:start];
+    
+    //check paths
+    // in parallel, w/o lock
+    if(YES == full)
+    {
+        //init
+        phaseStart = [NSDate date];
+        pathChecker = [[PathChecker alloc] init];
+        
+        //check
+        missing = [pathChecker missing:checkPaths];
+        checkTime = [[NSDate date] timeIntervalSinceDate:phaseStart];
+        
+        //dbg msg
+        os_log_debug(logHandle, "checked %lu paths (on %lu volumes) in %.2f seconds: %lu are gone", (unsigned long)pathChecker.checked, (unsigned long)pathChecker.volumes, checkTime, (unsigned long)missing.count);
+    }
+    
+    //find rules to delete
+    for(NSString* key in snapshot)
+    {
+        //rules for item
+        NSArray* rules = snapshot[key];
+        
+        //(first) rule
+        Rule* rule = rules.firstObject;
+        
+        //flag
+        BOOL allDeleted = YES;
+        
+        //only do path checks on full cleanup
+        if(YES == full)
+        {
+            //directory rule?
+            // check if directory has been deleted
+            if(YES == rule.isDirectory.boolValue)
+            {
+                //was directory deleted?
+                if(YES == [missing containsObject:[rule.path substringToIndex:rule.path.length - 1]])
                 {
                     //dbg msg
-                    os_log_debug(logHandle, "process-level (temporary) rule's process (%@) has exited - will delete rule", rule.pid);
+                    os_log_debug(logHandle, "%{public}@ is gone, will delete directory rule", rule.path);
                     
                     //add to list
                     [rules2Delete addObject:rule];
-                    
-                    //next
-                    continue;
                 }
                 
-                //did rule expire?
-                if(nil != rule.expiration)
+                //next
+                continue;
+            }
+            
+            //for (normal) item rules
+            // first set flag if all 'external' paths have been deleted
+            for(NSString* path in snapshotPaths[key])
+            {
+                //path still there?
+                if(YES != [missing containsObject:path])
                 {
-                    //compute interval
-                    // and check if it expired
-                    timeInterval = [rule.expiration timeIntervalSinceNow];
-                    if(timeInterval <= 0)
-                    {
-                        //dbg msg
-                        os_log_debug(logHandle, "rule's expiration has hit (%@) - will delete rule", rule.expiration);
-                        
-                        //add to list
-                        [rules2Delete addObject:rule];
-                        
-                        //next
-                        continue;
-                    }
+                    //toggle
+                    allDeleted = NO;
+                    
+                    //done
+                    break;
                 }
             }
         }
+        
+        //check each rule's 'internal' path
+        // and expiration, and process id (temp rules)
+        for(Rule* rule in rules)
+        {
+            //was path deleted?
+            // and all 'external' paths too?
+            if( (YES == full) &&
+                (YES == allDeleted) &&
+                (nil != rule.path) &&
+                (YES == [missing containsObject:rule.path]) )
+            {
+                //dbg msg
+                os_log_debug(logHandle, "%{public}@ is gone - will delete rule", rule.path);
+                
+                //add to list
+                [rules2Delete addObject:rule];
+                
+                //next
+                continue;
+            }
+            
+            //did process (for temp rule) exit?
+            if( (YES == [rule isTemporary]) &&
+                (YES != isAlive(rule.pid.intValue)) )
+            {
+                //dbg msg
+                os_log_debug(logHandle, "process-level (temporary) rule's process (%@) has exited - will delete rule", rule.pid);
+                
+                //add to list
+                [rules2Delete addObject:rule];
+                
+                //next
+                continue;
+            }
+            
+            //did rule expire?
+            if( (nil != rule.expiration) &&
+                ([rule.expiration timeIntervalSinceNow] <= 0) )
+            {
+                //dbg msg
+                os_log_debug(logHandle, "rule's expiration has hit (%@) - will delete rule", rule.expiration);
+                
+                //add to list
+                [rules2Delete addObject:rule];
+                
+                //next
+                continue;
+            }
+        }
     }
     
-    //save count
-    deletedRules = rules2Delete.count;
+    //init
+    phaseStart = [NSDate date];
     
-    //now delete each
-    for(Rule* rule in rules2Delete)
+    //sync to delete
+    // all at once, then (re)index once
+    @synchronized(self)
     {
-        //delete
-        [self delete:rule.key rule:rule.uuid];
+        //delete each
+        for(Rule* rule in rules2Delete)
+        {
+            //already deleted (e.g. by user, or its process exit)?
+            if(NSNotFound == [self.rules[rule.key][KEY_RULES] indexOfObjectIdenticalTo:rule]) continue;
+            
+            //remove
+            [self remove:rule.key rule:rule.uuid in:self.rules];
+            
+            //changed
+            [self.changes changed:rule.key];
+            
+            //inc
+            deletedRules++;
+        }
+        
+        //(re)build index
+        // just the deleted rules' keys
+        if(0 != deletedRules) [self reindex:[NSSet setWithArray:[rules2Delete valueForKey:@"key"]]];
+    }
+    
+    //update
+    lockTime += [[NSDate date] timeIntervalSinceDate:phaseStart];
+    
+    //save (once)
+    if( (0 != deletedRules) &&
+        (YES != [self save]) )
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to save rules (after cleaning up %lu)", (unsigned long)deletedRules);
     }
     
     //dbg msg
     os_log_debug(logHandle, "cleaned up/deleted %ld rules", (long)deletedRules);
     
-    return deletedRules;
+    //report
+    // counts, and timings (seconds)
+    return @{KEY_CLEANUP_DELETED:@(deletedRules), KEY_CLEANUP_ITEMS:@(snapshot.count), KEY_CLEANUP_PATHS:@(checkPaths.count), KEY_CLEANUP_MISSING:@(missing.count), KEY_CLEANUP_VOLUMES:@(pathChecker.volumes), KEY_CLEANUP_CHECK_TIME:@(checkTime), KEY_CLEANUP_LOCK_TIME:@(lockTime), KEY_CLEANUP_TIME:@([[NSDate date] timeIntervalSinceDate:start])};
 }
 
 @end
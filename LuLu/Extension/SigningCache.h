@@ -0,0 +1,64 @@
+//
+//  file: SigningCache.h
+//  project: LuLu (launch daemon)
+//  description: cache of code signing results (header)
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#ifndef SigningCache_h
+#define SigningCache_h
+
+@import OSLog;
+@import Foundation;
+
+#import <bsm/libbsm.h>
+
+//max number of (cached) results
+#define SIGNING_CACHE_COUNT_LIMIT 4096
+
+//delay before saving (seconds)
+// coalesces saves when many new items are seen at once
+#define SIGNING_CACHE_SAVE_DELAY 30
+
+//generator of signing info
+// e.g. a (full) code signing check, only invoked on a miss
+typedef NSMutableDictionary* _Nullable (^SigningInfoGenerator)(void);
+
+//persistent, bounded cache of (valid) code signing results
+// key: file identity (device, inode, modification time, size), flags, and, for running processes, the cdhash
+// a file that's changed (replaced, modified) has a new identity so always misses, and its old entry is dropped
+// least recently used entries are evicted once over the count limit
+@interface SigningCache : NSObject
+
+/* PROPERTIES */
+
+//number of entries
+@property(nonatomic, readonly)NSUInteger count;
+
+//number of hits
+@property(nonatomic, readonly)uint64_t hits;
+
+//number of misses
+@property(nonatomic, readonly)uint64_t misses;
+
+//number of entries dropped as their file changed
+@property(nonatomic, readonly)uint64_t invalidations;
+
+/* METHODS */
+
+//init
+// loads any saved results from file (nil: in memory only)
+-(id _Nonnull)init:(NSString* _Nullable)file;
+
+//signing info for an item
+// token: running process (its cdhash is part of key), or NULL for static (on-disk) checks
+// returns cached result, or result from generator (cached if valid)
+-(NSMutableDictionary* _Nullable)signingInfo:(NSString* _Nonnull)path token:(audit_token_t* _Nullable)token flags:(uint32_t)flags generator:(SigningInfoGenerator _Nonnull)generator;
+
+//save (now)
+-(BOOL)save;
+
+@end
+
+#endif /* SigningCache_h */
@@ -0,0 +1,332 @@
+//
+//  file: SigningCache.m
+//  project: LuLu (launch daemon)
+//  description: cache of code signing results
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#import "consts.h"
+#import "SigningCache.h"
+
+#import <sys/stat.h>
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+//code signing ops
+// see: xnu's bsd/sys/codesign.h
+#define CS_OPS_STATUS 0
+#define CS_OPS_CDHASH 5
+
+//code signing status: valid
+#define CS_VALID 0x00000001
+
+//cdhash length
+#define CS_CDHASH_LEN 20
+
+//(private) code signing ops, via audit token
+int csops_audittoken(pid_t pid, unsigned int ops, void* useraddr, size_t usersize, audit_token_t* token);
+
+//keys for (saved) entries
+#define KEY_ENTRY_INFO @"info"
+#define KEY_ENTRY_PATH @"path"
+#define KEY_ENTRY_USED @"used"
+
+//key for (saved) entries
+#define KEY_SIGNING_CACHE_ENTRIES @"entries"
+
+//key for (saved) version
+#define KEY_SIGNING_CACHE_VERSION @"version"
+
+//version
+// bump if key or entry format changes
+#define SIGNING_CACHE_VERSION 1
+
+@implementation SigningCache
+{
+    //file
+    NSString* file;
+    
+    //entries
+    // key: identity, value: info, path, last used
+    NSMutableDictionary<NSString*, NSMutableDictionary*>* entries;
+    
+    //(current) identity of each path
+    NSMutableDictionary<NSString*, NSString*>* identities;
+    
+    //flag
+    // save is scheduled
+    BOOL saveScheduled;
+}
+
+@synthesize hits;
+@synthesize misses;
+@synthesize invalidations;
+
+//init
+-(id)init:(NSString*)cacheFile
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //saved cache
+        NSDictionary* saved = nil;
+        
+        //save file
+        file = cacheFile;
+        
+        //init
+        entries = [NSMutableDictionary dictionary];
+        identities = [NSMutableDictionary dictionary];
+        
+        //load
+        if(nil != file) saved = [NSDictionary dictionaryWithContentsOfFile:file];
+        
+        //ignore other versions
+        if(SIGNING_CACHE_VERSION == [saved[KEY_SIGNING_CACHE_VERSION] intValue])
+        {
+            //add each
+            [saved[KEY_SIGNING_CACHE_ENTRIES] enumerateKeysAndObjectsUsingBlock:^(NSString* key, NSDictionary* entry, BOOL* stop) {
+                
+                //sanity check
+                if( (YES != [entry isKindOfClass:[NSDictionary class]]) ||
+                    (nil == entry[KEY_ENTRY_INFO]) ||
+                    (nil == entry[KEY_ENTRY_PATH]) ) return;
+                
+                //add
+                self->entries[key] = [entry mutableCopy];
+                self->identities[entry[KEY_ENTRY_PATH]] = key;
+            }];
+            
+            //dbg msg
+            os_log_debug(logHandle, "loaded %lu (cached) signing results from %{public}@", (unsigned long)entries.count, file);
+        }
+    }
+    
+    return self;
+}
+
+//number of entries
+-(NSUInteger)count
+{
+    @synchronized(self) {
+        return entries.count;
+    }
+}
+
+//build identity
+// device, inode, modification time, size, flags, and (for running processes) cdhash
+// returns nil if item can't be identified, or (running) process isn't validly signed
+-(NSString*)identity:(NSString*)path token:(audit_token_t*)token flags:(uint32_t)flags
+{
+    //stat
+    struct stat info = {0};
+    
+    //code signing status
+    uint32_t status = 0;
+    
+    //cdhash
+    unsigned char cdhash[CS_CDHASH_LEN] = {0};
+    
+    //cdhash (as string)
+    NSMutableString* cdhashString = nil;
+    
+    //stat
+    if(0 != stat(path.fileSystemRepresentation, &info)) return nil;
+    
+    //running process?
+    // kernel has to (still) consider it validly signed, and its cdhash is part of the key
+    if(NULL != token)
+    {
+        //get status
+        if( (0 != csops_audittoken(audit_token_to_pid(*token), CS_OPS_STATUS, &status, sizeof(status), token)) ||
+            (CS_VALID != (status & CS_VALID)) ) return nil;
+        
+        //get cdhash
+        if(0 != csops_audittoken(audit_token_to_pid(*token), CS_OPS_CDHASH, cdhash, sizeof(cdhash), token)) return nil;
+        
+        //convert
+        cdhashString = [NSMutableString string];
+        for(int i = 0; i < CS_CDHASH_LEN; i++) [cdhashString appendFormat:@"%02x", cdhash[i]];
+    }
+    
+    return [NSString stringWithFormat:@"%d:%llu:%ld.%09ld:%lld:%x:%@", info.st_dev, (unsigned long long)info.st_ino, (long)info.st_mtimespec.tv_sec, (long)info.st_mtimespec.tv_nsec, (long long)info.st_size, flags, (nil != cdhashString) ? cdhashString : @"static"];
+}
+
+//signing info for an item
+-(NSMutableDictionary*)signingInfo:(NSString*)path token:(audit_token_t*)token flags:(uint32_t)flags generator:(SigningInfoGenerator)generator
+{
+    //identity
+    NSString* identity = nil;
+    
+    //signing info
+    NSMutableDictionary* signingInfo = nil;
+    
+    //key of paths
+    // static and dynamic results are cached separately
+    NSString* pathKey = nil;
+    
+    //build identity
+    identity = [self identity:path token:token flags:flags];
+    
+    //can't identify?
+    // just generate (and don't cache)
+    if(nil == identity)
+    {
+        //stats
+        @synchronized(self) { misses++; }
+        
+        return generator();
+    }
+    
+    //init path key
+    pathKey = [NSString stringWithFormat:@"%@:%x:%d", path, flags, (NULL != token)];
+    
+    //sync
+    @synchronized(self) {
+        
+        //hit?
+        signingInfo = entries[identity][KEY_ENTRY_INFO];
+        if(nil != signingInfo)
+        {
+            //stats
+            hits++;
+            
+            //update last used
+            entries[identity][KEY_ENTRY_USED] = @(NSDate.date.timeIntervalSince1970);
+            
+            //(mutable) copy
+            return [signingInfo mutableCopy];
+        }
+        
+        //stats
+        misses++;
+    }
+    
+    //generate
+    // note: not under lock, as it's (relatively) slow
+    signingInfo = generator();
+    
+    //only cache valid results
+    // as failures can be transient (e.g. process exited)
+    if( (nil == signingInfo[KEY_CS_STATUS]) ||
+        (noErr != [signingInfo[KEY_CS_STATUS] intValue]) )
+    {
+        return signingInfo;
+    }
+    
+    //sync
+    @synchronized(self) {
+        
+        //file changed?
+        // drop entry for its old identity
+        if( (nil != identities[pathKey]) &&
+            (YES != [identities[pathKey] isEqualToString:identity]) )
+        {
+            //dbg msg
+            os_log_debug(logHandle, "%{public}@ changed, dropping (cached) signing result", path);
+            
+            //drop
+            [entries removeObjectForKey:identities[pathKey]];
+            invalidations++;
+        }
+        
+        //add
+        entries[identity] = [@{KEY_ENTRY_INFO:[signingInfo copy], KEY_ENTRY_PATH:pathKey, KEY_ENTRY_USED:@(NSDate.date.timeIntervalSince1970)} mutableCopy];
+        identities[pathKey] = identity;
+        
+        //over limit?
+        if(entries.count > SIGNING_CACHE_COUNT_LIMIT) [self evict];
+        
+        //schedule save
+        [self scheduleSave];
+    }
+    
+    return signingInfo;
+}
+
+//evict least recently used entries
+// drops oldest ~10%, so eviction (a sort) is infrequent
+// note: caller should hold lock
+-(void)evict
+{
+    //keys
+    // sorted by last use
+    NSArray* keys = nil;
+    
+    //sort
+    keys = [entries keysSortedByValueUsingComparator:^NSComparisonResult(NSDictionary* first, NSDictionary* second) {
+        return [first[KEY_ENTRY_USED] compare:second[KEY_ENTRY_USED]];
+    }];
+    
+    //drop oldest
+    for(NSString* key in [keys subarrayWithRange:NSMakeRange(0, keys.count - (SIGNING_CACHE_COUNT_LIMIT * 9 / 10))])
+    {
+        //drop path's identity
+        [identities removeObjectForKey:entries[key][KEY_ENTRY_PATH]];
+        
+        //drop
+        [entries removeObjectForKey:key];
+    }
+}
+
+//schedule save
+// note: caller should hold lock
+-(void)scheduleSave
+{
+    //weak self
+    __weak typeof(self) weakSelf = self;
+    
+    //no file or already scheduled?
+    if( (nil == file) || (YES == saveScheduled) ) return;
+    
+    //set flag
+    saveScheduled = YES;
+    
+    //save (later)
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(SIGNING_CACHE_SAVE_DELAY * NSEC_PER_SEC)), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0), ^{
+        [weakSelf save];
+    });
+}
+
+//save
+-(BOOL)save
+{
+    //flag
+    BOOL saved = NO;
+    
+    //snapshot
+    NSDictionary* snapshot = nil;
+    
+    //sync
+    @synchronized(self) {
+        
+        //reset flag
+        saveScheduled = NO;
+        
+        //no file?
+        if(nil == file) return NO;
+        
+        //snapshot
+        snapshot = @{KEY_SIGNING_CACHE_VERSION:@SIGNING_CACHE_VERSION, KEY_SIGNING_CACHE_ENTRIES:[[NSDictionary alloc] initWithDictionary:entries copyItems:YES]};
+    }
+    
+    //save
+    saved = [snapshot writeToFile:file atomically:YES];
+    if(YES != saved)
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to save signing cache to %{public}@", file);
+    }
+    
+    //dbg msg
+    os_log_debug(logHandle, "saved signing cache (%lu entries, hits: %llu, misses: %llu, invalidations: %llu)", (unsigned long)[snapshot[KEY_SIGNING_CACHE_ENTRIES] count], self.hits, self.misses, self.invalidations);
+    
+    return saved;
+}
+
+@end
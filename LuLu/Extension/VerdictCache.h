@@ -0,0 +1,60 @@
+//
+//  file: VerdictCache.h
+//  project: LuLu (launch daemon)
+//  description: cache of flow verdicts (header)
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#ifndef VerdictCache_h
+#define VerdictCache_h
+
+@import OSLog;
+@import Foundation;
+@import NetworkExtension;
+
+//number of shards
+// each w/ its own lock, so concurrent flows rarely contend
+#define VERDICT_CACHE_SHARDS 16
+
+//max number of (cached) verdicts, per shard
+#define VERDICT_CACHE_SHARD_SIZE 256
+
+//bounded, sharded cache of flow verdicts
+// key: process (pid + pid version, from flow's audit token), remote endpoint, URL, port, and protocol
+// entries are tagged w/ the generation they were computed in, and any change to rules, preferences,
+// profiles, lists, or the console user bumps the generation, so stale verdicts are never returned
+@interface VerdictCache : NSObject
+
+/* PROPERTIES */
+
+//current generation
+@property(nonatomic, readonly)uint64_t generation;
+
+//number of hits
+@property(nonatomic, readonly)uint64_t hits;
+
+//number of misses
+@property(nonatomic, readonly)uint64_t misses;
+
+/* METHODS */
+
+//build key for a flow
+// returns nil if flow's process can't be identified
++(NSString*)keyForFlow:(NEFilterSocketFlow*)flow;
+
+//lookup verdict
+// returns NO on miss (or if cached verdict is from an older generation)
+-(BOOL)lookup:(NSString*)key verdict:(NSInteger*)verdict;
+
+//store verdict
+// ignored if generation has changed since verdict's evaluation started
+-(void)store:(NSString*)key verdict:(NSInteger)verdict generation:(uint64_t)generation;
+
+//invalidate all (cached) verdicts
+// invoke on any change that could alter a verdict
+-(void)invalidate;
+
+@end
+
+#endif /* VerdictCache_h */
@@ -0,0 +1,294 @@
+//
+//  file: VerdictCache.m
+//  project: LuLu (launch daemon)
+//  description: cache of flow verdicts
+//
+//  copyright (c) 2017 Objective-See. All rights reserved.
+//
+
+#import "VerdictCache.h"
+
+#import <stdatomic.h>
+#import <bsm/libbsm.h>
+@import SystemConfiguration;
+
+/* GLOBALS */
+
+//log handle
+extern os_log_t logHandle;
+
+//bits for verdict
+// cached values are: (generation << VERDICT_BITS) | verdict
+#define VERDICT_BITS 4
+
+//shard
+// two generations of entries: new/promoted entries go in 'recent', and when it fills
+// it becomes 'older' (dropping the previous 'older'), so size is bounded w/o tracking recency per entry
+@interface VerdictCacheShard : NSObject
+
+//recent entries
+@property(nonatomic, retain)NSMutableDictionary* recent;
+
+//older entries
+@property(nonatomic, retain)NSMutableDictionary* older;
+
+@end
+
+@implementation VerdictCacheShard
+
+-(id)init
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //init
+        self.recent = [NSMutableDictionary dictionary];
+        self.older = [NSMutableDictionary dictionary];
+    }
+    
+    return self;
+}
+
+//add entry
+// note: caller should hold the shard lock
+-(void)add:(NSString*)key value:(NSNumber*)value
+{
+    //full?
+    // rotate: recent -> older
+    if(self.recent.count >= VERDICT_CACHE_SHARD_SIZE/2)
+    {
+        self.older = self.recent;
+        self.recent = [NSMutableDictionary dictionary];
+    }
+    
+    //add
+    self.recent[key] = value;
+}
+
+@end
+
+//console user changed
+// invalidate, as verdicts depend on who is logged in
+static void consoleUserChanged(SCDynamicStoreRef store, CFArrayRef changedKeys, void* info)
+{
+    //dbg msg
+    os_log_debug(logHandle, "console user changed, invalidating verdict cache");
+    
+    //invalidate
+    [(__bridge VerdictCache*)info invalidate];
+}
+
+@implementation VerdictCache
+{
+    //shards
+    NSArray<VerdictCacheShard*>* shards;
+    
+    //generation
+    _Atomic uint64_t currentGeneration;
+    
+    //stats
+    _Atomic uint64_t hitCount;
+    _Atomic uint64_t missCount;
+    
+    //store (for console user notifications)
+    SCDynamicStoreRef store;
+}
+
+//init
+-(id)init
+{
+    //init super
+    self = [super init];
+    if(nil != self)
+    {
+        //shards
+        NSMutableArray* allShards = [NSMutableArray array];
+        
+        //key for console user
+        CFStringRef consoleUserKey = NULL;
+        
+        //context
+        // note: unretained, as store is released in dealloc
+        SCDynamicStoreContext context = {0, (__bridge void*)self, NULL, NULL, NULL};
+        
+        //init shards
+        for(NSUInteger i = 0; i < VERDICT_CACHE_SHARDS; i++)
+        {
+            [allShards addObject:[[VerdictCacheShard alloc] init]];
+        }
+        shards = [allShards copy];
+        
+        //start at generation 1
+        atomic_init(&currentGeneration, 1);
+        
+        //watch for console user changes
+        store = SCDynamicStoreCreate(NULL, CFSTR("com.objective-see.lulu.verdicts"), consoleUserChanged, &context);
+        if(NULL != store)
+        {
+            //init key
+            consoleUserKey = SCDynamicStoreKeyCreateConsoleUser(NULL);
+            
+            //register
+            if( (YES != SCDynamicStoreSetNotificationKeys(store, (__bridge CFArrayRef)@[(__bridge NSString*)consoleUserKey], NULL)) ||
+                (YES != SCDynamicStoreSetDispatchQueue(store, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0))) )
+            {
+                //err msg
+                os_log_error(logHandle, "ERROR: failed to watch for console user changes (error: %{public}s)", SCErrorString(SCError()));
+            }
+            
+            //release
+            if(NULL != consoleUserKey) CFRelease(consoleUserKey);
+        }
+    }
+    
+    return self;
+}
+
+//dealloc
+-(void)dealloc
+{
+    //stop watching
+    if(NULL != store)
+    {
+        SCDynamicStoreSetDispatchQueue(store, NULL);
+        CFRelease(store);
+    }
+}
+
+//build key for a flow
++(NSString*)keyForFlow:(NEFilterSocketFlow*)flow
+{
+    //audit token
+    audit_token_t* token = NULL;
+    
+    //remote endpoint
+    NWHostEndpoint* remoteEndpoint = nil;
+    
+    //sanity check
+    if(sizeof(audit_token_t) != flow.sourceAppAuditToken.length) return nil;
+    
+    //init token
+    token = (audit_token_t*)flow.sourceAppAuditToken.bytes;
+    
+    //init remote endpoint
+    remoteEndpoint = (NWHostEndpoint*)flow.remoteEndpoint;
+    
+    //build key
+    // note: pid version changes on exec, so a reused/exec'd pid won't hit
+    return [NSString stringWithFormat:@"%d:%d|%@|%@|%@|%@|%d", audit_token_to_pid(*token), audit_token_to_pidversion(*token), remoteEndpoint.hostname, flow.remoteHostname, flow.URL.absoluteString, remoteEndpoint.port, flow.socketProtocol];
+}
+
+//current generation
+-(uint64_t)generation
+{
+    return atomic_load(&currentGeneration);
+}
+
+//hits
+-(uint64_t)hits
+{
+    return atomic_load(&hitCount);
+}
+
+//misses
+-(uint64_t)misses
+{
+    return atomic_load(&missCount);
+}
+
+//lookup verdict
+-(BOOL)lookup:(NSString*)key verdict:(NSInteger*)verdict
+{
+    //value
+    NSNumber* value = nil;
+    
+    //shard
+    VerdictCacheShard* shard = nil;
+    
+    //sanity check
+    if(nil == key) goto bail;
+    
+    //init shard
+    shard = shards[key.hash % VERDICT_CACHE_SHARDS];
+    
+    //sync
+    @synchronized(shard) {
+        
+        //check recent
+        value = shard.recent[key];
+        
+        //check older
+        // promote if found
+        if(nil == value)
+        {
+            value = shard.older[key];
+            if(nil != value)
+            {
+                [shard.older removeObjectForKey:key];
+                [shard add:key value:value];
+            }
+        }
+    }
+    
+    //miss or stale?
+    if( (nil == value) ||
+        ((value.unsignedLongLongValue >> VERDICT_BITS) != atomic_load(&currentGeneration)) )
+    {
+        //unset
+        value = nil;
+        
+        //bail
+        goto bail;
+    }
+    
+    //hit
+    *verdict = (NSInteger)(value.unsignedLongLongValue & ((1 << VERDICT_BITS) - 1));
+    
+bail:
+    
+    //update stats
+    if(nil != value) atomic_fetch_add(&hitCount, 1);
+    else atomic_fetch_add(&missCount, 1);
+    
+    return (nil != value);
+}
+
+//store verdict
+-(void)store:(NSString*)key verdict:(NSInteger)verdict generation:(uint64_t)generation
+{
+    //shard
+    VerdictCacheShard* shard = nil;
+    
+    //sanity check
+    if( (nil == key) ||
+        (verdict < 0) || (verdict >= (1 << VERDICT_BITS)) ) return;
+    
+    //changed while verdict was evaluated?
+    // verdict might be stale, so don't cache
+    if(generation != atomic_load(&currentGeneration)) return;
+    
+    //init shard
+    shard = shards[key.hash % VERDICT_CACHE_SHARDS];
+    
+    //sync
+    @synchronized(shard) {
+        
+        //add
+        [shard add:key value:@((generation << VERDICT_BITS) | (uint64_t)verdict)];
+    }
+    
+    return;
+}
+
+//invalidate all (cached) verdicts
+// just bumps the generation, stale entries are ignored (and eventually rotated out)
+-(void)invalidate
+{
+    //bump
+    atomic_fetch_add(&currentGeneration, 1);
+    
+    return;
+}
+
+@end
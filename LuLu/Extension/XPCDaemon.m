@@ -12,9 +12,11 @@
 #import "Alerts.h"
 #import "consts.h"
 #import "Profiles.h"
+#import "FlowStats.h"
 #import "XPCDaemon.h"
 #import "utilities.h"
 #import "Preferences.h"
+#import "XPCListener.h"
 
 //global rules obj
 extern Rules* rules;
@@ -28,6 +30,12 @@ extern Profiles* profiles;
 //global prefs obj
 extern Preferences* preferences;
 
+//global flow stats obj
+extern FlowStats* flowStats;
+
+//global XPC listener obj
+extern XPCListener* xpcListener;
+
 //global log handle
 extern os_log_t logHandle;
 
@@ -46,6 +54,19 @@ extern os_log_t logHandle;
     return;
 }
 
+//register as *the* client
+// cmdline clients (e.g. 'LuLu -stats') don't, so are never sent alerts
+-(void)registerClient
+{
+    //dbg msg
+    os_log_debug(logHandle, "XPC request: '%s'", __PRETTY_FUNCTION__);
+    
+    //register (calling) connection
+    [xpcListener registerClient:NSXPCConnection.currentConnection];
+    
+    return;
+}
+
 //send preferences to the client
 -(void)getPreferences:(void (^)(NSDictionary*))reply
 {
@@ -97,7 +118,7 @@ extern os_log_t logHandle;
         //err msg
         os_log_error(logHandle, "ERROR: failed to archive rules: %{public}@", error);
             
-    } else os_log_debug(logHandle, "archived %lu rules, and sending to user...", (unsigned long)rules.rules.count);
+    } else os_log_debug(logHandle, "archived %lu rules (%lu bytes), and sending to user...", (unsigned long)rules.rules.count, (unsigned long)archivedRules.length);
 
     //reply w/ rules
     reply(archivedRules);
@@ -105,6 +126,46 @@ extern os_log_t logHandle;
     return;
 }
 
+//send rules changed since a generation to the client
+// just changed/removed items, unless generation is unknown (then, all rules)
+-(void)getRulesSince:(unsigned long long)generation reply:(void (^)(NSData*))reply
+{
+    //changes
+    NSDictionary* changes = nil;
+    
+    //archived changes
+    NSData* archivedChanges = nil;
+    
+    //error
+    NSError* error = nil;
+    
+    //dbg msg
+    os_log_debug(logHandle, "XPC request: '%s' (generation: %llu)", __PRETTY_FUNCTION__, generation);
+    
+    //sync
+    // as items are (live) rules
+    @synchronized(rules)
+    {
+        //get changes
+        changes = [rules changesSince:generation];
+        
+        //archive
+        archivedChanges = [NSKeyedArchiver archivedDataWithRootObject:changes requiringSecureCoding:YES error:&error];
+    }
+    
+    if(nil == archivedChanges)
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to archive rule changes: %{public}@", error);
+        
+    } else os_log_debug(logHandle, "archived %lu changed items (full: %d, %lu bytes), and sending to user...", (unsigned long)[changes[KEY_RULES_ITEMS] count], [changes[KEY_RULES_FULL] boolValue], (unsigned long)archivedChanges.length);
+    
+    //reply w/ changes
+    reply(archivedChanges);
+    
+    return;
+}
+
 //add a rule
 -(void)addRule:(NSDictionary*)info
 {
@@ -229,7 +290,8 @@ bail:
 }
 
 //cleanup rules
--(void)cleanupRules:(BOOL)full reply:(void (^)(NSInteger))reply
+// reply is report: number of deleted rules, paths checked, & timings
+-(void)cleanupRules:(BOOL)full reply:(void (^)(NSDictionary*))reply
 {
     //dbg msg
     os_log_debug(logHandle, "XPC request: '%s'", __PRETTY_FUNCTION__);
@@ -303,6 +365,19 @@ bail:
     return;
 }
 
+//get (flow) statistics
+// snapshot of per stage latencies & verdict counts
+-(void)getStatistics:(void (^)(NSDictionary*))reply
+{
+    //dbg msg
+    os_log_debug(logHandle, "XPC request: '%s'", __PRETTY_FUNCTION__);
+    
+    //reply w/ snapshot
+    reply([flowStats snapshot]);
+    
+    return;
+}
+
 //get current profile *name*
 -(void)getCurrentProfile:(void (^)(NSString*))reply
 {
@@ -399,19 +474,19 @@ bail:
         }
     }
 
-    //set
-    [profiles set:newProfilePath];
-
-    //reload rules
-    [rules load];
+    //set & activate
+    // swaps in profile's (pre-compiled) rules & prefs
+    if(YES != [profiles activate:newProfilePath])
+    {
+        //err msg
+        os_log_error(logHandle, "ERROR: failed to activate profile %{public}@", newProfilePath);
+        goto bail;
+    }
 
     //tell user rules changed
     // ...in case rule's window need refreshing
     [alerts.xpcUserClient rulesChanged];
 
-    //reload prefs
-    [preferences load];
-
     //happy
     wasSet = YES;
 
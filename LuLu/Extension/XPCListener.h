@@ -29,4 +29,10 @@ OSStatus SecTaskValidateForRequirement(SecTaskRef task, CFStringRef requirement)
 //XPC connection for login item
 @property(weak)NSXPCConnection* client;
 
+/* METHODS */
+
+//register (connection) as *the* client
+// i.e. the login item/main app, that alerts are sent to
+-(void)registerClient:(NSXPCConnection*)connection;
+
 @end
@@ -14,6 +14,7 @@
 #import "Alerts.h"
 #import "utilities.h"
 #import "XPCListener.h"
+#import "VerdictCache.h"
 
 #import "XPCDaemon.h"
 
@@ -33,6 +34,9 @@ extern Alerts* alerts;
 //filter data provider obj
 extern FilterDataProvider* provider;
 
+//verdict cache
+extern VerdictCache* verdictCache;
+
 //interface for 'extension' to NSXPCConnection
 // allows us to access the 'private' auditToken iVar
 @interface ExtendedNSXPCConnection : NSXPCConnection
@@ -136,6 +140,10 @@ extern os_log_t logHandle;
     
     //signing req string (main app)
     NSString* requirement = nil;
+    
+    //(weak) connection
+    // handlers only act for *the* client
+    __weak NSXPCConnection* weakConnection = newConnection;
 
     //extract audit token
     auditToken = ((ExtendedNSXPCConnection*)newConnection).auditToken;
@@ -241,9 +249,16 @@ extern os_log_t logHandle;
         //dbg msg
         os_log_debug(logHandle, "XPC 'interruptionHandler' method invoked");
         
+        //ignore if not *the* client
+        // e.g. a cmdline client (that never registered)
+        if(weakConnection != self.client) return;
+        
         //unset user
         alerts.consoleUser = nil;
         
+        //(cached) verdicts depend on user
+        [verdictCache invalidate];
+        
     }];
 
     //set invalidation handler
@@ -251,10 +266,17 @@ extern os_log_t logHandle;
 
         //dbg msg
         os_log_debug(logHandle, "XPC 'invalidationHandler' method invoked ...client is gone");
+        
+        //ignore if not *the* client
+        // e.g. a cmdline client (that never registered)
+        if(weakConnection != self.client) return;
 
         //unset user
         alerts.consoleUser = nil;
         
+        //(cached) verdicts depend on user
+        [verdictCache invalidate];
+        
         //resume any held (related) flows (nil key = all)
         [provider resumeFlowsForKey:nil verdict:[NEFilterNewFlowVerdict allowVerdict]];
 
@@ -263,17 +285,13 @@ extern os_log_t logHandle;
 
     }];
     
-    //save
-    self.client = newConnection;
-    
-    //and set user
-    alerts.consoleUser = getConsoleUser();
-    
     //resume
+    // note: only becomes *the* client once it registers (via 'registerClient')
+    //       cmdline clients (e.g. 'LuLu -stats') never do, so can't reset the user, verdicts, etc.
     [newConnection resume];
     
     //dbg msg
-    os_log_debug(logHandle, "allowing XPC connection from client (pid: %d, user: %{public}@)", audit_token_to_pid(auditToken), alerts.consoleUser);
+    os_log_debug(logHandle, "allowing XPC connection from client (pid: %d)", audit_token_to_pid(auditToken));
     
     //happy
     shouldAccept = YES;
@@ -307,4 +325,23 @@ bail:
     return shouldAccept;
 }
 
+//register (connection) as *the* client
+// i.e. the login item/main app, that alerts are sent to
+-(void)registerClient:(NSXPCConnection*)connection
+{
+    //save
+    self.client = connection;
+    
+    //and set user
+    alerts.consoleUser = getConsoleUser();
+    
+    //(cached) verdicts depend on user
+    [verdictCache invalidate];
+    
+    //dbg msg
+    os_log_debug(logHandle, "registered XPC client (pid: %d, user: %{public}@)", connection.processIdentifier, alerts.consoleUser);
+    
+    return;
+}
+
 @end
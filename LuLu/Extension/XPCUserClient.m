@@ -22,6 +22,10 @@ extern XPCListener* xpcListener;
 extern os_log_t logHandle;
 
 @implementation XPCUserClient
+{
+    //rules changed notification scheduled?
+    BOOL rulesChangedPending;
+}
 
 //is a user client (i.e. the LuLu app) connected?
 -(BOOL)isConnected {
@@ -77,7 +81,46 @@ bail:
 }
 
 //inform user rules have changed
+// coalesced, so a burst of changes (e.g. in passive mode) results in a single notification
 -(void)rulesChanged
+{
+    //no client?
+    // no need to do anything...
+    if(nil == xpcListener.client)
+    {
+        //bail
+        return;
+    }
+    
+    //sync
+    @synchronized(self)
+    {
+        //already scheduled?
+        if(YES == rulesChangedPending) return;
+        
+        //set
+        rulesChangedPending = YES;
+    }
+    
+    //notify (after delay)
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(RULES_CHANGED_DELAY * NSEC_PER_SEC)), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        
+        //sync
+        @synchronized(self)
+        {
+            //unset
+            self->rulesChangedPending = NO;
+        }
+        
+        //notify
+        [self notifyRulesChanged];
+    });
+    
+    return;
+}
+
+//(actually) inform user rules have changed
+-(void)notifyRulesChanged
 {
     //dbg msg
     os_log_debug(logHandle, "invoking user XPC method, '%s'", __PRETTY_FUNCTION__);
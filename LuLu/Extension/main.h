@@ -11,9 +11,15 @@
 #import "Alerts.h"
 #import "consts.h"
 #import "Profiles.h"
+#import "FlowStats.h"
+#import "FlowRecorder.h"
 #import "utilities.h"
 #import "Preferences.h"
+#import "ExitMonitor.h"
 #import "XPCListener.h"
+#import "AncestryTable.h"
+#import "VerdictCache.h"
+#import "SigningCache.h"
 #import "BlockOrAllowList.h"
 #import "FilterDataProvider.h"
 
@@ -46,6 +52,25 @@ Preferences* preferences = nil;
 //profile obj
 Profiles* profiles = nil;
 
+//verdict cache
+VerdictCache* verdictCache = nil;
+
+//signing cache
+SigningCache* signingCache = nil;
+
+//exit monitor
+// (single) watcher for process exits
+ExitMonitor* exitMonitor = nil;
+
+//ancestry table
+AncestryTable* ancestryTable = nil;
+
+//flow stats
+FlowStats* flowStats = nil;
+
+//flow recorder
+FlowRecorder* flowRecorder = nil;
+
 //dispatch source for SIGTERM
 dispatch_source_t dispatchSource = nil;
 
@@ -39,6 +39,14 @@ int main(int argc, char *argv[])
     //dbg msg
     os_log_debug(logHandle, "enabled extension ('startSystemExtensionMode' was called)");
     
+    //alloc/init verdict cache
+    // first, as loading prefs, rules, etc. invalidates it
+    verdictCache = [[VerdictCache alloc] init];
+    
+    //alloc/init exit monitor
+    // before anything that watches for process exits (rules, ancestry table, etc.)
+    exitMonitor = [[ExitMonitor alloc] init];
+    
     //alloc/init/load prefs
     preferences = [[Preferences alloc] init];
             
@@ -72,6 +80,26 @@ int main(int argc, char *argv[])
         }
     }
         
+    //alloc/init (code) signing cache
+    // loads any saved results, so short-lived tools aren't fully (re)validated on each launch
+    signingCache = [[SigningCache alloc] init:[INSTALL_DIRECTORY stringByAppendingPathComponent:SIGNING_CACHE_FILE]];
+    
+    //alloc/init ancestry table
+    // shared across processes, so (common) ancestors are only looked up once
+    ancestryTable = [[AncestryTable alloc] init:[[SystemAncestryProvider alloc] init:exitMonitor]];
+    
+    //alloc/init flow stats
+    // always on, so latencies can be checked (via 'LuLu -stats') w/o debug logging
+    flowStats = [[FlowStats alloc] init];
+    
+    //record flows?
+    // opt-in (not in UI), for offline replay of the decision engine
+    if(YES == [preferences.preferences[PREF_RECORD_FLOWS] boolValue])
+    {
+        //alloc/init
+        flowRecorder = [[FlowRecorder alloc] init:[INSTALL_DIRECTORY stringByAppendingPathComponent:FLOW_RECORDING_FILE]];
+    }
+    
     //prep rules
     // first time? generate defaults rules
     // upgrade (v1.0)? convert to new format
@@ -88,6 +116,10 @@ int main(int argc, char *argv[])
         goto bail;
     }
     
+    //compile (inactive) profiles
+    // in the background, so switching profiles is instant
+    [profiles compileAll];
+    
     //allow list?
     if(YES == [preferences.preferences[PREF_USE_ALLOW_LIST] boolValue])
     {
@@ -25,6 +25,22 @@
     int _cidrLength;
     uint8_t _cidrLo[16];
     uint8_t _cidrHi[16];
+
+    //cached (numeric) port ranges for endpointPort
+    // lazily parsed on first match; not serialized
+    BOOL _portParsed;
+    int _portRangeCount;
+    uint16_t _portLo[PORT_SPEC_MAX_RANGES];
+    uint16_t _portHi[PORT_SPEC_MAX_RANGES];
+
+    //cached lower-cased endpointAddr/endpointHost
+    // lazily built on first (exact) match; not serialized
+    NSString* _lowercaseEndpointAddr;
+    NSString* _lowercaseEndpointHost;
+
+    //cached canonical (symlink-resolved) path
+    // lazily resolved on first use; not serialized
+    NSString* _canonicalPath;
 }
 
 /* PROPERTIES */
@@ -71,6 +87,7 @@
 @property(nonatomic, retain) NSRegularExpression* endpointRegex;
 
 //remote port
+// a port, range, or comma-separated list of either (e.g. '80,443,8000-8100')
 @property(nonatomic, retain)NSString* endpointPort;
 
 //type
@@ -78,6 +95,7 @@
 @property(nonatomic, retain)NSNumber* type;
 
 //protocol
+// IPPROTO_TCP/IPPROTO_UDP/etc. (nil/0: any protocol)
 @property(nonatomic, retain)NSNumber* protocol;
 
 //is disabled
@@ -106,6 +124,10 @@
 
 /* METHODS */
 
+//classes allowed when (the app) unarchives rules, or rule changes, from the daemon
+// note: containers must be mutable, as that's all the daemon sends
++(NSSet*)archiveClasses;
+
 //init method
 -(id)init:(NSDictionary*)info;
 
@@ -127,8 +149,26 @@
 //check if a numeric IP string falls within this rule's (cached) CIDR/range endpoint
 -(BOOL)endpointAddrInRange:(NSString*)address;
 
-//covert to dictionary
--(NSMutableString*)toJSON;
+//check if a (parsed) numeric IP falls within this rule's (cached) CIDR/range endpoint
+// address is in network byte order, 4 (AF_INET) or 16 (AF_INET6) bytes
+-(BOOL)endpointAddrInRange:(const uint8_t*)address family:(int)family;
+
+//check if rule's endpoint address or host is (exactly) one of a set of lower-cased names
+-(BOOL)endpointAddrInNames:(NSSet*)lowercaseNames;
+
+//check if a port matches rule's endpoint port ('*', port, range, or list)
+-(BOOL)endpointPortMatches:(uint16_t)port;
+
+//check if a protocol matches rule's protocol (if any)
+-(BOOL)protocolMatches:(int)protocol;
+
+//canonical (symlink-resolved) path
+// resolved once, as it's how tree ('process + kids') rules are keyed
+-(NSString*)canonicalPath;
+
+//append as JSON (object)
+// note: temporary properties (such as pid) not included
+-(void)appendJSON:(NSMutableData*)json;
 
 //make a rule obj from a dictioanary
 -(id)initFromJSON:(NSDictionary*)info;
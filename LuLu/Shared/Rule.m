@@ -38,6 +38,83 @@ EndpointType endpointTypeForAddress(NSString* address)
     return EndpointTypeExact;
 }
 
+//date formatter for JSON (exports)
+// format: ISO 8601, created once as formatters are expensive to create (and are thread safe)
+static NSDateFormatter* jsonDateFormatter(void)
+{
+    //formatter
+    static NSDateFormatter* dateFormatter = nil;
+    
+    //once
+    static dispatch_once_t onceToken = 0;
+    
+    //init formatter
+    dispatch_once(&onceToken, ^{
+        dateFormatter = [[NSDateFormatter alloc] init];
+        [dateFormatter setDateFormat:@"yyyy-MM-dd'T'HH:mm:ssZ"];
+    });
+    
+    return dateFormatter;
+}
+
+//append a JSON field's name
+// preceded by a ',' unless it's the object's first field (i.e. nothing appended since its start)
+static void appendJSONName(NSMutableData* json, NSUInteger start, const char* name)
+{
+    //not first?
+    if(start != json.length) [json appendBytes:"," length:1];
+    
+    //name
+    [json appendBytes:"\"" length:1];
+    [json appendBytes:name length:strlen(name)];
+    [json appendBytes:"\" : " length:4];
+    
+    return;
+}
+
+//append a JSON (string) field
+// skipped if nil, or not convertible
+static void appendJSONString(NSMutableData* json, NSUInteger start, const char* name, NSString* value)
+{
+    //length
+    // to undo name if value can't be converted
+    NSUInteger length = json.length;
+    
+    //skip nil
+    if(nil == value) return;
+    
+    //name
+    appendJSONName(json, start, name);
+    
+    //value
+    if(YES != appendEscapedJSON(json, value))
+    {
+        //undo
+        json.length = length;
+    }
+    
+    return;
+}
+
+//append a JSON (number) field
+static void appendJSONNumber(NSMutableData* json, NSUInteger start, const char* name, long long value)
+{
+    //number
+    char number[32] = {0};
+    
+    //length
+    int length = 0;
+    
+    //name
+    appendJSONName(json, start, name);
+    
+    //value
+    length = snprintf(number, sizeof(number), "%lld", value);
+    [json appendBytes:number length:length];
+    
+    return;
+}
+
 @implementation Rule
 
 @synthesize scope;
@@ -114,6 +191,10 @@ EndpointType endpointTypeForAddress(NSString* address)
             //init port
             // nil? default to all ('*')
             self.endpointPort = (nil != info[KEY_ENDPOINT_PORT]) ? info[KEY_ENDPOINT_PORT] : VALUE_ANY;
+            
+            //init proto
+            // only for endpoint rules, as process (+ kids) rules cover all traffic
+            self.protocol = info[KEY_PROTOCOL];
         }
         
         //init URL obj (w/ scheme)
@@ -137,9 +218,6 @@ EndpointType endpointTypeForAddress(NSString* address)
             self.endpointHost = remoteURL.host;
         }
         
-        //set proto
-        self.protocol = info[KEY_PROTOCOL];
-    
         //set type
         self.type = info[KEY_TYPE];
         
@@ -281,7 +359,31 @@ EndpointType endpointTypeForAddress(NSString* address)
 // note: parses & caches the bounds on first use (endpointAddr is immutable after creation)
 -(BOOL)endpointAddrInRange:(NSString*)address
 {
-    //parse (& cache) bounds once
+    //couldn't parse? no match
+    if(NO == [self parseEndpointRange]) return NO;
+
+    //numeric containment check
+    return addressInRange(address, _cidrFamily, _cidrLo, _cidrHi, _cidrLength);
+}
+
+//check if a (parsed) numeric IP falls within this rule's CIDR/range endpoint
+// no string parsing, so flows' addresses can be parsed once & checked against many rules
+-(BOOL)endpointAddrInRange:(const uint8_t*)address family:(int)family
+{
+    //couldn't parse? no match
+    if(NO == [self parseEndpointRange]) return NO;
+
+    //mismatched family? no match
+    if(family != _cidrFamily) return NO;
+
+    //lo <= ip <= hi ?
+    return ((memcmp(_cidrLo, address, _cidrLength) <= 0) && (memcmp(address, _cidrHi, _cidrLength) <= 0));
+}
+
+//parse (& cache) CIDR/range bounds once
+// returns NO if endpointAddr isn't a valid CIDR/range
+-(BOOL)parseEndpointRange
+{
     @synchronized(self)
     {
         if(NO == _cidrParsed)
@@ -291,11 +393,104 @@ EndpointType endpointTypeForAddress(NSString* address)
         }
     }
 
-    //couldn't parse? no match
-    if(NO == _cidrValid) return NO;
+    return _cidrValid;
+}
 
-    //numeric containment check
-    return addressInRange(address, _cidrFamily, _cidrLo, _cidrHi, _cidrLength);
+//check if rule's endpoint address or host is one of a set of lower-cased names
+// note: lower-cases (& caches) endpoint addr/host on first use (as they're immutable after creation)
+-(BOOL)endpointAddrInNames:(NSSet*)lowercaseNames
+{
+    //addr
+    NSString* addr = nil;
+    
+    //host
+    NSString* host = nil;
+    
+    //lower-case once
+    @synchronized(self)
+    {
+        if(nil == _lowercaseEndpointAddr)
+        {
+            _lowercaseEndpointAddr = self.endpointAddr.lowercaseString ?: @"";
+            _lowercaseEndpointHost = self.endpointHost.lowercaseString;
+        }
+        
+        addr = _lowercaseEndpointAddr;
+        host = _lowercaseEndpointHost;
+    }
+    
+    //check endpoint address
+    if(YES == [lowercaseNames containsObject:addr]) return YES;
+    
+    //(also) check endpoint host
+    return ( (nil != host) && (YES == [lowercaseNames containsObject:host]) );
+}
+
+//check if a port matches rule's endpoint port
+// note: parses (& caches) the port ranges on first use (endpointPort is immutable after creation)
+-(BOOL)endpointPortMatches:(uint16_t)port
+{
+    //range bounds (binary search)
+    int first = 0, last = 0;
+    
+    //any port?
+    if(YES == [self.endpointPort isEqualToString:VALUE_ANY]) return YES;
+    
+    //parse (& cache) ranges once
+    @synchronized(self)
+    {
+        if(NO == _portParsed)
+        {
+            if(YES != parsePortSpec(self.endpointPort, _portLo, _portHi, PORT_SPEC_MAX_RANGES, &_portRangeCount))
+            {
+                //err msg
+                os_log_error(logHandle, "ERROR: rule's endpoint port '%{public}@' is not a valid port (range/list)", self.endpointPort);
+                
+                //no ranges
+                // so rule won't match
+                _portRangeCount = 0;
+            }
+            _portParsed = YES;
+        }
+    }
+    
+    //binary search (sorted, disjoint) ranges
+    last = _portRangeCount - 1;
+    while(first <= last)
+    {
+        int middle = (first + last) / 2;
+        
+        if(port < _portLo[middle]) last = middle - 1;
+        else if(port > _portHi[middle]) first = middle + 1;
+        else return YES;
+    }
+    
+    return NO;
+}
+
+//check if a protocol matches rule's protocol
+// rules w/o a protocol (e.g. older rules, or process-wide rules) match any
+-(BOOL)protocolMatches:(int)protocol
+{
+    //any?
+    if(0 == self.protocol.intValue) return YES;
+    
+    return (self.protocol.intValue == protocol);
+}
+
+//canonical (symlink-resolved) path
+// note: resolves (& caches) on first use (path is immutable after creation)
+-(NSString*)canonicalPath
+{
+    @synchronized(self)
+    {
+        if(nil == _canonicalPath)
+        {
+            _canonicalPath = canonicalPath(self.path);
+        }
+        
+        return _canonicalPath;
+    }
 }
 
 //is rule directory?
@@ -312,6 +507,12 @@ EndpointType endpointTypeForAddress(NSString* address)
     return _isDirectory;
 }
 
+//classes allowed when (the app) unarchives rules, or rule changes, from the daemon
++(NSSet*)archiveClasses
+{
+    return [NSSet setWithArray:@[[NSMutableDictionary class], [NSMutableArray class], [NSString class], [NSNumber class], [NSMutableSet class], [NSDate class], [Rule class]]];
+}
+
 //required as we support secure coding
 +(BOOL)supportsSecureCoding
 {
@@ -346,6 +547,7 @@ EndpointType endpointTypeForAddress(NSString* address)
         self.isEndpointAddrRegex = (nil != endpointAddrType) ? endpointAddrType.integerValue : endpointTypeForAddress(self.endpointAddr);
         self.endpointHost = [decoder decodeObjectOfClass:[NSString class] forKey:NSStringFromSelector(@selector(endpointHost))];
         self.endpointPort = [decoder decodeObjectOfClass:[NSString class] forKey:NSStringFromSelector(@selector(endpointPort))];
+        self.protocol = [decoder decodeObjectOfClass:[NSNumber class] forKey:NSStringFromSelector(@selector(protocol))];
         
         self.type = [decoder decodeObjectOfClass:[NSNumber class] forKey:NSStringFromSelector(@selector(type))];
         self.scope = [decoder decodeObjectOfClass:[NSNumber class] forKey:NSStringFromSelector(@selector(scope))];
@@ -376,6 +578,7 @@ EndpointType endpointTypeForAddress(NSString* address)
     [encoder encodeObject:self.endpointAddr forKey:NSStringFromSelector(@selector(endpointAddr))];
     [encoder encodeObject:self.endpointHost forKey:NSStringFromSelector(@selector(endpointHost))];
     [encoder encodeObject:self.endpointPort forKey:NSStringFromSelector(@selector(endpointPort))];
+    [encoder encodeObject:self.protocol forKey:NSStringFromSelector(@selector(protocol))];
     //endpoint addr match type
     // note: encoded as an object (not a primitive), so it can be decoded w/o any chance of a
     //       type-mismatch exception (which would abort the decode of *all* rules)
@@ -517,101 +720,88 @@ bail:
     return [NSString stringWithFormat:@"RULE: pid: %@, path: %@, name: %@, endpoint addr: %@, endpoint port: %@, action: %@, type: %@, disabled: %@, creation: %@, expiration: %@", pid, self.path, self.name, self.endpointAddr, self.endpointPort, self.action, self.type, isDisabled, self.creation, expiration];
 }
 
-//covert rule to dictionary
-// needed for conversion to JSON
+//append rule as JSON
+// bytes are appended directly (no per field formatting/escaping objects), so exports of 100Ks of rules are fast
 // note: temporary properties (such as pid) not included
--(NSMutableString*)toJSON
+-(void)appendJSON:(NSMutableData*)json
 {
-    //json
-    NSMutableString* json = nil;
-    
-    //escaped
-    NSString* escaped = nil;
+    //start (of fields)
+    NSUInteger start = 0;
     
-    //date formatter
-    NSDateFormatter* dateFormatter = nil;
-    
-    //init formatter
-    // format: ISO 8601 format
-    dateFormatter = [[NSDateFormatter alloc] init];
-    [dateFormatter setDateFormat:@"yyyy-MM-dd'T'HH:mm:ssZ"];
-    
-    //init
-    json = [NSMutableString string];
+    //start
+    [json appendBytes:"{" length:1];
+    start = json.length;
     
     //key
-    [json appendFormat:@"\"%@\" : \"%@\",", NSStringFromSelector(@selector(key)), self.key];
+    appendJSONString(json, start, sel_getName(@selector(key)), self.key);
     
     //uuid
-    [json appendFormat:@"\"%@\" : \"%@\",", NSStringFromSelector(@selector(uuid)), self.uuid];
+    appendJSONString(json, start, sel_getName(@selector(uuid)), self.uuid);
     
     //path
-    escaped = toEscapedJSON(self.path);
-    if(nil != escaped)
-    {
-        [json appendFormat:@"\"%@\" : %@,", NSStringFromSelector(@selector(path)), escaped];
-    }
+    appendJSONString(json, start, sel_getName(@selector(path)), self.path);
     
     //name
-    escaped = toEscapedJSON(self.name);
-    if(nil != escaped)
-    {
-        [json appendFormat:@"\"%@\" : %@,", NSStringFromSelector(@selector(name)), escaped];
-    }
+    appendJSONString(json, start, sel_getName(@selector(name)), self.name);
     
-    escaped = toEscapedJSON(self.endpointAddr);
-    if(nil != escaped)
-    {
-        [json appendFormat:@"\"%@\" : %@,", NSStringFromSelector(@selector(endpointAddr)), escaped];
-    }
+    //endpoint addr
+    appendJSONString(json, start, sel_getName(@selector(endpointAddr)), self.endpointAddr);
     
-    if(nil != self.endpointHost)
-    {
-        escaped = toEscapedJSON(self.endpointHost);
-        if(nil != escaped)
-        {
-            [json appendFormat:@"\"%@\" : %@,", NSStringFromSelector(@selector(endpointHost)), escaped];
-        }
-    }
+    //endpoint host
+    appendJSONString(json, start, sel_getName(@selector(endpointHost)), self.endpointHost);
     
     //creation
     if(nil != self.creation)
     {
-        [json appendFormat:@"\"%@\" : \"%@\",", NSStringFromSelector(@selector(creation)), [dateFormatter stringFromDate:self.creation]];
+        appendJSONString(json, start, sel_getName(@selector(creation)), [jsonDateFormatter() stringFromDate:self.creation]);
     }
     
     //expiration
     if(nil != self.expiration)
     {
-        [json appendFormat:@"\"%@\" : \"%@\",", NSStringFromSelector(@selector(expiration)), [dateFormatter stringFromDate:self.expiration]];
+        appendJSONString(json, start, sel_getName(@selector(expiration)), [jsonDateFormatter() stringFromDate:self.expiration]);
     }
-
+    
     //port
-    [json appendFormat:@"\"%@\" : \"%@\",", NSStringFromSelector(@selector(endpointPort)), self.endpointPort];
+    appendJSONString(json, start, sel_getName(@selector(endpointPort)), self.endpointPort);
+    
+    //protocol
+    if(0 != self.protocol.intValue)
+    {
+        appendJSONNumber(json, start, sel_getName(@selector(protocol)), self.protocol.intValue);
+    }
     
     //endpoint addr match type {exact, regex, cidr}
-    [json appendFormat:@"\"%@\" : %ld,", NSStringFromSelector(@selector(isEndpointAddrRegex)), (long)self.isEndpointAddrRegex];
-
+    appendJSONNumber(json, start, sel_getName(@selector(isEndpointAddrRegex)), self.isEndpointAddrRegex);
+    
     //type
-    [json appendFormat:@"\"%@\" : %d,", NSStringFromSelector(@selector(type)), self.type.intValue];
+    appendJSONNumber(json, start, sel_getName(@selector(type)), self.type.intValue);
     
     //disabled
     if(nil != self.isDisabled)
     {
-        [json appendFormat:@"\"%@\" : %d,", NSStringFromSelector(@selector(isDisabled)), self.isDisabled.intValue];
+        appendJSONNumber(json, start, sel_getName(@selector(isDisabled)), self.isDisabled.intValue);
     }
     
     //scope
-    [json appendFormat:@"\"%@\" : %d,", NSStringFromSelector(@selector(scope)), self.scope.intValue];
+    appendJSONNumber(json, start, sel_getName(@selector(scope)), self.scope.intValue);
     
     //action
-    [json appendFormat:@"\"%@\" : %d,", NSStringFromSelector(@selector(action)), self.action.intValue];
+    appendJSONNumber(json, start, sel_getName(@selector(action)), self.action.intValue);
     
     //cs info
-    // dictionary...
+    // dictionary of strings, numbers, & arrays
     if(nil != self.csInfo)
     {
-        [json appendFormat:@"\"%@\" : {", NSStringFromSelector(@selector(csInfo))];
+        //start (of cs info fields)
+        NSUInteger csStart = 0;
+        
+        //name
+        appendJSONName(json, start, sel_getName(@selector(csInfo)));
+        
+        //start
+        [json appendBytes:"{" length:1];
+        csStart = json.length;
         
         //convert each key/value pair
         for(NSString* key in self.csInfo)
@@ -619,80 +809,68 @@ bail:
             //extract value
             id value = self.csInfo[key];
             
+            //key (as C string)
+            // skip if it can't be converted
+            const char* name = [key isKindOfClass:[NSString class]] ? key.UTF8String : NULL;
+            if(NULL == name) continue;
+            
             //string?
             if(YES == [value isKindOfClass:[NSString class]])
             {
-                escaped = toEscapedJSON(value);
-                if(nil != escaped)
-                {
-                    //append
-                    [json appendFormat:@"\"%@\" : %@,", key, escaped];
-                }
+                appendJSONString(json, csStart, name, value);
             }
             
             //number?
-            if(YES == [value isKindOfClass:[NSNumber class]])
+            else if(YES == [value isKindOfClass:[NSNumber class]])
             {
-                //append
-                [json appendFormat:@"\"%@\" : %d,", key, [value intValue]];
+                appendJSONNumber(json, csStart, name, [value longLongValue]);
             }
             
             //array?
-            if(YES == [value isKindOfClass:[NSArray class]])
+            // strings, or description of (any) other items
+            else if(YES == [value isKindOfClass:[NSArray class]])
             {
-                //append
-                [json appendFormat:@"\"%@\" : [", key];
+                //start (of items)
+                NSUInteger itemsStart = 0;
+                
+                //name
+                appendJSONName(json, csStart, name);
+                
+                //start
+                [json appendBytes:"[" length:1];
+                itemsStart = json.length;
                 
                 //add each item
                 for(id item in value)
                 {
-                    //string?
-                    if(YES == [item isKindOfClass:[NSString class]])
-                    {
-                        escaped = toEscapedJSON(item);
-                        if(nil != escaped)
-                        {
-                            //append
-                            [json appendFormat:@"%@,", escaped];
-                        }
-                    }
-                    else
+                    //length
+                    // to undo ',' if item can't be converted
+                    NSUInteger length = json.length;
+                    
+                    //not first?
+                    if(itemsStart != json.length) [json appendBytes:"," length:1];
+                    
+                    //append
+                    if(YES != appendEscapedJSON(json, [item isKindOfClass:[NSString class]] ? item : [item description]))
                     {
-                        [json appendFormat:@"\"%@\",", item];
+                        //undo
+                        json.length = length;
                     }
                 }
                 
-                //remove last ','
-                if(YES == [json hasSuffix:@","])
-                {
-                    //remove
-                    [json deleteCharactersInRange:NSMakeRange(json.length-1, 1)];
-                }
-                
                 //end
-                [json appendFormat:@"],"];
+                [json appendBytes:"]" length:1];
             }
         }
         
-        //remove last ','
-        if(YES == [json hasSuffix:@","])
-        {
-            //remove
-            [json deleteCharactersInRange:NSMakeRange(json.length-1, 1)];
-        }
-        
         //end
-        [json appendFormat:@"}"];
+        [json appendBytes:"}" length:1];
     }
     
-    //remove last ','
-    if(YES == [json hasSuffix:@","])
-    {
-        //remove
-        [json deleteCharactersInRange:NSMakeRange(json.length-1, 1)];
-    }
+    //end
+    [json appendBytes:"}" length:1];
     
-    return json;
+    return;
 }
 
 //make a rule obj from a dictioanary
@@ -701,12 +879,8 @@ bail:
     id value = nil;
     
     //date formatter
-    NSDateFormatter* dateFormatter = nil;
-    
-    //init formatter
-    // format: ISO 8601 format
-    dateFormatter = [[NSDateFormatter alloc] init];
-    [dateFormatter setDateFormat:@"yyyy-MM-dd'T'HH:mm:ssZ"];
+    // shared, as creating one (per rule) is expensive
+    NSDateFormatter* dateFormatter = jsonDateFormatter();
     
     //dbg msg
     //os_log_debug(logHandle, "method '%s' invoked", __PRETTY_FUNCTION__);
@@ -797,6 +971,35 @@ bail:
             goto bail;
         }
         
+        //port spec valid?
+        // '*', a port, range, or list of either
+        if( (YES != [self.endpointPort isEqualToString:VALUE_ANY]) &&
+            (YES != isPortSpec(self.endpointPort)) )
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: 'endpointPort' (%{public}@) is not a valid port, range, or list", self.endpointPort);
+            
+            self = nil;
+            goto bail;
+        }
+        
+        //protocol
+        // optional (older exports don't include it)
+        self.protocol = info[NSStringFromSelector(@selector(protocol))];
+        if([self.protocol isKindOfClass:[NSString class]]) {
+            self.protocol = @([(NSString*)self.protocol integerValue]);
+        }
+        
+        if( (nil != self.protocol) &&
+            (YES != [self.protocol isKindOfClass:[NSNumber class]]) )
+        {
+            //err msg
+            os_log_error(logHandle, "ERROR: 'protocol' should be a number, not %@", [self.protocol class]);
+            
+            self = nil;
+            goto bail;
+        }
+        
         //endpoint addr match type {exact, regex, cidr, glob}
         // validate before calling 'integerValue', as a non-number (e.g. NSNull) would throw
         id endpointAddrType = info[NSStringFromSelector(@selector(isEndpointAddrRegex))];
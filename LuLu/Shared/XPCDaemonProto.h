@@ -9,12 +9,26 @@
 
 @import Foundation;
 
-@protocol XPCDaemonProtocol
+//statistics (only)
+// all a cmdline client (e.g. 'LuLu -stats') needs
+@protocol XPCStatsProtocol
+
+//get (flow) statistics
+// per stage latencies & verdict counts
+-(void)getStatistics:(void (^)(NSDictionary*))reply;
+
+@end
+
+@protocol XPCDaemonProtocol <XPCStatsProtocol>
 
 //check in
 // used by the client to confirm the daemon is up & accepting XPC connections
 -(void)checkIn:(void (^)(BOOL))reply;
 
+//register as *the* client
+// i.e. the one alerts (and rule changes) are sent to, which cmdline clients never are
+-(void)registerClient;
+
 //get preferences
 -(void)getPreferences:(void (^)(NSDictionary*))reply;
 
@@ -24,6 +38,9 @@
 //get rules
 -(void)getRules:(void (^)(NSData*))reply;
 
+//get rules changed since a generation
+-(void)getRulesSince:(unsigned long long)generation reply:(void (^)(NSData*))reply;
+
 //add rule
 -(void)addRule:(NSDictionary*)info;
 
@@ -37,7 +54,8 @@
 -(void)importRules:(NSData*)newRules userOnly:(BOOL)userOnly result:(void (^)(BOOL))reply;
 
 //cleanup rules
--(void)cleanupRules:(BOOL)fule reply:(void (^)(NSInteger))reply;
+// reply is report: number of deleted rules, paths checked, & timings
+-(void)cleanupRules:(BOOL)full reply:(void (^)(NSDictionary*))reply;
 
 //get current profile
 -(void)getCurrentProfile:(void (^)(NSString*))profile;
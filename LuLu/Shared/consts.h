@@ -32,6 +32,10 @@ typedef NS_ENUM(NSInteger, EndpointType) {
     EndpointTypeGlob  = 3,
 };
 
+//max (merged) ranges in an endpoint port spec
+// e.g. '80,443,8000-8100' is 3 ranges
+#define PORT_SPEC_MAX_RANGES 32
+
 //patreon url
 #define PATREON_URL @"https://www.patreon.com/join/objective_see"
 
@@ -65,9 +69,21 @@ typedef NS_ENUM(NSInteger, EndpointType) {
 //rules file
 #define RULES_FILE @"rules.plist"
 
+//rules journal (suffix)
+#define RULES_JOURNAL_SUFFIX @".journal"
+
+//rules journal records, before compacting (into rules file)
+#define RULES_JOURNAL_LIMIT 512
+
 //(old) rules file
 #define RULES_FILE_V1 @"rules_v1.plist"
 
+//(code) signing cache file
+#define SIGNING_CACHE_FILE @"signingCache.plist"
+
+//flow recording file
+#define FLOW_RECORDING_FILE @"flows.recording"
+
 //client no status
 #define STATUS_CLIENT_UNKNOWN -1
 
@@ -221,6 +237,22 @@ typedef NS_ENUM(NSInteger, EndpointType) {
 // not really a 'pref' but need to save it
 #define PREF_ALERT_LAST_RULE_DURATION @"alertLastRuleDuration"
 
+//record flows
+// not in UI, set (manually) to capture flows for offline replay
+#define PREF_RECORD_FLOWS @"recordFlows"
+
+//max (paused) related flows held per process
+// not in UI, overrides the default (RELATED_FLOWS_LIMIT)
+#define PREF_RELATED_FLOWS_LIMIT @"relatedFlowsLimit"
+
+//what to do w/ flows beyond that max
+// not in UI, default is block
+#define PREF_RELATED_FLOWS_OVERFLOW @"relatedFlowsOverflow"
+
+//related flows overflow options
+#define PREF_RELATED_FLOWS_OVERFLOW_BLOCK 0
+#define PREF_RELATED_FLOWS_OVERFLOW_ALLOW 1
+
 //rule duration buttons
 #define RULE_DURATION_BUTTON_ALWAYS 100
 #define RULE_DURATION_BUTTON_PROCESS 101
@@ -316,10 +348,31 @@ typedef NS_ENUM(NSInteger, EndpointType) {
 #define CMDLINE_FLAG_WELCOME @"-welcome"
 #define CMDLINE_FLAG_PREFS @"-prefs"
 #define CMDLINE_FLAG_RULES @"-rules"
+#define CMDLINE_FLAG_STATS @"-stats"
 
 #define KEY_PATHS @"paths"
 #define KEY_RULES @"rules"
 
+//rules journal (record) keys & ops
+#define KEY_JOURNAL_OP @"op"
+#define KEY_JOURNAL_RULE @"rule"
+#define KEY_JOURNAL_UUID @"uuid"
+#define KEY_JOURNAL_STATE @"state"
+
+#define JOURNAL_OP_ADD @"add"
+#define JOURNAL_OP_PATH @"path"
+#define JOURNAL_OP_DELETE @"delete"
+#define JOURNAL_OP_TOGGLE @"toggle"
+
+//rule (delta) sync keys
+#define KEY_RULES_GENERATION @"generation"
+#define KEY_RULES_FULL @"full"
+#define KEY_RULES_ITEMS @"items"
+#define KEY_RULES_REMOVED @"removed"
+
+//delay for (coalescing) rules changed notifications
+#define RULES_CHANGED_DELAY 0.25
+
 #define KEY_ID @"id"
 #define KEY_PATH @"path"
 #define KEY_KEY @"key"
@@ -467,5 +520,38 @@ typedef enum {Update_Error, Update_None, Update_NotSupported, Update_Available}
 //profiles directory
 #define PROFILE_DIRECTORY @"Profiles"
 
+//(compiled) lists directory
+#define LISTS_DIRECTORY @"Lists"
+
+//(remote) list validators
+#define KEY_LIST_URL @"url"
+#define KEY_LIST_ETAG @"etag"
+#define KEY_LIST_LAST_MODIFIED @"lastModified"
+
+//timeout for fetching (remote) lists
+#define REMOTE_LIST_TIMEOUT 60
+
+//(flow) statistics
+#define KEY_STATS_SINCE @"since"
+#define KEY_STATS_STAGES @"stages"
+#define KEY_STATS_VERDICTS @"verdicts"
+#define KEY_STATS_NAME @"name"
+#define KEY_STATS_COUNT @"count"
+#define KEY_STATS_MEAN @"mean"
+#define KEY_STATS_P50 @"p50"
+#define KEY_STATS_P99 @"p99"
+#define KEY_STATS_P999 @"p999"
+#define KEY_STATS_MAX @"max"
+
+//(rules) cleanup report
+#define KEY_CLEANUP_DELETED @"deleted"
+#define KEY_CLEANUP_ITEMS @"items"
+#define KEY_CLEANUP_PATHS @"paths"
+#define KEY_CLEANUP_MISSING @"missing"
+#define KEY_CLEANUP_VOLUMES @"volumes"
+#define KEY_CLEANUP_CHECK_TIME @"checkTime"
+#define KEY_CLEANUP_LOCK_TIME @"lockTime"
+#define KEY_CLEANUP_TIME @"time"
+
 
 #endif /* const_h */
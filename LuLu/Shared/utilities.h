@@ -116,12 +116,24 @@ BOOL matchesCSInfo(NSDictionary* csInfo_1, NSDictionary* csInfo_2);
 //escape string
 NSString* toEscapedJSON(NSString* input);
 
+//append string, (quoted &) escaped as JSON
+// returns NO (and appends nothing) if string isn't valid (e.g. can't be converted to UTF-8)
+BOOL appendEscapedJSON(NSMutableData* json, NSString* input);
+
 //convert date to absolute
 NSDate* absoluteDate(NSDate* date);
 
+//get parent of a process, for its hierarchy
+// real parent (via serial) or responsible pid if we're not root, else ppid
+pid_t getAncestorParent(pid_t pid);
+
 //generate list of ancestors
 NSMutableArray* generateProcessHierarchy(pid_t child);
 
+//canonical (symlink-resolved) path
+// cached, as resolving touches the file system
+NSString* canonicalPath(NSString* path);
+
 //is process on internal drive?
 BOOL isInternalProcess(NSString *path);
 
@@ -135,6 +147,14 @@ BOOL addressInRange(NSString* address, int family, const uint8_t* lo, const uint
 //is a string a valid CIDR or IP range?
 BOOL isAddressRange(NSString* spec);
 
+//parse a port spec: a port ('443'), range ('8000-8100'), or comma-separated list of either
+// on success: returns YES, fills lo/hi (max entries) w/ sorted, merged (inclusive) ranges, sets *count
+BOOL parsePortSpec(NSString* spec, uint16_t* lo, uint16_t* hi, int max, int* count);
+
+//is a string a valid port spec?
+// i.e. a port, range, or list of either (all 1-65535)
+BOOL isPortSpec(NSString* spec);
+
 //convert a simple glob (using '*' wildcards) to an anchored regular expression
 // e.g. '85.140.*.*' -> '^85\.140\..*\..*$' : literal chars are regex-escaped, '*' -> '.*', anchored
 NSString* regexFromGlob(NSString* glob);
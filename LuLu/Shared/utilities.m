@@ -122,21 +122,47 @@ bail:
 
 #pragma GCC diagnostic pop
 
-//generate list of ancestors
-NSMutableArray* generateProcessHierarchy(pid_t child)
+//canonical (symlink-resolved) path
+// cached, as resolving touches the file system (and the same paths, e.g. shells, recur)
+NSString* canonicalPath(NSString* path)
 {
-    //ancestors
-    NSMutableArray* ancestors = nil;
+    //canonical path
+    NSString* canonical = nil;
     
-    //current process id
-    pid_t currentPID = -1;
+    //cache
+    static NSCache* cache = nil;
     
-    //current path
-    NSString* currentPath = nil;
+    //token
+    static dispatch_once_t onceToken = 0;
     
-    //current name
-    NSString* currentName = nil;
+    //no path?
+    if(0 == path.length) return path;
+    
+    //init cache
+    dispatch_once(&onceToken, ^{
+        
+        //init
+        cache = [[NSCache alloc] init];
+        cache.countLimit = 2048;
+    });
+    
+    //cached?
+    canonical = [cache objectForKey:path];
+    if(nil != canonical) return canonical;
+    
+    //resolve
+    canonical = [path stringByResolvingSymlinksInPath];
     
+    //cache
+    [cache setObject:canonical forKey:path];
+    
+    return canonical;
+}
+
+//get parent of a process, for its hierarchy
+// for apps (and if we're not root) via serial, then responsible pid, then standard (ppid)
+pid_t getAncestorParent(pid_t pid)
+{
     //parent pid
     pid_t parentPID = -1;
     
@@ -146,9 +172,6 @@ NSMutableArray* generateProcessHierarchy(pid_t child)
     //token
     static dispatch_once_t onceToken = 0;
     
-    //init
-    ancestors = [NSMutableArray array];
-    
     //only once
     // init requirements
     dispatch_once(&onceToken, ^{
@@ -158,6 +181,56 @@ NSMutableArray* generateProcessHierarchy(pid_t child)
         
     });
     
+    //for apps (and if we're not root)
+    // try application services pid via serial
+    if(0 != getuid())
+    {
+        //real parent via serial
+        parentPID = [getRealParent(pid)[@"pid"] intValue];
+        
+        //not found
+        // try via responsible pid
+        if( (0 == parentPID) &&
+            (NULL != getRPID) )
+        {
+            //get rpid
+            parentPID = getRPID(pid);
+        }
+    }
+    
+    //couldn't find/get rPID?
+    // default back to using standard method
+    if( (parentPID <= 0) ||
+        (pid == parentPID) )
+    {
+        //get parent pid
+        parentPID = getParent(pid);
+    }
+    
+    return parentPID;
+}
+
+//generate list of ancestors
+NSMutableArray* generateProcessHierarchy(pid_t child)
+{
+    //ancestors
+    NSMutableArray* ancestors = nil;
+    
+    //current process id
+    pid_t currentPID = -1;
+    
+    //current path
+    NSString* currentPath = nil;
+    
+    //current name
+    NSString* currentName = nil;
+    
+    //parent pid
+    pid_t parentPID = -1;
+    
+    //init
+    ancestors = [NSMutableArray array];
+    
     //start w/ self
     currentPID = child;
     
@@ -181,35 +254,8 @@ NSMutableArray* generateProcessHierarchy(pid_t child)
         //add
         [ancestors insertObject:[@{KEY_PROCESS_ID:[NSNumber numberWithInt:currentPID], KEY_PROCESS_PATH:currentPath, KEY_PROCESS_NAME:currentName} mutableCopy] atIndex:0];
         
-        //for apps (and if we're not root)
-        // try application services pid via serial
-        if(0 != getuid())
-        {
-            //real parent via serial
-            parentPID = [getRealParent(currentPID)[@"pid"] intValue];
-        }
-        
-        //not found
-        // try via responsible pid
-        if(0 == parentPID)
-        {
-            //for parent
-            // first try via rPID
-            if(NULL != getRPID)
-            {
-                //get rpid
-                parentPID = getRPID(currentPID);
-            }
-        }
-        
-        //couldn't find/get rPID?
-        // default back to using standard method
-        if( (parentPID <= 0) ||
-            (currentPID == parentPID) )
-        {
-            //get parent pid
-            parentPID = getParent(currentPID);
-        }
+        //get parent
+        parentPID = getAncestorParent(currentPID);
         
         //done?
         if( (parentPID <= 0) ||
@@ -1913,6 +1959,93 @@ bail:
     return output;
 }
 
+//append string, (quoted &) escaped as JSON
+// unlike 'toEscapedJSON', no (per string) serialization: bytes are escaped directly, as exports can have 100Ks of rules
+BOOL appendEscapedJSON(NSMutableData* json, NSString* input)
+{
+    //hex
+    static const char hex[] = "0123456789abcdef";
+    
+    //input (as UTF-8)
+    const char* utf8 = NULL;
+    
+    //length
+    size_t length = 0;
+    
+    //start of current run (of unescaped bytes)
+    size_t run = 0;
+    
+    //sanity check
+    if(YES != [input isKindOfClass:[NSString class]]) return NO;
+    
+    //convert
+    // nil if invalid (e.g. lone surrogate)
+    utf8 = input.UTF8String;
+    if(NULL == utf8) return NO;
+    
+    //init
+    length = strlen(utf8);
+    
+    //start
+    [json appendBytes:"\"" length:1];
+    
+    //escape
+    // quotes, backslashes, & control characters
+    for(size_t i = 0; i < length; i++)
+    {
+        //char
+        unsigned char c = (unsigned char)utf8[i];
+        
+        //escaped (two char) form
+        char escaped[6] = {'\\', 0};
+        
+        //escaped length
+        size_t escapedLength = 2;
+        
+        //no escape needed?
+        if( (c >= 0x20) &&
+            ('"' != c) &&
+            ('\\' != c) )
+        {
+            continue;
+        }
+        
+        //append run
+        [json appendBytes:utf8 + run length:i - run];
+        run = i + 1;
+        
+        switch(c)
+        {
+            case '"':  escaped[1] = '"'; break;
+            case '\\': escaped[1] = '\\'; break;
+            case '\n': escaped[1] = 'n'; break;
+            case '\r': escaped[1] = 'r'; break;
+            case '\t': escaped[1] = 't'; break;
+            case '\b': escaped[1] = 'b'; break;
+            case '\f': escaped[1] = 'f'; break;
+                
+            //other control characters
+            // as '\\u00XX'
+            default:
+                escaped[1] = 'u'; escaped[2] = '0'; escaped[3] = '0';
+                escaped[4] = hex[c >> 4]; escaped[5] = hex[c & 0xF];
+                escapedLength = 6;
+                break;
+        }
+        
+        //append escaped
+        [json appendBytes:escaped length:escapedLength];
+    }
+    
+    //append (last) run
+    [json appendBytes:utf8 + run length:length - run];
+    
+    //end
+    [json appendBytes:"\"" length:1];
+    
+    return YES;
+}
+
 
 //is process on internal drive?
 BOOL isInternalProcess(NSString *path)
@@ -2083,6 +2216,110 @@ BOOL isAddressRange(NSString* spec)
     return parseAddressRange(spec, &family, lo, hi, &length);
 }
 
+//parse a port spec: a port ('443'), range ('8000-8100'), or comma-separated list of either
+// on success: returns YES, fills lo/hi (max entries) w/ sorted, merged (inclusive) ranges, sets *count
+BOOL parsePortSpec(NSString* spec, uint16_t* lo, uint16_t* hi, int max, int* count)
+{
+    //result
+    BOOL parsed = NO;
+    
+    //number of ranges
+    int ranges = 0;
+    
+    //non-digits
+    NSCharacterSet* nonDigits = NSCharacterSet.decimalDigitCharacterSet.invertedSet;
+    
+    //whitespace set (for trimming)
+    NSCharacterSet* whitespace = NSCharacterSet.whitespaceCharacterSet;
+    
+    //bad args?
+    if( (0 == spec.length) ||
+        (NULL == lo) || (NULL == hi) || (NULL == count) || (max <= 0) )
+    {
+        goto bail;
+    }
+    
+    //parse each item
+    for(NSString* item in [spec componentsSeparatedByString:@","])
+    {
+        //bounds
+        NSInteger first = 0, last = 0;
+        
+        //split on '-'
+        NSArray* bounds = [item componentsSeparatedByString:@"-"];
+        if(bounds.count > 2) goto bail;
+        
+        //each bound must be all digits
+        for(NSString* bound in bounds)
+        {
+            //trim
+            NSString* trimmed = [bound stringByTrimmingCharactersInSet:whitespace];
+            
+            //empty or not a number?
+            if( (0 == trimmed.length) ||
+                (trimmed.length > 5) ||
+                (NSNotFound != [trimmed rangeOfCharacterFromSet:nonDigits].location) ) goto bail;
+        }
+        
+        //extract
+        first = [[bounds.firstObject stringByTrimmingCharactersInSet:whitespace] integerValue];
+        last = [[bounds.lastObject stringByTrimmingCharactersInSet:whitespace] integerValue];
+        
+        //validate
+        if( (first < 1) || (last > 65535) || (first > last) ) goto bail;
+        
+        //too many?
+        if(ranges == max) goto bail;
+        
+        //insert (sorted by lo)
+        int i = ranges++;
+        while( (i > 0) && (lo[i-1] > first) )
+        {
+            lo[i] = lo[i-1];
+            hi[i] = hi[i-1];
+            i--;
+        }
+        lo[i] = (uint16_t)first;
+        hi[i] = (uint16_t)last;
+    }
+    
+    //merge overlapping/adjacent ranges
+    *count = 0;
+    for(int i = 0; i < ranges; i++)
+    {
+        //extends previous?
+        if( (0 != *count) &&
+            (lo[i] <= (uint32_t)hi[*count-1] + 1) )
+        {
+            if(hi[i] > hi[*count-1]) hi[*count-1] = hi[i];
+            continue;
+        }
+        
+        //add
+        lo[*count] = lo[i];
+        hi[*count] = hi[i];
+        (*count)++;
+    }
+    
+    //happy
+    parsed = YES;
+    
+bail:
+    
+    return parsed;
+}
+
+//is a string a valid port spec?
+// i.e. a port, range, or list of either (all 1-65535)
+BOOL isPortSpec(NSString* spec)
+{
+    //bounds (unused here; we only care if parsing succeeds)
+    int count = 0;
+    uint16_t lo[PORT_SPEC_MAX_RANGES] = {0}, hi[PORT_SPEC_MAX_RANGES] = {0};
+    
+    return parsePortSpec(spec, lo, hi, PORT_SPEC_MAX_RANGES, &count);
+}
+
 //convert a simple glob (using '*' wildcards) to an anchored regular expression
 // e.g. '85.140.*.*' -> '^85\.140\..*\..*$' : literal chars are regex-escaped, '*' -> '.*', anchored
 NSString* regexFromGlob(NSString* glob)
@@ -0,0 +1,222 @@
+#!/bin/bash
+
+#
+# run_tests.sh
+# Script to compile and run a set of tests, e.g. ./run_tests.sh rule_index
+# any further arguments (e.g. -recording <file>) are passed to the test
+#
+
+# Set up paths
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+TEST_NAME="$1"
+shift
+
+# Tests: description, frameworks/libraries, & the (real) code they're compiled against
+case "$TEST_NAME" in
+    # against the real index
+    rule_index)
+        DESCRIPTION="rule index"
+        LINK=()
+        SOURCES=(Extension/RuleIndex.m Extension/EndpointMatcher.m Extension/AddressMatcher.m Shared/utilities.m)
+        ;;
+    # against the real matcher
+    list_matcher)
+        DESCRIPTION="list matcher"
+        LINK=()
+        SOURCES=(Extension/ListMatcher.m Shared/utilities.m)
+        ;;
+    # against the real list & matcher
+    remote_list)
+        DESCRIPTION="remote list"
+        LINK=(-framework NetworkExtension)
+        SOURCES=(Extension/BlockOrAllowList.m Extension/ListMatcher.m Shared/utilities.m)
+        ;;
+    # against the real cache & matcher
+    verdict_cache)
+        DESCRIPTION="verdict cache"
+        LINK=(-framework NetworkExtension -framework SystemConfiguration)
+        SOURCES=(Extension/VerdictCache.m Extension/ListMatcher.m Shared/utilities.m)
+        ;;
+    # against the real cache
+    process_cache)
+        DESCRIPTION="process cache"
+        LINK=(-lbsm)
+        SOURCES=(Extension/ProcessCache.m Extension/ExitMonitor.m)
+        ;;
+    # against the real process, binary, & signing code
+    process_enrichment)
+        DESCRIPTION="process enrichment"
+        LINK=(-framework AppKit -framework Security)
+        SOURCES=(Extension/Process.m Extension/SigningCache.m Extension/Binary.m Shared/signing.m Shared/utilities.m)
+        ;;
+    # against the real cache
+    signing_cache)
+        DESCRIPTION="signing cache"
+        LINK=(-lbsm)
+        SOURCES=(Extension/SigningCache.m)
+        ;;
+    # against the real journal
+    rule_journal)
+        DESCRIPTION="rule journal"
+        LINK=()
+        SOURCES=(Extension/RuleJournal.m)
+        ;;
+    # against the real change log, and rules & its index/matchers
+    rule_changes)
+        DESCRIPTION="rule changes"
+        LINK=(-framework AppKit -framework Security -framework NetworkExtension -lbsm)
+        SOURCES=(Extension/RuleChanges.m Extension/Rules.m Extension/ProfileSnapshot.m Extension/PathChecker.m Extension/RuleExpirations.m Extension/RuleIndex.m Extension/RuleJournal.m Extension/EndpointMatcher.m Extension/AddressMatcher.m Extension/FlowMatchContext.m Shared/Rule.m Shared/utilities.m)
+        ;;
+    # against the real matcher
+    endpoint_matcher)
+        DESCRIPTION="endpoint matcher"
+        LINK=()
+        SOURCES=(Extension/EndpointMatcher.m Shared/utilities.m)
+        ;;
+    # against the real context, rule, & list matcher
+    flow_match_context)
+        DESCRIPTION="flow match context"
+        LINK=(-framework NetworkExtension)
+        SOURCES=(Extension/FlowMatchContext.m Extension/ListMatcher.m Shared/Rule.m Shared/utilities.m)
+        ;;
+    # against the real rule
+    port_spec)
+        DESCRIPTION="port spec"
+        LINK=()
+        SOURCES=(Shared/Rule.m Shared/utilities.m)
+        ;;
+    # against the real matcher
+    address_matcher)
+        DESCRIPTION="address matcher"
+        LINK=()
+        SOURCES=(Extension/AddressMatcher.m Shared/utilities.m)
+        ;;
+    # against the real index
+    tree_rules)
+        DESCRIPTION="tree rules"
+        LINK=()
+        SOURCES=(Extension/RuleIndex.m Extension/EndpointMatcher.m Extension/AddressMatcher.m Shared/utilities.m)
+        ;;
+    # against the real table
+    ancestry_table)
+        DESCRIPTION="ancestry table"
+        LINK=(-framework AppKit -framework Security -lbsm)
+        SOURCES=(Extension/AncestryTable.m Extension/ExitMonitor.m Shared/utilities.m)
+        ;;
+    # against the real stats
+    flow_stats)
+        DESCRIPTION="flow stats"
+        LINK=()
+        SOURCES=(Extension/FlowStats.m)
+        ;;
+    # against the real recorder, rules, lists, & matchers
+    flow_replay)
+        DESCRIPTION="flow replay"
+        LINK=(-framework AppKit -framework Security -framework NetworkExtension -lbsm)
+        SOURCES=(Extension/FlowRecorder.m Extension/Rules.m Extension/ProfileSnapshot.m Extension/PathChecker.m Extension/RuleExpirations.m Extension/RuleIndex.m Extension/RuleChanges.m Extension/RuleJournal.m Extension/EndpointMatcher.m Extension/AddressMatcher.m Extension/BlockOrAllowList.m Extension/ListMatcher.m Extension/GrayList.m Extension/FlowMatchContext.m Extension/FlowStats.m Shared/Rule.m Shared/utilities.m)
+        ;;
+    # against the real related flows
+    related_flows)
+        DESCRIPTION="related flows"
+        LINK=()
+        SOURCES=(Extension/RelatedFlows.m)
+        ;;
+    # against the real exit monitor
+    exit_monitor)
+        DESCRIPTION="exit monitor"
+        LINK=(-lbsm)
+        SOURCES=(Extension/ExitMonitor.m)
+        ;;
+    # against the real expirations, and rules & its index/matchers
+    rule_expirations)
+        DESCRIPTION="rule expirations"
+        LINK=(-framework AppKit -framework Security -framework NetworkExtension -lbsm)
+        SOURCES=(Extension/RuleExpirations.m Extension/Rules.m Extension/ProfileSnapshot.m Extension/PathChecker.m Extension/RuleIndex.m Extension/RuleChanges.m Extension/RuleJournal.m Extension/EndpointMatcher.m Extension/AddressMatcher.m Extension/FlowMatchContext.m Shared/Rule.m Shared/utilities.m)
+        ;;
+    # against the real path checker, and rules & its index/matchers
+    rules_cleanup)
+        DESCRIPTION="rules cleanup"
+        LINK=(-framework AppKit -framework Security -framework NetworkExtension -lbsm)
+        SOURCES=(Extension/PathChecker.m Extension/Rules.m Extension/ProfileSnapshot.m Extension/RuleExpirations.m Extension/RuleIndex.m Extension/RuleChanges.m Extension/RuleJournal.m Extension/EndpointMatcher.m Extension/AddressMatcher.m Extension/FlowMatchContext.m Shared/Rule.m Shared/utilities.m)
+        ;;
+    # against the real search index & rule
+    rule_search_index)
+        DESCRIPTION="rule search index"
+        LINK=(-framework NetworkExtension)
+        SOURCES=(App/RuleSearchIndex.m Shared/Rule.m Shared/utilities.m)
+        ;;
+    # against the real rules writer & reader, and rules & its index/matchers
+    rules_import_export)
+        DESCRIPTION="rules import/export"
+        LINK=(-framework AppKit -framework Security -framework NetworkExtension -lbsm)
+        SOURCES=(App/RulesWriter.m App/RulesReader.m Extension/PathChecker.m Extension/Rules.m Extension/ProfileSnapshot.m Extension/RuleExpirations.m Extension/RuleIndex.m Extension/RuleChanges.m Extension/RuleJournal.m Extension/EndpointMatcher.m Extension/AddressMatcher.m Extension/FlowMatchContext.m Shared/Rule.m Shared/utilities.m)
+        ;;
+    # against the real profile snapshot, and rules & its index/matchers
+    profile_snapshots)
+        DESCRIPTION="profile snapshots"
+        LINK=(-framework AppKit -framework Security -framework NetworkExtension -lbsm)
+        SOURCES=(Extension/Rules.m Extension/ProfileSnapshot.m Extension/ExitMonitor.m Extension/RuleExpirations.m Extension/RuleIndex.m Extension/RuleChanges.m Extension/RuleJournal.m Extension/EndpointMatcher.m Extension/AddressMatcher.m Extension/FlowMatchContext.m Shared/Rule.m Shared/utilities.m)
+        ;;
+    *)
+        echo "Usage: $0 <tests> [arguments]"
+        echo "tests: rule_index, list_matcher, remote_list, verdict_cache, process_cache, process_enrichment, signing_cache, rule_journal, rule_changes, endpoint_matcher, flow_match_context, port_spec, address_matcher, tree_rules, ancestry_table, flow_stats, flow_replay, related_flows, exit_monitor, rule_expirations, rules_cleanup, rule_search_index, rules_import_export, profile_snapshots"
+        exit 1
+        ;;
+esac
+
+# Code is relative to the (project's) top-level directory
+SOURCE_FILES=()
+for SOURCE in "${SOURCES[@]}"; do
+    SOURCE_FILES+=("$SCRIPT_DIR/../$SOURCE")
+done
+
+TEST_FILE="$SCRIPT_DIR/test_$TEST_NAME.m"
+TEST_BINARY="$SCRIPT_DIR/test_$TEST_NAME"
+
+echo "🚀 Building and running $DESCRIPTION tests..."
+echo "==========================================="
+
+# Check if test file exists
+if [ ! -f "$TEST_FILE" ]; then
+    echo "❌ Error: Test file not found at $TEST_FILE"
+    exit 1
+fi
+
+# Compile the test
+echo ""
+echo "🔨 Compiling test..."
+clang -fobjc-arc -fmodules -framework Foundation "${LINK[@]}" \
+      -I "$SCRIPT_DIR/../Shared" -I "$SCRIPT_DIR/../Extension" -I "$SCRIPT_DIR/../App" \
+      -o "$TEST_BINARY" \
+      "$TEST_FILE" "${SOURCE_FILES[@]}" \
+      -Wno-objc-missing-property-synthesis \
+      -Wno-incomplete-implementation
+
+# Check if compilation succeeded
+if [ $? -ne 0 ]; then
+    echo "❌ Compilation failed!"
+    exit 1
+fi
+
+echo "✅ Compilation successful!"
+
+# Run the test
+echo ""
+echo "🧪 Running tests..."
+echo "=================="
+"$TEST_BINARY" "$@"
+
+# Capture test result
+TEST_RESULT=$?
+
+# Clean up
+rm -f "$TEST_BINARY"
+
+# Report final result
+if [ $TEST_RESULT -eq 0 ]; then
+    echo "✅ All tests completed successfully!"
+else
+    echo "❌ Tests failed with exit code $TEST_RESULT"
+fi
+
+exit $TEST_RESULT
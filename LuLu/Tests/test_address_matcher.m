@@ -0,0 +1,228 @@
+//
+//  test_address_matcher.m
+//  LuLu
+//
+//  Tests (and a benchmark vs. per-rule checks) for the CIDR/range interval index
+//  builds against the real AddressMatcher.m (and utilities.m, for range parsing), with a minimal Rule stand-in
+//
+
+#import <Foundation/Foundation.h>
+#import <arpa/inet.h>
+#import <sys/socket.h>
+
+#import "Rule.h"
+#import "utilities.h"
+#import "AddressMatcher.h"
+
+//log handle
+os_log_t logHandle = nil;
+
+// Minimal Rule implementation
+// only what the matcher touches
+@implementation Rule
+
+@synthesize endpointAddr, isEndpointAddrRegex, isDisabled;
+
+@end
+
+//make a rule
+static Rule* makeRule(NSString* addr)
+{
+    Rule* rule = [[Rule alloc] init];
+    rule.endpointAddr = addr;
+    rule.isEndpointAddrRegex = EndpointTypeCIDR;
+    return rule;
+}
+
+//per-rule (reference) matching
+// i.e. 'addressInRange' on each rule
+static NSSet* referenceMatch(NSArray* rules, NSString* address)
+{
+    NSMutableSet* matched = [NSMutableSet set];
+    for(Rule* rule in rules)
+    {
+        int family = 0, length = 0;
+        uint8_t lo[16] = {0}, hi[16] = {0};
+
+        if( (YES == parseAddressRange(rule.endpointAddr, &family, lo, hi, &length)) &&
+            (YES == addressInRange(address, family, lo, hi, length)) ) [matched addObject:rule];
+    }
+    return matched;
+}
+
+//indexed match
+static NSSet* indexMatch(AddressMatcher* matcher, NSString* address)
+{
+    uint8_t bytes[16] = {0};
+
+    if(1 == inet_pton(AF_INET, address.UTF8String, bytes)) return [matcher match:bytes family:AF_INET] ?: [NSSet set];
+    if(1 == inet_pton(AF_INET6, address.UTF8String, bytes)) return [matcher match:bytes family:AF_INET6] ?: [NSSet set];
+
+    return [NSSet set];
+}
+
+//random IPv4 address
+static NSString* randomIPv4(void)
+{
+    return [NSString stringWithFormat:@"%u.%u.%u.%u", arc4random_uniform(4) + 10, arc4random_uniform(256), arc4random_uniform(256), arc4random_uniform(256)];
+}
+
+//random IPv6 address
+static NSString* randomIPv6(void)
+{
+    return [NSString stringWithFormat:@"2001:db8:%x:%x::%x", arc4random_uniform(4), arc4random_uniform(0x10000), arc4random_uniform(0x10000)];
+}
+
+//random (overlapping) rules
+static NSArray* randomRules(NSUInteger count)
+{
+    NSMutableArray* rules = [NSMutableArray array];
+    for(NSUInteger i = 0; i < count; i++)
+    {
+        switch(arc4random_uniform(4))
+        {
+            case 0: [rules addObject:makeRule([NSString stringWithFormat:@"%@/%u", randomIPv4(), 8 + arc4random_uniform(25)])]; break;
+            case 1: [rules addObject:makeRule([NSString stringWithFormat:@"%@ - %@", randomIPv4(), randomIPv4()])]; break;
+            case 2: [rules addObject:makeRule([NSString stringWithFormat:@"%@/%u", randomIPv6(), 32 + arc4random_uniform(97)])]; break;
+            default: [rules addObject:makeRule([NSString stringWithFormat:@"%@ - %@", randomIPv6(), randomIPv6()])]; break;
+        }
+    }
+    return rules;
+}
+
+int main(int argc, const char * argv[]) {
+    @autoreleasepool {
+
+        NSLog(@"🧪 Address Matcher Test Suite");
+        NSLog(@"=============================");
+
+        logHandle = os_log_create("com.objective-see.lulu.tests", "AddressMatcher");
+
+        int testsPassed = 0;
+        int totalTests = 0;
+
+        // Test 1: Nested & adjacent ranges
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 1: nested & adjacent ranges");
+
+            Rule* outer = makeRule(@"10.0.0.0/8");
+            Rule* inner = makeRule(@"10.1.0.0/16");
+            Rule* range = makeRule(@"10.1.255.255 - 10.2.0.10");
+            Rule* v6 = makeRule(@"2001:db8::/32");
+            AddressMatcher* matcher = [[AddressMatcher alloc] init:@[outer, inner, range, v6]];
+
+            if( (4 == matcher.count) &&
+                (YES == [indexMatch(matcher, @"10.0.0.1") isEqualToSet:[NSSet setWithObject:outer]]) &&
+                (YES == [indexMatch(matcher, @"10.1.2.3") isEqualToSet:([NSSet setWithObjects:outer, inner, nil])]) &&
+                (YES == [indexMatch(matcher, @"10.1.255.255") isEqualToSet:([NSSet setWithObjects:outer, inner, range, nil])]) &&
+                (YES == [indexMatch(matcher, @"10.2.0.10") isEqualToSet:([NSSet setWithObjects:outer, range, nil])]) &&
+                (YES == [indexMatch(matcher, @"10.2.0.11") isEqualToSet:[NSSet setWithObject:outer]]) &&
+                (0 == indexMatch(matcher, @"11.0.0.0").count) &&
+                (0 == indexMatch(matcher, @"9.255.255.255").count) &&
+                (YES == [indexMatch(matcher, @"2001:db8::1") isEqualToSet:[NSSet setWithObject:v6]]) ) {
+                NSLog(@"✅ PASS: nested/adjacent ranges (%lu segments)", (unsigned long)matcher.segmentCount);
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: nested/adjacent ranges");
+            }
+        }
+
+        // Test 2: Family boundaries ('all' ranges, max addresses)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 2: family boundaries");
+
+            Rule* all4 = makeRule(@"0.0.0.0/0");
+            Rule* top4 = makeRule(@"255.255.255.0/24");
+            Rule* all6 = makeRule(@"::/0");
+            AddressMatcher* matcher = [[AddressMatcher alloc] init:@[all4, top4, all6, makeRule(@"not a range")]];
+
+            if( (3 == matcher.count) &&
+                (YES == [indexMatch(matcher, @"0.0.0.0") isEqualToSet:[NSSet setWithObject:all4]]) &&
+                (YES == [indexMatch(matcher, @"255.255.255.255") isEqualToSet:([NSSet setWithObjects:all4, top4, nil])]) &&
+                (YES == [indexMatch(matcher, @"ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff") isEqualToSet:[NSSet setWithObject:all6]]) &&
+                (nil == [[AddressMatcher alloc] init:@[makeRule(@"not a range")]]) ) {
+                NSLog(@"✅ PASS: family boundaries");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: family boundaries");
+            }
+        }
+
+        // Test 3: Random ranges & addresses vs. 'addressInRange'
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 3: random ranges vs. 'addressInRange' (100 rounds)");
+
+            NSUInteger mismatches = 0;
+            NSUInteger hits = 0;
+            for(int round = 0; round < 100; round++)
+            {
+                NSArray* rules = randomRules(1 + arc4random_uniform(50));
+                AddressMatcher* matcher = [[AddressMatcher alloc] init:rules];
+
+                for(int i = 0; i < 200; i++)
+                {
+                    NSString* address = (0 == i % 2) ? randomIPv4() : randomIPv6();
+                    NSSet* expected = referenceMatch(rules, address);
+
+                    if(YES != [indexMatch(matcher, address) isEqualToSet:expected])
+                    {
+                        if(0 == mismatches) NSLog(@"   mismatch: %@ (expected %lu rules)", address, (unsigned long)expected.count);
+                        mismatches++;
+                    }
+                    hits += (0 != expected.count);
+                }
+            }
+
+            if(0 == mismatches) {
+                NSLog(@"✅ PASS: index agrees (%lu of 20000 addresses matched)", (unsigned long)hits);
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: %lu mismatches", (unsigned long)mismatches);
+            }
+        }
+
+        // Benchmark: 10k ranges
+        {
+            NSLog(@"\n⏱  Benchmark: 10k ranges, 10k lookups");
+
+            NSMutableArray* rules = [NSMutableArray array];
+            for(int i = 0; i < 10000; i++)
+            {
+                [rules addObject:makeRule([NSString stringWithFormat:@"%d.%d.%d.0/24", 10 + (i >> 16), (i >> 8) & 0xFF, i & 0xFF])];
+            }
+
+            NSMutableArray* addresses = [NSMutableArray array];
+            for(int i = 0; i < 10000; i++) [addresses addObject:randomIPv4()];
+
+            NSDate* start = [NSDate date];
+            AddressMatcher* matcher = [[AddressMatcher alloc] init:rules];
+            NSLog(@"   build: %.2f ms (%lu segments)", [[NSDate date] timeIntervalSinceDate:start] * 1000, (unsigned long)matcher.segmentCount);
+
+            NSUInteger hits = 0;
+            start = [NSDate date];
+            for(NSString* address in addresses) hits += indexMatch(matcher, address).count;
+            NSLog(@"   indexed: %.2f ms (%lu hits)", [[NSDate date] timeIntervalSinceDate:start] * 1000, (unsigned long)hits);
+
+            hits = 0;
+            start = [NSDate date];
+            for(NSUInteger i = 0; i < 100; i++) hits += referenceMatch(rules, addresses[i]).count;
+            NSLog(@"   per-rule ('addressInRange'), 100 lookups: %.2f ms (%lu hits)", [[NSDate date] timeIntervalSinceDate:start] * 1000, (unsigned long)hits);
+        }
+
+        // Test Results Summary
+        NSLog(@"\n🏁 Address Matcher Test Results");
+        NSLog(@"===============================");
+        NSLog(@"Tests Passed: %d/%d", testsPassed, totalTests);
+
+        if (testsPassed == totalTests) {
+            NSLog(@"✅ ALL TESTS PASSED!");
+            return 0;
+        } else {
+            NSLog(@"❌ %d tests failed. Please check implementation.", totalTests - testsPassed);
+            return 1;
+        }
+    }
+}
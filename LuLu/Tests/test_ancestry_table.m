@@ -0,0 +1,342 @@
+//
+//  test_ancestry_table.m
+//  LuLu
+//
+//  Tests (and a build-farm benchmark) for the shared process ancestry table
+//  builds against the real AncestryTable.m, driven by a stand-in (in-memory) process table
+//
+
+#import <Foundation/Foundation.h>
+#import <unistd.h>
+
+#import "consts.h"
+#import "utilities.h"
+#import "AncestryTable.h"
+
+//log handle
+os_log_t logHandle = nil;
+
+// Stand-in provider
+// an in-memory process table, w/ (synchronous) exits & pid reuse
+@interface StandInProvider : NSObject <AncestryProvider>
+
+//processes
+// key: pid, value: entry
+@property(nonatomic, retain)NSMutableDictionary<NSNumber*, AncestryEntry*>* processes;
+
+//pid versions
+// key: pid, kept across exits
+@property(nonatomic, retain)NSMutableDictionary<NSNumber*, NSNumber*>* versions;
+
+//watches
+// [pid, handler] pairs, the pair is the (opaque) watch
+@property(nonatomic, retain)NSMutableArray<NSArray*>* watches;
+
+//number of lookups
+@property(nonatomic)NSUInteger lookups;
+
+@end
+
+@implementation StandInProvider
+
+-(id)init
+{
+    self = [super init];
+    if(nil != self) {
+        _processes = [NSMutableDictionary dictionary];
+        _versions = [NSMutableDictionary dictionary];
+        _watches = [NSMutableArray array];
+    }
+    return self;
+}
+
+//start a process
+// bumps pid version, so a reused pid looks like a new process
+-(void)spawn:(pid_t)pid parent:(pid_t)parent path:(NSString*)path
+{
+    AncestryEntry* entry = [[AncestryEntry alloc] init];
+    entry.pid = pid;
+    entry.parent = parent;
+    entry.path = path;
+    entry.name = path.lastPathComponent;
+    entry.version = self.versions[@(pid)].intValue + 1;
+    self.versions[@(pid)] = @(entry.version);
+    self.processes[@(pid)] = entry;
+}
+
+//exit a process
+// re-parents its kids to launchd, and (unless missed) delivers exit events
+-(void)exit:(pid_t)pid notify:(BOOL)notify
+{
+    [self.processes removeObjectForKey:@(pid)];
+    for(AncestryEntry* entry in self.processes.allValues) {
+        if(pid == entry.parent) entry.parent = 1;
+    }
+
+    NSMutableArray* fired = [NSMutableArray array];
+    for(NSArray* watch in self.watches) {
+        if(YES == [watch[0] isEqual:@(pid)]) [fired addObject:watch];
+    }
+    [self.watches removeObjectsInArray:fired];
+
+    if(YES != notify) return;
+    for(NSArray* watch in fired) {
+        ((dispatch_block_t)watch[1])();
+    }
+}
+
+-(AncestryEntry*)entryForPid:(pid_t)pid
+{
+    self.lookups++;
+
+    AncestryEntry* process = self.processes[@(pid)];
+    if(nil == process) return nil;
+
+    //copy
+    // as the table's entries are snapshots
+    AncestryEntry* entry = [[AncestryEntry alloc] init];
+    entry.pid = process.pid;
+    entry.parent = process.parent;
+    entry.path = process.path;
+    entry.name = process.name;
+    entry.version = process.version;
+    return entry;
+}
+
+-(id)watch:(pid_t)pid handler:(dispatch_block_t)handler
+{
+    if(nil == self.processes[@(pid)]) return nil;
+
+    NSArray* watch = @[@(pid), handler];
+    [self.watches addObject:watch];
+    return watch;
+}
+
+-(void)unwatch:(id)watch
+{
+    [self.watches removeObjectIdenticalTo:watch];
+}
+
+@end
+
+//pids of ancestors
+static NSArray* pids(NSArray* ancestors)
+{
+    return [ancestors valueForKey:KEY_PROCESS_ID];
+}
+
+//walk ancestors w/o a table
+// one lookup per hop, like 'generateProcessHierarchy'
+static NSUInteger walk(StandInProvider* provider, pid_t pid)
+{
+    NSUInteger hops = 0;
+    while(pid > 0) {
+        AncestryEntry* entry = [provider entryForPid:pid];
+        if(nil == entry) break;
+        hops++;
+        if(entry.parent == pid) break;
+        pid = entry.parent;
+    }
+    return hops;
+}
+
+int main(int argc, const char * argv[]) {
+    @autoreleasepool {
+
+        NSLog(@"🧪 Ancestry Table Test Suite");
+        NSLog(@"============================");
+
+        logHandle = os_log_create("com.objective-see.lulu.tests", "AncestryTable");
+
+        int testsPassed = 0;
+        int totalTests = 0;
+
+        StandInProvider* provider = [[StandInProvider alloc] init];
+        [provider spawn:1 parent:0 path:@"/sbin/launchd"];
+        [provider spawn:100 parent:1 path:@"/Applications/Utilities/Terminal.app/Contents/MacOS/Terminal"];
+        [provider spawn:200 parent:100 path:@"/bin/zsh"];
+        [provider spawn:300 parent:200 path:@"/usr/bin/curl"];
+        [provider spawn:301 parent:200 path:@"/usr/bin/nc"];
+
+        AncestryTable* table = [[AncestryTable alloc] init:provider];
+
+        // Test 1: Chain, in 'generateProcessHierarchy' format
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 1: ancestors (root first, w/ index)");
+
+            NSArray* ancestors = [table ancestors:300 version:1];
+
+            if( ([pids(ancestors) isEqualToArray:@[@1, @100, @200, @300]]) &&
+                ([ancestors[0][KEY_PROCESS_PATH] isEqualToString:@"/sbin/launchd"]) &&
+                ([ancestors[3][KEY_PROCESS_NAME] isEqualToString:@"curl"]) &&
+                ([ancestors[3][KEY_INDEX] isEqual:@3]) &&
+                (4 == provider.lookups) &&
+                (4 == table.count) ) {
+                NSLog(@"✅ PASS: ancestors enumerated");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: ancestors: %@ (lookups: %lu)", ancestors, (unsigned long)provider.lookups);
+            }
+        }
+
+        // Test 2: Common ancestors are reused
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 2: shared hops (only new hops looked up)");
+
+            provider.lookups = 0;
+            NSArray* sibling = [table ancestors:301 version:1];
+            NSArray* again = [table ancestors:300 version:1];
+
+            if( ([pids(sibling) isEqualToArray:@[@1, @100, @200, @301]]) &&
+                ([pids(again) isEqualToArray:@[@1, @100, @200, @300]]) &&
+                (1 == provider.lookups) ) {
+                NSLog(@"✅ PASS: one lookup for two chains");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: %lu lookups", (unsigned long)provider.lookups);
+            }
+        }
+
+        // Test 3: Exit invalidates (and kids are re-parented)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 3: process exit");
+
+            [provider exit:200 notify:YES];
+            NSArray* ancestors = [table ancestors:300 version:1];
+
+            if( ([pids(ancestors) isEqualToArray:@[@1, @300]]) &&
+                (1 == table.exits) ) {
+                NSLog(@"✅ PASS: exited ancestor dropped, child refreshed");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: ancestors: %@", pids(ancestors));
+            }
+        }
+
+        // Test 4: Pid reuse (w/ missed exit event) is caught via pid version
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 4: pid version change");
+
+            [provider exit:300 notify:NO];
+            [provider spawn:300 parent:100 path:@"/usr/bin/ssh"];
+            NSArray* stale = [table ancestors:300 version:1];
+            NSArray* fresh = [table ancestors:300 version:2];
+
+            if( ([stale.lastObject[KEY_PROCESS_PATH] isEqualToString:@"/usr/bin/curl"]) &&
+                ([fresh.lastObject[KEY_PROCESS_PATH] isEqualToString:@"/usr/bin/ssh"]) &&
+                ([pids(fresh) isEqualToArray:@[@1, @100, @300]]) ) {
+                NSLog(@"✅ PASS: reused pid re-looked up");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: stale: %@, fresh: %@", stale, fresh);
+            }
+        }
+
+        // Test 5: Exited (or unknown) processes aren't cached
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 5: unknown process");
+
+            NSUInteger before = table.count;
+            NSArray* ancestors = [table ancestors:999 version:0];
+
+            if( (1 == ancestors.count) &&
+                ([ancestors[0][KEY_PROCESS_PATH] isEqualToString:NSLocalizedString(@"unknown", @"unknown")]) &&
+                (before == table.count) ) {
+                NSLog(@"✅ PASS: unknown process added as 'unknown', not cached");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: ancestors: %@", ancestors);
+            }
+        }
+
+        // Test 6: Table is bounded
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 6: LRU bound");
+
+            AncestryTable* small = [[AncestryTable alloc] init:provider];
+            small.countLimit = 8;
+
+            for(pid_t pid = 1000; pid < 1020; pid++) {
+                [provider spawn:pid parent:100 path:[NSString stringWithFormat:@"/tmp/tool%d", pid]];
+                [small ancestors:pid version:1];
+            }
+
+            if( (8 == small.count) &&
+                (0 != small.evictions) &&
+                (provider.watches.count == table.count + small.count) ) {
+                NSLog(@"✅ PASS: bounded (%lu evictions)", (unsigned long)small.evictions);
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: count: %lu", (unsigned long)small.count);
+            }
+        }
+
+        // Test 7: System provider matches 'generateProcessHierarchy'
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 7: system provider (this process)");
+
+            AncestryTable* system = [[AncestryTable alloc] init:[[SystemAncestryProvider alloc] init]];
+            NSArray* ancestors = [system ancestors:getpid() version:0];
+            NSArray* expected = generateProcessHierarchy(getpid());
+
+            if( ([pids(ancestors) isEqualToArray:pids(expected)]) &&
+                ([[ancestors valueForKey:KEY_PROCESS_PATH] isEqualToArray:[expected valueForKey:KEY_PROCESS_PATH]]) ) {
+                NSLog(@"✅ PASS: same hierarchy (%lu hops)", (unsigned long)ancestors.count);
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: table: %@, expected: %@", pids(ancestors), pids(expected));
+            }
+        }
+
+        // Benchmark: build farm
+        // 50 shells (under one terminal), each running 200 compilers
+        {
+            NSLog(@"\n⏱  Benchmark: build farm (10k processes, 4-hop chains)");
+
+            StandInProvider* farm = [[StandInProvider alloc] init];
+            [farm spawn:1 parent:0 path:@"/sbin/launchd"];
+            [farm spawn:2 parent:1 path:@"/usr/bin/make"];
+            for(pid_t shell = 10; shell < 60; shell++) {
+                [farm spawn:shell parent:2 path:@"/bin/sh"];
+            }
+            for(pid_t cc = 1000; cc < 11000; cc++) {
+                [farm spawn:cc parent:10 + (cc % 50) path:@"/usr/bin/clang"];
+            }
+
+            NSUInteger hops = 0;
+            NSDate* start = [NSDate date];
+            for(pid_t cc = 1000; cc < 11000; cc++) {
+                hops += walk(farm, cc);
+            }
+            NSLog(@"   per-process walks: %.2f ms (%lu lookups)", [[NSDate date] timeIntervalSinceDate:start] * 1000, (unsigned long)farm.lookups);
+
+            farm.lookups = 0;
+            AncestryTable* shared = [[AncestryTable alloc] init:farm];
+            start = [NSDate date];
+            for(pid_t cc = 1000; cc < 11000; cc++) {
+                hops += [shared ancestors:cc version:1].count;
+            }
+            NSLog(@"   shared table: %.2f ms (%lu lookups, %llu hits, %lu total hops)", [[NSDate date] timeIntervalSinceDate:start] * 1000, (unsigned long)farm.lookups, shared.hits, (unsigned long)hops);
+        }
+
+        // Test Results Summary
+        NSLog(@"\n🏁 Ancestry Table Test Results");
+        NSLog(@"=============================");
+        NSLog(@"Tests Passed: %d/%d", testsPassed, totalTests);
+
+        if (testsPassed == totalTests) {
+            NSLog(@"✅ ALL TESTS PASSED!");
+            return 0;
+        } else {
+            NSLog(@"❌ %d tests failed. Please check implementation.", totalTests - testsPassed);
+            return 1;
+        }
+    }
+}
@@ -0,0 +1,236 @@
+//
+//  test_endpoint_matcher.m
+//  LuLu
+//
+//  Tests (and a benchmark vs. per-rule regexes) for the multi-pattern endpoint matcher
+//  builds against the real EndpointMatcher.m (and utilities.m, for 'regexFromGlob'), with a minimal Rule stand-in
+//
+
+#import <Foundation/Foundation.h>
+
+#import "Rule.h"
+#import "utilities.h"
+#import "EndpointMatcher.h"
+
+//log handle
+os_log_t logHandle = nil;
+
+// Minimal Rule implementation
+// only what the matcher touches (mirrors Rule.m's regex compilation)
+@implementation Rule
+
+@synthesize endpointAddr, endpointRegex, isEndpointAddrRegex, isDisabled;
+
+-(NSRegularExpression*)compiledEndpointRegex
+{
+    if(nil == self.endpointRegex)
+    {
+        NSString* pattern = (EndpointTypeGlob == self.isEndpointAddrRegex) ? regexFromGlob(self.endpointAddr) : [NSString stringWithFormat:@"^(?:%@)$", self.endpointAddr];
+        self.endpointRegex = [NSRegularExpression regularExpressionWithPattern:pattern options:0 error:nil];
+    }
+    return self.endpointRegex;
+}
+
+@end
+
+//make a rule
+static Rule* makeRule(NSString* addr, EndpointType type)
+{
+    Rule* rule = [[Rule alloc] init];
+    rule.endpointAddr = addr;
+    rule.isEndpointAddrRegex = type;
+    return rule;
+}
+
+//per-rule (reference) matching
+static NSSet* referenceMatch(NSArray* rules, NSArray* names)
+{
+    NSMutableSet* matched = [NSMutableSet set];
+    for(Rule* rule in rules) {
+        NSRegularExpression* regex = [rule compiledEndpointRegex];
+        for(NSString* name in names) {
+            if( (nil != regex) && (0 != [regex numberOfMatchesInString:name options:0 range:NSMakeRange(0, name.length)]) ) {
+                [matched addObject:rule];
+                break;
+            }
+        }
+    }
+    return matched;
+}
+
+//random string over a small alphabet
+static NSString* randomString(NSString* alphabet, NSUInteger maxLength)
+{
+    NSMutableString* string = [NSMutableString string];
+    NSUInteger length = arc4random_uniform((uint32_t)maxLength + 1);
+    for(NSUInteger i = 0; i < length; i++) {
+        [string appendFormat:@"%C", [alphabet characterAtIndex:arc4random_uniform((uint32_t)alphabet.length)]];
+    }
+    return string;
+}
+
+//synthetic pattern rules
+static NSArray* syntheticRules(NSUInteger count)
+{
+    NSMutableArray* rules = [NSMutableArray array];
+    for(NSUInteger i = 0; i < count; i++) {
+        switch(i % 3) {
+            case 0: [rules addObject:makeRule([NSString stringWithFormat:@"*.tracker%lu.com", (unsigned long)i], EndpointTypeGlob)]; break;
+            case 1: [rules addObject:makeRule([NSString stringWithFormat:@"85.%lu.*.*", (unsigned long)(i % 256)], EndpointTypeGlob)]; break;
+            default: [rules addObject:makeRule([NSString stringWithFormat:@"[a-z0-9]+\\.cdn%lu\\.(net|org)", (unsigned long)i], EndpointTypeRegex)]; break;
+        }
+    }
+    return rules;
+}
+
+int main(int argc, const char * argv[]) {
+    @autoreleasepool {
+
+        NSLog(@"🧪 Endpoint Matcher Test Suite");
+        NSLog(@"==============================");
+
+        logHandle = os_log_create("com.objective-see.lulu.tests", "EndpointMatcher");
+
+        int testsPassed = 0;
+        int totalTests = 0;
+
+        // Test 1: Glob matcher agrees with 'regexFromGlob'
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 1: glob matcher vs. regex (10k random globs/strings)");
+
+            BOOL ok = YES;
+            for(int i = 0; i < 10000 && ok; i++) {
+                NSString* glob = randomString(@"ab.*", 8);
+                NSString* string = randomString(@"ab.", 10);
+                NSRegularExpression* regex = [NSRegularExpression regularExpressionWithPattern:regexFromGlob(glob) options:0 error:nil];
+
+                BOOL expected = (0 != [regex numberOfMatchesInString:string options:0 range:NSMakeRange(0, string.length)]);
+                BOOL actual = globMatch(glob.UTF8String, strlen(glob.UTF8String), string.UTF8String, strlen(string.UTF8String));
+                if(expected != actual) {
+                    NSLog(@"   mismatch: '%@' vs '%@' (expected %d)", glob, string, expected);
+                    ok = NO;
+                }
+            }
+
+            if(YES == ok) {
+                NSLog(@"✅ PASS: glob matcher agrees");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: glob matcher disagrees");
+            }
+        }
+
+        // Test 2: Required literals
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 2: required literals of regexes");
+
+            if( ([requiredLiteralForRegex(@"api\\.example\\.com") isEqualToString:@"api.example.com"]) &&
+                ([requiredLiteralForRegex(@"(foo|bar)\\.example\\.com") isEqualToString:@".example.com"]) &&
+                ([requiredLiteralForRegex(@"[a-z]+\\.cdn\\.net") isEqualToString:@".cdn.net"]) &&
+                ([requiredLiteralForRegex(@"abcx?yz") isEqualToString:@"abc"]) &&
+                ([requiredLiteralForRegex(@"ab{2}cd") isEqualToString:@"cd"]) &&
+                (nil == requiredLiteralForRegex(@"foo|bar")) &&
+                (nil == requiredLiteralForRegex(@"(?i)foo")) &&
+                (nil == requiredLiteralForRegex(@".*")) &&
+                (nil == requiredLiteralForRegex(@"\\d+")) ) {
+                NSLog(@"✅ PASS: literals extracted (or safely skipped)");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: unexpected literal");
+            }
+        }
+
+        // Test 3: Matcher agrees with per-rule regexes
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 3: matcher vs. per-rule regexes");
+
+            NSMutableArray* rules = [syntheticRules(300) mutableCopy];
+            [rules addObject:makeRule(@".*\\.evil\\.(com|net)", EndpointTypeRegex)];
+            [rules addObject:makeRule(@"foo|bar", EndpointTypeRegex)];
+            [rules addObject:makeRule(@"(?i)CASE\\.com", EndpointTypeRegex)];
+            [rules addObject:makeRule(@"*", EndpointTypeGlob)];
+            [rules addObject:makeRule(@"github.com", EndpointTypeExact)];
+
+            EndpointMatcher* matcher = [[EndpointMatcher alloc] init:rules];
+
+            NSArray* nameSets = @[@[@"www.tracker3.com"], @[@"85.4.1.2", @"host.example"], @[@"x1.cdn2.net"], @[@"x1.cdn2.com"],
+                                  @[@"a.evil.net"], @[@"foo"], @[@"foobar"], @[@"case.com"], @[@"github.com"], @[@"https://www.tracker30.com/p", @"www.tracker30.com"]];
+
+            BOOL ok = (304 == matcher.count);
+            for(NSArray* names in nameSets) {
+                if(YES != [[matcher match:names] isEqualToSet:referenceMatch([rules subarrayWithRange:NSMakeRange(0, 304)], names)]) {
+                    NSLog(@"   mismatch for %@", names);
+                    ok = NO;
+                }
+            }
+
+            if(YES == ok) {
+                NSLog(@"✅ PASS: same rules matched");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: matcher disagrees");
+            }
+        }
+
+        // Test 4: No (valid) patterns
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 4: no (valid) patterns");
+
+            if( (nil == [[EndpointMatcher alloc] init:@[makeRule(@"github.com", EndpointTypeExact)]]) &&
+                (nil == [[EndpointMatcher alloc] init:@[makeRule(@"(unbalanced", EndpointTypeRegex)]]) ) {
+                NSLog(@"✅ PASS: no matcher");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: matcher created");
+            }
+        }
+
+        // Benchmark: matcher vs. per-rule regexes
+        {
+            NSLog(@"\n⏱  Benchmark: 100 lookups (3 names each)");
+
+            NSMutableArray* names = [NSMutableArray array];
+            for(int i = 0; i < 100; i++) {
+                [names addObject:@[[NSString stringWithFormat:@"https://www.tracker%d.com/pixel", i], [NSString stringWithFormat:@"www.tracker%d.com", i], [NSString stringWithFormat:@"85.%d.1.1", i % 300]]];
+            }
+
+            for(NSNumber* count in @[@10, @100, @1000, @10000]) {
+                NSArray* rules = syntheticRules(count.unsignedIntegerValue);
+                for(Rule* rule in rules) [rule compiledEndpointRegex];
+
+                NSDate* start = [NSDate date];
+                EndpointMatcher* matcher = [[EndpointMatcher alloc] init:rules];
+                NSTimeInterval build = [[NSDate date] timeIntervalSinceDate:start];
+
+                NSUInteger hits = 0;
+                start = [NSDate date];
+                for(NSArray* flowNames in names) hits += [matcher match:flowNames].count;
+                NSTimeInterval automaton = [[NSDate date] timeIntervalSinceDate:start];
+
+                NSUInteger referenceHits = 0;
+                start = [NSDate date];
+                for(NSArray* flowNames in names) referenceHits += referenceMatch(rules, flowNames).count;
+                NSTimeInterval perRule = [[NSDate date] timeIntervalSinceDate:start];
+
+                NSLog(@"   %5lu patterns: build %.2f ms, matcher %.2f ms, per-rule regex %.2f ms (%lu/%lu hits)", (unsigned long)count.unsignedIntegerValue, build * 1000, automaton * 1000, perRule * 1000, (unsigned long)hits, (unsigned long)referenceHits);
+            }
+        }
+
+        // Test Results Summary
+        NSLog(@"\n🏁 Endpoint Matcher Test Results");
+        NSLog(@"================================");
+        NSLog(@"Tests Passed: %d/%d", testsPassed, totalTests);
+
+        if (testsPassed == totalTests) {
+            NSLog(@"✅ ALL TESTS PASSED!");
+            return 0;
+        } else {
+            NSLog(@"❌ %d tests failed. Please check implementation.", totalTests - testsPassed);
+            return 1;
+        }
+    }
+}
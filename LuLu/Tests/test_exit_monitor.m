@@ -0,0 +1,302 @@
+//
+//  test_exit_monitor.m
+//  LuLu
+//
+//  Tests (and an exit latency benchmark) for the (single, kqueue-based) process exit monitor
+//  builds against the real ExitMonitor.m
+//
+
+#import <Foundation/Foundation.h>
+#import <spawn.h>
+#import <signal.h>
+#import <sys/wait.h>
+#import <mach/mach.h>
+#import <mach/mach_time.h>
+#import <bsm/libbsm.h>
+
+#import "ExitMonitor.h"
+
+//log handle
+os_log_t logHandle = nil;
+
+//spawn a (long-running) child
+static pid_t spawnChild(void)
+{
+    pid_t child = 0;
+    char* arguments[] = {"/bin/sleep", "30", NULL};
+    posix_spawn(&child, "/bin/sleep", NULL, NULL, arguments, NULL);
+    return child;
+}
+
+//(live) pid version of a process
+// 0 if unknown
+static int versionOf(pid_t pid)
+{
+    int version = 0;
+    task_name_t task = MACH_PORT_NULL;
+    audit_token_t token = {0};
+    mach_msg_type_number_t size = TASK_AUDIT_TOKEN_COUNT;
+    if(KERN_SUCCESS != task_name_for_pid(mach_task_self(), pid, &task)) return 0;
+    if(KERN_SUCCESS == task_info(task, TASK_AUDIT_TOKEN, (task_info_t)&token, &size)) version = audit_token_to_pidversion(token);
+    mach_port_deallocate(mach_task_self(), task);
+    return version;
+}
+
+//kill (& reap) a child
+static void killChild(pid_t child)
+{
+    kill(child, SIGKILL);
+    waitpid(child, NULL, 0);
+}
+
+//wait (up to ~2s) for a condition
+static BOOL waitFor(BOOL(^condition)(void))
+{
+    for(int i = 0; i < 200; i++) {
+        if(YES == condition()) return YES;
+        usleep(10000);
+    }
+    return condition();
+}
+
+int main(int argc, const char * argv[]) {
+    @autoreleasepool {
+
+        NSLog(@"🧪 Exit Monitor Test Suite");
+        NSLog(@"==========================");
+
+        logHandle = os_log_create("com.objective-see.lulu.tests", "ExitMonitor");
+
+        int testsPassed = 0;
+        int totalTests = 0;
+
+        // Test 1: Exit is delivered
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 1: exit delivered");
+
+            ExitMonitor* monitor = [[ExitMonitor alloc] init];
+            __block int delivered = 0;
+
+            pid_t child = spawnChild();
+            id watch = [monitor watch:child version:versionOf(child) handler:^{ @synchronized(monitor) { delivered++; } }];
+            BOOL watching = ( (nil != watch) && (1 == monitor.count) );
+
+            killChild(child);
+
+            if( (YES == watching) &&
+                (YES == waitFor(^BOOL{ @synchronized(monitor) { return (1 == delivered); } })) &&
+                (0 == monitor.count) &&
+                (1 == monitor.exits) ) {
+                NSLog(@"✅ PASS: handler invoked (once), watch removed");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: delivered: %d, count: %lu", delivered, (unsigned long)monitor.count);
+            }
+        }
+
+        // Test 2: Already exited process
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 2: already exited");
+
+            ExitMonitor* monitor = [[ExitMonitor alloc] init];
+            __block BOOL delivered = NO;
+
+            pid_t child = spawnChild();
+            int version = versionOf(child);
+            killChild(child);
+
+            id watch = [monitor watch:child version:version handler:^{ delivered = YES; }];
+            usleep(100000);
+
+            if( (nil == watch) &&
+                (NO == delivered) &&
+                (0 == monitor.count) &&
+                (nil == [monitor watch:0 version:0 handler:^{}]) ) {
+                NSLog(@"✅ PASS: no watch (& no handler) for exited process");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: watch: %@, delivered: %d", watch, delivered);
+            }
+        }
+
+        // Test 3: Many watches, one process
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 3: shared watches");
+
+            ExitMonitor* monitor = [[ExitMonitor alloc] init];
+            __block int delivered = 0;
+
+            pid_t child = spawnChild();
+            NSMutableArray* watches = [NSMutableArray array];
+            for(int i = 0; i < 3; i++) {
+                [watches addObject:[monitor watch:child version:versionOf(child) handler:^{ @synchronized(monitor) { delivered++; } }]];
+            }
+            BOOL shared = ( (1 == monitor.count) && (3 == monitor.watchCount) );
+
+            //unwatch one
+            [monitor unwatch:watches[0]];
+            BOOL unwatched = (2 == monitor.watchCount);
+
+            killChild(child);
+
+            if( (YES == shared) &&
+                (YES == unwatched) &&
+                (YES == waitFor(^BOOL{ @synchronized(monitor) { return (2 == delivered); } })) &&
+                (1 == monitor.exits) ) {
+                NSLog(@"✅ PASS: one (kernel) watch per pid, unwatched handler not invoked");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: delivered: %d", delivered);
+            }
+        }
+
+        // Test 4: Unwatch (last) watch
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 4: unwatch");
+
+            ExitMonitor* monitor = [[ExitMonitor alloc] init];
+            __block BOOL delivered = NO;
+
+            pid_t child = spawnChild();
+            id watch = [monitor watch:child version:versionOf(child) handler:^{ delivered = YES; }];
+            [monitor unwatch:watch];
+            [monitor unwatch:@"not a watch"];
+
+            killChild(child);
+            usleep(100000);
+
+            if( (NO == delivered) &&
+                (0 == monitor.count) &&
+                (0 == monitor.exits) ) {
+                NSLog(@"✅ PASS: no handler after unwatch");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: delivered: %d, exits: %llu", delivered, monitor.exits);
+            }
+        }
+
+        // Test 5: Handlers can (re)watch
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 5: (re)watch from handler");
+
+            ExitMonitor* monitor = [[ExitMonitor alloc] init];
+            __block int delivered = 0;
+
+            pid_t first = spawnChild();
+            pid_t second = spawnChild();
+
+            [monitor watch:first version:versionOf(first) handler:^{
+                @synchronized(monitor) { delivered++; }
+                [monitor watch:second version:versionOf(second) handler:^{ @synchronized(monitor) { delivered++; } }];
+            }];
+
+            killChild(first);
+            BOOL firstDelivered = waitFor(^BOOL{ @synchronized(monitor) { return (1 == delivered); } });
+
+            killChild(second);
+
+            if( (YES == firstDelivered) &&
+                (YES == waitFor(^BOOL{ @synchronized(monitor) { return (2 == delivered); } })) ) {
+                NSLog(@"✅ PASS: watch added from a handler, w/o deadlock");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: delivered: %d", delivered);
+            }
+        }
+
+        // Test 6: Reused pid
+        // watch is for a pid + version, so a (live) process w/ a different version isn't watched
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 6: reused pid (version mismatch)");
+
+            ExitMonitor* monitor = [[ExitMonitor alloc] init];
+            __block BOOL delivered = NO;
+
+            pid_t child = spawnChild();
+            int version = versionOf(child);
+
+            id stale = [monitor watch:child version:version + 1 handler:^{ delivered = YES; }];
+            NSUInteger staleCount = monitor.count;
+            id current = [monitor watch:child version:version handler:^{}];
+            id unknown = [monitor watch:child version:0 handler:^{}];
+
+            killChild(child);
+            usleep(100000);
+
+            if( (0 != version) &&
+                (nil == stale) &&
+                (0 == staleCount) &&
+                (nil != current) &&
+                (nil != unknown) &&
+                (NO == delivered) ) {
+                NSLog(@"✅ PASS: mismatched version treated as exited, matching (or unknown) version watched");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: version: %d, stale: %@ (count: %lu), current: %@, unknown: %@", version, stale, (unsigned long)staleCount, current, unknown);
+            }
+        }
+
+        // Benchmark: exit latency & watch cost
+        // vs. the old (60s) poll, where a held flow of an exited process lingered up to a minute
+        {
+            NSLog(@"\n⏱  Benchmark: exit latency (50 processes)");
+
+            ExitMonitor* monitor = [[ExitMonitor alloc] init];
+            mach_timebase_info_data_t timebase = {0};
+            mach_timebase_info(&timebase);
+
+            __block uint64_t exited = 0;
+            uint64_t total = 0;
+            uint64_t max = 0;
+
+            for(int i = 0; i < 50; i++) {
+                pid_t child = spawnChild();
+                exited = 0;
+                [monitor watch:child version:versionOf(child) handler:^{ @synchronized(monitor) { exited = mach_absolute_time(); } }];
+
+                uint64_t killed = mach_absolute_time();
+                kill(child, SIGKILL);
+                waitFor(^BOOL{ @synchronized(monitor) { return (0 != exited); } });
+                waitpid(child, NULL, 0);
+
+                uint64_t latency = (exited - killed) * timebase.numer / timebase.denom;
+                total += latency;
+                max = MAX(max, latency);
+            }
+
+            NSLog(@"   kill -> handler: %.1f µs mean, %.1f µs max (vs. up to 60 s w/ the poll)", total / 50.0 / 1000.0, max / 1000.0);
+
+            //watch cost
+            pid_t child = spawnChild();
+            NSMutableArray* watches = [NSMutableArray array];
+            NSDate* start = [NSDate date];
+            for(int i = 0; i < 10000; i++) [watches addObject:[monitor watch:child version:versionOf(child) handler:^{}]];
+            NSTimeInterval watchTime = [[NSDate date] timeIntervalSinceDate:start];
+            start = [NSDate date];
+            for(id watch in watches) [monitor unwatch:watch];
+            NSTimeInterval unwatchTime = [[NSDate date] timeIntervalSinceDate:start];
+            killChild(child);
+
+            NSLog(@"   watch: %.2f µs, unwatch: %.2f µs (10k watches, one process)", watchTime * 1e6 / 10000, unwatchTime * 1e6 / 10000);
+        }
+
+        // Test Results Summary
+        NSLog(@"\n🏁 Exit Monitor Test Results");
+        NSLog(@"===========================");
+        NSLog(@"Tests Passed: %d/%d", testsPassed, totalTests);
+
+        if (testsPassed == totalTests) {
+            NSLog(@"✅ ALL TESTS PASSED!");
+            return 0;
+        } else {
+            NSLog(@"❌ %d tests failed. Please check implementation.", totalTests - testsPassed);
+            return 1;
+        }
+    }
+}
@@ -0,0 +1,331 @@
+//
+//  test_flow_match_context.m
+//  LuLu
+//
+//  Tests (and a replay benchmark) for the per-flow match context
+//  builds against the real FlowMatchContext.m, Rule.m, ListMatcher.m (and utilities.m)
+//
+
+#import <Foundation/Foundation.h>
+#import <sys/socket.h>
+#import <stdatomic.h>
+
+#import "Rule.h"
+#import "ListMatcher.h"
+#import "FlowMatchContext.h"
+
+//log handle
+os_log_t logHandle = nil;
+
+//malloc logger
+// (libmalloc) hook, called on each allocation/free
+typedef void (malloc_logger_t)(uint32_t type, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3, uintptr_t result, uint32_t num_hot_frames_to_skip);
+extern malloc_logger_t* malloc_logger;
+
+//allocation type flag
+#define MALLOC_LOG_TYPE_ALLOCATE 2
+
+//allocation count
+static atomic_ulong allocations = 0;
+
+//count allocations
+static void countAllocations(uint32_t type, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3, uintptr_t result, uint32_t num_hot_frames_to_skip)
+{
+    if(0 != (type & MALLOC_LOG_TYPE_ALLOCATE)) atomic_fetch_add(&allocations, 1);
+}
+
+//make a rule
+static Rule* makeRule(NSString* addr, EndpointType type, NSString* port)
+{
+    return [[Rule alloc] init:@{KEY_PATH:@"/usr/bin/curl", KEY_KEY:@"/usr/bin/curl", KEY_PROCESS_NAME:@"curl", KEY_ENDPOINT_ADDR:addr, KEY_ENDPOINT_ADDR_IS_REGEX:@(type), KEY_ENDPOINT_PORT:port}];
+}
+
+//legacy (per check) endpoint names
+// i.e. what rules/lists each rebuilt from the flow
+static NSArray* legacyNames(NSURL* url, NSString* hostname, NSString* remoteHostname)
+{
+    NSMutableArray* names = [NSMutableArray array];
+
+    if(nil != url.absoluteString)
+    {
+        [names addObject:url.absoluteString];
+        if(nil != url.host) [names addObject:url.host];
+    }
+    if(nil != hostname) [names addObject:hostname];
+    if(nil != remoteHostname) [names addObject:remoteHostname];
+
+    return names;
+}
+
+//legacy rule check
+// names rebuilt, compared case-insensitively, and parsed (per CIDR rule)
+static BOOL legacyRuleMatch(Rule* rule, NSURL* url, NSString* hostname, NSString* remoteHostname)
+{
+    for(NSString* name in legacyNames(url, hostname, remoteHostname))
+    {
+        if(EndpointTypeCIDR == rule.isEndpointAddrRegex)
+        {
+            if(YES == [rule endpointAddrInRange:name]) return YES;
+        }
+        else if( (NSOrderedSame == [rule.endpointAddr caseInsensitiveCompare:name]) ||
+                 ((nil != rule.endpointHost) && (NSOrderedSame == [rule.endpointHost caseInsensitiveCompare:name])) )
+        {
+            return YES;
+        }
+    }
+
+    return NO;
+}
+
+//legacy list check
+// lower-cased names rebuilt (per list)
+static BOOL legacyListMatch(ListMatcher* list, NSURL* url, NSString* hostname, NSString* remoteHostname)
+{
+    NSMutableSet* names = [NSMutableSet set];
+
+    for(NSString* name in legacyNames(url, hostname, remoteHostname))
+    {
+        [names addObject:name.lowercaseString];
+    }
+    if(YES == [remoteHostname hasPrefix:@"www."]) [names addObject:[[remoteHostname substringFromIndex:4] lowercaseString]];
+
+    return (nil != [list match:names]);
+}
+
+//context rule check
+static BOOL contextRuleMatch(Rule* rule, FlowMatchContext* context)
+{
+    if(EndpointTypeCIDR == rule.isEndpointAddrRegex)
+    {
+        for(NSUInteger i = 0; i < context.addressCount; i++)
+        {
+            const FlowAddress* address = [context addressAtIndex:i];
+            if(YES == [rule endpointAddrInRange:address->bytes family:address->family]) return YES;
+        }
+        return NO;
+    }
+
+    return [rule endpointAddrInNames:context.lowercaseNames];
+}
+
+int main(int argc, const char * argv[]) {
+    @autoreleasepool {
+
+        NSLog(@"🧪 Flow Match Context Test Suite");
+        NSLog(@"================================");
+
+        logHandle = os_log_create("com.objective-see.lulu.tests", "FlowMatchContext");
+
+        int testsPassed = 0;
+        int totalTests = 0;
+
+        // Test 1: Names are de-duplicated (in order) & lower-cased once
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 1: names (ordered, de-duplicated, lower-cased)");
+
+            FlowMatchContext* context = [[FlowMatchContext alloc] initWithURL:[NSURL URLWithString:@"https://WWW.Example.com/path"] hostname:@"93.184.216.34" remoteHostname:@"WWW.Example.com" port:@"443" family:AF_INET protocol:IPPROTO_TCP];
+
+            NSArray* expected = @[@"https://WWW.Example.com/path", @"WWW.Example.com", @"93.184.216.34"];
+
+            if( (YES == [context.names isEqualToArray:expected]) &&
+                (YES == [context.lowercaseNames containsObject:@"www.example.com"]) &&
+                (NO == [context.lowercaseNames containsObject:@"example.com"]) &&
+                (YES == [context.listNames containsObject:@"example.com"]) &&
+                (YES == [context.listNames containsObject:@"https://www.example.com/path"]) &&
+                (443 == context.portNumber) &&
+                (IPPROTO_TCP == context.protocol) ) {
+                NSLog(@"✅ PASS: names built once");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: names: %@ / %@ / %@", context.names, context.lowercaseNames, context.listNames);
+            }
+        }
+
+        // Test 2: Numeric addresses are parsed once (hostnames/URLs skipped)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 2: numeric addresses");
+
+            FlowMatchContext* v4 = [[FlowMatchContext alloc] initWithURL:nil hostname:@"10.1.2.3" remoteHostname:@"host.local" port:@"22" family:AF_INET protocol:IPPROTO_TCP];
+            FlowMatchContext* v6 = [[FlowMatchContext alloc] initWithURL:nil hostname:@"2001:db8::1" remoteHostname:nil port:@"22" family:AF_INET6 protocol:IPPROTO_TCP];
+            FlowMatchContext* none = [[FlowMatchContext alloc] initWithURL:[NSURL URLWithString:@"https://github.com"] hostname:@"github.com" remoteHostname:nil port:@"443" family:AF_INET protocol:IPPROTO_TCP];
+
+            if( (1 == v4.addressCount) &&
+                (AF_INET == [v4 addressAtIndex:0]->family) &&
+                (10 == [v4 addressAtIndex:0]->bytes[0]) &&
+                (1 == v6.addressCount) &&
+                (AF_INET6 == [v6 addressAtIndex:0]->family) &&
+                (0 == none.addressCount) &&
+                (NULL == [none addressAtIndex:0]) ) {
+                NSLog(@"✅ PASS: addresses parsed");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: addresses (%lu, %lu, %lu)", (unsigned long)v4.addressCount, (unsigned long)v6.addressCount, (unsigned long)none.addressCount);
+            }
+        }
+
+        // Test 3: Best host name (url host, remote host name, then endpoint)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 3: best host name");
+
+            FlowMatchContext* url = [[FlowMatchContext alloc] initWithURL:[NSURL URLWithString:@"https://api.github.com/x"] hostname:@"140.82.112.6" remoteHostname:@"github.com" port:@"443" family:AF_INET protocol:IPPROTO_TCP];
+            FlowMatchContext* remote = [[FlowMatchContext alloc] initWithURL:nil hostname:@"140.82.112.6" remoteHostname:@"github.com" port:@"443" family:AF_INET protocol:IPPROTO_TCP];
+            FlowMatchContext* endpoint = [[FlowMatchContext alloc] initWithURL:nil hostname:@"140.82.112.6" remoteHostname:@"" port:@"443" family:AF_INET protocol:IPPROTO_TCP];
+            FlowMatchContext* empty = [[FlowMatchContext alloc] initWithURL:nil hostname:@"" remoteHostname:nil port:nil family:AF_INET protocol:IPPROTO_UDP];
+
+            if( (YES == [url.bestHostname isEqualToString:@"api.github.com"]) &&
+                (YES == [remote.bestHostname isEqualToString:@"github.com"]) &&
+                (YES == [endpoint.bestHostname isEqualToString:@"140.82.112.6"]) &&
+                (nil == empty.bestHostname) ) {
+                NSLog(@"✅ PASS: best host name picked");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: best host names: %@, %@, %@, %@", url.bestHostname, remote.bestHostname, endpoint.bestHostname, empty.bestHostname);
+            }
+        }
+
+        // Test 4: Rule checks match the legacy (per rule) checks
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 4: rule checks (context vs. legacy)");
+
+            NSArray* rules = @[makeRule(@"GitHub.com", EndpointTypeExact, @"443"), makeRule(@"https://github.com/login", EndpointTypeExact, @"443"), makeRule(@"10.0.0.0/8", EndpointTypeCIDR, @"*"), makeRule(@"2001:db8::/32", EndpointTypeCIDR, @"*"), makeRule(@"192.168.1.10 - 192.168.1.20", EndpointTypeCIDR, @"*"), makeRule(@"8.8.8.8", EndpointTypeExact, @"53")];
+
+            NSArray* flows = @[
+                @[[NSURL URLWithString:@"https://github.com/login"], @"140.82.112.6", @"github.com"],
+                @[[NSNull null], @"10.9.8.7", @"intranet.local"],
+                @[[NSNull null], @"2001:db8::42", [NSNull null]],
+                @[[NSNull null], @"192.168.1.15", [NSNull null]],
+                @[[NSNull null], @"192.168.1.21", [NSNull null]],
+                @[[NSNull null], @"8.8.8.8", @"dns.google"],
+                @[[NSNull null], @"1.1.1.1", @"one.one.one.one"],
+            ];
+
+            BOOL agreed = YES;
+            NSUInteger matched = 0;
+            for(NSArray* flow in flows)
+            {
+                NSURL* url = (NSNull.null == flow[0]) ? nil : flow[0];
+                NSString* remoteHostname = (NSNull.null == flow[2]) ? nil : flow[2];
+
+                FlowMatchContext* context = [[FlowMatchContext alloc] initWithURL:url hostname:flow[1] remoteHostname:remoteHostname port:@"443" family:([flow[1] containsString:@":"] ? AF_INET6 : AF_INET) protocol:IPPROTO_TCP];
+
+                for(Rule* rule in rules)
+                {
+                    BOOL legacy = legacyRuleMatch(rule, url, flow[1], remoteHostname);
+                    if(legacy != contextRuleMatch(rule, context)) agreed = NO;
+                    matched += legacy;
+                }
+            }
+
+            if( (YES == agreed) && (6 == matched) ) {
+                NSLog(@"✅ PASS: context checks agree (%lu matches)", (unsigned long)matched);
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: context checks disagree (agreed: %d, matches: %lu)", agreed, (unsigned long)matched);
+            }
+        }
+
+        // Test 5: List checks match the legacy (per list) checks
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 5: list checks (context vs. legacy)");
+
+            ListMatcher* list = [[ListMatcher alloc] init:@"example.com\n*.doubleclick.net\n10.0.0.0/8\n"];
+
+            FlowMatchContext* www = [[FlowMatchContext alloc] initWithURL:nil hostname:@"93.184.216.34" remoteHostname:@"www.example.com" port:@"443" family:AF_INET protocol:IPPROTO_TCP];
+            FlowMatchContext* ad = [[FlowMatchContext alloc] initWithURL:nil hostname:@"1.2.3.4" remoteHostname:@"AD.DoubleClick.net" port:@"443" family:AF_INET protocol:IPPROTO_TCP];
+            FlowMatchContext* ip = [[FlowMatchContext alloc] initWithURL:nil hostname:@"10.0.0.1" remoteHostname:nil port:@"443" family:AF_INET protocol:IPPROTO_TCP];
+            FlowMatchContext* miss = [[FlowMatchContext alloc] initWithURL:nil hostname:@"1.2.3.4" remoteHostname:@"github.com" port:@"443" family:AF_INET protocol:IPPROTO_TCP];
+
+            if( (nil != [list match:www.listNames]) &&
+                (YES == legacyListMatch(list, nil, @"93.184.216.34", @"www.example.com")) &&
+                (nil != [list match:ad.listNames]) &&
+                (nil != [list match:ip.listNames]) &&
+                (nil == [list match:miss.listNames]) ) {
+                NSLog(@"✅ PASS: list checks agree");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: list checks disagree");
+            }
+        }
+
+        // Benchmark: replay flows, legacy vs. context
+        {
+            NSLog(@"\n⏱  Benchmark: replay 10k flows (2 lists, 50 rules)");
+
+            ListMatcher* blockList = [[ListMatcher alloc] init:@"*.doubleclick.net\nexample.org\n172.16.0.0/12\n"];
+            ListMatcher* allowList = [[ListMatcher alloc] init:@"apple.com\n*.icloud.com\n"];
+
+            NSMutableArray* rules = [NSMutableArray array];
+            for(int i = 0; i < 50; i++)
+            {
+                if(0 == i % 5) [rules addObject:makeRule([NSString stringWithFormat:@"10.%d.0.0/16", i], EndpointTypeCIDR, @"*")];
+                else [rules addObject:makeRule([NSString stringWithFormat:@"host%d.example.com", i], EndpointTypeExact, @"443")];
+            }
+
+            NSMutableArray* flows = [NSMutableArray array];
+            for(int i = 0; i < 10000; i++)
+            {
+                NSString* hostname = [NSString stringWithFormat:@"10.%d.%d.%d", i % 60, (i >> 8) & 0xFF, i & 0xFF];
+                NSString* remoteHostname = [NSString stringWithFormat:@"www.host%d.example.com", i % 100];
+                [flows addObject:@[hostname, remoteHostname]];
+            }
+
+            for(int pass = 0; pass < 2; pass++)
+            {
+                NSUInteger hits = 0;
+                NSDate* start = nil;
+                unsigned long count = 0;
+
+                atomic_store(&allocations, 0);
+                malloc_logger = countAllocations;
+                start = [NSDate date];
+
+                for(NSArray* flow in flows)
+                {
+                    @autoreleasepool
+                    {
+                        //legacy: names rebuilt per list & per rule
+                        if(0 == pass)
+                        {
+                            hits += legacyListMatch(blockList, nil, flow[0], flow[1]);
+                            hits += legacyListMatch(allowList, nil, flow[0], flow[1]);
+                            for(Rule* rule in rules) hits += legacyRuleMatch(rule, nil, flow[0], flow[1]);
+                        }
+                        //context: built once, shared
+                        else
+                        {
+                            FlowMatchContext* context = [[FlowMatchContext alloc] initWithURL:nil hostname:flow[0] remoteHostname:flow[1] port:@"443" family:AF_INET protocol:IPPROTO_TCP];
+
+                            hits += (nil != [blockList match:context.listNames]);
+                            hits += (nil != [allowList match:context.listNames]);
+                            for(Rule* rule in rules) hits += contextRuleMatch(rule, context);
+                        }
+                    }
+                }
+
+                NSTimeInterval elapsed = [[NSDate date] timeIntervalSinceDate:start];
+                malloc_logger = NULL;
+                count = atomic_load(&allocations);
+
+                NSLog(@"   %@: %.2f ms (%.1f allocations/flow, %lu hits)", (0 == pass) ? @"legacy " : @"context", elapsed * 1000, (double)count / flows.count, (unsigned long)hits);
+            }
+        }
+
+        // Test Results Summary
+        NSLog(@"\n🏁 Flow Match Context Test Results");
+        NSLog(@"==================================");
+        NSLog(@"Tests Passed: %d/%d", testsPassed, totalTests);
+
+        if (testsPassed == totalTests) {
+            NSLog(@"✅ ALL TESTS PASSED!");
+            return 0;
+        } else {
+            NSLog(@"❌ %d tests failed. Please check implementation.", totalTests - testsPassed);
+            return 1;
+        }
+    }
+}
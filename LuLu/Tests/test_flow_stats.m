@@ -0,0 +1,249 @@
+//
+//  test_flow_stats.m
+//  LuLu
+//
+//  Tests (and an overhead benchmark) for the per stage flow latency histograms & verdict counters
+//  builds against the real FlowStats.m
+//
+
+#import <Foundation/Foundation.h>
+#import <mach/mach_time.h>
+
+#import "consts.h"
+#import "FlowStats.h"
+
+//log handle
+os_log_t logHandle = nil;
+
+//exact percentile
+// of a sorted array of values
+static uint64_t exactPercentile(NSArray<NSNumber*>* sorted, double percentile)
+{
+    NSUInteger rank = (NSUInteger)ceil(percentile / 100.0 * sorted.count);
+    if(0 == rank) rank = 1;
+    return sorted[rank - 1].unsignedLongLongValue;
+}
+
+//within (relative) error?
+static BOOL within(uint64_t value, uint64_t expected, double error)
+{
+    return (fabs((double)value - (double)expected) <= (expected * error) + 1);
+}
+
+//stage from a snapshot
+static NSDictionary* stageNamed(NSDictionary* snapshot, NSString* name)
+{
+    for(NSDictionary* stage in snapshot[KEY_STATS_STAGES]) {
+        if(YES == [stage[KEY_STATS_NAME] isEqualToString:name]) return stage;
+    }
+    return nil;
+}
+
+//busy work
+// stand-in for a (fast) flow decision
+static uint64_t work(uint64_t seed)
+{
+    for(int i = 0; i < 200; i++) seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return seed;
+}
+
+int main(int argc, const char * argv[]) {
+    @autoreleasepool {
+
+        NSLog(@"🧪 Flow Stats Test Suite");
+        NSLog(@"========================");
+
+        logHandle = os_log_create("com.objective-see.lulu.tests", "FlowStats");
+
+        int testsPassed = 0;
+        int totalTests = 0;
+
+        // Test 1: Small values are exact
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 1: exact (small) values");
+
+            FlowStats* stats = [[FlowStats alloc] init];
+            for(uint64_t value = 1; value <= 10; value++) [stats record:FlowStageRules nanoseconds:value];
+
+            if( (10 == [stats count:FlowStageRules]) &&
+                (5 == [stats percentile:50 stage:FlowStageRules]) &&
+                (10 == [stats percentile:99 stage:FlowStageRules]) &&
+                (0 == [stats percentile:50 stage:FlowStageAlert]) ) {
+                NSLog(@"✅ PASS: small values recorded exactly");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: p50: %llu, p99: %llu", [stats percentile:50 stage:FlowStageRules], [stats percentile:99 stage:FlowStageRules]);
+            }
+        }
+
+        // Test 2: Percentiles (vs. exact) on a long-tailed distribution
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 2: percentiles within ~6%%");
+
+            FlowStats* stats = [[FlowStats alloc] init];
+            NSMutableArray* values = [NSMutableArray array];
+
+            srandom(42);
+            for(int i = 0; i < 100000; i++) {
+                //mostly ~µs, w/ a tail out to ~100ms
+                uint64_t value = 500 + (random() % 5000);
+                if(0 == i % 100) value = 100000 + (random() % 10000000);
+                if(0 == i % 5000) value = 100000000 + (random() % 1000);
+                [stats record:FlowStageTotal nanoseconds:value];
+                [values addObject:@(value)];
+            }
+
+            NSArray* sorted = [values sortedArrayUsingSelector:@selector(compare:)];
+            BOOL ok = YES;
+            for(NSNumber* percentile in @[@50, @90, @99, @99.9]) {
+                uint64_t recorded = [stats percentile:percentile.doubleValue stage:FlowStageTotal];
+                uint64_t expected = exactPercentile(sorted, percentile.doubleValue);
+                if(YES != within(recorded, expected, 0.0625)) {
+                    NSLog(@"   p%@: %llu vs. %llu", percentile, recorded, expected);
+                    ok = NO;
+                }
+            }
+
+            if( (YES == ok) &&
+                ([stats percentile:100 stage:FlowStageTotal] == [sorted.lastObject unsignedLongLongValue]) ) {
+                NSLog(@"✅ PASS: p50/p90/p99/p999 within bucket error, p100 is max");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: percentiles off");
+            }
+        }
+
+        // Test 3: Huge values are clamped (not dropped)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 3: clamped values");
+
+            FlowStats* stats = [[FlowStats alloc] init];
+            [stats record:FlowStageAlert nanoseconds:UINT64_MAX / 2];
+            [stats record:FlowStageAlert nanoseconds:0];
+
+            if( (2 == [stats count:FlowStageAlert]) &&
+                (0 == [stats percentile:50 stage:FlowStageAlert]) &&
+                ([stats percentile:100 stage:FlowStageAlert] >= (1ULL << (FLOW_HISTOGRAM_MAX_BITS - 1))) ) {
+                NSLog(@"✅ PASS: huge value clamped into last bucket");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: count: %llu", [stats count:FlowStageAlert]);
+            }
+        }
+
+        // Test 4: Concurrent recording (no lost updates)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 4: concurrent recording");
+
+            FlowStats* stats = [[FlowStats alloc] init];
+            dispatch_apply(8, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t thread) {
+                for(int i = 0; i < 100000; i++) {
+                    [stats record:FlowStageProcess nanoseconds:(thread + 1) * 1000];
+                    [stats count:FlowStatsVerdictAllow];
+                }
+            });
+
+            NSDictionary* snapshot = [stats snapshot];
+            NSDictionary* process = stageNamed(snapshot, @"process");
+
+            if( (800000 == [process[KEY_STATS_COUNT] unsignedLongLongValue]) &&
+                (4500 == [process[KEY_STATS_MEAN] unsignedLongLongValue]) &&
+                (8000 == [process[KEY_STATS_MAX] unsignedLongLongValue]) &&
+                (800000 == [snapshot[KEY_STATS_VERDICTS][@"allow"] unsignedLongLongValue]) ) {
+                NSLog(@"✅ PASS: 800k values from 8 threads");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: %@", process);
+            }
+        }
+
+        // Test 5: Snapshot (plist types, all stages & verdicts)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 5: snapshot");
+
+            FlowStats* stats = [[FlowStats alloc] init];
+            uint64_t start = mach_absolute_time();
+            [NSThread sleepForTimeInterval:0.002];
+            [stats record:FlowStageSigning start:start];
+            [stats count:FlowStatsVerdictBlock];
+            [stats count:FlowStatsVerdictCached];
+
+            NSDictionary* snapshot = [stats snapshot];
+            NSDictionary* signing = stageNamed(snapshot, @"signing");
+
+            if( (FlowStageCount == [snapshot[KEY_STATS_STAGES] count]) &&
+                ([stageNamed(snapshot, @"total") isEqual:[snapshot[KEY_STATS_STAGES] firstObject]]) &&
+                (nil != stageNamed(snapshot, @"relatedFlows")) &&
+                (1 == [signing[KEY_STATS_COUNT] unsignedLongLongValue]) &&
+                ([signing[KEY_STATS_P50] unsignedLongLongValue] >= 2000000) &&
+                (1 == [snapshot[KEY_STATS_VERDICTS][@"block"] unsignedLongLongValue]) &&
+                (1 == [snapshot[KEY_STATS_VERDICTS][@"cached"] unsignedLongLongValue]) &&
+                (YES == [NSPropertyListSerialization propertyList:snapshot isValidForFormat:NSPropertyListBinaryFormat_v1_0]) ) {
+                NSLog(@"✅ PASS: snapshot has all stages & verdicts (and is a valid plist)");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: snapshot: %@", snapshot);
+            }
+        }
+
+        // Benchmark: overhead
+        // a flow records ~5 stages (total, verdict cache, process, rules, & one list) plus a verdict
+        {
+            NSLog(@"\n⏱  Benchmark: overhead (1M records)");
+
+            FlowStats* stats = [[FlowStats alloc] init];
+            uint64_t sink = 0;
+
+            NSDate* start = [NSDate date];
+            for(int i = 0; i < 1000000; i++) {
+                [stats record:(FlowStage)(i % FlowStageCount) start:mach_absolute_time()];
+            }
+            NSTimeInterval recordTime = [[NSDate date] timeIntervalSinceDate:start];
+            NSLog(@"   record (incl. clock read): %.1f ns each", recordTime * 1e9 / 1000000);
+
+            start = [NSDate date];
+            for(int i = 0; i < 100000; i++) {
+                for(int stage = 0; stage < 5; stage++) sink += work(i + stage) & 1;
+            }
+            NSTimeInterval plain = [[NSDate date] timeIntervalSinceDate:start];
+
+            start = [NSDate date];
+            for(int i = 0; i < 100000; i++) {
+                uint64_t flowStart = mach_absolute_time();
+                for(int stage = 1; stage < 5; stage++) {
+                    uint64_t stageStart = mach_absolute_time();
+                    sink += work(i + stage) & 1;
+                    [stats record:(FlowStage)stage start:stageStart];
+                }
+                sink += work(i) & 1;
+                [stats record:FlowStageTotal start:flowStart];
+                [stats count:FlowStatsVerdictAllow];
+            }
+            NSTimeInterval instrumented = [[NSDate date] timeIntervalSinceDate:start];
+
+            NSLog(@"   100k synthetic flows: %.2f ms plain vs. %.2f ms instrumented (%.1f%% overhead, %.2f µs/flow) (sink: %llu)", plain * 1000, instrumented * 1000, (instrumented - plain) * 100 / plain, plain * 1e6 / 100000, sink & 1);
+
+            start = [NSDate date];
+            for(int i = 0; i < 1000; i++) [stats snapshot];
+            NSLog(@"   snapshot: %.1f µs each", [[NSDate date] timeIntervalSinceDate:start] * 1e6 / 1000);
+        }
+
+        // Test Results Summary
+        NSLog(@"\n🏁 Flow Stats Test Results");
+        NSLog(@"=========================");
+        NSLog(@"Tests Passed: %d/%d", testsPassed, totalTests);
+
+        if (testsPassed == totalTests) {
+            NSLog(@"✅ ALL TESTS PASSED!");
+            return 0;
+        } else {
+            NSLog(@"❌ %d tests failed. Please check implementation.", totalTests - testsPassed);
+            return 1;
+        }
+    }
+}
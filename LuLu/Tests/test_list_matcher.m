@@ -0,0 +1,228 @@
+//
+//  test_list_matcher.m
+//  LuLu
+//
+//  Tests (and a 1M-item benchmark) for the compiled block/allow list matcher & its (binary) image
+//  builds against the real ListMatcher.m (and utilities.m, for range parsing)
+//
+
+#import <Foundation/Foundation.h>
+#import <mach/mach.h>
+
+#import "ListMatcher.h"
+
+//log handle
+os_log_t logHandle = nil;
+
+//resident memory (in MB)
+static double residentMB(void)
+{
+    mach_task_basic_info_data_t info = {0};
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+
+    if(KERN_SUCCESS != task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count)) return 0;
+
+    return info.resident_size / (1024.0 * 1024.0);
+}
+
+//check a single name
+static BOOL matches(ListMatcher* matcher, NSString* name)
+{
+    return (nil != [matcher match:[NSSet setWithObject:name]]);
+}
+
+int main(int argc, const char * argv[]) {
+    @autoreleasepool {
+
+        NSLog(@"🧪 List Matcher Test Suite");
+        NSLog(@"==========================");
+
+        logHandle = os_log_create("com.objective-see.lulu.tests", "ListMatcher");
+
+        int testsPassed = 0;
+        int totalTests = 0;
+
+        ListMatcher* matcher = [[ListMatcher alloc] init:@"# comment\n\n  Example.COM \n*.doubleclick.net\nhttps://evil.com/path\n10.0.0.0/8\n2001:db8::/32\n192.168.1.10 - 192.168.1.20\n"];
+
+        // Test 1: Exact items (trimmed, lower-cased)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 1: exact items");
+
+            if( (YES == matches(matcher, @"example.com")) &&
+                (YES == matches(matcher, @"https://evil.com/path")) &&
+                (NO == matches(matcher, @"sub.example.com")) &&
+                (NO == matches(matcher, @"# comment")) ) {
+                NSLog(@"✅ PASS: exact items matched");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: exact items");
+            }
+        }
+
+        // Test 2: Wildcard items (sub-domains only)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 2: wildcard items");
+
+            if( (YES == matches(matcher, @"ad.doubleclick.net")) &&
+                (YES == matches(matcher, @"a.b.c.doubleclick.net")) &&
+                (NO == matches(matcher, @"doubleclick.net")) &&
+                (NO == matches(matcher, @"notdoubleclick.net")) ) {
+                NSLog(@"✅ PASS: wildcard items matched");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: wildcard items");
+            }
+        }
+
+        // Test 3: CIDR & range items
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 3: CIDR/range items");
+
+            if( (YES == matches(matcher, @"10.1.2.3")) &&
+                (NO == matches(matcher, @"11.0.0.1")) &&
+                (YES == matches(matcher, @"2001:db8::1")) &&
+                (NO == matches(matcher, @"2001:db9::1")) &&
+                (YES == matches(matcher, @"192.168.1.10")) &&
+                (YES == matches(matcher, @"192.168.1.20")) &&
+                (NO == matches(matcher, @"192.168.1.21")) &&
+                (NO == matcher.matchesAllIPv4) &&
+                (6 == matcher.count) ) {
+                NSLog(@"✅ PASS: CIDR/range items matched");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: CIDR/range items");
+            }
+        }
+
+        // Test 4: 'all' items
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 4: '0.0.0.0/0' and '::/0'");
+
+            ListMatcher* all = [[ListMatcher alloc] init:@"0.0.0.0/0\n::/0"];
+
+            if( (YES == all.matchesAllIPv4) &&
+                (YES == all.matchesAllIPv6) &&
+                (YES == matches(all, @"8.8.8.8")) ) {
+                NSLog(@"✅ PASS: 'all' items");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: 'all' items");
+            }
+        }
+
+        // Test 5: Compiled image round trip (via mmap)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 5: compiled image (save, map, query)");
+
+            NSString* path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"test_list_matcher.list"];
+            NSDictionary* source = @{NSFileSize:@1234, NSFileModificationDate:[NSDate dateWithTimeIntervalSince1970:1600000000]};
+
+            NSData* image = [ListMatcher compile:@"example.com\n*.doubleclick.net\n10.0.0.0/8\n" source:source];
+            [image writeToFile:path atomically:YES];
+
+            ListMatcher* mapped = [[ListMatcher alloc] initWithFile:path];
+
+            if( (nil != mapped) &&
+                (3 == mapped.count) &&
+                (YES == [mapped isCompiledFrom:source]) &&
+                (NO == [mapped isCompiledFrom:@{NSFileSize:@1235, NSFileModificationDate:source[NSFileModificationDate]}]) &&
+                (YES == matches(mapped, @"example.com")) &&
+                (YES == matches(mapped, @"x.doubleclick.net")) &&
+                (YES == matches(mapped, @"10.9.9.9")) ) {
+                NSLog(@"✅ PASS: compiled image mapped & queried");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: compiled image");
+            }
+
+            [NSFileManager.defaultManager removeItemAtPath:path error:nil];
+        }
+
+        // Test 6: Corrupt/unsupported images are rejected
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 6: corrupt/unsupported images");
+
+            NSData* image = [ListMatcher compile:@"example.com\n" source:nil];
+
+            NSMutableData* corrupt = [image mutableCopy];
+            ((uint8_t*)corrupt.mutableBytes)[corrupt.length-3] ^= 0xFF;
+
+            NSMutableData* versioned = [image mutableCopy];
+            ((uint32_t*)versioned.mutableBytes)[1] = LIST_IMAGE_VERSION + 1;
+
+            NSData* truncated = [image subdataWithRange:NSMakeRange(0, image.length/2)];
+
+            if( (nil != [[ListMatcher alloc] initWithImage:image]) &&
+                (nil == [[ListMatcher alloc] initWithImage:corrupt]) &&
+                (nil == [[ListMatcher alloc] initWithImage:versioned]) &&
+                (nil == [[ListMatcher alloc] initWithImage:truncated]) ) {
+                NSLog(@"✅ PASS: bad images rejected");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: bad image accepted");
+            }
+        }
+
+        // Benchmark: 1M item list
+        {
+            NSLog(@"\n⏱  Benchmark: 1M items");
+
+            NSMutableString* list = [NSMutableString string];
+            for(int i = 0; i < 1000000; i++) {
+                switch(i % 4) {
+                    case 0: [list appendFormat:@"host%d.example%d.com\n", i, i % 1000]; break;
+                    case 1: [list appendFormat:@"*.ads%d.net\n", i]; break;
+                    case 2: [list appendFormat:@"https://tracker%d.io/pixel\n", i]; break;
+                    default: [list appendFormat:@"%d.%d.%d.0/24\n", (i >> 16) & 0xFF, (i >> 8) & 0xFF, i & 0xFF]; break;
+                }
+            }
+
+            double before = residentMB();
+            NSDate* start = [NSDate date];
+            ListMatcher* big = [[ListMatcher alloc] init:list];
+            NSLog(@"   compile: %.2f s (%lu items, +%.1f MB resident)", [[NSDate date] timeIntervalSinceDate:start], (unsigned long)big.count, residentMB() - before);
+
+            NSString* path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"test_list_matcher_1m.list"];
+            [big.image writeToFile:path atomically:YES];
+
+            before = residentMB();
+            start = [NSDate date];
+            big = [[ListMatcher alloc] initWithFile:path];
+            NSLog(@"   map (& verify): %.2f s (%lu bytes, +%.1f MB resident)", [[NSDate date] timeIntervalSinceDate:start], (unsigned long)big.image.length, residentMB() - before);
+
+            NSMutableArray* names = [NSMutableArray array];
+            for(int i = 0; i < 1000; i++) {
+                [names addObject:[NSSet setWithObjects:[NSString stringWithFormat:@"www.cdn%d.ads%d.net", i, i * 4 + 1], [NSString stringWithFormat:@"10.%d.%d.1", i & 0xFF, i >> 8], nil]];
+            }
+
+            NSUInteger hits = 0;
+            start = [NSDate date];
+            for(int i = 0; i < 1000000; i++) {
+                hits += (nil != [big match:names[i % names.count]]);
+            }
+            NSTimeInterval elapsed = [[NSDate date] timeIntervalSinceDate:start];
+            NSLog(@"   1M lookups: %.2f s (%.0f lookups/s, %lu hits)", elapsed, 1000000 / elapsed, (unsigned long)hits);
+
+            [NSFileManager.defaultManager removeItemAtPath:path error:nil];
+        }
+
+        // Test Results Summary
+        NSLog(@"\n🏁 List Matcher Test Results");
+        NSLog(@"============================");
+        NSLog(@"Tests Passed: %d/%d", testsPassed, totalTests);
+
+        if (testsPassed == totalTests) {
+            NSLog(@"✅ ALL TESTS PASSED!");
+            return 0;
+        } else {
+            NSLog(@"❌ %d tests failed. Please check implementation.", totalTests - testsPassed);
+            return 1;
+        }
+    }
+}
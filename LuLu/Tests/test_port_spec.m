@@ -0,0 +1,218 @@
+//
+//  test_port_spec.m
+//  LuLu
+//
+//  Tests (and a small benchmark) for numeric port specs & protocol-aware rules
+//  builds against the real Rule.m (and utilities.m, for port spec parsing)
+//
+
+#import <Foundation/Foundation.h>
+#import <netinet/in.h>
+
+#import "Rule.h"
+#import "utilities.h"
+
+//log handle
+os_log_t logHandle = nil;
+
+//make a rule
+static Rule* makeRule(NSString* port, NSNumber* protocol)
+{
+    NSMutableDictionary* info = [@{KEY_PATH:@"/usr/bin/curl", KEY_KEY:@"/usr/bin/curl", KEY_PROCESS_NAME:@"curl", KEY_ENDPOINT_ADDR:VALUE_ANY, KEY_ENDPOINT_PORT:port, KEY_TYPE:@RULE_TYPE_USER, KEY_ACTION:@RULE_STATE_ALLOW} mutableCopy];
+    if(nil != protocol) info[KEY_PROTOCOL] = protocol;
+
+    return [[Rule alloc] init:info];
+}
+
+//parse a spec into a string of ranges
+// e.g. '80,8000-8100' -> '80-80,8000-8100'
+static NSString* ranges(NSString* spec)
+{
+    int count = 0;
+    uint16_t lo[PORT_SPEC_MAX_RANGES] = {0}, hi[PORT_SPEC_MAX_RANGES] = {0};
+    NSMutableArray* items = [NSMutableArray array];
+
+    if(YES != parsePortSpec(spec, lo, hi, PORT_SPEC_MAX_RANGES, &count)) return nil;
+
+    for(int i = 0; i < count; i++) [items addObject:[NSString stringWithFormat:@"%d-%d", lo[i], hi[i]]];
+
+    return [items componentsJoinedByString:@","];
+}
+
+int main(int argc, const char * argv[]) {
+    @autoreleasepool {
+
+        NSLog(@"🧪 Port Spec Test Suite");
+        NSLog(@"=======================");
+
+        logHandle = os_log_create("com.objective-see.lulu.tests", "PortSpec");
+
+        int testsPassed = 0;
+        int totalTests = 0;
+
+        // Test 1: Ports, ranges & lists parse (sorted & merged)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 1: valid specs");
+
+            if( (YES == [ranges(@"443") isEqualToString:@"443-443"]) &&
+                (YES == [ranges(@"8000-8100") isEqualToString:@"8000-8100"]) &&
+                (YES == [ranges(@" 8000 - 8100 ") isEqualToString:@"8000-8100"]) &&
+                (YES == [ranges(@"443, 80,8000-8100,8050-8200,81") isEqualToString:@"80-81,443-443,8000-8200"]) &&
+                (YES == [ranges(@"1-65535") isEqualToString:@"1-65535"]) ) {
+                NSLog(@"✅ PASS: specs parsed");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: specs: %@, %@", ranges(@"443, 80,8000-8100,8050-8200,81"), ranges(@"8000-8100"));
+            }
+        }
+
+        // Test 2: Invalid specs are rejected
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 2: invalid specs");
+
+            BOOL rejected = YES;
+            for(NSString* spec in @[@"", @"0", @"65536", @"abc", @"80-", @"-80", @"1-2-3", @"80,,443", @"8100-8000", @"443 tcp", @"*"])
+            {
+                if(YES == isPortSpec(spec))
+                {
+                    NSLog(@"   accepted: '%@'", spec);
+                    rejected = NO;
+                }
+            }
+
+            NSMutableArray* many = [NSMutableArray array];
+            for(int i = 0; i <= PORT_SPEC_MAX_RANGES; i++) [many addObject:[NSString stringWithFormat:@"%d", 1000 + i * 2]];
+
+            if( (YES == rejected) &&
+                (NO == isPortSpec([many componentsJoinedByString:@","])) ) {
+                NSLog(@"✅ PASS: invalid specs rejected");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: invalid spec accepted");
+            }
+        }
+
+        // Test 3: Rules match ports numerically
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 3: rule port matching");
+
+            Rule* any = makeRule(VALUE_ANY, nil);
+            Rule* single = makeRule(@"443", nil);
+            Rule* range = makeRule(@"8000-8100", nil);
+            Rule* list = makeRule(@"22,80,443,8000-8100", nil);
+
+            if( (YES == [any endpointPortMatches:12345]) &&
+                (YES == [single endpointPortMatches:443]) &&
+                (NO == [single endpointPortMatches:444]) &&
+                (YES == [range endpointPortMatches:8000]) &&
+                (YES == [range endpointPortMatches:8100]) &&
+                (NO == [range endpointPortMatches:8101]) &&
+                (YES == [list endpointPortMatches:22]) &&
+                (YES == [list endpointPortMatches:8050]) &&
+                (NO == [list endpointPortMatches:23]) &&
+                (NO == [list endpointPortMatches:0]) ) {
+                NSLog(@"✅ PASS: ports matched");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: port matching");
+            }
+        }
+
+        // Test 4: Protocol is matched (if set)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 4: protocol matching");
+
+            Rule* tcp = makeRule(@"443", @(IPPROTO_TCP));
+            Rule* any = makeRule(@"443", nil);
+
+            NSMutableDictionary* info = [@{KEY_PATH:@"/usr/bin/curl", KEY_KEY:@"/usr/bin/curl", KEY_PROCESS_NAME:@"curl", KEY_SCOPE:@ACTION_SCOPE_PROCESS, KEY_PROTOCOL:@(IPPROTO_TCP), KEY_ACTION:@RULE_STATE_ALLOW} mutableCopy];
+            Rule* process = [[Rule alloc] init:info];
+
+            if( (YES == [tcp protocolMatches:IPPROTO_TCP]) &&
+                (NO == [tcp protocolMatches:IPPROTO_UDP]) &&
+                (YES == [any protocolMatches:IPPROTO_UDP]) &&
+                (YES == [process protocolMatches:IPPROTO_UDP]) ) {
+                NSLog(@"✅ PASS: protocol matched (process rules cover all)");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: protocol matching");
+            }
+        }
+
+        // Test 5: Protocol & ranges survive archiving and JSON export/import
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 5: archive & JSON round trip");
+
+            Rule* rule = makeRule(@"80,8000-8100", @(IPPROTO_UDP));
+            rule.scope = @ACTION_SCOPE_ENDPOINT;
+
+            NSData* archived = [NSKeyedArchiver archivedDataWithRootObject:rule requiringSecureCoding:YES error:nil];
+            Rule* unarchived = [NSKeyedUnarchiver unarchivedObjectOfClass:[Rule class] fromData:archived error:nil];
+
+            NSString* json = [NSString stringWithFormat:@"{%@}", [rule toJSON]];
+            NSDictionary* info = [NSJSONSerialization JSONObjectWithData:[json dataUsingEncoding:NSUTF8StringEncoding] options:0 error:nil];
+            Rule* imported = [[Rule alloc] initFromJSON:info];
+
+            NSMutableDictionary* bad = [info mutableCopy];
+            bad[@"endpointPort"] = @"80-";
+
+            if( (IPPROTO_UDP == unarchived.protocol.intValue) &&
+                (YES == [imported.endpointPort isEqualToString:@"80,8000-8100"]) &&
+                (IPPROTO_UDP == imported.protocol.intValue) &&
+                (YES == [imported endpointPortMatches:8042]) &&
+                (nil == [[Rule alloc] initFromJSON:bad]) ) {
+                NSLog(@"✅ PASS: round trips");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: round trips (json: %@)", json);
+            }
+        }
+
+        // Benchmark: 101 single-port rules vs. one range rule
+        {
+            NSLog(@"\n⏱  Benchmark: ports 8000-8100, 1M lookups");
+
+            NSMutableArray* rules = [NSMutableArray array];
+            for(int port = 8000; port <= 8100; port++) [rules addObject:makeRule([NSString stringWithFormat:@"%d", port], @(IPPROTO_TCP))];
+            Rule* range = makeRule(@"8000-8100", @(IPPROTO_TCP));
+
+            NSUInteger hits = 0;
+            NSDate* start = [NSDate date];
+            for(int i = 0; i < 1000000; i++)
+            {
+                NSString* port = [NSString stringWithFormat:@"%d", 7950 + (i % 200)];
+                for(Rule* rule in rules)
+                {
+                    if(YES == [rule.endpointPort isEqualToString:port]) { hits++; break; }
+                }
+            }
+            NSLog(@"   101 rules (string compare): %.2f ms (%lu hits)", [[NSDate date] timeIntervalSinceDate:start] * 1000, (unsigned long)hits);
+
+            hits = 0;
+            start = [NSDate date];
+            for(int i = 0; i < 1000000; i++)
+            {
+                hits += ( (YES == [range protocolMatches:IPPROTO_TCP]) && (YES == [range endpointPortMatches:(uint16_t)(7950 + (i % 200))]) );
+            }
+            NSLog(@"   1 rule (numeric range): %.2f ms (%lu hits)", [[NSDate date] timeIntervalSinceDate:start] * 1000, (unsigned long)hits);
+        }
+
+        // Test Results Summary
+        NSLog(@"\n🏁 Port Spec Test Results");
+        NSLog(@"=========================");
+        NSLog(@"Tests Passed: %d/%d", testsPassed, totalTests);
+
+        if (testsPassed == totalTests) {
+            NSLog(@"✅ ALL TESTS PASSED!");
+            return 0;
+        } else {
+            NSLog(@"❌ %d tests failed. Please check implementation.", totalTests - testsPassed);
+            return 1;
+        }
+    }
+}
@@ -0,0 +1,216 @@
+//
+//  test_process_cache.m
+//  LuLu
+//
+//  Tests (and a pid-reuse stress test) for the LRU process cache
+//  builds against the real ProcessCache.m
+//
+
+#import <Foundation/Foundation.h>
+#import <spawn.h>
+#import <bsm/libbsm.h>
+#import <sys/wait.h>
+
+#import "ProcessCache.h"
+
+//log handle
+os_log_t logHandle = nil;
+
+//make an audit token
+// only pid & pid version are set
+static NSData* makeToken(pid_t pid, int pidversion)
+{
+    audit_token_t token = {0};
+    token.val[5] = (unsigned int)pid;
+    token.val[7] = (unsigned int)pidversion;
+    return [NSData dataWithBytes:&token length:sizeof(token)];
+}
+
+int main(int argc, const char * argv[]) {
+    @autoreleasepool {
+
+        NSLog(@"🧪 Process Cache Test Suite");
+        NSLog(@"===========================");
+
+        logHandle = os_log_create("com.objective-see.lulu.tests", "ProcessCache");
+
+        int testsPassed = 0;
+        int totalTests = 0;
+
+        //(live) pid for synthetic tokens
+        pid_t pid = getpid();
+
+        // Test 1: Miss, then hit
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 1: miss then hit");
+
+            ProcessCache* cache = [[ProcessCache alloc] init];
+
+            BOOL missed = (nil == [cache objectForToken:makeToken(pid, 1)]);
+            [cache setObject:@"process" forToken:makeToken(pid, 1) cost:100];
+
+            if( (YES == missed) &&
+                (YES == [[cache objectForToken:makeToken(pid, 1)] isEqualToString:@"process"]) &&
+                (1 == cache.hits) && (1 == cache.misses) && (100 == cache.totalCost) ) {
+                NSLog(@"✅ PASS: miss, add, hit");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: hits: %llu, misses: %llu", cache.hits, cache.misses);
+            }
+        }
+
+        // Test 2: Reused pid (new pid version) doesn't hit
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 2: pid reuse");
+
+            ProcessCache* cache = [[ProcessCache alloc] init];
+            [cache setObject:@"old" forToken:makeToken(pid, 1) cost:100];
+
+            if( (nil == [cache objectForToken:makeToken(pid, 2)]) &&
+                (nil == [cache objectForToken:[NSData dataWithBytes:"short" length:5]]) ) {
+                NSLog(@"✅ PASS: new pid version (& malformed token) missed");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: old process returned for new pid version");
+            }
+        }
+
+        // Test 3: LRU eviction (count)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 3: LRU eviction");
+
+            ProcessCache* cache = [[ProcessCache alloc] init];
+            cache.countLimit = 3;
+
+            [cache setObject:@"a" forToken:makeToken(pid, 1) cost:1];
+            [cache setObject:@"b" forToken:makeToken(pid, 2) cost:1];
+            [cache setObject:@"c" forToken:makeToken(pid, 3) cost:1];
+            [cache objectForToken:makeToken(pid, 1)];
+            [cache setObject:@"d" forToken:makeToken(pid, 4) cost:1];
+
+            if( (3 == cache.count) && (1 == cache.evictions) &&
+                (nil != [cache objectForToken:makeToken(pid, 1)]) &&
+                (nil == [cache objectForToken:makeToken(pid, 2)]) &&
+                (nil != [cache objectForToken:makeToken(pid, 3)]) &&
+                (nil != [cache objectForToken:makeToken(pid, 4)]) ) {
+                NSLog(@"✅ PASS: least recently used evicted");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: count: %lu, evictions: %llu", (unsigned long)cache.count, cache.evictions);
+            }
+        }
+
+        // Test 4: Memory budget
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 4: memory budget");
+
+            ProcessCache* cache = [[ProcessCache alloc] init];
+            cache.costLimit = 1000;
+
+            for(int i = 0; i < 10; i++) {
+                [cache setObject:@(i) forToken:makeToken(pid, i) cost:300];
+            }
+
+            if( (3 == cache.count) && (cache.totalCost <= 1000) &&
+                (nil != [cache objectForToken:makeToken(pid, 9)]) ) {
+                NSLog(@"✅ PASS: within budget (%lu bytes, %lu entries)", (unsigned long)cache.totalCost, (unsigned long)cache.count);
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: over budget (%lu bytes, %lu entries)", (unsigned long)cache.totalCost, (unsigned long)cache.count);
+            }
+        }
+
+        // Test 5: Eviction on process exit
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 5: exit eviction");
+
+            ProcessCache* cache = [[ProcessCache alloc] init];
+
+            pid_t child = 0;
+            char* arguments[] = {"/bin/sleep", "30", NULL};
+            posix_spawn(&child, "/bin/sleep", NULL, NULL, arguments, NULL);
+
+            [cache setObject:@"child" forToken:makeToken(child, 1) cost:1];
+            BOOL cached = (1 == cache.count);
+
+            kill(child, SIGKILL);
+            waitpid(child, NULL, 0);
+
+            for(int i = 0; (i < 200) && (0 != cache.count); i++) usleep(10000);
+
+            //already exited (& reaped) process
+            [cache setObject:@"gone" forToken:makeToken(child, 2) cost:1];
+
+            if( (YES == cached) && (0 == cache.count) && (2 == cache.exits) ) {
+                NSLog(@"✅ PASS: exited processes evicted");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: count: %lu, exits: %llu", (unsigned long)cache.count, cache.exits);
+            }
+        }
+
+        // Stress: pid reuse, w/ a small budget
+        {
+            totalTests++;
+            NSLog(@"\n⏱  Stress: 200k adds/lookups w/ reused pids");
+
+            ProcessCache* cache = [[ProcessCache alloc] init];
+            cache.countLimit = 256;
+            cache.costLimit = 64 * 1024;
+
+            pid_t pids[] = {getpid(), getppid()};
+            NSUInteger wrong = 0;
+            NSUInteger overLimit = 0;
+
+            NSDate* start = [NSDate date];
+            dispatch_apply(4, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t thread) {
+                for(int i = 0; i < 50000; i++) {
+                    //pid is 'reused' every 1000 versions
+                    int version = (int)(thread * 50000 + i);
+                    pid_t p = pids[version % 2];
+                    NSString* object = [NSString stringWithFormat:@"%d:%d", p, version];
+
+                    [cache setObject:object forToken:makeToken(p, version) cost:128 + (i % 512)];
+
+                    //lookup a recent (maybe evicted) version
+                    int recent = version - (i % 300);
+                    NSString* found = [cache objectForToken:makeToken(pids[recent % 2], recent)];
+                    if( (nil != found) && (YES != [found isEqualToString:[NSString stringWithFormat:@"%d:%d", pids[recent % 2], recent]]) ) {
+                        @synchronized(cache) { wrong++; }
+                    }
+                    if( (cache.count > cache.countLimit) || (cache.totalCost > cache.costLimit + 640) ) {
+                        @synchronized(cache) { overLimit++; }
+                    }
+                }
+            });
+            NSTimeInterval elapsed = [[NSDate date] timeIntervalSinceDate:start];
+
+            NSLog(@"   %.2f s (hits: %llu, misses: %llu, evictions: %llu, entries: %lu, cost: %lu)", elapsed, cache.hits, cache.misses, cache.evictions, (unsigned long)cache.count, (unsigned long)cache.totalCost);
+
+            if( (0 == wrong) && (0 == overLimit) ) {
+                NSLog(@"✅ PASS: no stale processes returned, limits held");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: %lu wrong processes, %lu limit violations", (unsigned long)wrong, (unsigned long)overLimit);
+            }
+        }
+
+        // Test Results Summary
+        NSLog(@"\n🏁 Process Cache Test Results");
+        NSLog(@"=============================");
+        NSLog(@"Tests Passed: %d/%d", testsPassed, totalTests);
+
+        if (testsPassed == totalTests) {
+            NSLog(@"✅ ALL TESTS PASSED!");
+            return 0;
+        } else {
+            NSLog(@"❌ %d tests failed. Please check implementation.", totalTests - testsPassed);
+            return 1;
+        }
+    }
+}
@@ -0,0 +1,170 @@
+//
+//  test_process_enrichment.m
+//  LuLu
+//
+//  Tests (and a microbenchmark) for two-phase process creation:
+//  fast identity (path, signing info, key) vs. lazy enrichment (binary, args, ancestors)
+//  builds against the real Process.m (w/ Binary.m, signing.m, & utilities.m), driven by a mock provider
+//
+
+#import <Foundation/Foundation.h>
+#import <spawn.h>
+#import <signal.h>
+#import <sys/wait.h>
+
+#import "Process.h"
+#import "utilities.h"
+#import "SigningCache.h"
+#import "FlowStats.h"
+#import "AncestryTable.h"
+
+//log handle
+os_log_t logHandle = nil;
+
+//signing cache
+// unused (nil), so processes are fully validated
+SigningCache* signingCache = nil;
+
+//ancestry table
+// unused (nil), so ancestors are enumerated via 'generateProcessHierarchy'
+AncestryTable* ancestryTable = nil;
+
+//flow stats
+// unused (nil), so (signing) timings aren't recorded
+FlowStats* flowStats = nil;
+
+//mock provider
+// stand-in for the extension's flow handling: creates a process per flow, then matches its key
+@interface MockProvider : NSObject
+
+//rules
+// key -> action
+@property(nonatomic, retain)NSDictionary* rules;
+
+//handle a flow
+// eager: enrich process up front, as was done before
+-(Process*)handleFlow:(NSData*)token eager:(BOOL)eager;
+
+@end
+
+@implementation MockProvider
+
+-(Process*)handleFlow:(NSData*)token eager:(BOOL)eager
+{
+    Process* process = [[Process alloc] init:(audit_token_t*)token.bytes];
+    if(YES == eager) [process enrich];
+
+    //'match' rule
+    (void)self.rules[process.key];
+
+    return process;
+}
+
+@end
+
+int main(int argc, const char * argv[]) {
+    @autoreleasepool {
+
+        NSLog(@"🧪 Process Enrichment Test Suite");
+        NSLog(@"================================");
+
+        logHandle = os_log_create("com.objective-see.lulu.tests", "ProcessEnrichment");
+
+        int testsPassed = 0;
+        int totalTests = 0;
+
+        //spawn children
+        // each is a 'flow' source
+        NSMutableArray* children = [NSMutableArray array];
+        NSMutableArray* tokens = [NSMutableArray array];
+        for(int i = 0; i < 20; i++) {
+            pid_t child = 0;
+            char* arguments[] = {"/bin/sleep", "30", NULL};
+            if(0 != posix_spawn(&child, "/bin/sleep", NULL, NULL, arguments, NULL)) continue;
+            [children addObject:@(child)];
+            [tokens addObject:tokenForPid(child)];
+        }
+
+        MockProvider* provider = [[MockProvider alloc] init];
+        provider.rules = @{@"com.apple.sleep":@0};
+
+        // Test 1: Identity is available w/o enrichment
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 1: identity phase");
+
+            Process* process = [provider handleFlow:tokens.firstObject eager:NO];
+
+            if( (nil != process) &&
+                (YES == [process.path isEqualToString:@"/bin/sleep"]) &&
+                (0 != process.key.length) &&
+                (nil != process.csInfo) ) {
+                NSLog(@"✅ PASS: path, key (%@), and signing info set", process.key);
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: identity: %@", process);
+            }
+        }
+
+        // Test 2: Enrichment on (first) access
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 2: lazy enrichment");
+
+            Process* process = [provider handleFlow:tokens.firstObject eager:NO];
+
+            BOOL argumentsOK = [process.arguments isEqualToArray:@[@"/bin/sleep", @"30"]];
+            BOOL ancestorsOK = NO;
+            for(NSDictionary* ancestor in process.ancestors) {
+                if(getpid() == [ancestor[KEY_PROCESS_ID] intValue]) ancestorsOK = YES;
+            }
+
+            if( (YES == argumentsOK) && (YES == ancestorsOK) &&
+                (YES == [process.binary.path isEqualToString:@"/bin/sleep"]) ) {
+                NSLog(@"✅ PASS: args, ancestors, and binary generated on access");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: args: %@, ancestors: %@", process.arguments, process.ancestors);
+            }
+        }
+
+        // Benchmark: identity only vs. eager
+        {
+            NSLog(@"\n⏱  Benchmark: %lu processes x 10", (unsigned long)tokens.count);
+
+            NSDate* start = [NSDate date];
+            for(int i = 0; i < 10; i++) {
+                for(NSData* token in tokens) [provider handleFlow:token eager:YES];
+            }
+            NSTimeInterval eager = [[NSDate date] timeIntervalSinceDate:start];
+
+            start = [NSDate date];
+            for(int i = 0; i < 10; i++) {
+                for(NSData* token in tokens) [provider handleFlow:token eager:NO];
+            }
+            NSTimeInterval lazy = [[NSDate date] timeIntervalSinceDate:start];
+
+            NSLog(@"   eager (identity + enrichment): %.2f ms/process", eager * 1000 / (10 * tokens.count));
+            NSLog(@"   identity only:                 %.2f ms/process", lazy * 1000 / (10 * tokens.count));
+        }
+
+        //cleanup
+        for(NSNumber* child in children) {
+            kill(child.intValue, SIGKILL);
+            waitpid(child.intValue, NULL, 0);
+        }
+
+        // Test Results Summary
+        NSLog(@"\n🏁 Process Enrichment Test Results");
+        NSLog(@"==================================");
+        NSLog(@"Tests Passed: %d/%d", testsPassed, totalTests);
+
+        if (testsPassed == totalTests) {
+            NSLog(@"✅ ALL TESTS PASSED!");
+            return 0;
+        } else {
+            NSLog(@"❌ %d tests failed. Please check implementation.", totalTests - testsPassed);
+            return 1;
+        }
+    }
+}
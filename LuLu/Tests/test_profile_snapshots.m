@@ -0,0 +1,414 @@
+//
+//  test_profile_snapshots.m
+//  LuLu
+//
+//  Tests (and a benchmark) for compiled profiles: rules compiled (w/o the lock) ahead of time, then activated via a swap
+//  builds against the real ProfileSnapshot, and Rules (& its index/matchers/journal)
+//
+
+#import <Foundation/Foundation.h>
+
+#import "Rule.h"
+#import "Rules.h"
+#import "consts.h"
+#import "RuleIndex.h"
+#import "RuleJournal.h"
+#import "ExitMonitor.h"
+#import "ProfileSnapshot.h"
+
+@class Alerts;
+@class Preferences;
+@class VerdictCache;
+
+//log handle
+os_log_t logHandle = nil;
+
+//alerts, prefs, verdict cache, & exit monitor
+// unused (nil): there's no client, and (except for one test) rules here aren't temporary
+Alerts* alerts = nil;
+Preferences* preferences = nil;
+VerdictCache* verdictCache = nil;
+ExitMonitor* exitMonitor = nil;
+
+// Stand-in XPC user client
+// created by 'Rules', but never messaged (as there's no client)
+@implementation XPCUserClient
+@end
+
+// Stand-in Binary
+// only referenced by default rule generation
+@implementation Binary
+@end
+
+// Stand-in Process
+// only referenced by rule lookups
+@implementation Process
+@end
+
+// Rules, for tests
+// never saved, but saves are counted
+@interface TestRules : Rules
+@property(nonatomic)NSUInteger saves;
+@end
+
+@implementation TestRules
+
+-(BOOL)save
+{
+    self.saves++;
+    return YES;
+}
+
+@end
+
+// Rules' (private) classes, for journal replay
+@interface Rules (Tests)
+-(NSSet*)archivedClasses;
+@end
+
+//rule for a path
+// w/ an (optional) expiration
+static Rule* pathRule(NSString* path, NSDate* expiration)
+{
+    NSMutableDictionary* info = [@{KEY_PATH:path, KEY_KEY:path, KEY_ACTION:@RULE_STATE_ALLOW, KEY_TYPE:@RULE_TYPE_USER, KEY_ENDPOINT_ADDR:VALUE_ANY, KEY_ENDPOINT_PORT:VALUE_ANY} mutableCopy];
+    if(nil != expiration) {
+        info[KEY_DURATION] = @(RuleDurationCustom);
+        info[KEY_DURATION_EXPIRATION] = expiration;
+    }
+    return [[Rule alloc] init:info];
+}
+
+//write a profile
+// rules file (as the daemon saves it), & prefs
+static NSString* writeProfile(NSString* directory, NSUInteger count, NSArray<Rule*>* extra)
+{
+    NSMutableDictionary* items = [NSMutableDictionary dictionary];
+    NSMutableArray* list = [NSMutableArray arrayWithArray:extra];
+    for(NSUInteger i = 0; i < count; i++) [list addObject:pathRule([NSString stringWithFormat:@"%@/app%lu", directory, (unsigned long)i], nil)];
+    for(Rule* rule in list) {
+        if(nil == items[rule.key]) items[rule.key] = [@{KEY_RULES:[NSMutableArray array]} mutableCopy];
+        [items[rule.key][KEY_RULES] addObject:rule];
+    }
+
+    [NSFileManager.defaultManager createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:nil];
+    [[NSKeyedArchiver archivedDataWithRootObject:items requiringSecureCoding:YES error:nil] writeToFile:[directory stringByAppendingPathComponent:RULES_FILE] atomically:YES];
+    [@{PREF_ALLOW_LOCALHOST:@YES} writeToFile:[directory stringByAppendingPathComponent:PREFS_FILE] atomically:YES];
+
+    return [directory stringByAppendingPathComponent:RULES_FILE];
+}
+
+//journal a rule
+// as if it was added after the rules were saved
+static void journalRule(Rules* rules, NSString* rulesFile, Rule* rule)
+{
+    RuleJournal* journal = [[RuleJournal alloc] init:[rulesFile stringByAppendingString:RULES_JOURNAL_SUFFIX]];
+    [journal replay:[rules archivedClasses]];
+    [journal append:@{KEY_JOURNAL_OP:JOURNAL_OP_ADD, KEY_JOURNAL_RULE:rule}];
+}
+
+int main(int argc, const char * argv[]) {
+    @autoreleasepool {
+
+        NSLog(@"🧪 Profile Snapshots Test Suite");
+        NSLog(@"==============================");
+
+        logHandle = os_log_create("com.objective-see.lulu.tests", "ProfileSnapshots");
+
+        int testsPassed = 0;
+        int totalTests = 0;
+
+        NSString* root = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"lulu.profiles.%d", getpid()]];
+
+        // Test 1: Compile
+        // rules file + journal, w/o touching active rules
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 1: compile (rules + journal), active rules untouched");
+
+            TestRules* rules = [[TestRules alloc] init];
+            [rules add:pathRule(@"/bin/active", nil) save:NO];
+            NSMutableDictionary* active = rules.rules;
+            RuleIndex* activeIndex = rules.compiledRules;
+
+            NSString* rulesFile = writeProfile([root stringByAppendingPathComponent:@"1"], 100, nil);
+            journalRule(rules, rulesFile, pathRule(@"/bin/journaled", nil));
+
+            ProfileSnapshot* snapshot = [rules compile:rulesFile];
+
+            if( (nil != snapshot) &&
+                (101 == snapshot.rules.count) &&
+                (nil != snapshot.rules[@"/bin/journaled"]) &&
+                (nil != snapshot.rules[@"/bin/journaled"][KEY_PATHS]) &&
+                (nil != snapshot.compiledRules) &&
+                (active == rules.rules) &&
+                (activeIndex == rules.compiledRules) &&
+                (nil != rules.rules[@"/bin/active"]) ) {
+                NSLog(@"✅ PASS: compiled %lu rules (incl. journaled) in %.2f ms", (unsigned long)snapshot.rules.count, snapshot.compileTime * 1000);
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: snapshot: %@, items: %lu, active: %d", snapshot, (unsigned long)snapshot.rules.count, (active == rules.rules));
+            }
+        }
+
+        // Test 2: Activate
+        // rules, index, & journal all swapped in
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 2: activate swaps in rules, index, & journal");
+
+            TestRules* rules = [[TestRules alloc] init];
+            [rules add:pathRule(@"/bin/active", nil) save:NO];
+
+            NSString* rulesFile = writeProfile([root stringByAppendingPathComponent:@"2"], 100, nil);
+            ProfileSnapshot* snapshot = [rules compile:rulesFile];
+            [rules activate:snapshot];
+
+            //changes now go to (new) journal
+            [rules add:pathRule(@"/bin/added", nil) save:YES];
+            ProfileSnapshot* recompiled = [rules compile:rulesFile];
+
+            if( (snapshot.rules == rules.rules) &&
+                (nil == rules.rules[@"/bin/active"]) &&
+                (snapshot.journal == rules.journal) &&
+                (nil != recompiled.rules[@"/bin/added"]) &&
+                (0 == rules.saves) ) {
+                NSLog(@"✅ PASS: swapped in %lu rules, later changes journaled to profile", (unsigned long)rules.rules.count);
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: rules swapped: %d, journal swapped: %d, added (after): %d", (snapshot.rules == rules.rules), (snapshot.journal == rules.journal), (nil != recompiled.rules[@"/bin/added"]));
+            }
+        }
+
+        // Test 3: Expirations
+        // rules that expired (since compiled) are deleted on activation, in one batch
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 3: expired rules deleted on activation");
+
+            TestRules* rules = [[TestRules alloc] init];
+
+            NSArray* extra = @[pathRule(@"/bin/expired1", [NSDate dateWithTimeIntervalSinceNow:-60]),
+                               pathRule(@"/bin/expired2", [NSDate dateWithTimeIntervalSinceNow:-1]),
+                               pathRule(@"/bin/later", [NSDate dateWithTimeIntervalSinceNow:3600])];
+            NSString* rulesFile = writeProfile([root stringByAppendingPathComponent:@"3"], 10, extra);
+
+            ProfileSnapshot* snapshot = [rules compile:rulesFile];
+            NSUInteger compiled = snapshot.rules.count;
+            [rules activate:snapshot];
+
+            if( (13 == compiled) &&
+                (11 == rules.rules.count) &&
+                (nil == rules.rules[@"/bin/expired1"]) &&
+                (nil == rules.rules[@"/bin/expired2"]) &&
+                (nil != rules.rules[@"/bin/later"]) &&
+                (1 == rules.saves) ) {
+                NSLog(@"✅ PASS: 2 expired rules deleted (one save), unexpired kept");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: compiled: %lu, active: %lu, saves: %lu", (unsigned long)compiled, (unsigned long)rules.rules.count, (unsigned long)rules.saves);
+            }
+        }
+
+        // Test 4: Staleness
+        // snapshot detects changes to its files (missing & empty journal are the same)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 4: stale snapshots detected");
+
+            TestRules* rules = [[TestRules alloc] init];
+            NSString* rulesFile = writeProfile([root stringByAppendingPathComponent:@"4"], 10, nil);
+
+            ProfileSnapshot* snapshot = [rules compile:rulesFile];
+            BOOL fresh = [snapshot isCurrent];
+
+            journalRule(rules, rulesFile, pathRule(@"/bin/journaled", nil));
+            BOOL journaled = [snapshot isCurrent];
+
+            [snapshot restamp];
+            BOOL restamped = [snapshot isCurrent];
+
+            [@{PREF_ALLOW_LOCALHOST:@NO, PREF_PASSIVE_MODE:@YES} writeToFile:[[rulesFile stringByDeletingLastPathComponent] stringByAppendingPathComponent:PREFS_FILE] atomically:YES];
+            BOOL prefsChanged = [snapshot isCurrent];
+
+            if( (YES == fresh) &&
+                (NO == journaled) &&
+                (YES == restamped) &&
+                (NO == prefsChanged) ) {
+                NSLog(@"✅ PASS: fresh after compile, stale after journal/prefs changes");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: fresh: %d, journaled: %d, restamped: %d, prefs changed: %d", fresh, journaled, restamped, prefsChanged);
+            }
+        }
+
+        // Test 5: Failed compile
+        // no snapshot, active rules untouched
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 5: failed compile leaves rules untouched");
+
+            TestRules* rules = [[TestRules alloc] init];
+            [rules add:pathRule(@"/bin/active", nil) save:NO];
+            NSMutableDictionary* active = rules.rules;
+
+            NSString* corrupt = [root stringByAppendingPathComponent:@"5/" RULES_FILE];
+            [NSFileManager.defaultManager createDirectoryAtPath:[corrupt stringByDeletingLastPathComponent] withIntermediateDirectories:YES attributes:nil error:nil];
+            [[@"not an archive" dataUsingEncoding:NSUTF8StringEncoding] writeToFile:corrupt atomically:YES];
+
+            ProfileSnapshot* missing = [rules compile:[root stringByAppendingPathComponent:@"none/" RULES_FILE]];
+            ProfileSnapshot* invalid = [rules compile:corrupt];
+
+            if( (nil == missing) &&
+                (nil == invalid) &&
+                (active == rules.rules) &&
+                (nil != rules.rules[@"/bin/active"]) ) {
+                NSLog(@"✅ PASS: missing & corrupt rules files fail to compile");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: missing: %@, invalid: %@", missing, invalid);
+            }
+        }
+
+        // Test 6: Concurrent readers
+        // (lock-free) lookups always see a complete index, while profiles are switched
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 6: readers never see a partial index during switches");
+
+            TestRules* rules = [[TestRules alloc] init];
+            NSString* fileA = writeProfile([root stringByAppendingPathComponent:@"6a"], 1000, nil);
+            NSString* fileB = writeProfile([root stringByAppendingPathComponent:@"6b"], 2000, nil);
+
+            //compile (all) ahead of time
+            NSMutableArray* snapshots = [NSMutableArray array];
+            for(int i = 0; i < 50; i++) [snapshots addObject:[rules compile:(0 == i % 2) ? fileA : fileB]];
+
+            NSMutableArray* indices = [NSMutableArray arrayWithObject:rules.compiledRules];
+            for(ProfileSnapshot* snapshot in snapshots) [indices addObject:snapshot.compiledRules];
+
+            __block volatile BOOL done = NO;
+            __block NSUInteger reads = 0;
+            __block NSUInteger bad = 0;
+            dispatch_group_t group = dispatch_group_create();
+            dispatch_group_async(group, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+                while(YES != done) {
+                    RuleIndex* index = rules.compiledRules;
+                    if( (nil == index) ||
+                        (NSNotFound == [indices indexOfObjectIdenticalTo:index]) ) bad++;
+                    reads++;
+                }
+            });
+
+            for(ProfileSnapshot* snapshot in snapshots) [rules activate:snapshot];
+            done = YES;
+            dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+
+            if( (0 == bad) &&
+                (0 != reads) &&
+                (rules.compiledRules == ((ProfileSnapshot*)snapshots.lastObject).compiledRules) ) {
+                NSLog(@"✅ PASS: %lu reads across 50 switches, all saw a complete index", (unsigned long)reads);
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: %lu bad of %lu reads", (unsigned long)bad, (unsigned long)reads);
+            }
+        }
+
+        // Test 7: Process rules
+        // previous rules' process (exit) watches are stopped on activation
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 7: process rules (& their exit watches) dropped on activation");
+
+            exitMonitor = [[ExitMonitor alloc] init];
+
+            TestRules* rules = [[TestRules alloc] init];
+            NSDictionary* info = @{KEY_PATH:@"/bin/process", KEY_KEY:@"/bin/process", KEY_ACTION:@RULE_STATE_ALLOW, KEY_TYPE:@RULE_TYPE_USER, KEY_ENDPOINT_ADDR:VALUE_ANY, KEY_ENDPOINT_PORT:VALUE_ANY, KEY_DURATION:@(RuleDurationProcess), KEY_PROCESS_ID:@(getpid())};
+            [rules add:[[Rule alloc] init:info] save:NO];
+            NSUInteger before = exitMonitor.watchCount;
+
+            NSString* rulesFile = writeProfile([root stringByAppendingPathComponent:@"7"], 10, nil);
+            [rules activate:[rules compile:rulesFile]];
+            NSUInteger after = exitMonitor.watchCount;
+
+            //(new) process rule, for same process, is watched (again)
+            [rules add:[[Rule alloc] init:info] save:NO];
+            NSUInteger rewatched = exitMonitor.watchCount;
+
+            if( (1 == before) &&
+                (0 == after) &&
+                (1 == rewatched) ) {
+                NSLog(@"✅ PASS: watch stopped on activation, (new) process rule re-watched");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: watches: %lu -> %lu -> %lu", (unsigned long)before, (unsigned long)after, (unsigned long)rewatched);
+            }
+
+            exitMonitor = nil;
+        }
+
+        // Test 8: Saves
+        // written to the active rules' file (i.e. its journal's), not the current profile pref's
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 8: saves write the active rules' file, and reset its journal");
+
+            Rules* rules = [[Rules alloc] init];
+            NSString* rulesFile = writeProfile([root stringByAppendingPathComponent:@"8"], 10, nil);
+            journalRule(rules, rulesFile, pathRule(@"/bin/journaled", nil));
+            [rules activate:[rules compile:rulesFile]];
+            [rules add:pathRule(@"/bin/added", nil) save:NO];
+
+            BOOL saved = [rules save];
+            ProfileSnapshot* reloaded = [rules compile:rulesFile];
+
+            if( (YES == saved) &&
+                (12 == reloaded.rules.count) &&
+                (nil != reloaded.rules[@"/bin/added"]) &&
+                (0 == rules.journal.count) ) {
+                NSLog(@"✅ PASS: saved into the active rules' file, journal reset");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: saved: %d, reloaded rules: %lu, journal records: %lu", saved, (unsigned long)reloaded.rules.count, (unsigned long)rules.journal.count);
+            }
+        }
+
+        // Benchmark: switching profiles (100k rules)
+        // (old) load under the lock vs. activating a (pre) compiled snapshot
+        {
+            NSLog(@"\n⏱  Benchmark: profile switch (100k rules)");
+
+            TestRules* rules = [[TestRules alloc] init];
+            NSString* rulesFile = writeProfile([root stringByAppendingPathComponent:@"bench"], 100000, nil);
+
+            //(old) switch: load (i.e. compile) & activate, while switching
+            NSDate* start = [NSDate date];
+            [rules activate:[rules compile:rulesFile]];
+            NSTimeInterval load = [[NSDate date] timeIntervalSinceDate:start];
+
+            //(new) switch: compiled ahead of time (in the background)
+            ProfileSnapshot* snapshot = [rules compile:rulesFile];
+            start = [NSDate date];
+            [rules activate:snapshot];
+            NSTimeInterval activate = [[NSDate date] timeIntervalSinceDate:start];
+
+            NSLog(@"   compile (background): %.2f ms", snapshot.compileTime * 1000);
+            NSLog(@"   load on switch:       %.2f ms", load * 1000);
+            NSLog(@"   activate on switch:   %.3f ms (%.0fx faster)", activate * 1000, load / activate);
+        }
+
+        [NSFileManager.defaultManager removeItemAtPath:root error:nil];
+
+        // Test Results Summary
+        NSLog(@"\n🏁 Profile Snapshots Test Results");
+        NSLog(@"================================");
+        NSLog(@"Tests Passed: %d/%d", testsPassed, totalTests);
+
+        if (testsPassed == totalTests) {
+            NSLog(@"✅ ALL TESTS PASSED!");
+            return 0;
+        } else {
+            NSLog(@"❌ %d tests failed. Please check implementation.", totalTests - testsPassed);
+            return 1;
+        }
+    }
+}
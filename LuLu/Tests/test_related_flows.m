@@ -0,0 +1,287 @@
+//
+//  test_related_flows.m
+//  LuLu
+//
+//  Tests (and a resume latency benchmark) for the (per process) queues of related flows
+//  builds against the real RelatedFlows.m
+//
+
+#import <Foundation/Foundation.h>
+
+#import "RelatedFlows.h"
+
+//log handle
+os_log_t logHandle = nil;
+
+//stand-in flow
+// just an endpoint (NEFilterSocketFlows can't be created directly)
+@interface TestFlow : NSObject
+@property(nonatomic, retain)NSString* endpoint;
+@end
+
+@implementation TestFlow
+@end
+
+//create flows
+// spread (round robin) across a number of endpoints
+static NSArray<TestFlow*>* makeFlows(NSUInteger count, NSUInteger endpoints)
+{
+    NSMutableArray* flows = [NSMutableArray array];
+    for(NSUInteger i = 0; i < count; i++) {
+        TestFlow* flow = [[TestFlow alloc] init];
+        flow.endpoint = [NSString stringWithFormat:@"host%lu.example.com:443", (unsigned long)(i % endpoints)];
+        [flows addObject:flow];
+    }
+    return flows;
+}
+
+//busy work
+// stand-in for a (full) flow evaluation: liveness, verdict cache, lists, rules
+static uint64_t evaluate(TestFlow* flow)
+{
+    uint64_t seed = flow.endpoint.hash;
+    for(int i = 0; i < 5000; i++) seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return seed;
+}
+
+int main(int argc, const char * argv[]) {
+    @autoreleasepool {
+
+        NSLog(@"🧪 Related Flows Test Suite");
+        NSLog(@"===========================");
+
+        logHandle = os_log_create("com.objective-see.lulu.tests", "RelatedFlows");
+
+        int testsPassed = 0;
+        int totalTests = 0;
+
+        // Test 1: Flows are held (and taken) in order, once
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 1: hold & take");
+
+            RelatedFlows* related = [[RelatedFlows alloc] init:10];
+            NSArray* flows = makeFlows(5, 5);
+            for(TestFlow* flow in flows) [related add:flow key:@"com.apple.Safari"];
+            [related add:flows[0] key:@"com.apple.Safari"];
+            [related add:flows[0] key:@"com.google.Chrome"];
+
+            BOOL held = ( (2 == related.count) && (6 == related.flowCount) &&
+                          (5 == [related countForKey:@"com.apple.Safari"]) &&
+                          (flows[0] == [related first:@"com.apple.Safari"]) );
+
+            NSArray* taken = [related take:@"com.apple.Safari"];
+
+            if( (YES == held) &&
+                ([taken isEqualToArray:flows]) &&
+                (1 == related.count) &&
+                (0 == [related take:@"com.apple.Safari"].count) &&
+                (NO == [related add:flows[0] key:nil]) ) {
+                NSLog(@"✅ PASS: held in order, duplicates ignored, key removed on take");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: taken: %@", taken);
+            }
+        }
+
+        // Test 2: Per key limit
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 2: limit (backpressure)");
+
+            RelatedFlows* related = [[RelatedFlows alloc] init:3];
+            NSArray* flows = makeFlows(5, 5);
+
+            int added = 0;
+            for(TestFlow* flow in flows) added += [related add:flow key:@"noisy"] ? 1 : 0;
+
+            //other keys aren't affected
+            BOOL other = [related add:flows[4] key:@"quiet"];
+
+            //alert's flow is always held
+            TestFlow* alerted = makeFlows(1, 1).firstObject;
+            [related addAlerted:alerted key:@"noisy"];
+
+            //limit can be raised
+            related.limit = 10;
+            BOOL raised = [related add:flows[4] key:@"noisy"];
+
+            if( (3 == added) &&
+                (2 == related.overflows) &&
+                (YES == other) &&
+                (YES == raised) &&
+                (5 == [related countForKey:@"noisy"]) &&
+                ([[related take:@"noisy"] containsObject:alerted]) &&
+                (RELATED_FLOWS_LIMIT == [[RelatedFlows alloc] init:0].limit) ) {
+                NSLog(@"✅ PASS: held up to limit, overflows counted, alerted flow always held");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: added: %d, overflows: %llu", added, related.overflows);
+            }
+        }
+
+        // Test 3: Grouped take
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 3: grouped take");
+
+            RelatedFlows* related = [[RelatedFlows alloc] init:100];
+            NSArray* flows = makeFlows(10, 3);
+            for(TestFlow* flow in flows) [related add:flow key:@"key"];
+
+            //unidentifiable flow
+            TestFlow* unknown = [[TestFlow alloc] init];
+            [related add:unknown key:@"key"];
+
+            NSArray<NSArray*>* groups = [related take:@"key" groupedBy:^id<NSCopying>(TestFlow* flow) {
+                return flow.endpoint;
+            }];
+
+            //3 endpoints (ordered by oldest flow), plus one for the unidentifiable flow
+            if( (4 == groups.count) &&
+                ([groups[0] isEqualToArray:(@[flows[0], flows[3], flows[6], flows[9]])]) &&
+                ([groups[1] isEqualToArray:(@[flows[1], flows[4], flows[7]])]) &&
+                ([groups[2] isEqualToArray:(@[flows[2], flows[5], flows[8]])]) &&
+                ([groups[3] isEqualToArray:@[unknown]]) &&
+                (0 == related.count) ) {
+                NSLog(@"✅ PASS: grouped by endpoint, in order");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: groups: %@", groups);
+            }
+        }
+
+        // Test 4: Remove
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 4: remove");
+
+            RelatedFlows* related = [[RelatedFlows alloc] init:10];
+            NSArray* flows = makeFlows(2, 2);
+            [related add:flows[0] key:@"key"];
+            [related add:flows[1] key:@"key"];
+
+            [related remove:flows[0] key:@"key"];
+            BOOL one = (flows[1] == [related first:@"key"]) && (1 == related.count);
+
+            [related remove:flows[1] key:@"key"];
+            [related remove:flows[1] key:@"missing"];
+
+            if( (YES == one) &&
+                (0 == related.count) &&
+                (0 == related.keys.count) ) {
+                NSLog(@"✅ PASS: key dropped once empty");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: keys: %@", related.keys);
+            }
+        }
+
+        // Test 5: Concurrent adds (limit holds)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 5: concurrent adds");
+
+            RelatedFlows* related = [[RelatedFlows alloc] init:500];
+            dispatch_apply(8, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t thread) {
+                for(TestFlow* flow in makeFlows(1000, 1000)) {
+                    [related add:flow key:[NSString stringWithFormat:@"key%zu", thread % 4]];
+                }
+            });
+
+            BOOL ok = (4 == related.count);
+            for(NSString* key in related.keys) ok = ok && (500 == [related countForKey:key]);
+
+            if( (YES == ok) &&
+                (2000 == related.flowCount) &&
+                (6000 == related.overflows) ) {
+                NSLog(@"✅ PASS: 8 threads, 4 keys, each capped at 500");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: flows: %lu, overflows: %llu", (unsigned long)related.flowCount, related.overflows);
+            }
+        }
+
+        // Test 6: Take matching (e.g. an exited process' flows), across keys
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 6: take matching");
+
+            RelatedFlows* related = [[RelatedFlows alloc] init:10];
+            NSArray* flows = makeFlows(6, 2);
+            for(NSUInteger i = 0; i < flows.count; i++) [related add:flows[i] key:(i < 2) ? @"a" : @"b"];
+
+            //'exited' flows: endpoint 0
+            NSDictionary* taken = [related takeMatching:^BOOL(TestFlow* flow) {
+                return [flow.endpoint hasPrefix:@"host0."];
+            }];
+
+            if( ([taken[@"a"] isEqualToArray:@[flows[0]]]) &&
+                ([taken[@"b"] isEqualToArray:(@[flows[2], flows[4]])]) &&
+                (1 == [related countForKey:@"a"]) &&
+                (2 == [related countForKey:@"b"]) &&
+                (0 == [related takeMatching:^BOOL(TestFlow* flow) { return NO; }].count) ) {
+                NSLog(@"✅ PASS: matching flows taken, in order, from each key");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: taken: %@", taken);
+            }
+        }
+
+        // Benchmark: resume latency for N held flows
+        // before: dequeue & evaluate one flow at a time; after: take all, evaluate one flow per endpoint, resume all
+        {
+            NSLog(@"\n⏱  Benchmark: resume latency (flows spread across 8 endpoints)");
+
+            for(NSNumber* count in @[@10, @100, @500, @1000]) {
+
+                NSArray* flows = makeFlows(count.unsignedIntegerValue, 8);
+                __block uint64_t sink = 0;
+
+                //before
+                RelatedFlows* related = [[RelatedFlows alloc] init:count.unsignedIntegerValue];
+                for(TestFlow* flow in flows) [related add:flow key:@"key"];
+
+                NSMutableArray* resumed = [NSMutableArray array];
+                NSDate* start = [NSDate date];
+                while(YES) {
+                    TestFlow* flow = [related first:@"key"];
+                    if(nil == flow) break;
+                    [related remove:flow key:@"key"];
+                    sink += evaluate(flow) & 1;
+                    [resumed addObject:flow];
+                }
+                NSTimeInterval before = [[NSDate date] timeIntervalSinceDate:start];
+
+                //after
+                for(TestFlow* flow in flows) [related add:flow key:@"key"];
+
+                [resumed removeAllObjects];
+                start = [NSDate date];
+                NSArray<NSArray*>* groups = [related take:@"key" groupedBy:^id<NSCopying>(TestFlow* flow) {
+                    return flow.endpoint;
+                }];
+                for(NSArray* group in groups) {
+                    sink += evaluate(group.firstObject) & 1;
+                    [resumed addObjectsFromArray:group];
+                }
+                NSTimeInterval after = [[NSDate date] timeIntervalSinceDate:start];
+
+                NSLog(@"   %4lu flows: %8.3f ms one at a time vs. %7.3f ms batched (%.1fx) (resumed: %lu, sink: %llu)", (unsigned long)count.unsignedIntegerValue, before * 1000, after * 1000, before / after, (unsigned long)resumed.count, sink & 1);
+            }
+        }
+
+        // Test Results Summary
+        NSLog(@"\n🏁 Related Flows Test Results");
+        NSLog(@"============================");
+        NSLog(@"Tests Passed: %d/%d", testsPassed, totalTests);
+
+        if (testsPassed == totalTests) {
+            NSLog(@"✅ ALL TESTS PASSED!");
+            return 0;
+        } else {
+            NSLog(@"❌ %d tests failed. Please check implementation.", totalTests - testsPassed);
+            return 1;
+        }
+    }
+}
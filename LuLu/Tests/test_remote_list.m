@@ -0,0 +1,321 @@
+//
+//  test_remote_list.m
+//  LuLu
+//
+//  Tests for (remote) block/allow list fetching: conditional requests, and keeping the last good list on failure
+//  builds against the real BlockOrAllowList.m, with a tiny local HTTP server standing in for the list's host
+//  (plus local lists, reloaded by their file watcher)
+//
+
+#import <Foundation/Foundation.h>
+#import <netinet/in.h>
+#import <sys/socket.h>
+
+#import "VerdictCache.h"
+#import "BlockOrAllowList.h"
+
+//log handle
+os_log_t logHandle = nil;
+
+//verdict cache
+// unused (nil), lists just invalidate it
+VerdictCache* verdictCache = nil;
+
+//server modes
+typedef enum { ServerOK, ServerError, ServerSlow, ServerTruncated } ServerMode;
+
+//current mode
+static volatile ServerMode serverMode = ServerOK;
+
+//number of '304 Not Modified' responses
+static volatile int notModified = 0;
+
+//list served
+static NSString* const servedList = @"# test list\nevil.com\n*.ads.net\n";
+
+//handle a single request
+static void handleRequest(int client)
+{
+    char buffer[4096] = {0};
+    ssize_t length = 0;
+    NSString* request = nil;
+    NSString* response = nil;
+
+    //read (just) the request headers
+    while(length < (ssize_t)sizeof(buffer)-1) {
+        ssize_t bytes = recv(client, buffer+length, sizeof(buffer)-1-length, 0);
+        if(bytes <= 0) break;
+        length += bytes;
+        if(NULL != strstr(buffer, "\r\n\r\n")) break;
+    }
+    request = [[NSString alloc] initWithUTF8String:buffer].lowercaseString;
+
+    switch(serverMode) {
+
+        //ok (or not modified)
+        case ServerOK:
+            if(YES == [request containsString:@"if-none-match: \"v1\""]) {
+                notModified++;
+                response = @"HTTP/1.1 304 Not Modified\r\nETag: \"v1\"\r\nConnection: close\r\n\r\n";
+            } else {
+                response = [NSString stringWithFormat:@"HTTP/1.1 200 OK\r\nETag: \"v1\"\r\nContent-Length: %lu\r\nConnection: close\r\n\r\n%@", (unsigned long)[servedList lengthOfBytesUsingEncoding:NSUTF8StringEncoding], servedList];
+            }
+            break;
+
+        //server error
+        case ServerError:
+            response = @"HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            break;
+
+        //slow (past client's timeout)
+        case ServerSlow:
+            sleep(3);
+            response = @"HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            break;
+
+        //truncated body
+        case ServerTruncated:
+            response = @"HTTP/1.1 200 OK\r\nContent-Length: 1000\r\nConnection: close\r\n\r\ngood.com\n";
+            break;
+    }
+
+    send(client, response.UTF8String, strlen(response.UTF8String), 0);
+    close(client);
+}
+
+//start server (on loopback, any port)
+// returns port, or 0 on error
+static in_port_t startServer(void)
+{
+    struct sockaddr_in address = {0};
+    socklen_t addressLength = sizeof(address);
+
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    if(server < 0) return 0;
+
+    address.sin_len = sizeof(address);
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if( (0 != bind(server, (struct sockaddr*)&address, sizeof(address))) ||
+        (0 != listen(server, 8)) ||
+        (0 != getsockname(server, (struct sockaddr*)&address, &addressLength)) ) {
+        close(server);
+        return 0;
+    }
+
+    //accept (forever), each request on its own queue
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        while(YES) {
+            int client = accept(server, NULL, NULL);
+            if(client < 0) continue;
+            dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+                handleRequest(client);
+            });
+        }
+    });
+
+    return ntohs(address.sin_port);
+}
+
+//fetch, and wait
+static BOOL fetch(BlockOrAllowList* list)
+{
+    __block BOOL result = NO;
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+
+    [list fetch:^(BOOL fetched) {
+        result = fetched;
+        dispatch_semaphore_signal(semaphore);
+    }];
+    dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+
+    return result;
+}
+
+//check a single name
+static BOOL matches(BlockOrAllowList* list, NSString* name)
+{
+    return (nil != [list.items match:[NSSet setWithObject:name]]);
+}
+
+//wait (up to ~2s) for a name to (not) match
+static BOOL waitForMatch(BlockOrAllowList* list, NSString* name, BOOL match)
+{
+    for(int i = 0; i < 200; i++) {
+        if(match == matches(list, name)) return YES;
+        usleep(10000);
+    }
+    return (match == matches(list, name));
+}
+
+int main(int argc, const char * argv[]) {
+    @autoreleasepool {
+
+        NSLog(@"🧪 Remote List Test Suite");
+        NSLog(@"=========================");
+
+        logHandle = os_log_create("com.objective-see.lulu.tests", "RemoteList");
+
+        int testsPassed = 0;
+        int totalTests = 0;
+
+        in_port_t port = startServer();
+        if(0 == port) {
+            NSLog(@"❌ FAIL: couldn't start local server");
+            return 1;
+        }
+
+        NSString* url = [NSString stringWithFormat:@"http://127.0.0.1:%d/list", port];
+
+        BlockOrAllowList* list = [[BlockOrAllowList alloc] init:nil];
+        list.timeout = 1;
+
+        // Test 1: Initial load (200 + ETag)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 1: initial load");
+
+            BOOL loaded = [list load:url];
+
+            if( (YES == loaded) &&
+                (2 == list.items.count) &&
+                (YES == matches(list, @"evil.com")) &&
+                (YES == matches(list, @"x.ads.net")) &&
+                (YES == [list.validators[KEY_LIST_ETAG] isEqualToString:@"\"v1\""]) ) {
+                NSLog(@"✅ PASS: list fetched & compiled");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: list not loaded (items: %lu, validators: %@)", (unsigned long)list.items.count, list.validators);
+            }
+        }
+
+        // Test 2: Unchanged list isn't re-downloaded (If-None-Match -> 304)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 2: conditional refetch");
+
+            ListMatcher* before = list.items;
+
+            if( (YES == fetch(list)) &&
+                (1 == notModified) &&
+                (before == list.items) ) {
+                NSLog(@"✅ PASS: 304, current list kept");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: conditional refetch (304s: %d)", notModified);
+            }
+        }
+
+        // Test 3: Failures keep the last good list
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 3: server error, timeout, truncated body");
+
+            ListMatcher* before = list.items;
+            BOOL fetched = NO;
+
+            serverMode = ServerError;
+            fetched |= fetch(list);
+
+            serverMode = ServerSlow;
+            NSDate* start = [NSDate date];
+            fetched |= fetch(list);
+            NSTimeInterval elapsed = [[NSDate date] timeIntervalSinceDate:start];
+
+            serverMode = ServerTruncated;
+            fetched |= fetch(list);
+
+            if( (NO == fetched) &&
+                (elapsed < 2.5) &&
+                (before == list.items) &&
+                (YES == matches(list, @"evil.com")) &&
+                (NO == matches(list, @"good.com")) ) {
+                NSLog(@"✅ PASS: last good list kept (timed out after %.2f s)", elapsed);
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: last good list lost (fetched: %d, timeout after %.2f s)", fetched, elapsed);
+            }
+        }
+
+        // Test 4: Lookups aren't blocked by a (slow) fetch
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 4: lookups during fetch");
+
+            serverMode = ServerSlow;
+            dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+            [list fetch:^(BOOL fetched) {
+                dispatch_semaphore_signal(semaphore);
+            }];
+
+            NSDate* start = [NSDate date];
+            NSUInteger hits = 0;
+            for(int i = 0; i < 10000; i++) {
+                hits += matches(list, @"evil.com");
+            }
+            NSTimeInterval elapsed = [[NSDate date] timeIntervalSinceDate:start];
+            dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+
+            if( (10000 == hits) && (elapsed < 0.5) ) {
+                NSLog(@"✅ PASS: 10k lookups in %.2f ms while fetching", elapsed * 1000);
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: lookups during fetch (hits: %lu, %.2f s)", (unsigned long)hits, elapsed);
+            }
+        }
+
+        [list clear];
+
+        // Test 5: Local list changes are (re)loaded by its file watcher
+        // i.e. in the background, not checked for on (each) lookup
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 5: local list reloaded on change");
+
+            NSString* file = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"lulu.list.%d", getpid()]];
+            [@"first.com\n" writeToFile:file atomically:NO encoding:NSUTF8StringEncoding error:nil];
+
+            BlockOrAllowList* local = [[BlockOrAllowList alloc] init:file];
+            BOOL loaded = matches(local, @"first.com");
+
+            //modified in place
+            [@"second.com\n" writeToFile:file atomically:NO encoding:NSUTF8StringEncoding error:nil];
+            BOOL modified = ( (YES == waitForMatch(local, @"second.com", YES)) && (NO == matches(local, @"first.com")) );
+
+            //replaced (as editors save)
+            [@"third.com\n" writeToFile:file atomically:YES encoding:NSUTF8StringEncoding error:nil];
+            BOOL replaced = waitForMatch(local, @"third.com", YES);
+
+            //replaced again (watcher re-armed on new file)
+            [@"fourth.com\n" writeToFile:file atomically:YES encoding:NSUTF8StringEncoding error:nil];
+            BOOL rearmed = waitForMatch(local, @"fourth.com", YES);
+
+            [local clear];
+            [NSFileManager.defaultManager removeItemAtPath:file error:nil];
+
+            if( (YES == loaded) &&
+                (YES == modified) &&
+                (YES == replaced) &&
+                (YES == rearmed) ) {
+                NSLog(@"✅ PASS: modified & replaced list reloaded (w/o a lookup)");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: loaded: %d, modified: %d, replaced: %d, re-armed: %d", loaded, modified, replaced, rearmed);
+            }
+        }
+
+        // Test Results Summary
+        NSLog(@"\n🏁 Remote List Test Results");
+        NSLog(@"===========================");
+        NSLog(@"Tests Passed: %d/%d", testsPassed, totalTests);
+
+        if (testsPassed == totalTests) {
+            NSLog(@"✅ ALL TESTS PASSED!");
+            return 0;
+        } else {
+            NSLog(@"❌ %d tests failed. Please check implementation.", totalTests - testsPassed);
+            return 1;
+        }
+    }
+}
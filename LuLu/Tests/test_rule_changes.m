@@ -0,0 +1,270 @@
+//
+//  test_rule_changes.m
+//  LuLu
+//
+//  Tests for the rule change log (delta syncs), and bytes sent per change (full vs. delta)
+//  builds against the real RuleChanges.m, and Rules (& its index/matchers), for (app) round trips of its changes
+//
+
+#import <Foundation/Foundation.h>
+
+#import "Rule.h"
+#import "Rules.h"
+#import "consts.h"
+#import "RuleChanges.h"
+
+@class Alerts;
+@class Preferences;
+@class ExitMonitor;
+@class VerdictCache;
+
+//log handle
+os_log_t logHandle = nil;
+
+//alerts, prefs, verdict cache, & exit monitor
+// unused (nil): there's no client, and rules here aren't temporary
+Alerts* alerts = nil;
+Preferences* preferences = nil;
+VerdictCache* verdictCache = nil;
+ExitMonitor* exitMonitor = nil;
+
+// Stand-in XPC user client
+// created by 'Rules', but never messaged (as there's no client)
+@implementation XPCUserClient
+@end
+
+// Stand-in Binary
+// only referenced by default rule generation
+@implementation Binary
+@end
+
+// Stand-in Process
+// only referenced by rule lookups
+@implementation Process
+@end
+
+// Rules, for tests
+// never saved
+@interface TestRules : Rules
+@end
+
+@implementation TestRules
+
+-(BOOL)save
+{
+    return YES;
+}
+
+@end
+
+//rule for a path
+static Rule* pathRule(NSString* path)
+{
+    return [[Rule alloc] init:@{KEY_PATH:path, KEY_KEY:path, KEY_ACTION:@RULE_STATE_ALLOW, KEY_TYPE:@RULE_TYPE_USER, KEY_ENDPOINT_ADDR:VALUE_ANY, KEY_ENDPOINT_PORT:VALUE_ANY}];
+}
+
+//round trip (rules') changes
+// archived as the daemon does, unarchived w/ the app's (exact) allowed classes
+static NSDictionary* roundTrip(Rules* rules, unsigned long long since)
+{
+    NSData* archived = [NSKeyedArchiver archivedDataWithRootObject:[rules changesSince:since] requiringSecureCoding:YES error:nil];
+    return [NSKeyedUnarchiver unarchivedObjectOfClasses:[Rule archiveClasses] fromData:archived error:nil];
+}
+
+//build delta (as rules does)
+static NSDictionary* delta(RuleChanges* changes, NSDictionary* rules, unsigned long long since)
+{
+    NSSet* keys = [changes keysSince:since];
+    if(nil == keys) return @{KEY_RULES_GENERATION:@(changes.generation), KEY_RULES_FULL:@YES, KEY_RULES_ITEMS:rules, KEY_RULES_REMOVED:@[]};
+
+    NSMutableDictionary* items = [NSMutableDictionary dictionary];
+    NSMutableArray* removed = [NSMutableArray array];
+    for(NSString* key in keys) {
+        if(nil != rules[key]) items[key] = rules[key];
+        else [removed addObject:key];
+    }
+
+    return @{KEY_RULES_GENERATION:@(changes.generation), KEY_RULES_FULL:@NO, KEY_RULES_ITEMS:items, KEY_RULES_REMOVED:removed};
+}
+
+//make a (rule-like) item
+static NSDictionary* makeItem(int i)
+{
+    NSDictionary* rule = @{@"name":[NSString stringWithFormat:@"Tool %d", i], @"path":[NSString stringWithFormat:@"/usr/local/bin/tool%d", i], @"uuid":[[NSUUID UUID] UUIDString], @"endpointAddr":@"*", @"endpointPort":@"443", @"action":@1};
+    return @{KEY_RULES:@[rule], KEY_PATHS:@[rule[@"path"]]};
+}
+
+//archived size
+static NSUInteger archivedSize(id object)
+{
+    return [NSKeyedArchiver archivedDataWithRootObject:object requiringSecureCoding:YES error:nil].length;
+}
+
+int main(int argc, const char * argv[]) {
+    @autoreleasepool {
+
+        NSLog(@"🧪 Rule Changes Test Suite");
+        NSLog(@"==========================");
+
+        logHandle = os_log_create("com.objective-see.lulu.tests", "RuleChanges");
+
+        int testsPassed = 0;
+        int totalTests = 0;
+
+        // Test 1: Changed keys since a generation
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 1: keys since a generation");
+
+            RuleChanges* changes = [[RuleChanges alloc] init];
+            unsigned long long start = changes.generation;
+
+            [changes changed:@"a"];
+            unsigned long long afterA = [changes changed:@"b"];
+            [changes changed:@"c"];
+            [changes changed:@"a"];
+
+            if( ([[changes keysSince:start] isEqualToSet:[NSSet setWithArray:@[@"a", @"b", @"c"]]]) &&
+                ([[changes keysSince:afterA] isEqualToSet:[NSSet setWithArray:@[@"a", @"c"]]]) &&
+                (0 == [changes keysSince:changes.generation].count) &&
+                (nil != [changes keysSince:changes.generation]) ) {
+                NSLog(@"✅ PASS: only newer changes returned");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: unexpected keys");
+            }
+        }
+
+        // Test 2: Unknown generations need a full sync
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 2: unknown generations");
+
+            RuleChanges* changes = [[RuleChanges alloc] init];
+            unsigned long long start = changes.generation;
+
+            [changes changed:@"a"];
+            unsigned long long beforeReset = changes.generation;
+            [changes changed:nil];
+
+            if( (nil == [changes keysSince:0]) &&
+                (nil == [changes keysSince:start]) &&
+                (nil == [changes keysSince:beforeReset]) &&
+                (nil == [changes keysSince:changes.generation + 1]) &&
+                (nil != [changes keysSince:changes.generation]) ) {
+                NSLog(@"✅ PASS: old, reset, and future generations need a full sync");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: unknown generation accepted");
+            }
+        }
+
+        // Test 3: Bounded
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 3: bounded change log");
+
+            RuleChanges* changes = [[RuleChanges alloc] init];
+            unsigned long long start = changes.generation;
+
+            for(int i = 0; i < RULE_CHANGES_LIMIT + 10; i++) [changes changed:[NSString stringWithFormat:@"key%d", i]];
+
+            if( (nil == [changes keysSince:start]) &&
+                ([changes keysSince:changes.generation - 5].count == 5) ) {
+                NSLog(@"✅ PASS: log reset once full");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: unbounded change log");
+            }
+        }
+
+        // Test 4: Delta (changed & removed)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 4: delta w/ changed & removed items");
+
+            RuleChanges* changes = [[RuleChanges alloc] init];
+            NSMutableDictionary* rules = [NSMutableDictionary dictionary];
+            for(int i = 0; i < 10; i++) rules[[NSString stringWithFormat:@"key%d", i]] = makeItem(i);
+            [changes changed:nil];
+
+            unsigned long long synced = changes.generation;
+            rules[@"key1"] = makeItem(100); [changes changed:@"key1"];
+            [rules removeObjectForKey:@"key2"]; [changes changed:@"key2"];
+
+            NSDictionary* changed = delta(changes, rules, synced);
+
+            if( (NO == [changed[KEY_RULES_FULL] boolValue]) &&
+                ([[changed[KEY_RULES_ITEMS] allKeys] isEqualToArray:@[@"key1"]]) &&
+                ([changed[KEY_RULES_REMOVED] isEqualToArray:@[@"key2"]]) &&
+                (changes.generation == [changed[KEY_RULES_GENERATION] unsignedLongLongValue]) ) {
+                NSLog(@"✅ PASS: delta has changed & removed items");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: delta: %@", changed);
+            }
+        }
+
+        // Test 5: App can unarchive (real) changes
+        // both full syncs and deltas (w/ changed & removed items)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 5: app unarchives full & delta changes");
+
+            TestRules* rules = [[TestRules alloc] init];
+            for(int i = 0; i < 10; i++) [rules add:pathRule([NSString stringWithFormat:@"/bin/tool%d", i]) save:NO];
+
+            NSDictionary* full = roundTrip(rules, rules.changes.generation + 1);
+
+            unsigned long long synced = rules.changes.generation;
+            [rules add:pathRule(@"/bin/new") save:NO];
+            [rules delete:@"/bin/tool1" rule:nil];
+            NSDictionary* changed = roundTrip(rules, synced);
+
+            if( (nil != full) &&
+                (YES == [full[KEY_RULES_FULL] boolValue]) &&
+                (10 == [full[KEY_RULES_ITEMS] count]) &&
+                (0 == [full[KEY_RULES_REMOVED] count]) &&
+                (nil != changed) &&
+                (NO == [changed[KEY_RULES_FULL] boolValue]) &&
+                ([[changed[KEY_RULES_ITEMS] allKeys] isEqualToArray:@[@"/bin/new"]]) &&
+                ([changed[KEY_RULES_REMOVED] isEqualToArray:@[@"/bin/tool1"]]) &&
+                (rules.changes.generation == [changed[KEY_RULES_GENERATION] unsignedLongLongValue]) ) {
+                NSLog(@"✅ PASS: full (%lu items) & delta unarchived", (unsigned long)[full[KEY_RULES_ITEMS] count]);
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: full: %@, delta: %@", full, changed);
+            }
+        }
+
+        // Measurement: bytes per change
+        {
+            NSLog(@"\n⏱  Measurement: bytes sent per change (2k items)");
+
+            RuleChanges* changes = [[RuleChanges alloc] init];
+            NSMutableDictionary* rules = [NSMutableDictionary dictionary];
+            for(int i = 0; i < 2000; i++) rules[[NSString stringWithFormat:@"key%d", i]] = makeItem(i);
+            [changes changed:nil];
+
+            unsigned long long synced = changes.generation;
+            rules[@"key42"] = makeItem(4200);
+            [changes changed:@"key42"];
+
+            NSLog(@"   full (getRules): %lu bytes", (unsigned long)archivedSize(rules));
+            NSLog(@"   delta (getRulesSince:): %lu bytes", (unsigned long)archivedSize(delta(changes, rules, synced)));
+        }
+
+        // Test Results Summary
+        NSLog(@"\n🏁 Rule Changes Test Results");
+        NSLog(@"============================");
+        NSLog(@"Tests Passed: %d/%d", testsPassed, totalTests);
+
+        if (testsPassed == totalTests) {
+            NSLog(@"✅ ALL TESTS PASSED!");
+            return 0;
+        } else {
+            NSLog(@"❌ %d tests failed. Please check implementation.", totalTests - testsPassed);
+            return 1;
+        }
+    }
+}
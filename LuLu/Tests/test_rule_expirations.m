@@ -0,0 +1,360 @@
+//
+//  test_rule_expirations.m
+//  LuLu
+//
+//  Tests (and a benchmark) for rule expirations: one (min) heap & timer, vs. a dispatch block per rule
+//  builds against the real RuleExpirations, and Rules (& its index/matchers)
+//  time is virtual: 'expire:' is passed 'now', so no test waits for a rule to expire
+//
+
+#import <Foundation/Foundation.h>
+
+#import "Rule.h"
+#import "Rules.h"
+#import "consts.h"
+#import "RuleIndex.h"
+#import "RuleExpirations.h"
+#import "FlowMatchContext.h"
+
+#import <netinet/in.h>
+#import <sys/socket.h>
+
+@class Alerts;
+@class Preferences;
+@class ExitMonitor;
+@class VerdictCache;
+
+//log handle
+os_log_t logHandle = nil;
+
+//alerts, prefs, verdict cache, & exit monitor
+// unused (nil): there's no client, and rules here aren't temporary
+Alerts* alerts = nil;
+Preferences* preferences = nil;
+VerdictCache* verdictCache = nil;
+ExitMonitor* exitMonitor = nil;
+
+// Stand-in XPC user client
+// created by 'Rules', but never messaged (as there's no client)
+@implementation XPCUserClient
+@end
+
+// Stand-in Binary
+// only referenced by default rule generation
+@implementation Binary
+@end
+
+// Stand-in Process
+// only what rule lookups touch
+@implementation Process
+
+@synthesize pid, key, path;
+
+@end
+
+// Rules, for tests
+// never saved, but saves are counted
+@interface TestRules : Rules
+@property(nonatomic)NSUInteger saves;
+@end
+
+@implementation TestRules
+
+-(BOOL)save
+{
+    self.saves++;
+    return YES;
+}
+
+@end
+
+//rule that never expires
+static Rule* permanentRule(NSString* key)
+{
+    return [[Rule alloc] init:@{KEY_PATH:key, KEY_KEY:key, KEY_ACTION:@RULE_STATE_ALLOW, KEY_TYPE:@RULE_TYPE_USER, KEY_ENDPOINT_ADDR:VALUE_ANY, KEY_ENDPOINT_PORT:VALUE_ANY}];
+}
+
+//rule that expires at a (virtual) time
+static Rule* expiringRule(NSString* key, NSDate* expiration)
+{
+    return [[Rule alloc] init:@{KEY_PATH:key, KEY_KEY:key, KEY_ACTION:@RULE_STATE_ALLOW, KEY_TYPE:@RULE_TYPE_USER, KEY_ENDPOINT_ADDR:VALUE_ANY, KEY_ENDPOINT_PORT:VALUE_ANY, KEY_DURATION:@(RuleDurationCustom), KEY_DURATION_EXPIRATION:expiration}];
+}
+
+//number of rules
+static NSUInteger ruleCount(Rules* rules)
+{
+    NSUInteger count = 0;
+    for(NSString* key in rules.rules) count += [rules.rules[key][KEY_RULES] count];
+    return count;
+}
+
+int main(int argc, const char * argv[]) {
+    @autoreleasepool {
+
+        NSLog(@"🧪 Rule Expirations Test Suite");
+        NSLog(@"==============================");
+
+        logHandle = os_log_create("com.objective-see.lulu.tests", "RuleExpirations");
+
+        int testsPassed = 0;
+        int totalTests = 0;
+
+        //virtual 'now'
+        NSDate* now = [NSDate dateWithTimeIntervalSinceReferenceDate:1000000];
+
+        // Test 1: Heap order
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 1: rules come out in expiration order");
+
+            RuleExpirations* expirations = [[RuleExpirations alloc] init];
+            NSMutableArray* offsets = [NSMutableArray array];
+
+            srandom(42);
+            for(int i = 0; i < 1000; i++) {
+                NSTimeInterval offset = (random() % 100000) * 10;
+                [offsets addObject:@(offset)];
+                [expirations add:expiringRule([NSString stringWithFormat:@"/bin/%d", i], [now dateByAddingTimeInterval:offset])];
+            }
+            [expirations add:permanentRule(@"/bin/never")];
+
+            NSDate* first = expirations.next;
+            NSArray* due = [expirations due:[NSDate distantFuture]];
+
+            BOOL ordered = YES;
+            for(NSUInteger i = 1; i < due.count; i++) {
+                if(NSOrderedDescending == [((Rule*)due[i-1]).expiration compare:((Rule*)due[i]).expiration]) ordered = NO;
+            }
+
+            NSNumber* min = [offsets valueForKeyPath:@"@min.self"];
+            if( (YES == ordered) &&
+                (1000 == due.count) &&
+                (0 == expirations.count) &&
+                (nil == expirations.next) &&
+                ([first isEqualToDate:[now dateByAddingTimeInterval:min.doubleValue]]) ) {
+                NSLog(@"✅ PASS: 1000 rules, in order (rule w/o expiration ignored)");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: ordered: %d, due: %lu, left: %lu", ordered, (unsigned long)due.count, (unsigned long)expirations.count);
+            }
+        }
+
+        // Test 2: Due (w/ batching window)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 2: due rules (and those within the batching window)");
+
+            RuleExpirations* expirations = [[RuleExpirations alloc] init];
+            [expirations add:expiringRule(@"/bin/a", [now dateByAddingTimeInterval:-5])];
+            [expirations add:expiringRule(@"/bin/b", now)];
+            [expirations add:expiringRule(@"/bin/c", [now dateByAddingTimeInterval:RULE_EXPIRATION_WINDOW / 2])];
+            [expirations add:expiringRule(@"/bin/d", [now dateByAddingTimeInterval:RULE_EXPIRATION_WINDOW * 2])];
+
+            NSArray* due = [expirations due:now];
+            NSArray* keys = [due valueForKey:@"key"];
+
+            if( ([keys isEqualToArray:@[@"/bin/a", @"/bin/b", @"/bin/c"]]) &&
+                (1 == expirations.count) &&
+                ([expirations.next isEqualToDate:[now dateByAddingTimeInterval:RULE_EXPIRATION_WINDOW * 2]]) &&
+                (0 == [expirations due:now].count) ) {
+                NSLog(@"✅ PASS: past, now, & within window due; later one isn't");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: due: %@", keys);
+            }
+        }
+
+        // Test 3: Virtual clock
+        // 1000 rules expiring over an hour, in bursts; clock advances to each (next) expiration, as the timer would
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 3: virtual clock (fires per batch, not per rule)");
+
+            RuleExpirations* expirations = [[RuleExpirations alloc] init];
+
+            //10 bursts, of 100 rules each, within ~0.5s
+            for(int burst = 0; burst < 10; burst++) {
+                for(int i = 0; i < 100; i++) {
+                    NSDate* expiration = [now dateByAddingTimeInterval:(burst * 360) + (i * 0.005)];
+                    [expirations add:expiringRule([NSString stringWithFormat:@"/bin/%d.%d", burst, i], expiration)];
+                }
+            }
+
+            NSUInteger fires = 0;
+            NSUInteger expired = 0;
+            BOOL early = NO;
+            NSDate* clock = now;
+            while(nil != expirations.next) {
+                //advance to (next) expiration
+                clock = [clock laterDate:expirations.next];
+                fires++;
+                for(Rule* rule in [expirations due:clock]) {
+                    //never earlier than window
+                    if([rule.expiration timeIntervalSinceDate:clock] > RULE_EXPIRATION_WINDOW) early = YES;
+                    expired++;
+                }
+            }
+
+            if( (10 == fires) &&
+                (1000 == expired) &&
+                (NO == early) ) {
+                NSLog(@"✅ PASS: 1000 rules expired in %lu fires", (unsigned long)fires);
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: fires: %lu, expired: %lu, early: %d", (unsigned long)fires, (unsigned long)expired, early);
+            }
+        }
+
+        // Test 4: Rules expire in one batch (one save)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 4: rules expire in one transaction");
+
+            TestRules* rules = [[TestRules alloc] init];
+            Rule* kept = expiringRule(@"/bin/kept", [now dateByAddingTimeInterval:3600]);
+
+            for(int i = 0; i < 100; i++) {
+                [rules add:expiringRule([NSString stringWithFormat:@"/bin/%d", i % 10], [now dateByAddingTimeInterval:i * 0.001]) save:NO];
+            }
+            [rules add:kept save:NO];
+            [rules add:permanentRule(@"/bin/never") save:NO];
+
+            NSUInteger before = ruleCount(rules);
+            NSTimeInterval expiresBefore = rules.compiledRules.expires;
+
+            NSUInteger nothing = [rules expire:[now dateByAddingTimeInterval:-60]];
+            NSUInteger expired = [rules expire:now];
+
+            if( (102 == before) &&
+                (0 == nothing) &&
+                (100 == expired) &&
+                (2 == ruleCount(rules)) &&
+                (1 == rules.saves) &&
+                (expiresBefore == now.timeIntervalSinceReferenceDate) &&
+                (rules.compiledRules.expires == kept.expiration.timeIntervalSinceReferenceDate) &&
+                (nil != rules.rules[@"/bin/kept"]) ) {
+                NSLog(@"✅ PASS: 100 rules deleted w/ one save, index's next expiration updated");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: before: %lu, expired: %lu, after: %lu, saves: %lu", (unsigned long)before, (unsigned long)expired, (unsigned long)ruleCount(rules), (unsigned long)rules.saves);
+            }
+        }
+
+        // Test 5: Rules (already) deleted before they expire
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 5: deleted rules are skipped");
+
+            TestRules* rules = [[TestRules alloc] init];
+            Rule* deleted = expiringRule(@"/bin/deleted", now);
+            [rules add:deleted save:NO];
+
+            //delete (by user)
+            // not via 'delete:' as that persists
+            @synchronized(rules) {
+                [rules.rules removeObjectForKey:deleted.key];
+            }
+            [rules reindex];
+
+            NSUInteger expired = [rules expire:now];
+
+            if( (0 == expired) &&
+                (0 == rules.saves) &&
+                (DBL_MAX == rules.compiledRules.expires) ) {
+                NSLog(@"✅ PASS: nothing (re)deleted, nothing saved");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: expired: %lu, saves: %lu", (unsigned long)expired, (unsigned long)rules.saves);
+            }
+        }
+
+        // Test 6: Lookups skip expired rules
+        // and hand the expiry (& its save) to the timer's queue, rather than doing it on the flow thread
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 6: lookups skip expired rules, expiry is async");
+
+            TestRules* rules = [[TestRules alloc] init];
+            Rule* lapsed = expiringRule(@"/bin/lapsed", [NSDate dateWithTimeIntervalSinceNow:-1]);
+            [rules add:lapsed save:NO];
+
+            Process* process = [[Process alloc] init];
+            process.pid = getpid();
+            process.key = lapsed.key;
+            process.path = lapsed.path;
+            FlowMatchContext* context = [[FlowMatchContext alloc] initWithURL:nil hostname:@"10.1.2.3" remoteHostname:nil port:@"443" family:AF_INET protocol:IPPROTO_TCP];
+
+            Rule* match = [rules find:process context:context];
+            NSUInteger saves = rules.saves;
+            BOOL present = (nil != rules.rules[lapsed.key]);
+
+            //let (main queue) expiry run
+            [NSRunLoop.mainRunLoop runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.25]];
+
+            if( (nil == match) &&
+                (0 == saves) &&
+                (YES == present) &&
+                (1 == rules.saves) &&
+                (nil == rules.rules[lapsed.key]) ) {
+                NSLog(@"✅ PASS: expired rule skipped, then deleted (& saved) off the lookup");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: match: %@, saves (lookup): %lu, present: %d, saves: %lu", match, (unsigned long)saves, present, (unsigned long)rules.saves);
+            }
+        }
+
+        // Benchmark: (min) heap vs. a dispatch block per rule
+        {
+            NSLog(@"\n⏱  Benchmark: scheduling expirations");
+
+            for(NSNumber* count in @[@100, @1000, @10000]) {
+                NSMutableArray* pending = [NSMutableArray array];
+                for(int i = 0; i < count.intValue; i++) {
+                    [pending addObject:expiringRule([NSString stringWithFormat:@"/bin/%d", i], [now dateByAddingTimeInterval:(i * 7919) % 86400])];
+                }
+
+                //dispatch block per rule
+                // (as before), on a (suspended) queue so none run
+                dispatch_queue_t queue = dispatch_queue_create("com.objective-see.lulu.tests.expirations", DISPATCH_QUEUE_SERIAL);
+                dispatch_suspend(queue);
+                NSDate* start = [NSDate date];
+                for(Rule* rule in pending) {
+                    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)([rule.expiration timeIntervalSinceDate:now] * NSEC_PER_SEC)), queue, ^{
+                        (void)rule;
+                    });
+                }
+                NSTimeInterval blocks = [[NSDate date] timeIntervalSinceDate:start];
+
+                //heap
+                RuleExpirations* expirations = [[RuleExpirations alloc] init];
+                start = [NSDate date];
+                for(Rule* rule in pending) [expirations add:rule];
+                NSTimeInterval heap = [[NSDate date] timeIntervalSinceDate:start];
+
+                //drain
+                start = [NSDate date];
+                NSUInteger fires = 0;
+                while(nil != expirations.next) {
+                    [expirations due:expirations.next];
+                    fires++;
+                }
+                NSTimeInterval drain = [[NSDate date] timeIntervalSinceDate:start];
+
+                NSLog(@"   %5d rules: dispatch_after %.2f ms (%d pending blocks) vs. heap %.2f ms (1 timer), drained in %lu fires: %.2f ms", count.intValue, blocks * 1000, count.intValue, heap * 1000, (unsigned long)fires, drain * 1000);
+            }
+        }
+
+        // Test Results Summary
+        NSLog(@"\n🏁 Rule Expirations Test Results");
+        NSLog(@"===============================");
+        NSLog(@"Tests Passed: %d/%d", testsPassed, totalTests);
+
+        if (testsPassed == totalTests) {
+            NSLog(@"✅ ALL TESTS PASSED!");
+            return 0;
+        } else {
+            NSLog(@"❌ %d tests failed. Please check implementation.", totalTests - testsPassed);
+            return 1;
+        }
+    }
+}
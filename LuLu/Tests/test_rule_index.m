@@ -0,0 +1,324 @@
+//
+//  test_rule_index.m
+//  LuLu
+//
+//  Tests (and a small benchmark) for the compiled rule index
+//  builds against the real RuleIndex.m, with a minimal Rule stand-in
+//
+
+#import <Foundation/Foundation.h>
+#import <sys/socket.h>
+
+#import "Rule.h"
+#import "RuleIndex.h"
+#import "utilities.h"
+
+//log handle
+os_log_t logHandle = nil;
+
+// Minimal Rule implementation
+// only what the index touches, so no signing deps are needed
+@implementation Rule
+
+@synthesize key, uuid, pid, path, name, type, scope, action, csInfo, protocol, isGlobal, creation, expiration, isDisabled, endpointAddr, endpointHost, endpointPort, endpointRegex, isEndpointAddrRegex;
+
+-(NSNumber*)isDirectory
+{
+    return @(([self.path hasPrefix:@"/"]) && ([self.path hasSuffix:@"/*"]));
+}
+
+-(void)setIsDirectory:(NSNumber*)isDirectory
+{
+    return;
+}
+
+-(BOOL)isTemporary
+{
+    return (nil != self.pid);
+}
+
+-(NSString*)canonicalPath
+{
+    return canonicalPath(self.path);
+}
+
+@end
+
+//make a rule
+static Rule* makeRule(NSString* path, NSString* addr, NSString* port)
+{
+    Rule* rule = [[Rule alloc] init];
+    rule.path = path;
+    rule.key = path;
+    rule.uuid = [[NSUUID UUID] UUIDString];
+    rule.endpointAddr = addr;
+    rule.endpointPort = port;
+    rule.scope = @ACTION_SCOPE_PROCESS;
+    return rule;
+}
+
+//add a rule to a rules dictionary
+static void addRule(NSMutableDictionary* rules, Rule* rule)
+{
+    if(nil == rules[rule.key])
+    {
+        rules[rule.key] = [@{KEY_RULES:[NSMutableArray array]} mutableCopy];
+    }
+    [rules[rule.key][KEY_RULES] addObject:rule];
+}
+
+//check two indices hold the same buckets
+// tree buckets combine keys, so their (unordered) rules are compared as sets
+static BOOL sameIndex(RuleIndex* a, RuleIndex* b)
+{
+    if( (a.count != b.count) || (a.expires != b.expires) ) return NO;
+    if( (a.globalRules.rules ?: @[]).count != (b.globalRules.rules ?: @[]).count ) return NO;
+    if( (nil != a.globalRules) && (YES != [a.globalRules.rules isEqualToArray:b.globalRules.rules]) ) return NO;
+
+    for(NSArray* pair in @[@[a.itemRules, b.itemRules], @[a.directoryRules, b.directoryRules]]) {
+        NSDictionary* x = pair[0];
+        NSDictionary* y = pair[1];
+        if(YES != [[NSSet setWithArray:x.allKeys] isEqualToSet:[NSSet setWithArray:y.allKeys]]) return NO;
+        for(NSString* key in x) {
+            if(YES != [[x[key] rules] isEqualToArray:[y[key] rules]]) return NO;
+            for(NSInteger tier = 0; tier < RuleTierCount; tier++) {
+                if(YES != [[x[key] rules:tier family:RuleFamilyIPv4] isEqualToArray:[y[key] rules:tier family:RuleFamilyIPv4]]) return NO;
+            }
+        }
+    }
+
+    if(YES != [[NSSet setWithArray:a.treeRules.allKeys] isEqualToSet:[NSSet setWithArray:b.treeRules.allKeys]]) return NO;
+    for(NSString* path in a.treeRules) {
+        if(YES != [[NSSet setWithArray:[a.treeRules[path] rules]] isEqualToSet:[NSSet setWithArray:[b.treeRules[path] rules]]]) return NO;
+    }
+
+    return YES;
+}
+
+int main(int argc, const char * argv[]) {
+    @autoreleasepool {
+
+        NSLog(@"🧪 Rule Index Test Suite");
+        NSLog(@"========================");
+
+        logHandle = os_log_create("com.objective-see.lulu.tests", "RuleIndex");
+
+        int testsPassed = 0;
+        int totalTests = 0;
+
+        // Test 1: Tiers are split per family
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 1: any/partial/exact tiers (per family)");
+
+            NSMutableDictionary* rules = [NSMutableDictionary dictionary];
+            addRule(rules, makeRule(@"/usr/bin/curl", VALUE_ANY, VALUE_ANY));
+            addRule(rules, makeRule(@"/usr/bin/curl", @"0.0.0.0/0", VALUE_ANY));
+            addRule(rules, makeRule(@"/usr/bin/curl", @"github.com", VALUE_ANY));
+            addRule(rules, makeRule(@"/usr/bin/curl", @"github.com", @"443"));
+
+            RuleIndex* index = [[RuleIndex alloc] init:rules];
+            RuleBucket* bucket = index.itemRules[@"/usr/bin/curl"];
+
+            if( (4 == index.count) &&
+                (2 == [bucket rules:RuleTierAny family:ruleFamilyForSocketFamily(AF_INET)].count) &&
+                (1 == [bucket rules:RuleTierAny family:ruleFamilyForSocketFamily(AF_INET6)].count) &&
+                (2 == [bucket rules:RuleTierPartial family:ruleFamilyForSocketFamily(AF_INET6)].count) &&
+                (1 == [bucket rules:RuleTierExact family:ruleFamilyForSocketFamily(AF_INET)].count) ) {
+                NSLog(@"✅ PASS: rules split into tiers");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: unexpected tiers");
+            }
+        }
+
+        // Test 2: Disabled rules are not indexed into tiers
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 2: disabled rules skipped");
+
+            NSMutableDictionary* rules = [NSMutableDictionary dictionary];
+            Rule* rule = makeRule(@"/usr/bin/curl", VALUE_ANY, VALUE_ANY);
+            rule.isDisabled = @YES;
+            addRule(rules, rule);
+
+            RuleIndex* index = [[RuleIndex alloc] init:rules];
+
+            if(0 == [index.itemRules[@"/usr/bin/curl"] rules:RuleTierAny family:RuleFamilyIPv4].count) {
+                NSLog(@"✅ PASS: disabled rule skipped");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: disabled rule was indexed");
+            }
+        }
+
+        // Test 3: Directory rules, shallowest to deepest
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 3: directory lookup");
+
+            NSMutableDictionary* rules = [NSMutableDictionary dictionary];
+            Rule* outer = makeRule(@"/Applications/*", VALUE_ANY, VALUE_ANY);
+            Rule* inner = makeRule(@"/Applications/Foo.app/*", VALUE_ANY, VALUE_ANY);
+            addRule(rules, inner);
+            addRule(rules, outer);
+            addRule(rules, makeRule(@"/Apps/*", VALUE_ANY, VALUE_ANY));
+
+            RuleIndex* index = [[RuleIndex alloc] init:rules];
+            NSArray* buckets = [index directoryRulesForPath:@"/Applications/Foo.app/Contents/MacOS/Foo"];
+
+            if( (2 == buckets.count) &&
+                (outer == [buckets[0] rules].firstObject) &&
+                (inner == [buckets[1] rules].firstObject) &&
+                (0 == [index directoryRulesForPath:@"/Applicationsfoo/bar"].count) ) {
+                NSLog(@"✅ PASS: directory buckets found (in order)");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: directory buckets: %@", buckets);
+            }
+        }
+
+        // Test 4: Tree rules keyed by resolved path
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 4: tree ('process + kids') rules");
+
+            NSMutableDictionary* rules = [NSMutableDictionary dictionary];
+            Rule* tree = makeRule(@"/tmp/shell", VALUE_ANY, VALUE_ANY);
+            tree.scope = @ACTION_SCOPE_PROCESS_TREE;
+            addRule(rules, tree);
+            addRule(rules, makeRule(@"/tmp/other", VALUE_ANY, VALUE_ANY));
+
+            RuleIndex* index = [[RuleIndex alloc] init:rules];
+
+            if( (1 == index.treeRules.count) &&
+                (tree == [index.treeRules[[@"/tmp/shell" stringByResolvingSymlinksInPath]] rules].firstObject) ) {
+                NSLog(@"✅ PASS: tree rule indexed by resolved path");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: tree rules: %@", index.treeRules);
+            }
+        }
+
+        // Test 5: Incremental (per key) builds match full builds
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 5: incremental builds match full builds");
+
+            BOOL passed = YES;
+            NSMutableDictionary* rules = [NSMutableDictionary dictionary];
+            addRule(rules, makeRule(VALUE_ANY, VALUE_ANY, @"53"));
+            addRule(rules, makeRule(@"/usr/bin/curl", @"github.com", @"443"));
+            addRule(rules, makeRule(@"/Applications/*", VALUE_ANY, VALUE_ANY));
+
+            //tree rules for one path, from two keys
+            Rule* tree = makeRule(@"/tmp/shell", VALUE_ANY, VALUE_ANY);
+            tree.scope = @ACTION_SCOPE_PROCESS_TREE;
+            addRule(rules, tree);
+            Rule* signedTree = makeRule(@"/tmp/shell", VALUE_ANY, @"80");
+            signedTree.key = @"com.example.shell";
+            signedTree.scope = @ACTION_SCOPE_PROCESS_TREE;
+            addRule(rules, signedTree);
+
+            RuleIndex* index = [[RuleIndex alloc] init:rules];
+
+            //add (item, directory, global)
+            Rule* added = makeRule(@"/usr/bin/curl", VALUE_ANY, VALUE_ANY);
+            added.expiration = [NSDate dateWithTimeIntervalSinceNow:60];
+            addRule(rules, added);
+            index = [[RuleIndex alloc] init:rules previous:index changed:[NSSet setWithObject:added.key]];
+            passed &= sameIndex(index, [[RuleIndex alloc] init:rules]);
+
+            addRule(rules, makeRule(@"/Users/*", VALUE_ANY, VALUE_ANY));
+            index = [[RuleIndex alloc] init:rules previous:index changed:[NSSet setWithObject:@"/Users/*"]];
+            passed &= sameIndex(index, [[RuleIndex alloc] init:rules]);
+
+            addRule(rules, makeRule(VALUE_ANY, VALUE_ANY, @"443"));
+            index = [[RuleIndex alloc] init:rules previous:index changed:[NSSet setWithObject:VALUE_ANY]];
+            passed &= sameIndex(index, [[RuleIndex alloc] init:rules]);
+
+            //toggle (in place) a tree rule
+            signedTree.isDisabled = @1;
+            index = [[RuleIndex alloc] init:rules previous:index changed:[NSSet setWithObject:signedTree.key]];
+            passed &= sameIndex(index, [[RuleIndex alloc] init:rules]);
+            passed &= (1 == [index.treeRules[tree.canonicalPath] rules].count);
+
+            //delete (item w/ earliest expiration, directory, tree)
+            [rules removeObjectForKey:added.key];
+            [rules removeObjectForKey:@"/Applications/*"];
+            [rules removeObjectForKey:tree.key];
+            index = [[RuleIndex alloc] init:rules previous:index changed:[NSSet setWithObjects:added.key, @"/Applications/*", tree.key, nil]];
+            passed &= sameIndex(index, [[RuleIndex alloc] init:rules]);
+            passed &= (DBL_MAX == index.expires) && (0 == index.treeRules.count);
+
+            //unchanged buckets are shared
+            RuleIndex* next = [[RuleIndex alloc] init:rules previous:index changed:[NSSet setWithObject:VALUE_ANY]];
+            passed &= (next.directoryRules[@"/Users/"] == index.directoryRules[@"/Users/"]);
+
+            if(passed) {
+                NSLog(@"✅ PASS: incremental builds match full builds, and share unchanged buckets");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: incremental index differs from full build");
+            }
+        }
+
+        // Benchmark: synthetic rule set
+        {
+            NSLog(@"\n⏱  Benchmark: 10k items, 500 directories");
+
+            NSMutableDictionary* rules = [NSMutableDictionary dictionary];
+            for(int i = 0; i < 10000; i++) {
+                addRule(rules, makeRule([NSString stringWithFormat:@"/usr/local/bin/tool%d", i], VALUE_ANY, @"443"));
+            }
+            for(int i = 0; i < 500; i++) {
+                addRule(rules, makeRule([NSString stringWithFormat:@"/opt/dir%d/*", i], VALUE_ANY, VALUE_ANY));
+            }
+
+            NSDate* start = [NSDate date];
+            RuleIndex* index = [[RuleIndex alloc] init:rules];
+            NSLog(@"   build: %.2f ms", [[NSDate date] timeIntervalSinceDate:start] * 1000);
+
+            start = [NSDate date];
+            for(int i = 0; i < 100; i++) {
+                Rule* rule = makeRule([NSString stringWithFormat:@"/usr/local/bin/tool%d", i], @"github.com", @"443");
+                addRule(rules, rule);
+                index = [[RuleIndex alloc] init:rules previous:index changed:[NSSet setWithObject:rule.key]];
+            }
+            NSLog(@"   100 single-rule (incremental) rebuilds: %.2f ms", [[NSDate date] timeIntervalSinceDate:start] * 1000);
+
+            NSUInteger found = 0;
+            start = [NSDate date];
+            for(int i = 0; i < 100000; i++) {
+                NSString* path = [NSString stringWithFormat:@"/opt/dir%d/bin/tool%d", i % 1000, i];
+                found += [index directoryRulesForPath:path].count;
+                found += (nil != index.itemRules[[NSString stringWithFormat:@"/usr/local/bin/tool%d", i % 20000]]);
+            }
+            NSLog(@"   100k indexed lookups: %.2f ms (%lu hits)", [[NSDate date] timeIntervalSinceDate:start] * 1000, (unsigned long)found);
+
+            found = 0;
+            start = [NSDate date];
+            for(int i = 0; i < 1000; i++) {
+                NSString* path = [NSString stringWithFormat:@"/opt/dir%d/bin/tool%d", i % 1000, i];
+                for(NSString* key in rules) {
+                    if( (YES == [key hasSuffix:@"/*"]) &&
+                        (YES == [path hasPrefix:[key substringToIndex:key.length-1]]) ) found++;
+                }
+            }
+            NSLog(@"   1k linear (per-key) scans: %.2f ms (%lu hits)", [[NSDate date] timeIntervalSinceDate:start] * 1000, (unsigned long)found);
+        }
+
+        // Test Results Summary
+        NSLog(@"\n🏁 Rule Index Test Results");
+        NSLog(@"=========================");
+        NSLog(@"Tests Passed: %d/%d", testsPassed, totalTests);
+
+        if (testsPassed == totalTests) {
+            NSLog(@"✅ ALL TESTS PASSED!");
+            return 0;
+        } else {
+            NSLog(@"❌ %d tests failed. Please check implementation.", totalTests - testsPassed);
+            return 1;
+        }
+    }
+}
@@ -0,0 +1,214 @@
+//
+//  test_rule_journal.m
+//  LuLu
+//
+//  Tests (crash injection, and an ingest benchmark) for the append-only rule journal
+//  builds against the real RuleJournal.m
+//
+
+#import <Foundation/Foundation.h>
+
+#import "RuleJournal.h"
+
+//log handle
+os_log_t logHandle = nil;
+
+//classes in records
+static NSSet* recordClasses(void)
+{
+    return [NSSet setWithArray:@[[NSDictionary class], [NSString class], [NSNumber class]]];
+}
+
+//make a (rule-like) record
+static NSDictionary* makeRecord(int i)
+{
+    return @{@"op":@"add", @"key":[NSString stringWithFormat:@"com.example.tool%d", i], @"uuid":[[NSUUID UUID] UUIDString], @"endpointAddr":@"*", @"endpointPort":@"443", @"index":@(i)};
+}
+
+//fresh journal at path
+static RuleJournal* freshJournal(NSString* path)
+{
+    [NSFileManager.defaultManager removeItemAtPath:path error:nil];
+
+    RuleJournal* journal = [[RuleJournal alloc] init:path];
+    [journal replay:recordClasses()];
+
+    return journal;
+}
+
+//check records are a (complete, in order) prefix
+static BOOL isPrefix(NSArray* records, NSUInteger count)
+{
+    if(records.count > count) return NO;
+
+    for(NSUInteger i = 0; i < records.count; i++) {
+        if([records[i][@"index"] unsignedIntegerValue] != i) return NO;
+    }
+
+    return YES;
+}
+
+int main(int argc, const char * argv[]) {
+    @autoreleasepool {
+
+        NSLog(@"🧪 Rule Journal Test Suite");
+        NSLog(@"==========================");
+
+        logHandle = os_log_create("com.objective-see.lulu.tests", "RuleJournal");
+
+        int testsPassed = 0;
+        int totalTests = 0;
+
+        NSString* path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"test_rule_journal.journal"];
+
+        // Test 1: Round trip
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 1: append & replay");
+
+            RuleJournal* journal = freshJournal(path);
+            for(int i = 0; i < 100; i++) [journal append:makeRecord(i)];
+
+            NSArray* records = [[[RuleJournal alloc] init:path] replay:recordClasses()];
+
+            if( (100 == journal.count) &&
+                (100 == records.count) &&
+                (YES == isPrefix(records, 100)) ) {
+                NSLog(@"✅ PASS: all records replayed (in order)");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: replayed %lu records", (unsigned long)records.count);
+            }
+        }
+
+        // Test 2: Reset
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 2: reset (i.e. after a save)");
+
+            RuleJournal* journal = freshJournal(path);
+            for(int i = 0; i < 10; i++) [journal append:makeRecord(i)];
+            [journal reset];
+            [journal append:makeRecord(0)];
+
+            NSArray* records = [[[RuleJournal alloc] init:path] replay:recordClasses()];
+
+            if( (1 == records.count) &&
+                (1 == journal.count) ) {
+                NSLog(@"✅ PASS: only post-reset records replayed");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: replayed %lu records", (unsigned long)records.count);
+            }
+        }
+
+        // Test 3: Crash injection (torn writes)
+        // truncate at random offsets: replay must return a valid prefix, and appends must then follow it
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 3: crash injection (truncation at 500 random offsets)");
+
+            RuleJournal* journal = freshJournal(path);
+            for(int i = 0; i < 50; i++) [journal append:makeRecord(i)];
+
+            NSData* full = [NSData dataWithContentsOfFile:path];
+            BOOL ok = YES;
+
+            for(int trial = 0; trial < 500 && ok; trial++) {
+                NSUInteger cut = arc4random_uniform((uint32_t)full.length + 1);
+                [[full subdataWithRange:NSMakeRange(0, cut)] writeToFile:path atomically:NO];
+
+                RuleJournal* recovered = [[RuleJournal alloc] init:path];
+                NSArray* records = [recovered replay:recordClasses()];
+                if(YES != isPrefix(records, 50)) { ok = NO; break; }
+
+                NSDictionary* next = makeRecord((int)records.count);
+                if(YES != [recovered append:next]) { ok = NO; break; }
+
+                NSArray* after = [[[RuleJournal alloc] init:path] replay:recordClasses()];
+                ok = ( (after.count == records.count + 1) && (YES == isPrefix(after, 51)) );
+            }
+
+            if(YES == ok) {
+                NSLog(@"✅ PASS: torn tails truncated, appends resume after last valid record");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: invalid replay after truncation");
+            }
+        }
+
+        // Test 4: Crash injection (corruption)
+        // flip a random byte: replay must stop before the corrupt record
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 4: crash injection (corruption at 500 random offsets)");
+
+            RuleJournal* journal = freshJournal(path);
+            for(int i = 0; i < 50; i++) [journal append:makeRecord(i)];
+
+            NSData* full = [NSData dataWithContentsOfFile:path];
+            BOOL ok = YES;
+
+            for(int trial = 0; trial < 500 && ok; trial++) {
+                NSMutableData* corrupt = [full mutableCopy];
+                NSUInteger offset = arc4random_uniform((uint32_t)full.length);
+                ((uint8_t*)corrupt.mutableBytes)[offset] ^= (1 + arc4random_uniform(255));
+                [corrupt writeToFile:path atomically:NO];
+
+                NSArray* records = [[[RuleJournal alloc] init:path] replay:recordClasses()];
+                ok = ( (YES == isPrefix(records, 50)) && (records.count < 50) );
+            }
+
+            if(YES == ok) {
+                NSLog(@"✅ PASS: corrupt records (and anything after) dropped");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: corrupt record replayed");
+            }
+        }
+
+        // Benchmark: ingest
+        // journal append vs. rewriting a whole archive on each add (as a full save does)
+        {
+            NSLog(@"\n⏱  Benchmark: ingest 5k rules");
+
+            RuleJournal* journal = freshJournal(path);
+            NSDate* start = [NSDate date];
+            for(int i = 0; i < 5000; i++) [journal append:makeRecord(i)];
+            NSTimeInterval elapsed = [[NSDate date] timeIntervalSinceDate:start];
+            NSLog(@"   journal: %.2f s (%.0f rules/s, %llu bytes)", elapsed, 5000 / elapsed, journal.size);
+
+            NSString* archivePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"test_rule_journal.plist"];
+            NSMutableDictionary* rules = [NSMutableDictionary dictionary];
+            start = [NSDate date];
+            for(int i = 0; i < 1000; i++) {
+                NSDictionary* record = makeRecord(i);
+                rules[record[@"key"]] = record;
+                [[NSKeyedArchiver archivedDataWithRootObject:rules requiringSecureCoding:YES error:nil] writeToFile:archivePath atomically:YES];
+            }
+            elapsed = [[NSDate date] timeIntervalSinceDate:start];
+            NSLog(@"   full rewrite (first 1k only): %.2f s (%.0f rules/s)", elapsed, 1000 / elapsed);
+
+            start = [NSDate date];
+            NSArray* records = [[[RuleJournal alloc] init:path] replay:recordClasses()];
+            NSLog(@"   replay: %.2f ms (%lu records)", [[NSDate date] timeIntervalSinceDate:start] * 1000, (unsigned long)records.count);
+
+            [NSFileManager.defaultManager removeItemAtPath:archivePath error:nil];
+        }
+
+        [NSFileManager.defaultManager removeItemAtPath:path error:nil];
+
+        // Test Results Summary
+        NSLog(@"\n🏁 Rule Journal Test Results");
+        NSLog(@"============================");
+        NSLog(@"Tests Passed: %d/%d", testsPassed, totalTests);
+
+        if (testsPassed == totalTests) {
+            NSLog(@"✅ ALL TESTS PASSED!");
+            return 0;
+        } else {
+            NSLog(@"❌ %d tests failed. Please check implementation.", totalTests - testsPassed);
+            return 1;
+        }
+    }
+}
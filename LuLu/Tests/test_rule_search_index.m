@@ -0,0 +1,281 @@
+//
+//  test_rule_search_index.m
+//  LuLu
+//
+//  Tests (and a latency benchmark) for the (trigram) rule search index, used to filter the rules window
+//  builds against the real RuleSearchIndex.m & Rule.m (and utilities.m)
+//  results are checked against '-[Rule matchesString:]', i.e. what filtering checked (per rule) before
+//
+
+#import <Foundation/Foundation.h>
+
+#import "Rule.h"
+#import "consts.h"
+#import "RuleSearchIndex.h"
+
+//log handle
+os_log_t logHandle = nil;
+
+//words
+// for (random) rule names, hosts, etc
+static NSArray* words(void)
+{
+    return @[@"safari", @"mail", @"zoom", @"slack", @"curl", @"python", @"node", @"spotify", @"dropbox", @"firefox", @"chrome", @"teams", @"git", @"ssh", @"music", @"news", @"xcode", @"docker", @"steam", @"signal"];
+}
+
+//make a (random) rule
+static Rule* makeRule(NSUInteger i)
+{
+    NSArray* names = words();
+    NSString* name = [NSString stringWithFormat:@"%@%lu", [names[random() % names.count] capitalizedString], (unsigned long)(i % 1000)];
+    NSString* path = [NSString stringWithFormat:@"/Applications/%@.app/Contents/MacOS/%@", name, name];
+    NSString* addr = (0 == i % 5) ? VALUE_ANY : ((0 == i % 2) ? [NSString stringWithFormat:@"%ld.%ld.%ld.%ld", random() % 256, random() % 256, random() % 256, random() % 256] : [NSString stringWithFormat:@"api.%@.com", names[random() % names.count]]);
+    NSString* port = (0 == i % 7) ? VALUE_ANY : [NSString stringWithFormat:@"%ld", 1 + random() % 65535];
+
+    NSMutableDictionary* info = [@{KEY_PATH:path, KEY_KEY:path, KEY_PROCESS_NAME:name, KEY_ENDPOINT_ADDR:addr, KEY_ENDPOINT_PORT:port, KEY_ACTION:@((0 == i % 3) ? RULE_STATE_BLOCK : RULE_STATE_ALLOW), KEY_TYPE:@RULE_TYPE_USER} mutableCopy];
+    info[KEY_CS_INFO] = @{KEY_CS_ID:[NSString stringWithFormat:@"com.%@.%@", names[random() % names.count], name]};
+    if(0 == i % 11) { info[KEY_DURATION] = @(RuleDurationProcess); info[KEY_PROCESS_ID] = @(100 + i); }
+    if(0 == i % 97) info[KEY_PROCESS_NAME] = [name stringByAppendingString:@" Größe"];
+
+    return [[Rule alloc] init:info];
+}
+
+//search via rules
+// i.e. as before: each rule's 'matchesString'
+static NSDictionary* linearSearch(NSArray<Rule*>* rules, NSString* query)
+{
+    NSMutableDictionary* results = [NSMutableDictionary dictionary];
+    for(Rule* rule in rules) {
+        if(YES != [rule matchesString:query]) continue;
+        if(nil == results[rule.key]) results[rule.key] = [NSMutableArray array];
+        [results[rule.key] addObject:rule];
+    }
+    return results;
+}
+
+//same matches?
+// per item, regardless of (rule) order
+static BOOL sameMatches(NSDictionary* matches, NSDictionary* expected)
+{
+    if(matches.count != expected.count) return NO;
+    for(NSString* key in expected) {
+        if(YES != [[NSSet setWithArray:matches[key]] isEqualToSet:[NSSet setWithArray:expected[key]]]) return NO;
+    }
+    return YES;
+}
+
+//build index
+static RuleSearchIndex* buildIndex(NSArray<Rule*>* rules)
+{
+    RuleSearchIndex* index = [[RuleSearchIndex alloc] init];
+    for(Rule* rule in rules) [index add:rule key:rule.key];
+    return index;
+}
+
+//queries
+static NSArray* queries(void)
+{
+    return @[@"s", @"S", @"a", @"1", @"*", @"sa", @"Sa", @"saf", @"SAFARI", @"safari1", @"api.zoom", @"com.slack", @"/applications/git", @".app/Contents", @"MacOS/Node", @"block", @"Allow", @"443", @"12.", @"größe", @"Größe", @"ö", @"any address", @"any port", @"zzz", @"xyzzy", @"\n"];
+}
+
+int main(int argc, const char * argv[]) {
+    @autoreleasepool {
+
+        NSLog(@"🧪 Rule Search Index Test Suite");
+        NSLog(@"===============================");
+
+        logHandle = os_log_create("com.objective-see.lulu.tests", "RuleSearchIndex");
+
+        int testsPassed = 0;
+        int totalTests = 0;
+
+        srandom(42);
+        NSMutableArray<Rule*>* rules = [NSMutableArray array];
+        for(NSUInteger i = 0; i < 5000; i++) [rules addObject:makeRule(i)];
+
+        // Test 1: Same matches as each rule's 'matchesString'
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 1: matches == 'matchesString' (%lu queries)", (unsigned long)queries().count);
+
+            RuleSearchIndex* index = buildIndex(rules);
+            NSMutableArray* failed = [NSMutableArray array];
+
+            for(NSString* query in queries()) {
+                //fresh (no narrowing)
+                RuleSearchIndex* fresh = buildIndex(rules);
+                if(YES != sameMatches([fresh search:query], linearSearch(rules, query))) [failed addObject:query];
+                //shared (w/ narrowing, where query extends previous)
+                if(YES != sameMatches([index search:query], linearSearch(rules, query))) [failed addObject:query];
+            }
+
+            if( (0 == failed.count) &&
+                (rules.count == index.count) ) {
+                NSLog(@"✅ PASS: all queries match");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: mismatched queries: %@", failed);
+            }
+        }
+
+        // Test 2: Typing (narrowing as query is extended, and widening as it's deleted)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 2: typing & deleting");
+
+            RuleSearchIndex* index = buildIndex(rules);
+            NSString* typed = @"api.spotify.com";
+            BOOL ok = YES;
+
+            for(NSUInteger i = 1; i <= typed.length; i++) {
+                NSString* query = [typed substringToIndex:i];
+                if(YES != sameMatches([index search:query], linearSearch(rules, query))) { ok = NO; NSLog(@"   mismatch: '%@'", query); }
+            }
+            for(NSUInteger i = typed.length; i >= 1; i--) {
+                NSString* query = [typed substringToIndex:i];
+                if(YES != sameMatches([index search:query], linearSearch(rules, query))) { ok = NO; NSLog(@"   mismatch: '%@'", query); }
+            }
+
+            if(YES == ok) {
+                NSLog(@"✅ PASS: each keystroke matches");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: typing mismatched");
+            }
+        }
+
+        // Test 3: Patches (removed, changed, & added rules)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 3: patched rules");
+
+            NSMutableArray* current = [rules mutableCopy];
+            RuleSearchIndex* index = buildIndex(current);
+
+            //search first
+            // so narrowing state must be dropped on patch
+            [index search:@"saf"];
+
+            //remove some
+            for(NSUInteger i = 0; i < 100; i++) {
+                [index remove:current[i]];
+            }
+            [current removeObjectsInRange:NSMakeRange(0, 100)];
+
+            //change some (same uuid, new endpoint)
+            for(NSUInteger i = 0; i < 100; i++) {
+                Rule* rule = current[i];
+                rule.endpointAddr = @"changed.safari.example";
+                [index add:rule key:rule.key];
+            }
+
+            //add some
+            for(NSUInteger i = 0; i < 100; i++) {
+                Rule* rule = makeRule(10000 + i);
+                [current addObject:rule];
+                [index add:rule key:rule.key];
+            }
+
+            BOOL ok = (current.count == index.count);
+            for(NSString* query in @[@"safari", @"changed.saf", @"saf", @"s", @"com"]) {
+                if(YES != sameMatches([index search:query], linearSearch(current, query))) { ok = NO; NSLog(@"   mismatch: '%@'", query); }
+            }
+
+            if(YES == ok) {
+                NSLog(@"✅ PASS: index reflects patches (%lu rules)", (unsigned long)index.count);
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: count: %lu vs. %lu", (unsigned long)index.count, (unsigned long)current.count);
+            }
+        }
+
+        // Test 4: Compaction (once most rules are removed)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 4: compaction");
+
+            NSMutableArray* current = [rules mutableCopy];
+            RuleSearchIndex* index = buildIndex(current);
+
+            //remove most (by item)
+            while(current.count > 1000) {
+                Rule* rule = current.lastObject;
+                [index removeItem:@{KEY_RULES:@[rule]}];
+                [current removeLastObject];
+            }
+
+            BOOL ok = (1000 == index.count);
+            for(NSString* query in @[@"safari", @"sa", @"block", @"com.zoom"]) {
+                if(YES != sameMatches([index search:query], linearSearch(current, query))) { ok = NO; NSLog(@"   mismatch: '%@'", query); }
+            }
+
+            if(YES == ok) {
+                NSLog(@"✅ PASS: compacted index still matches");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: count: %lu", (unsigned long)index.count);
+            }
+        }
+
+        // Benchmark: filter latency at 100k rules
+        // vs. checking each rule ('matchesString'), as the rules window did on each keystroke
+        {
+            NSLog(@"\n⏱  Benchmark: filter latency (100k rules)");
+
+            srandom(7);
+            NSMutableArray<Rule*>* many = [NSMutableArray array];
+            for(NSUInteger i = 0; i < 100000; i++) [many addObject:makeRule(i)];
+
+            NSDate* start = [NSDate date];
+            RuleSearchIndex* index = buildIndex(many);
+            NSLog(@"   build: %.0f ms", [[NSDate date] timeIntervalSinceDate:start] * 1000);
+
+            //typing
+            NSString* typed = @"spotify42";
+            NSTimeInterval slowest = 0;
+            for(NSUInteger i = 1; i <= typed.length; i++) {
+                NSString* query = [typed substringToIndex:i];
+                start = [NSDate date];
+                NSDictionary* results = [index search:query];
+                NSTimeInterval took = [[NSDate date] timeIntervalSinceDate:start];
+                slowest = MAX(slowest, took);
+                NSLog(@"   '%@': %.2f ms (%lu items)", query, took * 1000, (unsigned long)results.count);
+            }
+            NSLog(@"   slowest keystroke: %.2f ms", slowest * 1000);
+
+            //fresh queries (e.g. pasted)
+            for(NSString* query in @[@"a", @"zo", @"api.slack", @"/applications/docker", @"443", @"block"]) {
+                start = [NSDate date];
+                NSDictionary* results = [index search:query];
+                NSTimeInterval took = [[NSDate date] timeIntervalSinceDate:start];
+
+                start = [NSDate date];
+                NSDictionary* linear = linearSearch(many, query);
+                NSTimeInterval linearTook = [[NSDate date] timeIntervalSinceDate:start];
+
+                NSLog(@"   '%@': index %.2f ms vs. each rule %.2f ms (%lu items, match: %d)", query, took * 1000, linearTook * 1000, (unsigned long)results.count, sameMatches(results, linear));
+            }
+
+            //patch
+            start = [NSDate date];
+            for(NSUInteger i = 0; i < 1000; i++) {
+                [index remove:many[i]];
+                [index add:many[i] key:many[i].key];
+            }
+            NSLog(@"   patch: %.2f µs per (changed) rule", [[NSDate date] timeIntervalSinceDate:start] * 1e6 / 1000);
+        }
+
+        // Test Results Summary
+        NSLog(@"\n🏁 Rule Search Index Test Results");
+        NSLog(@"================================");
+        NSLog(@"Tests Passed: %d/%d", testsPassed, totalTests);
+
+        if (testsPassed == totalTests) {
+            NSLog(@"✅ ALL TESTS PASSED!");
+            return 0;
+        } else {
+            NSLog(@"❌ %d tests failed. Please check implementation.", totalTests - testsPassed);
+            return 1;
+        }
+    }
+}
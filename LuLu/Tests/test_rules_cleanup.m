@@ -0,0 +1,300 @@
+//
+//  test_rules_cleanup.m
+//  LuLu
+//
+//  Tests (and a benchmark) for (full) rules cleanup: paths checked in parallel (per volume), deletions applied in one batch
+//  builds against the real PathChecker, and Rules (& its index/matchers)
+//
+
+#import <Foundation/Foundation.h>
+
+#import "Rule.h"
+#import "Rules.h"
+#import "consts.h"
+#import "RuleIndex.h"
+#import "PathChecker.h"
+
+@class Alerts;
+@class Preferences;
+@class ExitMonitor;
+@class VerdictCache;
+
+//log handle
+os_log_t logHandle = nil;
+
+//alerts, prefs, verdict cache, & exit monitor
+// unused (nil): there's no client, and (temporary) rules' process exits aren't watched
+Alerts* alerts = nil;
+Preferences* preferences = nil;
+VerdictCache* verdictCache = nil;
+ExitMonitor* exitMonitor = nil;
+
+// Stand-in XPC user client
+// created by 'Rules', but never messaged (as there's no client)
+@implementation XPCUserClient
+@end
+
+// Stand-in Binary
+// only referenced by default rule generation
+@implementation Binary
+@end
+
+// Stand-in Process
+// only referenced by rule lookups
+@implementation Process
+@end
+
+// Rules, for tests
+// never saved, but saves are counted
+@interface TestRules : Rules
+@property(nonatomic)NSUInteger saves;
+@end
+
+@implementation TestRules
+
+-(BOOL)save
+{
+    self.saves++;
+    return YES;
+}
+
+@end
+
+//rule for a path
+static Rule* pathRule(NSString* path)
+{
+    return [[Rule alloc] init:@{KEY_PATH:path, KEY_KEY:path, KEY_ACTION:@RULE_STATE_ALLOW, KEY_TYPE:@RULE_TYPE_USER, KEY_ENDPOINT_ADDR:VALUE_ANY, KEY_ENDPOINT_PORT:VALUE_ANY}];
+}
+
+//create files
+// in a (new) temp directory
+static NSArray<NSString*>* createFiles(NSString* directory, NSUInteger count)
+{
+    NSMutableArray* files = [NSMutableArray array];
+    [NSFileManager.defaultManager createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:nil];
+    for(NSUInteger i = 0; i < count; i++) {
+        NSString* file = [directory stringByAppendingPathComponent:[NSString stringWithFormat:@"app%lu", (unsigned long)i]];
+        [NSData.data writeToFile:file atomically:NO];
+        [files addObject:file];
+    }
+    return files;
+}
+
+int main(int argc, const char * argv[]) {
+    @autoreleasepool {
+
+        NSLog(@"🧪 Rules Cleanup Test Suite");
+        NSLog(@"===========================");
+
+        logHandle = os_log_create("com.objective-see.lulu.tests", "RulesCleanup");
+
+        int testsPassed = 0;
+        int totalTests = 0;
+
+        NSString* root = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"lulu.cleanup.%d", getpid()]];
+
+        // Test 1: Missing paths
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 1: missing paths found (in parallel)");
+
+            NSArray* files = createFiles([root stringByAppendingPathComponent:@"1"], 1000);
+            NSMutableSet* deleted = [NSMutableSet set];
+            for(NSUInteger i = 0; i < files.count; i += 3) {
+                [NSFileManager.defaultManager removeItemAtPath:files[i] error:nil];
+                [deleted addObject:files[i]];
+            }
+
+            //plus a path under a (deleted) file, & under a missing directory
+            NSMutableSet* paths = [NSMutableSet setWithArray:files];
+            [paths addObject:[files[0] stringByAppendingPathComponent:@"child"]];
+            [paths addObject:[files[1] stringByAppendingPathComponent:@"child"]];
+            [deleted addObject:[files[0] stringByAppendingPathComponent:@"child"]];
+            [deleted addObject:[files[1] stringByAppendingPathComponent:@"child"]];
+
+            PathChecker* checker = [[PathChecker alloc] init];
+            NSSet* missing = [checker missing:paths];
+
+            if( ([missing isEqualToSet:deleted]) &&
+                (paths.count == checker.checked) &&
+                (checker.volumes >= 1) ) {
+                NSLog(@"✅ PASS: %lu of %lu paths missing", (unsigned long)missing.count, (unsigned long)paths.count);
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: missing: %lu (expected %lu), checked: %lu", (unsigned long)missing.count, (unsigned long)deleted.count, (unsigned long)checker.checked);
+            }
+        }
+
+        // Test 2: Volumes
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 2: paths map to their volume (mount point)");
+
+            PathChecker* checker = [[PathChecker alloc] init];
+
+            if( ([[checker volume:@"/usr/bin/curl"] isEqualToString:@"/"]) &&
+                ([[checker volume:@"/"] isEqualToString:@"/"]) &&
+                ([[checker volume:@"/dev/null"] isEqualToString:@"/dev"]) &&
+                ([[checker volume:@"/devices/x"] isEqualToString:@"/"]) ) {
+                NSLog(@"✅ PASS: longest (whole component) mount point matches");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: /dev/null -> %@, /devices/x -> %@", [checker volume:@"/dev/null"], [checker volume:@"/devices/x"]);
+            }
+        }
+
+        // Test 3: Full cleanup
+        // deleted apps' rules (and dirs' rules) are deleted, in one batch (one save)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 3: full cleanup, one save");
+
+            NSString* directory = [root stringByAppendingPathComponent:@"3"];
+            NSArray* files = createFiles(directory, 100);
+            NSString* gone = [root stringByAppendingPathComponent:@"3.gone"];
+            createFiles(gone, 1);
+
+            TestRules* rules = [[TestRules alloc] init];
+            for(NSString* file in files) {
+                [rules add:pathRule(file) save:NO];
+                [rules add:pathRule(file) save:NO];
+            }
+            [rules add:pathRule([directory stringByAppendingString:@"/*"]) save:NO];
+            [rules add:pathRule([gone stringByAppendingString:@"/*"]) save:NO];
+            [rules add:pathRule(VALUE_ANY) save:NO];
+
+            //delete 10 apps (& one dir)
+            for(NSUInteger i = 0; i < 10; i++) [NSFileManager.defaultManager removeItemAtPath:files[i] error:nil];
+            [NSFileManager.defaultManager removeItemAtPath:gone error:nil];
+
+            //app moved? rule stays, as an 'external' path is still there
+            @synchronized(rules) {
+                [rules.rules[files[0]][KEY_PATHS] addObject:files[50]];
+            }
+
+            NSUInteger before = rules.rules.count;
+            NSDictionary* report = [rules cleanup:NO];
+            NSUInteger partial = [report[KEY_CLEANUP_DELETED] unsignedIntegerValue];
+
+            report = [rules cleanup:YES];
+
+            if( (0 == partial) &&
+                (19 == [report[KEY_CLEANUP_DELETED] unsignedIntegerValue]) &&
+                (before - 10 == rules.rules.count) &&
+                (nil != rules.rules[files[0]]) &&
+                (nil == rules.rules[files[1]]) &&
+                (nil == rules.rules[[gone stringByAppendingString:@"/*"]]) &&
+                (nil != rules.rules[VALUE_ANY]) &&
+                (1 == rules.saves) &&
+                (nil != report[KEY_CLEANUP_LOCK_TIME]) &&
+                (nil != report[KEY_CLEANUP_CHECK_TIME]) ) {
+                NSLog(@"✅ PASS: %@ rules deleted w/ one save (report: %@)", report[KEY_CLEANUP_DELETED], report);
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: partial: %lu, report: %@, items: %lu -> %lu, saves: %lu", (unsigned long)partial, report, (unsigned long)before, (unsigned long)rules.rules.count, (unsigned long)rules.saves);
+            }
+        }
+
+        // Test 4: Rules aren't locked while paths are checked
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 4: rules usable during cleanup");
+
+            NSArray* files = createFiles([root stringByAppendingPathComponent:@"4"], 5000);
+            TestRules* rules = [[TestRules alloc] init];
+            for(NSString* file in files) [rules add:pathRule(file) save:NO];
+
+            //longest wait for lock, during cleanup
+            __block NSTimeInterval longest = 0;
+            __block BOOL done = NO;
+            dispatch_semaphore_t finished = dispatch_semaphore_create(0);
+            dispatch_async(dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+                while(YES != done) {
+                    NSDate* start = [NSDate date];
+                    @synchronized(rules) {}
+                    longest = MAX(longest, [[NSDate date] timeIntervalSinceDate:start]);
+                }
+                dispatch_semaphore_signal(finished);
+            });
+
+            NSDictionary* report = [rules cleanup:YES];
+            done = YES;
+            dispatch_semaphore_wait(finished, DISPATCH_TIME_FOREVER);
+
+            if( (0 == [report[KEY_CLEANUP_DELETED] unsignedIntegerValue]) &&
+                (5000 == [report[KEY_CLEANUP_PATHS] unsignedIntegerValue]) &&
+                ([report[KEY_CLEANUP_LOCK_TIME] doubleValue] < [report[KEY_CLEANUP_TIME] doubleValue]) ) {
+                NSLog(@"✅ PASS: locked %.2f ms of %.2f ms (longest wait: %.2f ms)", [report[KEY_CLEANUP_LOCK_TIME] doubleValue] * 1000, [report[KEY_CLEANUP_TIME] doubleValue] * 1000, longest * 1000);
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: report: %@", report);
+            }
+        }
+
+        // Test 5: Process rules
+        // removed (on exit) in one batch, and as they were never saved, w/o a save (or journal record)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 5: process rules removed in one batch, nothing persisted");
+
+            TestRules* rules = [[TestRules alloc] init];
+            for(int i = 0; i < 50; i++) {
+                NSString* path = [NSString stringWithFormat:@"/bin/process%d", i % 5];
+                [rules add:[[Rule alloc] init:@{KEY_PATH:path, KEY_KEY:path, KEY_ACTION:@RULE_STATE_ALLOW, KEY_TYPE:@RULE_TYPE_USER, KEY_ENDPOINT_ADDR:VALUE_ANY, KEY_ENDPOINT_PORT:VALUE_ANY, KEY_DURATION:@(RuleDurationProcess), KEY_PROCESS_ID:@(getpid())}] save:NO];
+            }
+            [rules add:pathRule(@"/bin/kept") save:NO];
+            RuleBucket* kept = rules.compiledRules.itemRules[@"/bin/kept"];
+
+            NSUInteger removed = [rules removeProcessRules:getpid()];
+
+            if( (50 == removed) &&
+                (1 == rules.rules.count) &&
+                (0 == rules.saves) &&
+                (1 == rules.compiledRules.itemRules.count) &&
+                (kept == rules.compiledRules.itemRules[@"/bin/kept"]) ) {
+                NSLog(@"✅ PASS: 50 rules removed, one reindex (unchanged bucket shared), nothing saved");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: removed: %lu, items: %lu, saves: %lu", (unsigned long)removed, (unsigned long)rules.rules.count, (unsigned long)rules.saves);
+            }
+        }
+
+        // Benchmark: serial (under lock) vs. parallel checks
+        {
+            NSLog(@"\n⏱  Benchmark: path checks");
+
+            for(NSNumber* count in @[@1000, @10000]) {
+                NSArray* files = createFiles([root stringByAppendingPathComponent:[NSString stringWithFormat:@"bench.%@", count]], count.unsignedIntegerValue);
+                NSSet* paths = [NSSet setWithArray:files];
+
+                NSDate* start = [NSDate date];
+                NSUInteger exists = 0;
+                for(NSString* path in paths) exists += [NSFileManager.defaultManager fileExistsAtPath:path];
+                NSTimeInterval serial = [[NSDate date] timeIntervalSinceDate:start];
+
+                PathChecker* checker = [[PathChecker alloc] init];
+                start = [NSDate date];
+                NSSet* missing = [checker missing:paths];
+                NSTimeInterval parallel = [[NSDate date] timeIntervalSinceDate:start];
+
+                NSLog(@"   %5lu paths: serial %.2f ms vs. parallel %.2f ms (%lu exist, %lu missing)", (unsigned long)paths.count, serial * 1000, parallel * 1000, (unsigned long)exists, (unsigned long)missing.count);
+            }
+        }
+
+        //cleanup
+        [NSFileManager.defaultManager removeItemAtPath:root error:nil];
+
+        // Test Results Summary
+        NSLog(@"\n🏁 Rules Cleanup Test Results");
+        NSLog(@"============================");
+        NSLog(@"Tests Passed: %d/%d", testsPassed, totalTests);
+
+        if (testsPassed == totalTests) {
+            NSLog(@"✅ ALL TESTS PASSED!");
+            return 0;
+        } else {
+            NSLog(@"❌ %d tests failed. Please check implementation.", totalTests - testsPassed);
+            return 1;
+        }
+    }
+}
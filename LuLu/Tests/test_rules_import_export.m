@@ -0,0 +1,432 @@
+//
+//  test_rules_import_export.m
+//  LuLu
+//
+//  Tests (and a throughput benchmark) for streaming rule export/import, and bulk (daemon) import
+//  builds against the real RulesWriter & RulesReader, Rule.m, and Rules (& its index/matchers)
+//  exports are checked to round trip (field for field), and against NSJSONSerialization
+//
+
+#import <Foundation/Foundation.h>
+
+#import "Rule.h"
+#import "Rules.h"
+#import "consts.h"
+#import "RulesReader.h"
+#import "RulesWriter.h"
+
+@class Alerts;
+@class Preferences;
+@class ExitMonitor;
+@class VerdictCache;
+
+//log handle
+os_log_t logHandle = nil;
+
+//alerts, prefs, verdict cache, & exit monitor
+// unused (nil): there's no client, and rules here aren't temporary
+Alerts* alerts = nil;
+Preferences* preferences = nil;
+VerdictCache* verdictCache = nil;
+ExitMonitor* exitMonitor = nil;
+
+// Stand-in XPC user client
+// created by 'Rules', but never messaged (as there's no client)
+@implementation XPCUserClient
+@end
+
+// Stand-in Binary
+// only referenced by default rule generation
+@implementation Binary
+@end
+
+// Stand-in Process
+// only referenced by rule lookups
+@implementation Process
+@end
+
+// Rules, for tests
+// never saved, but saves are counted
+@interface TestRules : Rules
+@property(nonatomic)NSUInteger saves;
+@end
+
+@implementation TestRules
+
+-(BOOL)save
+{
+    self.saves++;
+    return YES;
+}
+
+@end
+
+//make a (random) rule
+// w/ awkward strings (quotes, backslashes, control chars, non-ascii), & all optional fields
+static Rule* makeRule(NSUInteger i, int type)
+{
+    NSArray* names = @[@"Safari", @"zoom.us", @"Größe \"quoted\"", @"back\\slash", @"tab\tnew\nline", @"emoji 🧱", @"/usr/bin/curl"];
+    NSString* name = [NSString stringWithFormat:@"%@ %lu", names[i % names.count], (unsigned long)i];
+    NSString* path = [NSString stringWithFormat:@"/Applications/%@.app/Contents/MacOS/%@", name, name];
+
+    NSMutableDictionary* info = [@{KEY_PATH:path, KEY_KEY:path, KEY_PROCESS_NAME:name, KEY_ACTION:@((0 == i % 3) ? RULE_STATE_BLOCK : RULE_STATE_ALLOW), KEY_TYPE:@(type)} mutableCopy];
+    info[KEY_ENDPOINT_ADDR] = (0 == i % 4) ? VALUE_ANY : [NSString stringWithFormat:@"api%lu.example.com", (unsigned long)i];
+    info[KEY_ENDPOINT_PORT] = (0 == i % 5) ? VALUE_ANY : [NSString stringWithFormat:@"%lu", (unsigned long)(1 + i % 65535)];
+    info[KEY_CS_INFO] = @{KEY_CS_ID:[NSString stringWithFormat:@"com.example.%lu", (unsigned long)i], KEY_CS_STATUS:@(0 == i % 2 ? 0 : -67062), KEY_CS_SIGNER:@(i % 4), KEY_CS_AUTHS:@[@"Developer ID Application: \"Example\"", @"Developer ID Certification Authority", @"Apple Root CA"]};
+
+    Rule* rule = [[Rule alloc] init:info];
+
+    //(whole second) creation
+    // as exports are only to the second
+    rule.creation = [NSDate dateWithTimeIntervalSince1970:1700000000 + i];
+    if(0 == i % 7) rule.expiration = [NSDate dateWithTimeIntervalSince1970:1800000000 + i];
+    if(0 == i % 6) rule.isDisabled = @1;
+    if(0 == i % 8) rule.protocol = @(IPPROTO_TCP);
+    if(0 == i % 9) rule.endpointHost = @"host.example.com";
+
+    return rule;
+}
+
+//rule's (exported) fields
+// normalized, so a round trip should be identical
+static NSDictionary* fields(Rule* rule)
+{
+    NSMutableDictionary* f = [NSMutableDictionary dictionary];
+    f[@"key"] = rule.key ?: @"";
+    f[@"uuid"] = rule.uuid ?: @"";
+    f[@"path"] = rule.path ?: @"";
+    f[@"name"] = rule.name ?: @"";
+    f[@"addr"] = rule.endpointAddr ?: @"";
+    f[@"host"] = rule.endpointHost ?: @"";
+    f[@"port"] = rule.endpointPort ?: @"";
+    f[@"regex"] = @(rule.isEndpointAddrRegex);
+    f[@"protocol"] = @(rule.protocol.intValue);
+    f[@"type"] = @(rule.type.intValue);
+    f[@"disabled"] = @(rule.isDisabled.intValue);
+    f[@"scope"] = @(rule.scope.intValue);
+    f[@"action"] = @(rule.action.intValue);
+    f[@"creation"] = @((long long)rule.creation.timeIntervalSince1970);
+    f[@"expiration"] = @((long long)rule.expiration.timeIntervalSince1970);
+    f[@"csInfo"] = rule.csInfo ?: @{};
+    return f;
+}
+
+//export (to memory)
+static NSData* exportRules(NSDictionary* rules, BOOL userOnly, RulesWriter** writer)
+{
+    NSOutputStream* stream = [NSOutputStream outputStreamToMemory];
+    *writer = [[RulesWriter alloc] init:stream];
+    if(YES != [*writer write:rules userOnly:userOnly]) return nil;
+    return [stream propertyForKey:NSStreamDataWrittenToMemoryStreamKey];
+}
+
+//import (from memory)
+// returns rules (by key), or nil if malformed
+static NSDictionary* importRules(NSData* data, RulesReader** reader)
+{
+    NSMutableDictionary* rules = [NSMutableDictionary dictionary];
+    *reader = [[RulesReader alloc] init:[NSInputStream inputStreamWithData:data]];
+    BOOL ok = [*reader read:^(NSString* key, Rule* rule) {
+        if(nil == rules[key]) rules[key] = [NSMutableArray array];
+        [rules[key] addObject:rule];
+    }];
+    return ok ? rules : nil;
+}
+
+//add rules (by key)
+static void addRules(NSMutableDictionary* rules, NSArray<Rule*>* list)
+{
+    for(Rule* rule in list) {
+        if(nil == rules[rule.key]) rules[rule.key] = [@{KEY_RULES:[NSMutableArray array]} mutableCopy];
+        [rules[rule.key][KEY_RULES] addObject:rule];
+    }
+}
+
+//archive rules
+// as the app sends them to the daemon
+static NSData* archive(NSDictionary* rules)
+{
+    return [NSKeyedArchiver archivedDataWithRootObject:rules requiringSecureCoding:YES error:nil];
+}
+
+int main(int argc, const char * argv[]) {
+    @autoreleasepool {
+
+        NSLog(@"🧪 Rules Import/Export Test Suite");
+        NSLog(@"=================================");
+
+        logHandle = os_log_create("com.objective-see.lulu.tests", "RulesImportExport");
+
+        int testsPassed = 0;
+        int totalTests = 0;
+
+        //rules
+        // enough so the export spans many (writer & reader) chunks
+        NSMutableDictionary* rules = [NSMutableDictionary dictionary];
+        NSMutableArray<Rule*>* list = [NSMutableArray array];
+        for(NSUInteger i = 0; i < 5000; i++) [list addObject:makeRule(i, (0 == i % 10) ? RULE_TYPE_DEFAULT : RULE_TYPE_USER)];
+        addRules(rules, list);
+
+        // Test 1: Round trip (field for field)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 1: export -> import round trip (%lu rules)", (unsigned long)list.count);
+
+            RulesWriter* writer = nil;
+            RulesReader* reader = nil;
+            NSData* data = exportRules(rules, NO, &writer);
+            NSDictionary* imported = importRules(data, &reader);
+
+            NSMutableArray* mismatched = [NSMutableArray array];
+            NSUInteger compared = 0;
+            for(NSString* key in rules) {
+                NSArray* original = rules[key][KEY_RULES];
+                NSArray* roundTripped = imported[key];
+                if(original.count != roundTripped.count) { [mismatched addObject:key]; continue; }
+                for(NSUInteger i = 0; i < original.count; i++) {
+                    compared++;
+                    if(YES != [fields(original[i]) isEqualToDictionary:fields(roundTripped[i])]) {
+                        [mismatched addObject:key];
+                        NSLog(@"   %@\n   vs. %@", fields(original[i]), fields(roundTripped[i]));
+                        break;
+                    }
+                }
+            }
+
+            if( (nil != data) &&
+                (data.length == writer.size) &&
+                (data.length > RULES_READER_CHUNK_SIZE) &&
+                (list.count == writer.count) &&
+                (list.count == reader.count) &&
+                (0 == reader.invalid) &&
+                (list.count == compared) &&
+                (0 == mismatched.count) ) {
+                NSLog(@"✅ PASS: %lu rules (%lu bytes) round trip", (unsigned long)reader.count, (unsigned long)data.length);
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: written: %lu, read: %lu (%lu invalid), mismatched: %@", (unsigned long)writer.count, (unsigned long)reader.count, (unsigned long)reader.invalid, mismatched);
+            }
+        }
+
+        // Test 2: Export is (standard) JSON
+        // i.e. readable by NSJSONSerialization (as before), w/ the same (rule) dictionaries
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 2: export parses as JSON");
+
+            RulesWriter* writer = nil;
+            NSData* data = exportRules(rules, NO, &writer);
+            NSDictionary* json = [NSJSONSerialization JSONObjectWithData:data options:0 error:nil];
+
+            BOOL ok = [json isKindOfClass:[NSDictionary class]] && (rules.count == json.count);
+            for(NSString* key in rules) {
+                if(YES != ok) break;
+                Rule* rule = [rules[key][KEY_RULES] firstObject];
+                Rule* parsed = [[Rule alloc] initFromJSON:[json[key] firstObject]];
+                ok = (nil != parsed) && [fields(rule) isEqualToDictionary:fields(parsed)];
+            }
+
+            if(YES == ok) {
+                NSLog(@"✅ PASS: %lu items parsed", (unsigned long)json.count);
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: export isn't (equivalent) JSON");
+            }
+        }
+
+        // Test 3: User only export
+        // skips temporary, & non-user rules, & items w/o any (remaining) rules
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 3: user only export");
+
+            NSMutableDictionary* mixed = [NSMutableDictionary dictionary];
+            Rule* user = makeRule(1, RULE_TYPE_USER);
+            Rule* baseline = makeRule(2, RULE_TYPE_DEFAULT);
+            Rule* temporary = [[Rule alloc] init:@{KEY_PATH:@"/bin/temp", KEY_KEY:@"/bin/temp", KEY_PROCESS_NAME:@"temp", KEY_ACTION:@RULE_STATE_ALLOW, KEY_TYPE:@RULE_TYPE_USER, KEY_DURATION:@(RuleDurationProcess), KEY_PROCESS_ID:@1234}];
+            addRules(mixed, @[user, baseline, temporary]);
+
+            RulesWriter* writer = nil;
+            RulesReader* reader = nil;
+            NSDictionary* all = importRules(exportRules(mixed, NO, &writer), &reader);
+            NSUInteger allCount = writer.count;
+            NSDictionary* userOnly = importRules(exportRules(mixed, YES, &writer), &reader);
+
+            if( (2 == allCount) &&
+                (2 == all.count) &&
+                (1 == writer.count) &&
+                (1 == userOnly.count) &&
+                (nil != userOnly[user.key]) ) {
+                NSLog(@"✅ PASS: temp & non-user rules skipped");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: all: %lu, user only: %lu (%@)", (unsigned long)allCount, (unsigned long)writer.count, userOnly);
+            }
+        }
+
+        // Test 4: Malformed documents (and invalid rules)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 4: validation while parsing");
+
+            NSString* valid = @"{\"key\" : \"k\", \"uuid\" : \"u\", \"path\" : \"/p\", \"name\" : \"n\", \"endpointAddr\" : \"*\", \"endpointPort\" : \"*\", \"type\" : 3, \"scope\" : 0, \"action\" : 1}";
+            NSString* invalid = @"{\"key\" : \"k\", \"uuid\" : \"u\", \"path\" : \"/p\", \"name\" : \"n\", \"endpointAddr\" : \"*\", \"endpointPort\" : \"http\", \"type\" : 3, \"scope\" : 0, \"action\" : 1}";
+
+            //documents, & whether they should be read
+            NSArray* documents = @[
+                @[@"{}", @YES],
+                @[@" \n{ } \n", @YES],
+                @[@"\xEF\xBB\xBF{}", @YES],
+                @[[NSString stringWithFormat:@"{\"a\\\"b\" : [%@]}", valid], @YES],
+                @[[NSString stringWithFormat:@"{\"a\" : [%@, %@], \"b\" : []}", valid, invalid], @YES],
+                @[@"", @NO],
+                @[@"[]", @NO],
+                @[@"{", @NO],
+                @[[NSString stringWithFormat:@"{\"a\" : [%@", valid], @NO],
+                @[[NSString stringWithFormat:@"{\"a\" : [%@,]}", valid], @NO],
+                @[[NSString stringWithFormat:@"{\"a\" : [%@],}", valid], @NO],
+                @[[NSString stringWithFormat:@"{\"a\" : [%@]} x", valid], @NO],
+                @[@"{\"a\" : [{\"key\" : }]}", @NO],
+                @[@"{\"a\" : {}}", @NO],
+                @[@"{\"a\" [ ]}", @NO],
+            ];
+
+            NSMutableArray* failed = [NSMutableArray array];
+            for(NSArray* document in documents) {
+                RulesReader* reader = nil;
+                NSDictionary* imported = importRules([document[0] dataUsingEncoding:NSUTF8StringEncoding], &reader);
+                if( (nil != imported) != [document[1] boolValue]) [failed addObject:document[0]];
+            }
+
+            //valid & invalid rule
+            // invalid is skipped (& counted), escaped key is unescaped
+            RulesReader* reader = nil;
+            NSDictionary* imported = importRules([[NSString stringWithFormat:@"{\"a\\\"b\" : [%@, %@]}", valid, invalid] dataUsingEncoding:NSUTF8StringEncoding], &reader);
+
+            if( (0 == failed.count) &&
+                (1 == reader.count) &&
+                (1 == reader.invalid) &&
+                (1 == [imported[@"a\"b"] count]) ) {
+                NSLog(@"✅ PASS: %lu documents validated", (unsigned long)documents.count);
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: failed: %@, read: %lu, invalid: %lu", failed, (unsigned long)reader.count, (unsigned long)reader.invalid);
+            }
+        }
+
+        // Test 5: Bulk (user only) import
+        // non-user rules are kept, user rules replaced, one save, & new index swapped in
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 5: bulk import");
+
+            TestRules* current = [[TestRules alloc] init];
+            Rule* baseline = makeRule(1, RULE_TYPE_DEFAULT);
+            Rule* oldUser = makeRule(1, RULE_TYPE_USER);
+            Rule* otherUser = makeRule(2, RULE_TYPE_USER);
+            [current add:baseline save:NO];
+            [current add:oldUser save:NO];
+            [current add:otherUser save:NO];
+            RuleIndex* index = current.compiledRules;
+
+            //import
+            // one rule for an existing item, & one for a new one
+            NSMutableDictionary* importing = [NSMutableDictionary dictionary];
+            Rule* newUser = makeRule(1, RULE_TYPE_USER);
+            Rule* newItem = makeRule(3, RULE_TYPE_USER);
+            addRules(importing, @[newUser, newItem]);
+
+            BOOL imported = [current import:archive(importing) userOnly:YES];
+            NSArray* item = current.rules[baseline.key][KEY_RULES];
+
+            if( (YES == imported) &&
+                (1 == current.saves) &&
+                (2 == current.rules.count) &&
+                (2 == item.count) &&
+                (YES == [item containsObject:baseline]) &&
+                (YES == [[item valueForKey:@"uuid"] containsObject:newUser.uuid]) &&
+                (nil == current.rules[otherUser.key]) &&
+                (nil != current.rules[newItem.key][KEY_PATHS]) &&
+                (index != current.compiledRules) ) {
+                NSLog(@"✅ PASS: merged, saved once, reindexed");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: imported: %d, saves: %lu, rules: %@", imported, (unsigned long)current.saves, current.rules);
+            }
+
+            //full import
+            // replaces all
+            current.saves = 0;
+            imported = [current import:archive(importing) userOnly:NO];
+
+            totalTests++;
+            if( (YES == imported) &&
+                (1 == current.saves) &&
+                (2 == current.rules.count) &&
+                (1 == [current.rules[baseline.key][KEY_RULES] count]) ) {
+                NSLog(@"✅ PASS: full import replaced all rules");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: imported: %d, saves: %lu, rules: %@", imported, (unsigned long)current.saves, current.rules);
+            }
+        }
+
+        // Benchmark: throughput at 100k rules
+        // streaming writer/reader vs. (old) whole document NSJSONSerialization
+        {
+            NSLog(@"\n⏱  Benchmark: import/export throughput (100k rules)");
+
+            NSMutableDictionary* many = [NSMutableDictionary dictionary];
+            NSMutableArray* manyList = [NSMutableArray array];
+            for(NSUInteger i = 0; i < 100000; i++) [manyList addObject:makeRule(i, RULE_TYPE_USER)];
+            addRules(many, manyList);
+
+            //export
+            RulesWriter* writer = nil;
+            NSDate* start = [NSDate date];
+            NSData* data = exportRules(many, NO, &writer);
+            NSTimeInterval took = [[NSDate date] timeIntervalSinceDate:start];
+            NSLog(@"   export: %.0f ms (%.0f rules/s, %.1f MB)", took * 1000, writer.count / took, data.length / 1e6);
+
+            //import (streaming)
+            RulesReader* reader = nil;
+            start = [NSDate date];
+            NSDictionary* imported = importRules(data, &reader);
+            took = [[NSDate date] timeIntervalSinceDate:start];
+            NSLog(@"   import: %.0f ms (%.0f rules/s, %lu items)", took * 1000, reader.count / took, (unsigned long)imported.count);
+
+            //import (whole document)
+            // as before: all of it deserialized, then each rule created
+            start = [NSDate date];
+            NSUInteger count = 0;
+            @autoreleasepool {
+                NSDictionary* json = [NSJSONSerialization JSONObjectWithData:data options:0 error:nil];
+                for(NSString* key in json) {
+                    for(NSDictionary* info in json[key]) count += (nil != [[Rule alloc] initFromJSON:info]);
+                }
+            }
+            took = [[NSDate date] timeIntervalSinceDate:start];
+            NSLog(@"   import (whole document): %.0f ms (%lu rules)", took * 1000, (unsigned long)count);
+
+            //bulk import (into daemon's rules)
+            TestRules* current = [[TestRules alloc] init];
+            start = [NSDate date];
+            [current import:archive(many) userOnly:YES];
+            took = [[NSDate date] timeIntervalSinceDate:start];
+            NSLog(@"   bulk import: %.0f ms (%lu items, %lu save)", took * 1000, (unsigned long)current.rules.count, (unsigned long)current.saves);
+        }
+
+        // Test Results Summary
+        NSLog(@"\n🏁 Rules Import/Export Test Results");
+        NSLog(@"==================================");
+        NSLog(@"Tests Passed: %d/%d", testsPassed, totalTests);
+
+        if (testsPassed == totalTests) {
+            NSLog(@"✅ ALL TESTS PASSED!");
+            return 0;
+        } else {
+            NSLog(@"❌ %d tests failed. Please check implementation.", totalTests - testsPassed);
+            return 1;
+        }
+    }
+}
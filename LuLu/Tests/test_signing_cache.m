@@ -0,0 +1,178 @@
+//
+//  test_signing_cache.m
+//  LuLu
+//
+//  Tests for the (code) signing result cache, using a fake signer
+//  builds against the real SigningCache.m (no Security framework calls, so no signed binaries needed)
+//
+
+#import <Foundation/Foundation.h>
+
+#import "consts.h"
+#import "SigningCache.h"
+
+//log handle
+os_log_t logHandle = nil;
+
+//number of times (fake) signer ran
+static int signed_ = 0;
+
+//fake signer
+// 'validates' anything, or fails if asked to
+static SigningInfoGenerator fakeSigner(BOOL valid)
+{
+    return ^NSMutableDictionary*{
+        signed_++;
+        if(YES != valid) return [@{KEY_CS_STATUS:@(-67062)} mutableCopy];
+        return [@{KEY_CS_STATUS:@0, KEY_CS_SIGNER:@1, KEY_CS_ID:@"com.example.tool"} mutableCopy];
+    };
+}
+
+int main(int argc, const char * argv[]) {
+    @autoreleasepool {
+
+        NSLog(@"🧪 Signing Cache Test Suite");
+        NSLog(@"===========================");
+
+        logHandle = os_log_create("com.objective-see.lulu.tests", "SigningCache");
+
+        int testsPassed = 0;
+        int totalTests = 0;
+
+        NSString* tool = [NSTemporaryDirectory() stringByAppendingPathComponent:@"test_signing_cache_tool"];
+        NSString* file = [NSTemporaryDirectory() stringByAppendingPathComponent:@"test_signing_cache.plist"];
+        [@"v1" writeToFile:tool atomically:YES encoding:NSUTF8StringEncoding error:nil];
+        [NSFileManager.defaultManager removeItemAtPath:file error:nil];
+
+        SigningCache* cache = [[SigningCache alloc] init:file];
+
+        // Test 1: Miss, then hit
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 1: miss then hit");
+
+            signed_ = 0;
+            NSDictionary* first = [cache signingInfo:tool token:NULL flags:0 generator:fakeSigner(YES)];
+            NSDictionary* second = [cache signingInfo:tool token:NULL flags:0 generator:fakeSigner(YES)];
+
+            if( (1 == signed_) && (YES == [first isEqualToDictionary:second]) &&
+                (1 == cache.hits) && (1 == cache.misses) ) {
+                NSLog(@"✅ PASS: signed once, then cached");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: signed %d times (hits: %llu, misses: %llu)", signed_, cache.hits, cache.misses);
+            }
+        }
+
+        // Test 2: Flags are part of the key
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 2: flags");
+
+            signed_ = 0;
+            [cache signingInfo:tool token:NULL flags:4 generator:fakeSigner(YES)];
+
+            if(1 == signed_) {
+                NSLog(@"✅ PASS: different flags re-signed");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: different flags hit");
+            }
+        }
+
+        // Test 3: Changed file misses (and old entry is dropped)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 3: invalidation on change");
+
+            //replace file (new inode, size, & mtime)
+            [@"version 2" writeToFile:tool atomically:YES encoding:NSUTF8StringEncoding error:nil];
+
+            signed_ = 0;
+            NSUInteger before = cache.count;
+            [cache signingInfo:tool token:NULL flags:0 generator:fakeSigner(YES)];
+
+            if( (1 == signed_) && (1 == cache.invalidations) && (before == cache.count) ) {
+                NSLog(@"✅ PASS: changed file re-signed, old entry dropped");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: signed %d times, invalidations: %llu, count: %lu -> %lu", signed_, cache.invalidations, (unsigned long)before, (unsigned long)cache.count);
+            }
+        }
+
+        // Test 4: Failures aren't cached
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 4: failures not cached");
+
+            signed_ = 0;
+            [cache signingInfo:tool token:NULL flags:8 generator:fakeSigner(NO)];
+            [cache signingInfo:tool token:NULL flags:8 generator:fakeSigner(NO)];
+
+            if(2 == signed_) {
+                NSLog(@"✅ PASS: failed result re-checked");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: failed result cached");
+            }
+        }
+
+        // Test 5: Persistence
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 5: save & reload");
+
+            [cache save];
+            SigningCache* reloaded = [[SigningCache alloc] init:file];
+
+            signed_ = 0;
+            [reloaded signingInfo:tool token:NULL flags:0 generator:fakeSigner(YES)];
+
+            if( (0 == signed_) && (cache.count == reloaded.count) && (1 == reloaded.hits) ) {
+                NSLog(@"✅ PASS: %lu results reloaded", (unsigned long)reloaded.count);
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: reloaded %lu results, signed %d times", (unsigned long)reloaded.count, signed_);
+            }
+        }
+
+        // Test 6: Bounded
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 6: bounded size");
+
+            SigningCache* bounded = [[SigningCache alloc] init:nil];
+            for(uint32_t flags = 0; flags < SIGNING_CACHE_COUNT_LIMIT + 500; flags++) {
+                [bounded signingInfo:tool token:NULL flags:flags generator:fakeSigner(YES)];
+            }
+
+            signed_ = 0;
+            [bounded signingInfo:tool token:NULL flags:SIGNING_CACHE_COUNT_LIMIT + 499 generator:fakeSigner(YES)];
+
+            if( (bounded.count <= SIGNING_CACHE_COUNT_LIMIT) && (0 == signed_) ) {
+                NSLog(@"✅ PASS: %lu entries (most recent kept)", (unsigned long)bounded.count);
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: %lu entries", (unsigned long)bounded.count);
+            }
+        }
+
+        NSLog(@"\n📊 hit rate: %.1f%% (hits: %llu, misses: %llu)", 100.0 * cache.hits / MAX(1, cache.hits + cache.misses), cache.hits, cache.misses);
+
+        [NSFileManager.defaultManager removeItemAtPath:tool error:nil];
+        [NSFileManager.defaultManager removeItemAtPath:file error:nil];
+
+        // Test Results Summary
+        NSLog(@"\n🏁 Signing Cache Test Results");
+        NSLog(@"=============================");
+        NSLog(@"Tests Passed: %d/%d", testsPassed, totalTests);
+
+        if (testsPassed == totalTests) {
+            NSLog(@"✅ ALL TESTS PASSED!");
+            return 0;
+        } else {
+            NSLog(@"❌ %d tests failed. Please check implementation.", totalTests - testsPassed);
+            return 1;
+        }
+    }
+}
@@ -0,0 +1,213 @@
+//
+//  test_tree_rules.m
+//  LuLu
+//
+//  Tests (and a deep process tree benchmark) for tree ('process + kids') rule lookups by canonical path
+//  builds against the real RuleIndex.m (and utilities.m, for 'canonicalPath'), with a minimal Rule stand-in
+//
+
+#import <Foundation/Foundation.h>
+
+#import "Rule.h"
+#import "utilities.h"
+#import "RuleIndex.h"
+
+//log handle
+os_log_t logHandle = nil;
+
+// Minimal Rule implementation
+// only what the index touches
+@implementation Rule
+
+@synthesize key, uuid, pid, path, scope, isDisabled, endpointAddr, endpointPort, isEndpointAddrRegex;
+
+-(NSNumber*)isDirectory
+{
+    return @NO;
+}
+
+-(void)setIsDirectory:(NSNumber*)isDirectory
+{
+    return;
+}
+
+-(NSString*)canonicalPath
+{
+    if(nil == _canonicalPath) _canonicalPath = canonicalPath(self.path);
+    return _canonicalPath;
+}
+
+@end
+
+//make a tree rule
+static Rule* makeTreeRule(NSString* path)
+{
+    Rule* rule = [[Rule alloc] init];
+    rule.path = path;
+    rule.key = path;
+    rule.uuid = [[NSUUID UUID] UUIDString];
+    rule.endpointAddr = VALUE_ANY;
+    rule.endpointPort = VALUE_ANY;
+    rule.scope = @ACTION_SCOPE_PROCESS_TREE;
+    return rule;
+}
+
+//add a rule to a rules dictionary
+static void addRule(NSMutableDictionary* rules, Rule* rule)
+{
+    if(nil == rules[rule.key])
+    {
+        rules[rule.key] = [@{KEY_RULES:[NSMutableArray array]} mutableCopy];
+    }
+    [rules[rule.key][KEY_RULES] addObject:rule];
+}
+
+//tree lookup, as 'find' did before
+// resolves each ancestor's path, on every flow
+static NSUInteger legacyLookup(RuleIndex* index, NSArray* ancestors)
+{
+    NSUInteger found = 0;
+    for(NSDictionary* ancestor in ancestors)
+    {
+        found += (nil != index.treeRules[[ancestor[KEY_PROCESS_PATH] stringByResolvingSymlinksInPath]]);
+    }
+    return found;
+}
+
+//resolve ancestors once
+// as 'Process' does
+static NSArray* canonicalAncestors(NSArray* ancestors)
+{
+    NSMutableArray* resolved = [NSMutableArray array];
+    for(NSDictionary* ancestor in ancestors)
+    {
+        [resolved addObject:@{KEY_PROCESS_ID:ancestor[KEY_PROCESS_ID], KEY_PROCESS_PATH:canonicalPath(ancestor[KEY_PROCESS_PATH])}];
+    }
+    return resolved;
+}
+
+int main(int argc, const char * argv[]) {
+    @autoreleasepool {
+
+        NSLog(@"🧪 Tree Rules Test Suite");
+        NSLog(@"========================");
+
+        logHandle = os_log_create("com.objective-see.lulu.tests", "TreeRules");
+
+        int testsPassed = 0;
+        int totalTests = 0;
+
+        //temp dir w/ a binary & a symlink to it
+        NSString* directory = [[NSTemporaryDirectory() stringByResolvingSymlinksInPath] stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+        NSString* binary = [directory stringByAppendingPathComponent:@"shell"];
+        NSString* link = [directory stringByAppendingPathComponent:@"sh"];
+
+        [NSFileManager.defaultManager createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:nil];
+        [NSData.data writeToFile:binary atomically:YES];
+        [NSFileManager.defaultManager createSymbolicLinkAtPath:link withDestinationPath:binary error:nil];
+
+        // Test 1: Canonical paths are resolved (& cached)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 1: canonical paths");
+
+            NSString* first = canonicalPath(link);
+            NSString* second = canonicalPath(link);
+
+            if( (YES == [first isEqualToString:binary]) &&
+                (first == second) &&
+                (nil == canonicalPath(nil)) ) {
+                NSLog(@"✅ PASS: canonical path resolved & cached");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: canonical path: %@", first);
+            }
+        }
+
+        // Test 2: Tree rules keyed by canonical path
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 2: tree rules via symlinked rule & ancestor paths");
+
+            NSMutableDictionary* rules = [NSMutableDictionary dictionary];
+            Rule* tree = makeTreeRule(link);
+            addRule(rules, tree);
+
+            RuleIndex* index = [[RuleIndex alloc] init:rules];
+            NSArray* ancestors = canonicalAncestors(@[@{KEY_PROCESS_ID:@42, KEY_PROCESS_PATH:link}]);
+
+            if( (tree == [index.treeRules[binary] rules].firstObject) &&
+                (nil != index.treeRules[ancestors.firstObject[KEY_PROCESS_PATH]]) ) {
+                NSLog(@"✅ PASS: tree rule found by canonical path");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: tree rules: %@", index.treeRules);
+            }
+        }
+
+        // Benchmark: deep process trees
+        {
+            NSLog(@"\n⏱  Benchmark: 500 tree rules, 200 processes (40 ancestors), 50 flows each");
+
+            NSMutableDictionary* rules = [NSMutableDictionary dictionary];
+            for(int i = 0; i < 500; i++) addRule(rules, makeTreeRule([NSString stringWithFormat:@"/Applications/IDE%d.app/Contents/MacOS/IDE", i]));
+            addRule(rules, makeTreeRule(link));
+
+            RuleIndex* index = [[RuleIndex alloc] init:rules];
+
+            NSMutableArray* processes = [NSMutableArray array];
+            for(int p = 0; p < 200; p++)
+            {
+                NSMutableArray* ancestors = [NSMutableArray array];
+                for(int depth = 0; depth < 40; depth++)
+                {
+                    NSString* path = (0 == depth % 4) ? link : [NSString stringWithFormat:@"/usr/local/bin/tool%d", depth];
+                    if(39 == depth) path = [NSString stringWithFormat:@"/Applications/IDE%d.app/Contents/MacOS/IDE", p];
+                    [ancestors addObject:@{KEY_PROCESS_ID:@(1000 + depth), KEY_PROCESS_PATH:path}];
+                }
+                [processes addObject:ancestors];
+            }
+
+            NSUInteger found = 0;
+            NSDate* start = [NSDate date];
+            for(NSArray* ancestors in processes)
+            {
+                for(int flow = 0; flow < 50; flow++) found += legacyLookup(index, ancestors);
+            }
+            NSLog(@"   per-flow resolution: %.2f ms (%lu hits)", [[NSDate date] timeIntervalSinceDate:start] * 1000, (unsigned long)found);
+
+            found = 0;
+            start = [NSDate date];
+            for(NSArray* ancestors in processes)
+            {
+                //once per process
+                NSArray* resolved = canonicalAncestors(ancestors);
+                NSMutableArray* treeRules = [NSMutableArray array];
+                for(NSDictionary* ancestor in resolved)
+                {
+                    RuleBucket* bucket = index.treeRules[ancestor[KEY_PROCESS_PATH]];
+                    if(nil != bucket) [treeRules addObject:@[bucket, ancestor[KEY_PROCESS_ID]]];
+                }
+
+                //per flow: cached
+                for(int flow = 0; flow < 50; flow++) found += treeRules.count;
+            }
+            NSLog(@"   per-process (canonical, cached): %.2f ms (%lu hits)", [[NSDate date] timeIntervalSinceDate:start] * 1000, (unsigned long)found);
+        }
+
+        [NSFileManager.defaultManager removeItemAtPath:directory error:nil];
+
+        // Test Results Summary
+        NSLog(@"\n🏁 Tree Rules Test Results");
+        NSLog(@"=========================");
+        NSLog(@"Tests Passed: %d/%d", testsPassed, totalTests);
+
+        if (testsPassed == totalTests) {
+            NSLog(@"✅ ALL TESTS PASSED!");
+            return 0;
+        } else {
+            NSLog(@"❌ %d tests failed. Please check implementation.", totalTests - testsPassed);
+            return 1;
+        }
+    }
+}
@@ -0,0 +1,181 @@
+//
+//  test_verdict_cache.m
+//  LuLu
+//
+//  Tests (and a replay benchmark) for the flow verdict cache
+//  builds against the real VerdictCache.m (and ListMatcher.m & utilities.m, for the benchmark's decision chain)
+//
+
+#import <Foundation/Foundation.h>
+
+#import "utilities.h"
+#import "ListMatcher.h"
+#import "VerdictCache.h"
+
+//log handle
+os_log_t logHandle = nil;
+
+//(uncached) decision
+// stand-in for the extension's chain: console user, alive check, block & allow lists
+static NSInteger decide(ListMatcher* blockList, ListMatcher* allowList, NSSet* names)
+{
+    (void)getConsoleUser();
+    if(YES != isAlive(getpid())) return 1;
+    if(nil != [blockList match:names]) return 1;
+    if(nil != [allowList match:names]) return 0;
+    return 0;
+}
+
+int main(int argc, const char * argv[]) {
+    @autoreleasepool {
+
+        NSLog(@"🧪 Verdict Cache Test Suite");
+        NSLog(@"===========================");
+
+        logHandle = os_log_create("com.objective-see.lulu.tests", "VerdictCache");
+
+        int testsPassed = 0;
+        int totalTests = 0;
+
+        // Test 1: Miss, then hit
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 1: miss then hit");
+
+            VerdictCache* cache = [[VerdictCache alloc] init];
+            NSInteger verdict = -1;
+
+            BOOL missed = (NO == [cache lookup:@"1:1|evil.com|443|6" verdict:&verdict]);
+            [cache store:@"1:1|evil.com|443|6" verdict:1 generation:cache.generation];
+            BOOL hit = [cache lookup:@"1:1|evil.com|443|6" verdict:&verdict];
+
+            if( (YES == missed) && (YES == hit) && (1 == verdict) &&
+                (1 == cache.hits) && (1 == cache.misses) ) {
+                NSLog(@"✅ PASS: miss, store, hit");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: hits: %llu, misses: %llu, verdict: %ld", cache.hits, cache.misses, (long)verdict);
+            }
+        }
+
+        // Test 2: Invalidation (generation bump)
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 2: invalidation");
+
+            VerdictCache* cache = [[VerdictCache alloc] init];
+            NSInteger verdict = -1;
+
+            [cache store:@"key" verdict:0 generation:cache.generation];
+            [cache invalidate];
+
+            if(NO == [cache lookup:@"key" verdict:&verdict]) {
+                NSLog(@"✅ PASS: stale verdict not returned");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: stale verdict returned");
+            }
+        }
+
+        // Test 3: Verdicts evaluated across a change aren't cached
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 3: change during evaluation");
+
+            VerdictCache* cache = [[VerdictCache alloc] init];
+            NSInteger verdict = -1;
+
+            uint64_t generation = cache.generation;
+            [cache invalidate];
+            [cache store:@"key" verdict:1 generation:generation];
+
+            if(NO == [cache lookup:@"key" verdict:&verdict]) {
+                NSLog(@"✅ PASS: verdict from older generation dropped");
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: verdict from older generation cached");
+            }
+        }
+
+        // Test 4: Bounded
+        {
+            totalTests++;
+            NSLog(@"\n📋 Test 4: bounded size");
+
+            VerdictCache* cache = [[VerdictCache alloc] init];
+            NSInteger verdict = -1;
+            NSUInteger cached = 0;
+            int count = VERDICT_CACHE_SHARDS * VERDICT_CACHE_SHARD_SIZE * 4;
+
+            for(int i = 0; i < count; i++) {
+                [cache store:[NSString stringWithFormat:@"key%d", i] verdict:0 generation:cache.generation];
+            }
+            for(int i = 0; i < count; i++) {
+                cached += [cache lookup:[NSString stringWithFormat:@"key%d", i] verdict:&verdict];
+            }
+
+            if( (0 != cached) && (cached <= VERDICT_CACHE_SHARDS * VERDICT_CACHE_SHARD_SIZE) ) {
+                NSLog(@"✅ PASS: %lu of %d verdicts retained", (unsigned long)cached, count);
+                testsPassed++;
+            } else {
+                NSLog(@"❌ FAIL: %lu of %d verdicts retained", (unsigned long)cached, count);
+            }
+        }
+
+        // Benchmark: replay of repeated flows (w/ and w/o cache)
+        {
+            NSLog(@"\n⏱  Benchmark: 100k flows (500 distinct)");
+
+            NSMutableString* list = [NSMutableString string];
+            for(int i = 0; i < 100000; i++) {
+                [list appendFormat:@"host%d.example.com\n*.ads%d.net\n", i, i];
+            }
+            ListMatcher* blockList = [[ListMatcher alloc] init:list];
+            ListMatcher* allowList = [[ListMatcher alloc] init:@"apple.com\n*.icloud.com\n"];
+
+            NSMutableArray* flows = [NSMutableArray array];
+            for(int i = 0; i < 500; i++) {
+                NSString* host = [NSString stringWithFormat:@"cdn%d.ads%d.net", i, i * 7];
+                [flows addObject:@[[NSString stringWithFormat:@"%d:1|%@|443|6", 100 + (i % 20), host], [NSSet setWithObject:host]]];
+            }
+
+            NSUInteger blocked = 0;
+            NSDate* start = [NSDate date];
+            for(int i = 0; i < 100000; i++) {
+                NSArray* flow = flows[i % flows.count];
+                blocked += decide(blockList, allowList, flow[1]);
+            }
+            NSTimeInterval uncached = [[NSDate date] timeIntervalSinceDate:start];
+            NSLog(@"   uncached: %.2f µs/flow (%lu blocked)", uncached * 1000000 / 100000, (unsigned long)blocked);
+
+            VerdictCache* cache = [[VerdictCache alloc] init];
+            blocked = 0;
+            start = [NSDate date];
+            for(int i = 0; i < 100000; i++) {
+                NSArray* flow = flows[i % flows.count];
+                NSInteger verdict = 0;
+                if(YES != [cache lookup:flow[0] verdict:&verdict]) {
+                    uint64_t generation = cache.generation;
+                    verdict = decide(blockList, allowList, flow[1]);
+                    [cache store:flow[0] verdict:verdict generation:generation];
+                }
+                blocked += verdict;
+            }
+            NSTimeInterval cached = [[NSDate date] timeIntervalSinceDate:start];
+            NSLog(@"   cached:   %.2f µs/flow (%lu blocked, hits: %llu, misses: %llu)", cached * 1000000 / 100000, (unsigned long)blocked, cache.hits, cache.misses);
+        }
+
+        // Test Results Summary
+        NSLog(@"\n🏁 Verdict Cache Test Results");
+        NSLog(@"=============================");
+        NSLog(@"Tests Passed: %d/%d", testsPassed, totalTests);
+
+        if (testsPassed == totalTests) {
+            NSLog(@"✅ ALL TESTS PASSED!");
+            return 0;
+        } else {
+            NSLog(@"❌ %d tests failed. Please check implementation.", totalTests - testsPassed);
+            return 1;
+        }
+    }
+}